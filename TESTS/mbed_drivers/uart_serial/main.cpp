@@ -0,0 +1,203 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "utest/utest.h"
+#include "unity/unity.h"
+#include "greentea-client/test_env.h"
+
+#include "mbed.h"
+
+#if !DEVICE_SERIAL || !DEVICE_INTERRUPTIN
+#error [NOT_SUPPORTED] UARTSerial is not supported on this target.
+#endif
+
+/**
+ * UARTSerial tests require the TX and RX pins of a spare UART to be wired
+ * together, and the following macros to be defined (see template_mbed_app.txt):
+ * - MBED_CONF_APP_UART_LOOPBACK_TX - TX pin of the UART under test
+ * - MBED_CONF_APP_UART_LOOPBACK_RX - RX pin of the UART under test
+ * - MBED_CONF_APP_UART_LOOPBACK_BAUD - Baud rate of the transfers
+ *
+ * The throughput and the CPU load are reported for the buffers and transfer
+ * mode selected by the drivers.uart-serial-* configuration.
+ */
+#if !defined(MBED_CONF_APP_UART_LOOPBACK_TX) || !defined(MBED_CONF_APP_UART_LOOPBACK_RX) || !defined(MBED_CONF_APP_UART_LOOPBACK_BAUD)
+#error [NOT_SUPPORTED] MBED_CONF_APP_UART_LOOPBACK_TX, MBED_CONF_APP_UART_LOOPBACK_RX and MBED_CONF_APP_UART_LOOPBACK_BAUD have to be defined for this test.
+#endif
+
+using namespace utest::v1;
+
+#define TRANSFER_SIZE       (32 * 1024)
+#define WRITE_CHUNK         100
+#define CALIBRATION_MS      500
+#define THREAD_STACK_SIZE   768
+
+static UARTSerial *serial;
+
+static volatile uint32_t idle_count;
+static volatile bool idle_run;
+
+/* Runs whenever nothing else does, the CPU load is deduced from how much it
+ * counts during a transfer compared to an idle period. */
+static void idle_counter()
+{
+    while (idle_run) {
+        idle_count++;
+    }
+}
+
+static uint32_t idle_rate;
+
+static void writer()
+{
+    char chunk[WRITE_CHUNK];
+    uint32_t written = 0;
+
+    while (written < TRANSFER_SIZE) {
+        uint32_t size = 0;
+        while (size < WRITE_CHUNK && written + size < TRANSFER_SIZE) {
+            chunk[size] = (char)(written + size);
+            size++;
+        }
+
+        ssize_t ret = serial->write(chunk, size);
+        if (ret > 0) {
+            written += ret;
+        }
+    }
+}
+
+static ssize_t read_copy(uint32_t received, char *buffer, size_t length)
+{
+    ssize_t ret = serial->read(buffer, length);
+    TEST_ASSERT_TRUE(ret > 0);
+    for (ssize_t i = 0; i < ret; i++) {
+        TEST_ASSERT_EQUAL_UINT8((uint8_t)(received + i), (uint8_t)buffer[i]);
+    }
+    return ret;
+}
+
+#if UARTSERIAL_LOCK_FREE_BUFFERS
+static ssize_t read_in_place(uint32_t received, char *buffer, size_t length)
+{
+    const void *data;
+    ssize_t ret = serial->read_span(&data);
+    TEST_ASSERT_TRUE(ret > 0);
+
+    const char *bytes = static_cast<const char *>(data);
+    for (ssize_t i = 0; i < ret; i++) {
+        TEST_ASSERT_EQUAL_UINT8((uint8_t)(received + i), (uint8_t)bytes[i]);
+    }
+    serial->consume(ret);
+    return ret;
+}
+#endif
+
+template <ssize_t (*Read)(uint32_t, char *, size_t)>
+void test_loopback()
+{
+    char buffer[64];
+    uint32_t received = 0;
+    Timer timer;
+
+    Thread idle_thread(osPriorityLow, THREAD_STACK_SIZE);
+    Thread writer_thread(osPriorityNormal, THREAD_STACK_SIZE);
+
+    idle_count = 0;
+    idle_run = true;
+    idle_thread.start(idle_counter);
+
+    timer.start();
+    writer_thread.start(writer);
+    while (received < TRANSFER_SIZE) {
+        received += Read(received, buffer, sizeof(buffer));
+    }
+    timer.stop();
+
+    idle_run = false;
+    idle_thread.join();
+    writer_thread.join();
+
+    uint32_t elapsed_ms = timer.read_ms();
+    uint32_t idle_ms = idle_count / idle_rate;
+    uint32_t load = idle_ms < elapsed_ms ? 100 * (elapsed_ms - idle_ms) / elapsed_ms : 0;
+
+    printf("%u bytes at %u baud: %u ms, %u bytes/s, CPU load %u%%\r\n",
+           TRANSFER_SIZE, MBED_CONF_APP_UART_LOOPBACK_BAUD, elapsed_ms,
+           (uint32_t)(1000ULL * TRANSFER_SIZE / elapsed_ms), load);
+}
+
+/* A message shorter than a block is handed over once the line is idle,
+ * without waiting for more data. */
+void test_partial_block()
+{
+    const char message[] = "idle";
+    char buffer[sizeof(message)];
+    size_t received = 0;
+    Timer timer;
+
+    TEST_ASSERT_EQUAL(sizeof(message), serial->write(message, sizeof(message)));
+
+    serial->set_blocking(false);
+    timer.start();
+    while (received < sizeof(message) && timer.read_ms() < 100) {
+        ssize_t ret = serial->read(buffer + received, sizeof(buffer) - received);
+        if (ret > 0) {
+            received += ret;
+        } else {
+            wait_ms(1);
+        }
+    }
+    serial->set_blocking(true);
+
+    TEST_ASSERT_EQUAL(sizeof(message), received);
+    TEST_ASSERT_EQUAL(0, memcmp(message, buffer, sizeof(message)));
+}
+
+utest::v1::status_t test_setup(const size_t number_of_cases)
+{
+    GREENTEA_SETUP(120, "default_auto");
+
+    serial = new UARTSerial(MBED_CONF_APP_UART_LOOPBACK_TX, MBED_CONF_APP_UART_LOOPBACK_RX,
+                            MBED_CONF_APP_UART_LOOPBACK_BAUD);
+
+    /* Count idle loops while this thread sleeps to calibrate the CPU load. */
+    Thread idle_thread(osPriorityLow, THREAD_STACK_SIZE);
+    idle_count = 0;
+    idle_run = true;
+    idle_thread.start(idle_counter);
+    wait_ms(CALIBRATION_MS);
+    idle_run = false;
+    idle_thread.join();
+    idle_rate = idle_count / CALIBRATION_MS + 1;
+
+    return verbose_test_setup_handler(number_of_cases);
+}
+
+Case cases[] = {
+    Case("loopback with read()", test_loopback<read_copy>),
+#if UARTSERIAL_LOCK_FREE_BUFFERS
+    Case("loopback with read_span()", test_loopback<read_in_place>),
+#endif
+    Case("partial block after idle line", test_partial_block),
+};
+
+Specification specification(test_setup, cases);
+
+int main()
+{
+    return !Harness::run(specification);
+}
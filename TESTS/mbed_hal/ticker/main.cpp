@@ -25,6 +25,10 @@
 #include "mbed.h"
 #include "ticker_api.h"
 
+#if MBED_TICKER_HEAP_QUEUE
+#error [NOT_SUPPORTED] test inspects the sorted list queue, see ticker_queue test for the heap queue
+#endif
+
 using namespace utest::v1;
 
 #define MBED_ARRAY_SIZE(array) (sizeof(array)/sizeof(array[0]))
@@ -0,0 +1,237 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utest/utest.h"
+#include "unity/unity.h"
+#include "greentea-client/test_env.h"
+
+#include "mbed.h"
+#include "ticker_api.h"
+
+using namespace utest::v1;
+
+/*
+ * These tests drive the ticker API against a stubbed ticker interface and only
+ * rely on the observable behaviour of the queue, they are valid for both the
+ * list and the heap queue.
+ */
+
+#define EVENT_COUNT 200
+#define ROUND_COUNT 50
+#define OPERATION_COUNT 20
+
+static timestamp_t stub_timestamp;
+static uint32_t stub_read_call;
+
+static void stub_init() { }
+
+static uint32_t stub_read()
+{
+    ++stub_read_call;
+    return stub_timestamp;
+}
+
+static void stub_disable_interrupt() { }
+static void stub_clear_interrupt() { }
+static void stub_set_interrupt(timestamp_t timestamp) { }
+static void stub_fire_interrupt() { }
+
+static const ticker_interface_t interface_stub = {
+    stub_init,
+    stub_read,
+    stub_disable_interrupt,
+    stub_clear_interrupt,
+    stub_set_interrupt,
+    stub_fire_interrupt
+};
+
+static ticker_event_queue_t queue_stub;
+
+static const ticker_data_t ticker_stub = {
+    &interface_stub,
+    &queue_stub
+};
+
+static ticker_event_t events[EVENT_COUNT];
+static bool queued[EVENT_COUNT];
+static us_timestamp_t last_timestamp;
+static uint32_t dispatch_count;
+
+static void event_handler(uint32_t id)
+{
+    TEST_ASSERT_TRUE(id < EVENT_COUNT);
+    TEST_ASSERT_TRUE(queued[id]);
+    TEST_ASSERT_TRUE(events[id].timestamp >= last_timestamp);
+    TEST_ASSERT_TRUE(events[id].timestamp <= stub_timestamp);
+
+    last_timestamp = events[id].timestamp;
+    queued[id] = false;
+    ++dispatch_count;
+}
+
+static utest::v1::status_t case_setup_handler(
+    const Case *const source, const size_t index_of_case
+) {
+    memset(&queue_stub, 0, sizeof(queue_stub));
+    memset(events, 0, sizeof(events));
+    memset(queued, 0, sizeof(queued));
+    stub_timestamp = 0;
+    stub_read_call = 0;
+    last_timestamp = 0;
+    dispatch_count = 0;
+    srand(0);
+    return greentea_case_setup_handler(source, index_of_case);
+}
+
+/**
+ * Given an initialized ticker.
+ * When events are randomly inserted and removed while the time advances.
+ * Then:
+ *   - The events are dispatched in timestamp order.
+ *   - Removed events are never dispatched.
+ *   - The head of the queue is the next event to dispatch.
+ */
+static void test_random_insert_remove_dispatch()
+{
+    ticker_set_handler(&ticker_stub, event_handler);
+
+    for (size_t round = 0; round < ROUND_COUNT; ++round) {
+        for (size_t op = 0; op < OPERATION_COUNT; ++op) {
+            size_t i = rand() % EVENT_COUNT;
+            if (queued[i]) {
+                ticker_remove_event(&ticker_stub, &events[i]);
+                queued[i] = false;
+            } else {
+                queued[i] = true;
+                ticker_insert_event_us(
+                    &ticker_stub, &events[i],
+                    stub_timestamp + 1 + (rand() % 100000), i
+                );
+            }
+        }
+
+        ticker_event_t *head = queue_stub.head;
+        for (size_t i = 0; i < EVENT_COUNT; ++i) {
+            if (queued[i]) {
+                TEST_ASSERT_TRUE(head->timestamp <= events[i].timestamp);
+            }
+        }
+
+        stub_timestamp += rand() % 5000;
+        last_timestamp = 0;
+        ticker_irq_handler(&ticker_stub);
+    }
+
+    stub_timestamp += 200000;
+    ticker_irq_handler(&ticker_stub);
+
+    TEST_ASSERT_NULL(queue_stub.head);
+    for (size_t i = 0; i < EVENT_COUNT; ++i) {
+        TEST_ASSERT_FALSE(queued[i]);
+    }
+    TEST_ASSERT_TRUE(dispatch_count > 0);
+}
+
+/**
+ * Given an initialized ticker with events inserted.
+ * When events which are not in the queue are removed.
+ * Then the queue should be left untouched.
+ */
+static void test_remove_not_queued()
+{
+    ticker_set_handler(&ticker_stub, event_handler);
+
+    for (size_t i = 0; i < EVENT_COUNT / 2; ++i) {
+        queued[i] = true;
+        ticker_insert_event_us(&ticker_stub, &events[i], 1000 + i, i);
+    }
+
+    // never inserted
+    ticker_remove_event(&ticker_stub, &events[EVENT_COUNT - 1]);
+
+    // already removed
+    ticker_remove_event(&ticker_stub, &events[0]);
+    ticker_remove_event(&ticker_stub, &events[0]);
+    queued[0] = false;
+
+    TEST_ASSERT_EQUAL_PTR(&events[1], queue_stub.head);
+
+    stub_timestamp = 1000 + EVENT_COUNT;
+    ticker_irq_handler(&ticker_stub);
+
+    TEST_ASSERT_NULL(queue_stub.head);
+    TEST_ASSERT_EQUAL_UINT32(EVENT_COUNT / 2 - 1, dispatch_count);
+}
+
+/**
+ * Given an initialized ticker.
+ * When events are inserted and removed.
+ * Then the statistics should account each critical section and the queue
+ * occupancy if they are enabled, or be zeroed otherwise.
+ */
+static void test_stats()
+{
+    ticker_set_handler(&ticker_stub, event_handler);
+
+    for (size_t i = 0; i < EVENT_COUNT; ++i) {
+        queued[i] = true;
+        ticker_insert_event_us(&ticker_stub, &events[i], 1000 + i, i);
+    }
+
+    for (size_t i = 0; i < EVENT_COUNT; i += 2) {
+        ticker_remove_event(&ticker_stub, &events[i]);
+        queued[i] = false;
+    }
+
+    ticker_stats_t stats;
+    ticker_get_stats(&ticker_stub, &stats);
+
+#ifdef MBED_TICKER_STATS_ENABLED
+    TEST_ASSERT_EQUAL_UINT32(EVENT_COUNT + EVENT_COUNT / 2, stats.critical_cnt);
+    TEST_ASSERT_EQUAL_UINT32(EVENT_COUNT / 2, stats.current_events);
+    TEST_ASSERT_EQUAL_UINT32(EVENT_COUNT, stats.max_events);
+    TEST_ASSERT_TRUE(stats.critical_total_time >= stats.critical_max_time);
+#else
+    TEST_ASSERT_EQUAL_UINT32(0, stats.critical_cnt);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.current_events);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.max_events);
+#endif
+}
+
+static const Case cases[] = {
+    Case("random insert, remove and dispatch", case_setup_handler,
+         test_random_insert_remove_dispatch, greentea_case_teardown_handler),
+    Case("remove events not queued", case_setup_handler,
+         test_remove_not_queued, greentea_case_teardown_handler),
+    Case("queue statistics", case_setup_handler,
+         test_stats, greentea_case_teardown_handler)
+};
+
+static utest::v1::status_t greentea_test_setup(const size_t number_of_cases)
+{
+    GREENTEA_SETUP(30, "default_auto");
+    return verbose_test_setup_handler(number_of_cases);
+}
+
+int main()
+{
+    Specification specification(greentea_test_setup, cases, greentea_test_teardown_handler);
+    return !Harness::run(specification);
+}
@@ -0,0 +1,331 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "mbed.h"
+#include "greentea-client/test_env.h"
+#include "unity/unity.h"
+#include "utest/utest.h"
+#include "platform/ATCmdParser.h"
+
+using namespace utest::v1;
+
+#define MODEM_BUFFER_SIZE   512
+#define TEST_TIMEOUT_MS     100
+#define BENCH_COMMANDS      500
+
+/* A modem answering the commands written to it from a script, without
+ * delay. Unknown commands are answered with ERROR, and commands answered
+ * with an empty string time out. */
+static const struct {
+    const char *command;
+    const char *response;
+} script[] = {
+    {"AT",          "\r\nOK\r\n"},
+    {"AT+CSQ",      "\r\n+CSQ: 17,99\r\n\r\nOK\r\n"},
+    {"AT+COPS?",    "\r\n+COPS: 0,0,\"operator\"\r\n\r\nOK\r\n"},
+    {"AT+CMEE",     "\r\n+CME ERROR: 10\r\n"},
+    {"AT+URC",      "\r\n+CIEV: 3\r\n+CIND: 1\r\n+URC: 1\r\n\r\nOK\r\n"},
+    {"AT+SILENT",   ""},
+    {"ATD*99#",     "\r\nCONNECT\r\n~PPP"},
+};
+
+class FakeModem : public FileHandle {
+public:
+    FakeModem() : _head(0), _tail(0), _command_len(0), _received(0) {}
+
+    virtual ssize_t read(void *buffer, size_t size)
+    {
+        size_t count = 0;
+        while (count < size && _tail != _head) {
+            static_cast<char *>(buffer)[count++] = _data[_tail];
+            _tail = (_tail + 1) % MODEM_BUFFER_SIZE;
+        }
+        return count ? (ssize_t)count : -EAGAIN;
+    }
+
+    virtual ssize_t write(const void *buffer, size_t size)
+    {
+        const char *data = static_cast<const char *>(buffer);
+        for (size_t i = 0; i < size; i++) {
+            if (data[i] == '\r') {
+                _command[_command_len] = '\0';
+                _command_len = 0;
+                respond(_command);
+            } else if (_command_len < sizeof(_command) - 1) {
+                _command[_command_len++] = data[i];
+            }
+        }
+        return size;
+    }
+
+    virtual off_t seek(off_t offset, int whence)
+    {
+        return -ESPIPE;
+    }
+
+    virtual int close()
+    {
+        return 0;
+    }
+
+    virtual bool wakes_pollers() const
+    {
+        return true;
+    }
+
+    virtual short poll(short events) const
+    {
+        return POLLOUT | (_tail != _head ? POLLIN : 0);
+    }
+
+    virtual void sigio(Callback<void()> func)
+    {
+        _sigio = func;
+    }
+
+    void inject(const char *data)
+    {
+        for (; *data; data++) {
+            _data[_head] = *data;
+            _head = (_head + 1) % MODEM_BUFFER_SIZE;
+            _received++;
+        }
+        wake_pollers();
+        if (_sigio) {
+            _sigio();
+        }
+    }
+
+    uint32_t received() const
+    {
+        return _received;
+    }
+
+private:
+    void respond(const char *command)
+    {
+        for (size_t i = 0; i < sizeof(script) / sizeof(script[0]); i++) {
+            if (strcmp(command, script[i].command) == 0) {
+                inject(script[i].response);
+                return;
+            }
+        }
+        inject("\r\nERROR\r\n");
+    }
+
+    char _data[MODEM_BUFFER_SIZE];
+    int _head;
+    int _tail;
+    char _command[32];
+    size_t _command_len;
+    uint32_t _received;
+    Callback<void()> _sigio;
+};
+
+static ATCmdParser *oob_parser;
+static int ciev;
+static int urcs;
+
+static void on_ciev()
+{
+    TEST_ASSERT_TRUE(oob_parser->recv("%d\n", &ciev));
+}
+
+static void on_urc()
+{
+    urcs++;
+}
+
+void test_blocking()
+{
+    FakeModem modem;
+    ATCmdParser at(&modem, "\r", 256, TEST_TIMEOUT_MS);
+    int rssi = 0;
+    int ber = 0;
+
+    TEST_ASSERT_TRUE(at.send("AT") && at.recv("OK"));
+    TEST_ASSERT_TRUE(at.send("AT+CSQ") && at.recv("+CSQ: %d,%d\n", &rssi, &ber) && at.recv("OK"));
+    TEST_ASSERT_EQUAL_INT(17, rssi);
+    TEST_ASSERT_EQUAL_INT(99, ber);
+    TEST_ASSERT_FALSE(at.send("AT+SILENT") && at.recv("OK"));
+
+    // oob prefixes starting alike share trie nodes
+    oob_parser = &at;
+    ciev = 0;
+    urcs = 0;
+    at.oob("+CIEV:", on_ciev);
+    at.oob("+CIND:", on_urc);
+    TEST_ASSERT_TRUE(at.send("AT+URC") && at.recv("OK"));
+    TEST_ASSERT_EQUAL_INT(3, ciev);
+    TEST_ASSERT_EQUAL_INT(1, urcs);
+
+    // Nothing past the response is read, the file handle can be handed over
+    char data[8];
+    TEST_ASSERT_TRUE(at.send("ATD*99#") && at.recv("CONNECT"));
+    TEST_ASSERT_EQUAL(6, modem.read(data, sizeof(data)));
+    TEST_ASSERT_EQUAL(0, memcmp(data, "\r\n~PPP", 6));
+}
+
+static ATCmdParser *async_parser;
+static int results[8];
+static char responses[8][64];
+static int completed;
+
+static void done(int result, const char *response)
+{
+    results[completed] = result;
+    strncpy(responses[completed], response, sizeof(responses[0]) - 1);
+    completed++;
+
+    // each command is sent from the completion of the previous one
+    static const char *const next[] = {"AT+CSQ", "AT+CMEE", "AT+URC", "AT+SILENT"};
+    if (completed <= (int)(sizeof(next) / sizeof(next[0]))) {
+        TEST_ASSERT_TRUE(async_parser->send_async(done, "%s", next[completed - 1]));
+        TEST_ASSERT_FALSE(async_parser->send_async(done, "AT"));
+    }
+}
+
+static void start()
+{
+    TEST_ASSERT_TRUE(async_parser->send_async(done, "AT"));
+}
+
+void test_async()
+{
+    EventQueue events;
+    FakeModem modem;
+    ATCmdParser at(&modem, "\r", 256, TEST_TIMEOUT_MS);
+    TEST_ASSERT_FALSE(at.send_async(done, "AT"));
+
+    async_parser = &at;
+    oob_parser = &at;
+    completed = 0;
+    ciev = 0;
+    urcs = 0;
+    at.oob("+CIEV:", on_ciev);
+    at.oob("+CIND:", on_urc);
+    at.oob("RING", on_urc);
+    at.set_event_queue(&events);
+
+    // unsolicited lines are handled while no command is in progress
+    modem.inject("\r\nRING\r\n");
+    events.dispatch(0);
+    TEST_ASSERT_EQUAL_INT(1, urcs);
+
+    events.call(start);
+    Timer timer;
+    timer.start();
+    while (completed < 5 && timer.read_ms() < 10 * TEST_TIMEOUT_MS) {
+        events.dispatch(10);
+    }
+    TEST_ASSERT_EQUAL_INT(5, completed);
+
+    TEST_ASSERT_EQUAL_INT(ATCmdParser::AT_OK, results[0]);
+    TEST_ASSERT_EQUAL_STRING("", responses[0]);
+    TEST_ASSERT_EQUAL_INT(ATCmdParser::AT_OK, results[1]);
+    TEST_ASSERT_EQUAL_STRING("+CSQ: 17,99", responses[1]);
+    TEST_ASSERT_EQUAL_INT(ATCmdParser::AT_ERROR, results[2]);
+    TEST_ASSERT_EQUAL_STRING("+CME ERROR: 10", responses[2]);
+
+    // oob lines are left out of the response, whether or not their
+    // callback reads the rest of the line
+    TEST_ASSERT_EQUAL_INT(ATCmdParser::AT_OK, results[3]);
+    TEST_ASSERT_EQUAL_STRING("+URC: 1", responses[3]);
+    TEST_ASSERT_EQUAL_INT(3, ciev);
+    TEST_ASSERT_EQUAL_INT(2, urcs);
+
+    TEST_ASSERT_EQUAL_INT(ATCmdParser::AT_TIMEOUT, results[4]);
+    TEST_ASSERT_EQUAL_STRING("", responses[4]);
+
+    // blocking mode again
+    at.set_event_queue(NULL);
+    TEST_ASSERT_TRUE(at.send("AT") && at.recv("OK"));
+}
+
+static int bench_remaining;
+
+static void bench_done(int result, const char *response)
+{
+    TEST_ASSERT_EQUAL_INT(ATCmdParser::AT_OK, result);
+    if (--bench_remaining > 0) {
+        async_parser->send_async(bench_done, "AT+COPS?");
+    }
+}
+
+static void bench_start()
+{
+    async_parser->send_async(bench_done, "AT+COPS?");
+}
+
+/* Commands per second and time per received byte, with the modem answering
+ * immediately so only the parser is measured */
+void test_benchmark()
+{
+    FakeModem modem;
+    ATCmdParser at(&modem, "\r", 256, TEST_TIMEOUT_MS);
+    char name[16];
+    Timer timer;
+
+    timer.start();
+    for (int i = 0; i < BENCH_COMMANDS; i++) {
+        TEST_ASSERT_TRUE(at.send("AT+COPS?"));
+        TEST_ASSERT_TRUE(at.recv("+COPS: 0,0,\"%15[^\"]\"\n", name));
+        TEST_ASSERT_TRUE(at.recv("OK"));
+    }
+    timer.stop();
+    int blocking_us = timer.read_us();
+    uint32_t blocking_bytes = modem.received();
+
+    EventQueue events;
+    async_parser = &at;
+    bench_remaining = BENCH_COMMANDS;
+    at.set_event_queue(&events);
+    events.call(bench_start);
+
+    timer.reset();
+    timer.start();
+    while (bench_remaining > 0) {
+        events.dispatch(0);
+    }
+    timer.stop();
+    int async_us = timer.read_us();
+    uint32_t async_bytes = modem.received() - blocking_bytes;
+    at.set_event_queue(NULL);
+
+    printf("%d commands:\r\n", BENCH_COMMANDS);
+    printf("  blocking  %8d us (%.0f commands/s, %.3f us/byte)\r\n",
+           blocking_us, BENCH_COMMANDS * 1e6f / blocking_us, (float)blocking_us / blocking_bytes);
+    printf("  async     %8d us (%.0f commands/s, %.3f us/byte)\r\n",
+           async_us, BENCH_COMMANDS * 1e6f / async_us, (float)async_us / async_bytes);
+}
+
+utest::v1::status_t test_setup(const size_t number_of_cases)
+{
+    GREENTEA_SETUP(30, "default_auto");
+    return verbose_test_setup_handler(number_of_cases);
+}
+
+Case cases[] = {
+    Case("Blocking commands and oob", test_blocking),
+    Case("Asynchronous commands", test_async),
+    Case("Commands per second against blocking mode", test_benchmark)
+};
+
+Specification specification(test_setup, cases);
+
+int main()
+{
+    return !Harness::run(specification);
+}
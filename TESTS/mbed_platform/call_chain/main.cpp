@@ -0,0 +1,263 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "mbed.h"
+#include "greentea-client/test_env.h"
+#include "unity/unity.h"
+#include "utest/utest.h"
+#include "platform/CallChain.h"
+#include "platform/StaticCallChain.h"
+#include "platform/mbed_stats.h"
+
+using namespace utest::v1;
+
+#define BENCH_HANDLERS      8
+#define BENCH_CALLS         10000
+
+#define ISR_CALLS           2000
+#define ISR_PERIOD_US       100
+
+static char order[8];
+static int order_len;
+
+static void record(char c)
+{
+    if (order_len < (int)sizeof(order) - 1) {
+        order[order_len++] = c;
+        order[order_len] = '\0';
+    }
+}
+
+static void reset_order()
+{
+    order_len = 0;
+    order[0] = '\0';
+}
+
+static void record_a() { record('a'); }
+static void record_b() { record('b'); }
+static void record_c() { record('c'); }
+static void record_d() { record('d'); }
+
+void test_order()
+{
+    StaticCallChain<3> chain;
+    reset_order();
+
+    pFunctionPointer_t b = chain.add(record_b);
+    pFunctionPointer_t c = chain.add(record_c);
+    pFunctionPointer_t a = chain.add_front(record_a);
+    TEST_ASSERT_NOT_NULL(a);
+    TEST_ASSERT_NOT_NULL(b);
+    TEST_ASSERT_NOT_NULL(c);
+
+    // full chains refuse new functions
+    TEST_ASSERT_NULL(chain.add(record_d));
+    TEST_ASSERT_NULL(chain.add_front(record_d));
+
+    TEST_ASSERT_EQUAL_INT(3, chain.size());
+    TEST_ASSERT_EQUAL_INT(0, chain.find(a));
+    TEST_ASSERT_EQUAL_INT(2, chain.find(c));
+    TEST_ASSERT_EQUAL_PTR(b, chain[1]);
+    TEST_ASSERT_NULL(chain.get(3));
+
+    chain.call();
+    TEST_ASSERT_EQUAL_STRING("abc", order);
+
+    // removed slots are reused
+    TEST_ASSERT_TRUE(chain.remove(b));
+    TEST_ASSERT_FALSE(chain.remove(b));
+    TEST_ASSERT_EQUAL_INT(-1, chain.find(b));
+    TEST_ASSERT_NOT_NULL(chain.add(record_d));
+
+    reset_order();
+    chain();
+    TEST_ASSERT_EQUAL_STRING("acd", order);
+
+    chain.clear();
+    TEST_ASSERT_EQUAL_INT(0, chain.size());
+    reset_order();
+    chain.call();
+    TEST_ASSERT_EQUAL_STRING("", order);
+    TEST_ASSERT_NOT_NULL(chain.add(record_a));
+}
+
+static StaticCallChain<4> removing_chain;
+static pFunctionPointer_t removing_handles[4];
+
+static void remove_self()
+{
+    record('s');
+    removing_chain.remove(removing_handles[0]);
+}
+
+static void remove_next()
+{
+    record('n');
+    removing_chain.remove(removing_handles[2]);
+}
+
+void test_remove_during_call()
+{
+    reset_order();
+    removing_handles[0] = removing_chain.add(remove_self);
+    removing_handles[1] = removing_chain.add(remove_next);
+    removing_handles[2] = removing_chain.add(record_c);
+    removing_handles[3] = removing_chain.add(record_d);
+
+    // removed functions are not called, even later in the same call
+    removing_chain.call();
+    TEST_ASSERT_EQUAL_STRING("snd", order);
+    TEST_ASSERT_EQUAL_INT(2, removing_chain.size());
+    removing_handles[2] = NULL;
+
+    // their slots are free again once the call is over
+    TEST_ASSERT_NOT_NULL(removing_chain.add(record_a));
+    TEST_ASSERT_NOT_NULL(removing_chain.add(record_b));
+    TEST_ASSERT_NULL(removing_chain.add(record_c));
+
+    reset_order();
+    removing_chain.call();
+    TEST_ASSERT_EQUAL_STRING("ndab", order);
+    removing_chain.clear();
+}
+
+static StaticCallChain<4> isr_chain;
+static volatile uint32_t isr_calls;
+static volatile uint32_t isr_count;
+
+static void count_call()
+{
+    isr_count++;
+}
+
+static void isr_dispatch()
+{
+    if (isr_calls < ISR_CALLS) {
+        isr_chain.call();
+        isr_calls++;
+    }
+}
+
+void test_isr_dispatch()
+{
+    isr_calls = 0;
+    isr_count = 0;
+    pFunctionPointer_t fixed = isr_chain.add(count_call);
+    TEST_ASSERT_NOT_NULL(fixed);
+
+    Ticker ticker;
+    ticker.attach_us(isr_dispatch, ISR_PERIOD_US);
+
+    // the thread churns the rest of the chain under the interrupt
+    while (isr_calls < ISR_CALLS) {
+        pFunctionPointer_t front = isr_chain.add_front(count_call);
+        pFunctionPointer_t back = isr_chain.add(count_call);
+        TEST_ASSERT_NOT_NULL(front);
+        TEST_ASSERT_NOT_NULL(back);
+        TEST_ASSERT_TRUE(isr_chain.remove(front));
+        TEST_ASSERT_TRUE(isr_chain.remove(back));
+    }
+    ticker.detach();
+
+    // the fixed function is called on every dispatch, the churned ones
+    // at most twice more
+    TEST_ASSERT_TRUE(isr_count >= ISR_CALLS);
+    TEST_ASSERT_TRUE(isr_count <= 3 * ISR_CALLS);
+    TEST_ASSERT_EQUAL_INT(1, isr_chain.size());
+    TEST_ASSERT_TRUE(isr_chain.remove(fixed));
+}
+
+static volatile uint32_t bench_count;
+
+static void bench_handler()
+{
+    bench_count++;
+}
+
+template <typename Chain>
+static float bench_dispatch(Chain &chain)
+{
+    Timer timer;
+
+    timer.start();
+    for (uint32_t i = 0; i < BENCH_CALLS; i++) {
+        chain.call();
+    }
+    timer.stop();
+
+    return timer.read_us();
+}
+
+template <typename Chain>
+static int bench_heap(Chain **chain)
+{
+    mbed_stats_heap_t before;
+    mbed_stats_heap_t after;
+
+    mbed_stats_heap_get(&before);
+    *chain = new Chain();
+    for (int i = 0; i < BENCH_HANDLERS; i++) {
+        (*chain)->add(bench_handler);
+    }
+    mbed_stats_heap_get(&after);
+
+    return after.current_size - before.current_size;
+}
+
+/* Time to dispatch to BENCH_HANDLERS handlers, the work done by
+ * InterruptManager on each interrupt, and heap used by the chains holding
+ * them. Heap use is only measured with MBED_HEAP_STATS_ENABLED. */
+void test_benchmark()
+{
+    CallChain *list = NULL;
+    StaticCallChain<BENCH_HANDLERS> *fixed = NULL;
+    int list_heap = bench_heap(&list);
+    int fixed_heap = bench_heap(&fixed);
+
+    bench_count = 0;
+    float list_us = bench_dispatch(*list);
+    float fixed_us = bench_dispatch(*fixed);
+    TEST_ASSERT_EQUAL_UINT32(2 * BENCH_CALLS * BENCH_HANDLERS, bench_count);
+
+    printf("%u calls of %u handlers:\r\n", BENCH_CALLS, BENCH_HANDLERS);
+    printf("  CallChain        %8.0f us (%.3f us/call), %d bytes of heap\r\n",
+           list_us, list_us / BENCH_CALLS, list_heap);
+    printf("  StaticCallChain  %8.0f us (%.3f us/call), %d bytes of heap\r\n",
+           fixed_us, fixed_us / BENCH_CALLS, fixed_heap);
+
+    delete list;
+    delete fixed;
+}
+
+utest::v1::status_t test_setup(const size_t number_of_cases)
+{
+    GREENTEA_SETUP(30, "default_auto");
+    return verbose_test_setup_handler(number_of_cases);
+}
+
+Case cases[] = {
+    Case("Order, capacity and removal", test_order),
+    Case("Removal during a call", test_remove_during_call),
+    Case("Interrupt dispatch while modified", test_isr_dispatch),
+    Case("Dispatch time and heap use against CallChain", test_benchmark)
+};
+
+Specification specification(test_setup, cases);
+
+int main()
+{
+    return !Harness::run(specification);
+}
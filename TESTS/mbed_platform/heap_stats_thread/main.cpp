@@ -0,0 +1,213 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "mbed.h"
+#include "greentea-client/test_env.h"
+#include "unity/unity.h"
+#include "utest/utest.h"
+#include "mbed_stats.h"
+
+#if !defined(MBED_HEAP_STATS_ENABLED) || !defined(MBED_CONF_RTOS_PRESENT) || !MBED_CONF_PLATFORM_HEAP_STATS_THREADS
+#error [NOT_SUPPORTED] test requires MBED_HEAP_STATS_ENABLED, the RTOS and platform.heap-stats-threads
+#endif
+
+using namespace utest::v1;
+
+#define LEAK_COUNT          3
+#define LEAK_SIZE           100
+
+#define STRESS_THREADS      4
+#define STRESS_OPS          2000
+#define STRESS_HELD         4
+#define STRESS_STACK_SIZE   1024
+
+#define SMALL_SIZE          MBED_CONF_PLATFORM_HEAP_ARENA_BLOCK_SIZE
+#define LARGE_SIZE          (MBED_CONF_PLATFORM_HEAP_ARENA_BLOCK_SIZE + 64)
+
+static void *leaked[LEAK_COUNT];
+static uint32_t leak_thread_id;
+
+static void leak()
+{
+    leak_thread_id = (uint32_t)Thread::gettid();
+    for (int i = 0; i < LEAK_COUNT; i++) {
+        leaked[i] = malloc(LEAK_SIZE);
+    }
+}
+
+void test_thread_accounting()
+{
+    mbed_stats_heap_t stats;
+    mbed_stats_heap_thread_t each[MBED_CONF_PLATFORM_HEAP_STATS_THREADS + 1];
+
+    Thread thread;
+    thread.start(leak);
+    thread.join();
+
+    // the memory left allocated by the thread is accounted to it
+    TEST_ASSERT_EQUAL(0, mbed_stats_heap_get_thread(leak_thread_id, &stats));
+    TEST_ASSERT_EQUAL_UINT32(LEAK_COUNT * LEAK_SIZE, stats.current_size);
+    TEST_ASSERT_EQUAL_UINT32(LEAK_COUNT, stats.alloc_cnt);
+    TEST_ASSERT_EQUAL_UINT32(MBED_CONF_PLATFORM_HEAP_ARENA_SIZE, stats.reserved_size);
+
+    size_t count = mbed_stats_heap_get_each(each, MBED_CONF_PLATFORM_HEAP_STATS_THREADS + 1);
+    size_t found = count;
+    for (size_t i = 0; i < count; i++) {
+        if (each[i].thread_id == leak_thread_id) {
+            found = i;
+        }
+    }
+    TEST_ASSERT_TRUE(found < count);
+    TEST_ASSERT_EQUAL_UINT32(LEAK_COUNT * LEAK_SIZE, each[found].heap.current_size);
+
+    // and stays so when freed by another thread
+    for (int i = 0; i < LEAK_COUNT; i++) {
+        free(leaked[i]);
+    }
+    TEST_ASSERT_EQUAL(0, mbed_stats_heap_get_thread(leak_thread_id, &stats));
+    TEST_ASSERT_EQUAL_UINT32(0, stats.current_size);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.alloc_cnt);
+    TEST_ASSERT_EQUAL_UINT32(LEAK_COUNT * LEAK_SIZE, stats.max_size);
+    TEST_ASSERT_EQUAL_UINT32(LEAK_COUNT * LEAK_SIZE, stats.total_size);
+
+    TEST_ASSERT_EQUAL(-1, mbed_stats_heap_get_thread(1, &stats));
+
+    // id 0 is the shared slot, not an unused one
+    TEST_ASSERT_EQUAL(0, mbed_stats_heap_get_thread(0, &stats));
+    count = mbed_stats_heap_get_each(each, MBED_CONF_PLATFORM_HEAP_STATS_THREADS + 1);
+    for (size_t i = 0; i < count; i++) {
+        if (each[i].thread_id == 0) {
+            TEST_ASSERT_EQUAL_UINT32(each[i].heap.total_size, stats.total_size);
+            TEST_ASSERT_EQUAL_UINT32(each[i].heap.alloc_cnt, stats.alloc_cnt);
+        }
+    }
+}
+
+static void *remote_ptr;
+
+static void remote_free()
+{
+    free(remote_ptr);
+}
+
+void test_arena_remote_free()
+{
+    mbed_stats_heap_t before;
+    mbed_stats_heap_t after;
+    uint32_t id = (uint32_t)Thread::gettid();
+
+    mbed_stats_heap_get_thread(id, &before);
+    void *ptr = malloc(SMALL_SIZE);
+    TEST_ASSERT_NOT_NULL(ptr);
+
+    // blocks freed by another thread go back to the arena of their owner
+    remote_ptr = ptr;
+    Thread thread;
+    thread.start(remote_free);
+    thread.join();
+
+    void *again = malloc(SMALL_SIZE);
+    TEST_ASSERT_EQUAL_PTR(ptr, again);
+    free(again);
+
+    mbed_stats_heap_get_thread(id, &after);
+    TEST_ASSERT_EQUAL_UINT32(before.current_size, after.current_size);
+    TEST_ASSERT_EQUAL_UINT32(before.alloc_cnt, after.alloc_cnt);
+    TEST_ASSERT_EQUAL_UINT32(before.total_size + 2 * SMALL_SIZE, after.total_size);
+}
+
+static size_t stress_size;
+static volatile uint32_t stress_failures;
+
+static void stress()
+{
+    void *held[STRESS_HELD] = {NULL};
+
+    for (int i = 0; i < STRESS_OPS; i++) {
+        free(held[i % STRESS_HELD]);
+        held[i % STRESS_HELD] = malloc(stress_size);
+        if (held[i % STRESS_HELD] == NULL) {
+            core_util_atomic_incr_u32((uint32_t *)&stress_failures, 1);
+        }
+    }
+    for (int i = 0; i < STRESS_HELD; i++) {
+        free(held[i]);
+    }
+}
+
+static int stress_us(size_t size)
+{
+    Thread *threads[STRESS_THREADS];
+    Timer timer;
+
+    stress_size = size;
+    stress_failures = 0;
+    timer.start();
+    for (int i = 0; i < STRESS_THREADS; i++) {
+        threads[i] = new Thread(osPriorityNormal, STRESS_STACK_SIZE);
+        threads[i]->start(stress);
+    }
+    for (int i = 0; i < STRESS_THREADS; i++) {
+        threads[i]->join();
+        delete threads[i];
+    }
+    timer.stop();
+
+    TEST_ASSERT_EQUAL_UINT32(0, stress_failures);
+    return timer.read_us();
+}
+
+/* Threads allocating and freeing at once, with allocations small enough for
+ * the arenas and larger ones taking the heap lock */
+void test_stress()
+{
+    mbed_stats_heap_t before;
+    mbed_stats_heap_t after;
+
+    mbed_stats_heap_get(&before);
+    int small_us = stress_us(SMALL_SIZE);
+    int large_us = stress_us(LARGE_SIZE);
+    mbed_stats_heap_get(&after);
+
+    TEST_ASSERT_EQUAL_UINT32(before.current_size, after.current_size);
+    TEST_ASSERT_EQUAL_UINT32(before.alloc_cnt, after.alloc_cnt);
+
+    int ops = 2 * STRESS_THREADS * STRESS_OPS;
+    printf("%d threads, %d mallocs and frees:\r\n", STRESS_THREADS, ops);
+    printf("  %4d bytes  %8d us (%.3f us/op)%s\r\n", SMALL_SIZE, small_us, (float)small_us / ops,
+           MBED_CONF_PLATFORM_HEAP_ARENA_SIZE ? ", thread arenas" : "");
+    printf("  %4d bytes  %8d us (%.3f us/op)\r\n", LARGE_SIZE, large_us, (float)large_us / ops);
+}
+
+utest::v1::status_t test_setup(const size_t number_of_cases)
+{
+    GREENTEA_SETUP(30, "default_auto");
+    return verbose_test_setup_handler(number_of_cases);
+}
+
+Case cases[] = {
+    Case("Allocations accounted to their thread", test_thread_accounting),
+#if MBED_CONF_PLATFORM_HEAP_ARENA_SIZE
+    Case("Arena blocks freed by another thread", test_arena_remote_free),
+#endif
+    Case("Threads allocating at once", test_stress)
+};
+
+Specification specification(test_setup, cases);
+
+int main()
+{
+    return !Harness::run(specification);
+}
@@ -0,0 +1,279 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "mbed.h"
+#include "greentea-client/test_env.h"
+#include "unity/unity.h"
+#include "utest/utest.h"
+#include "platform/mbed_mem_trace.h"
+#include "platform/mbed_mem_profile.h"
+
+using namespace utest::v1;
+
+#define BENCH_LIVE          (MBED_CONF_PLATFORM_MEM_PROFILE_ALLOCATIONS / 4)
+#define BENCH_OPS           10000
+
+/* The profile is fed with made up pointers and callers, so the test does not
+ * depend on MBED_MEM_TRACING_ENABLED nor on the allocations of the test
+ * framework */
+#define CALLER(n)           ((void *)(uintptr_t)(0x8001 + 4 * (n)))
+#define PTR(n)              ((void *)(uintptr_t)(0x20000000 + 16 * (n)))
+
+static void alloc(void *ptr, size_t size, void *caller)
+{
+    mbed_mem_profile_callback(MBED_MEM_TRACE_MALLOC, ptr, caller, size);
+}
+
+static void release(void *ptr, void *caller)
+{
+    mbed_mem_profile_callback(MBED_MEM_TRACE_FREE, NULL, caller, ptr);
+}
+
+void test_callers()
+{
+    mbed_mem_profile_site_t sites[4];
+    mbed_mem_profile_stats_t stats;
+    mbed_mem_profile_reset();
+
+    alloc(PTR(0), 8, CALLER(0));
+    alloc(PTR(1), 100, CALLER(0));
+    mbed_mem_profile_callback(MBED_MEM_TRACE_CALLOC, PTR(2), CALLER(1), (size_t)4, (size_t)50);
+    alloc(PTR(3), 1000, CALLER(2));
+    release(PTR(3), CALLER(3));
+    release(PTR(0), CALLER(3));
+
+    // grown in place, then moved
+    mbed_mem_profile_callback(MBED_MEM_TRACE_REALLOC, PTR(1), CALLER(0), PTR(1), (size_t)120);
+    mbed_mem_profile_callback(MBED_MEM_TRACE_REALLOC, PTR(4), CALLER(0), PTR(1), (size_t)300);
+
+    // failed allocations are not accounted
+    alloc(NULL, 10, CALLER(1));
+
+    TEST_ASSERT_EQUAL(3, mbed_mem_profile_get(sites, 4));
+    mbed_mem_profile_get_stats(&stats);
+    TEST_ASSERT_EQUAL(3, stats.site_cnt);
+    TEST_ASSERT_EQUAL(0, stats.untracked_cnt);
+    TEST_ASSERT_EQUAL(0, stats.unknown_free_cnt);
+
+    // sorted by live size
+    TEST_ASSERT_EQUAL_PTR(CALLER(0), sites[0].caller);
+    TEST_ASSERT_EQUAL(300, sites[0].live_size);
+    TEST_ASSERT_EQUAL(1, sites[0].live_cnt);
+    TEST_ASSERT_EQUAL(4, sites[0].alloc_cnt);
+    TEST_ASSERT_EQUAL(300, sites[0].max_size);
+    TEST_ASSERT_EQUAL(1, sites[0].size_hist[0]);
+    TEST_ASSERT_EQUAL(2, sites[0].size_hist[4]);
+    TEST_ASSERT_EQUAL(1, sites[0].size_hist[6]);
+
+    TEST_ASSERT_EQUAL_PTR(CALLER(1), sites[1].caller);
+    TEST_ASSERT_EQUAL(200, sites[1].live_size);
+    TEST_ASSERT_EQUAL(1, sites[1].size_hist[5]);
+
+    TEST_ASSERT_EQUAL_PTR(CALLER(2), sites[2].caller);
+    TEST_ASSERT_EQUAL(0, sites[2].live_size);
+    TEST_ASSERT_EQUAL(0, sites[2].live_cnt);
+    TEST_ASSERT_EQUAL(1000, sites[2].max_size);
+    TEST_ASSERT_EQUAL(1, sites[2].size_hist[MBED_MEM_PROFILE_BUCKETS - 1]);
+
+    // only the largest fit
+    TEST_ASSERT_EQUAL(1, mbed_mem_profile_get(sites, 1));
+    TEST_ASSERT_EQUAL_PTR(CALLER(0), sites[0].caller);
+}
+
+void test_limits()
+{
+    mbed_mem_profile_site_t sites[MBED_CONF_PLATFORM_MEM_PROFILE_SITES + 1];
+    mbed_mem_profile_stats_t stats;
+    const int callers = MBED_CONF_PLATFORM_MEM_PROFILE_SITES + 8;
+    const int allocations = MBED_CONF_PLATFORM_MEM_PROFILE_ALLOCATIONS;
+    mbed_mem_profile_reset();
+
+    for (int i = 0; i < allocations; i++) {
+        alloc(PTR(i), 16, CALLER(i % callers));
+    }
+    release(PTR(allocations), CALLER(0));
+
+    // the callers that do not fit share an entry
+    TEST_ASSERT_EQUAL(MBED_CONF_PLATFORM_MEM_PROFILE_SITES + 1,
+                      mbed_mem_profile_get(sites, MBED_CONF_PLATFORM_MEM_PROFILE_SITES + 1));
+    mbed_mem_profile_get_stats(&stats);
+    TEST_ASSERT_EQUAL(MBED_CONF_PLATFORM_MEM_PROFILE_SITES, stats.site_cnt);
+    TEST_ASSERT_EQUAL(allocations / 4, stats.untracked_cnt);
+    TEST_ASSERT_EQUAL(1, stats.unknown_free_cnt);
+
+    uint32_t live = 0;
+    bool other = false;
+    for (int i = 0; i < MBED_CONF_PLATFORM_MEM_PROFILE_SITES + 1; i++) {
+        live += sites[i].live_cnt;
+        other |= (sites[i].caller == NULL);
+    }
+    TEST_ASSERT_TRUE(other);
+    TEST_ASSERT_EQUAL(allocations - allocations / 4, live);
+
+    // freeing everything in another order leaves the table consistent
+    for (int i = allocations - 1; i >= 0; i -= 2) {
+        release(PTR(i), CALLER(0));
+    }
+    for (int i = 0; i < allocations; i += 2) {
+        release(PTR(i), CALLER(0));
+    }
+    mbed_mem_profile_get(sites, MBED_CONF_PLATFORM_MEM_PROFILE_SITES + 1);
+    for (int i = 0; i < MBED_CONF_PLATFORM_MEM_PROFILE_SITES + 1; i++) {
+        TEST_ASSERT_EQUAL(0, sites[i].live_size);
+        TEST_ASSERT_EQUAL(0, sites[i].live_cnt);
+    }
+    mbed_mem_profile_get_stats(&stats);
+    TEST_ASSERT_EQUAL(1 + allocations / 4, stats.unknown_free_cnt);
+}
+
+static const uint8_t *get_uint(const uint8_t *p, uintptr_t *value)
+{
+    *value = 0;
+    for (int shift = 0; ; shift += 7) {
+        *value |= (uintptr_t)(*p & 0x7f) << shift;
+        if (!(*p++ & 0x80)) {
+            return p;
+        }
+    }
+}
+
+void test_dump()
+{
+    uint8_t buffer[128];
+    mbed_mem_profile_reset();
+
+    alloc(PTR(0), 300, CALLER(0));
+    alloc(PTR(1), 20, CALLER(1));
+
+    size_t size = mbed_mem_profile_dump(NULL, 0);
+    TEST_ASSERT_TRUE(size <= sizeof(buffer));
+    TEST_ASSERT_EQUAL(size, mbed_mem_profile_dump(buffer, 8));
+    TEST_ASSERT_EQUAL(size, mbed_mem_profile_dump(buffer, sizeof(buffer)));
+
+    TEST_ASSERT_EQUAL('M', buffer[0]);
+    TEST_ASSERT_EQUAL('P', buffer[1]);
+    TEST_ASSERT_EQUAL(MBED_MEM_PROFILE_DUMP_VERSION, buffer[2]);
+    TEST_ASSERT_EQUAL(MBED_MEM_PROFILE_BUCKETS, buffer[3]);
+
+    const uint8_t *p = buffer + 4;
+    uintptr_t entries, untracked, unknown;
+    p = get_uint(p, &entries);
+    p = get_uint(p, &untracked);
+    p = get_uint(p, &unknown);
+    TEST_ASSERT_EQUAL(2, entries);
+    TEST_ASSERT_EQUAL(0, untracked);
+    TEST_ASSERT_EQUAL(0, unknown);
+
+    uintptr_t total = 0;
+    for (uintptr_t i = 0; i < entries; i++) {
+        uintptr_t value;
+        p = get_uint(p, &value);
+        TEST_ASSERT_TRUE(value == (uintptr_t)CALLER(0) || value == (uintptr_t)CALLER(1));
+        p = get_uint(p, &value);
+        total += value;
+        for (int j = 0; j < 4 + MBED_MEM_PROFILE_BUCKETS - 1; j++) {
+            p = get_uint(p, &value);
+        }
+    }
+    TEST_ASSERT_EQUAL(320, total);
+    TEST_ASSERT_EQUAL(size, p - buffer);
+}
+
+static volatile uint32_t bench_count;
+
+static void bench_nop_callback(uint8_t op, void *res, void *caller, ...)
+{
+    bench_count++;
+}
+
+template <typename F>
+static float bench_ops(F callback)
+{
+    Timer timer;
+
+    // pairs of malloc and free with BENCH_LIVE allocations live
+    timer.start();
+    for (int i = 0; i < BENCH_OPS / 2; i++) {
+        callback(MBED_MEM_TRACE_MALLOC, PTR(i + BENCH_LIVE), CALLER(i % 8), (size_t)32);
+        callback(MBED_MEM_TRACE_FREE, NULL, CALLER(0), PTR(i));
+    }
+    timer.stop();
+
+    return timer.read_us();
+}
+
+/* Time added by the profile to each memory operation, against a callback
+ * doing nothing */
+void test_benchmark()
+{
+    mbed_mem_profile_reset();
+    for (int i = 0; i < BENCH_LIVE; i++) {
+        alloc(PTR(i), 32, CALLER(i % 8));
+    }
+
+    float nop_us = bench_ops(bench_nop_callback);
+    float profile_us = bench_ops(mbed_mem_profile_callback);
+
+    mbed_mem_profile_stats_t stats;
+    mbed_mem_profile_get_stats(&stats);
+    TEST_ASSERT_EQUAL(0, stats.untracked_cnt);
+    TEST_ASSERT_EQUAL(0, stats.unknown_free_cnt);
+
+    printf("%d memory operations, %d allocations live:\r\n", BENCH_OPS, BENCH_LIVE);
+    printf("  empty callback    %8.0f us (%.3f us/op)\r\n", nop_us, nop_us / BENCH_OPS);
+    printf("  profile callback  %8.0f us (%.3f us/op)\r\n", profile_us, profile_us / BENCH_OPS);
+
+#ifdef MBED_MEM_TRACING_ENABLED
+    // the whole cost of a traced malloc and free
+    Timer timer;
+    void *ptrs[BENCH_LIVE];
+    mbed_mem_profile_reset();
+    mbed_mem_trace_set_callback(mbed_mem_profile_callback);
+    timer.start();
+    for (int i = 0; i < BENCH_OPS / 2; i++) {
+        ptrs[i % BENCH_LIVE] = malloc(32);
+        if (i >= BENCH_LIVE - 1) {
+            free(ptrs[(i + 1) % BENCH_LIVE]);
+        }
+    }
+    timer.stop();
+    mbed_mem_trace_set_callback(NULL);
+    for (int i = 0; i < BENCH_LIVE - 1; i++) {
+        free(ptrs[(BENCH_OPS / 2 + 1 + i) % BENCH_LIVE]);
+    }
+
+    printf("  malloc and free   %8d us (%.3f us/op)\r\n", timer.read_us(), (float)timer.read_us() / BENCH_OPS);
+#endif
+}
+
+utest::v1::status_t test_setup(const size_t number_of_cases)
+{
+    GREENTEA_SETUP(30, "default_auto");
+    return verbose_test_setup_handler(number_of_cases);
+}
+
+Case cases[] = {
+    Case("Allocations accounted by caller", test_callers),
+    Case("Table limits", test_limits),
+    Case("Binary dump", test_dump),
+    Case("Overhead per memory operation", test_benchmark)
+};
+
+Specification specification(test_setup, cases);
+
+int main()
+{
+    return !Harness::run(specification);
+}
@@ -0,0 +1,269 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "mbed.h"
+#include "greentea-client/test_env.h"
+#include "unity/unity.h"
+#include "utest/utest.h"
+
+#if !defined(MBED_CONF_RTOS_PRESENT)
+#error [NOT_SUPPORTED] poll wakeup test requires RTOS
+#endif
+
+using namespace utest::v1;
+
+#define TEST_HANDLES        32
+#define TEST_TIMEOUT_MS     100
+#define TEST_WAKEUPS        100
+
+/* A file handle whose readability is set by the test, counting how many
+ * times poll() checks it */
+class TestHandle : public FileHandle {
+public:
+    TestHandle() : _readable(false), _polls(0) {}
+
+    virtual ssize_t read(void *buffer, size_t size)
+    {
+        _readable = false;
+        return 0;
+    }
+
+    virtual ssize_t write(const void *buffer, size_t size)
+    {
+        return size;
+    }
+
+    virtual off_t seek(off_t offset, int whence)
+    {
+        return -ESPIPE;
+    }
+
+    virtual int close()
+    {
+        return 0;
+    }
+
+    virtual bool wakes_pollers() const
+    {
+        return true;
+    }
+
+    virtual short poll(short events) const
+    {
+        _polls++;
+        return _readable ? POLLIN : 0;
+    }
+
+    void signal()
+    {
+        _readable = true;
+        wake_pollers();
+    }
+
+    volatile bool _readable;
+    mutable volatile uint32_t _polls;
+};
+
+static TestHandle handles[TEST_HANDLES];
+static pollfh fhs[TEST_HANDLES];
+
+static void setup_handles()
+{
+    for (int i = 0; i < TEST_HANDLES; i++) {
+        handles[i]._readable = false;
+        handles[i]._polls = 0;
+        fhs[i].fh = &handles[i];
+        fhs[i].events = POLLIN;
+        fhs[i].revents = 0;
+    }
+}
+
+static uint32_t total_polls()
+{
+    uint32_t polls = 0;
+    for (int i = 0; i < TEST_HANDLES; i++) {
+        polls += handles[i]._polls;
+    }
+    return polls;
+}
+
+void test_ready()
+{
+    setup_handles();
+    handles[3]._readable = true;
+
+    TEST_ASSERT_EQUAL(1, poll(fhs, TEST_HANDLES, 0));
+    TEST_ASSERT_EQUAL(POLLIN, fhs[3].revents);
+    TEST_ASSERT_EQUAL(0, fhs[4].revents);
+
+    TEST_ASSERT_EQUAL(1, poll(fhs, TEST_HANDLES, -1));
+    TEST_ASSERT_EQUAL(POLLIN, fhs[3].revents);
+}
+
+/* A timed out poll() checks each handle once, and leaves the CPU to a
+ * lower priority thread while waiting */
+static volatile uint32_t idle_count;
+static volatile bool idle_stop;
+
+static void idle_thread()
+{
+    while (!idle_stop) {
+        idle_count++;
+    }
+}
+
+void test_timeout()
+{
+    setup_handles();
+    idle_count = 0;
+    idle_stop = false;
+
+    Thread idle(osPriorityLow);
+    idle.start(idle_thread);
+
+    Timer timer;
+    timer.start();
+    int count = poll(fhs, TEST_HANDLES, TEST_TIMEOUT_MS);
+    timer.stop();
+
+    idle_stop = true;
+    idle.join();
+
+    printf("%d handles, %d ms timeout: %lu scans, %lu idle loops\r\n",
+           TEST_HANDLES, TEST_TIMEOUT_MS, (unsigned long)total_polls(), (unsigned long)idle_count);
+
+    TEST_ASSERT_EQUAL(0, count);
+    TEST_ASSERT_INT_WITHIN(10, TEST_TIMEOUT_MS, timer.read_ms());
+    TEST_ASSERT_TRUE(idle_count > 0);
+    TEST_ASSERT_EQUAL(TEST_HANDLES, total_polls());
+}
+
+/* Wakeups from interrupts only rescan the handle that signalled */
+static Timer latency_timer;
+static volatile int latency_handle;
+
+static void signal_irq()
+{
+    latency_timer.reset();
+    handles[latency_handle].signal();
+}
+
+void test_wakeup_latency()
+{
+    Timeout timeout;
+    int max_us = 0;
+    int total_us = 0;
+
+    latency_timer.start();
+    for (int i = 0; i < TEST_WAKEUPS; i++) {
+        setup_handles();
+        latency_handle = i % TEST_HANDLES;
+        timeout.attach_us(signal_irq, 1000);
+
+        int count = poll(fhs, TEST_HANDLES, -1);
+        int us = latency_timer.read_us();
+
+        TEST_ASSERT_EQUAL(1, count);
+        TEST_ASSERT_EQUAL(POLLIN, fhs[latency_handle].revents);
+        TEST_ASSERT_EQUAL(TEST_HANDLES + 1, total_polls());
+        TEST_ASSERT_EQUAL(2, handles[latency_handle]._polls);
+
+        total_us += us;
+        if (us > max_us) {
+            max_us = us;
+        }
+    }
+
+    printf("%d handles: wakeup latency %d us average, %d us max\r\n",
+           TEST_HANDLES, total_us / TEST_WAKEUPS, max_us);
+}
+
+/* Wakeups from another thread */
+static void signal_thread(TestHandle *handle)
+{
+    Thread::wait(10);
+    handle->signal();
+}
+
+void test_wakeup_thread()
+{
+    setup_handles();
+
+    Thread thread;
+    thread.start(callback(signal_thread, &handles[TEST_HANDLES - 1]));
+
+    TEST_ASSERT_EQUAL(1, poll(fhs, TEST_HANDLES, 1000));
+    TEST_ASSERT_EQUAL(POLLIN, fhs[TEST_HANDLES - 1].revents);
+    thread.join();
+}
+
+/* A file handle which doesn't call wake_pollers() is found by rescanning */
+class QuietHandle : public TestHandle {
+public:
+    virtual bool wakes_pollers() const
+    {
+        return false;
+    }
+};
+
+static void set_readable(QuietHandle *handle)
+{
+    Thread::wait(10);
+    handle->_readable = true;
+}
+
+void test_rescan()
+{
+    setup_handles();
+    QuietHandle quiet;
+    fhs[0].fh = &quiet;
+
+    Thread thread;
+    thread.start(callback(set_readable, &quiet));
+
+    Timer timer;
+    timer.start();
+    int count = poll(fhs, TEST_HANDLES, 1000);
+    timer.stop();
+    thread.join();
+
+    TEST_ASSERT_EQUAL(1, count);
+    TEST_ASSERT_EQUAL(POLLIN, fhs[0].revents);
+    TEST_ASSERT_INT_WITHIN(MBED_CONF_PLATFORM_POLL_RESCAN_INTERVAL + 5, 10, timer.read_ms());
+    TEST_ASSERT_EQUAL(TEST_HANDLES - 1, total_polls());
+}
+
+utest::v1::status_t test_setup(const size_t number_of_cases)
+{
+    GREENTEA_SETUP(30, "default_auto");
+    return verbose_test_setup_handler(number_of_cases);
+}
+
+Case cases[] = {
+    Case("Ready handles", test_ready),
+    Case("Timeout and idle time", test_timeout),
+    Case("Wakeup latency from interrupt", test_wakeup_latency),
+    Case("Wakeup from thread", test_wakeup_thread),
+#if MBED_CONF_PLATFORM_POLL_RESCAN_INTERVAL >= 0
+    Case("Rescan of handles without wakeups", test_rescan)
+#endif
+};
+
+Specification specification(test_setup, cases);
+
+int main()
+{
+    return !Harness::run(specification);
+}
@@ -0,0 +1,264 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "mbed.h"
+#include "greentea-client/test_env.h"
+#include "unity/unity.h"
+#include "utest/utest.h"
+#include "platform/CircularBuffer.h"
+#include "platform/LockFreeRingBuffer.h"
+
+using namespace utest::v1;
+
+#define BENCH_BUFFER_SIZE   256
+#define BENCH_BYTES         (64 * 1024)
+#define BENCH_CHUNK         32
+
+#define ISR_VALUES          2000
+#define ISR_PERIOD_US       100
+
+void test_spsc_push_pop()
+{
+    // deliberately not a power of two
+    SPSCRingBuffer<int, 5> buffer;
+    int data[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    int out[8];
+
+    TEST_ASSERT_TRUE(buffer.empty());
+    TEST_ASSERT_FALSE(buffer.full());
+    TEST_ASSERT_FALSE(buffer.pop(out[0]));
+
+    TEST_ASSERT_EQUAL_UINT32(5, buffer.push(data, 8));
+    TEST_ASSERT_TRUE(buffer.full());
+    TEST_ASSERT_FALSE(buffer.push(data[5]));
+
+    TEST_ASSERT_EQUAL_UINT32(3, buffer.pop(out, 3));
+    TEST_ASSERT_EQUAL_INT(0, out[0]);
+    TEST_ASSERT_EQUAL_INT(2, out[2]);
+
+    // wraps around the end of the storage
+    TEST_ASSERT_EQUAL_UINT32(3, buffer.push(&data[5], 3));
+    TEST_ASSERT_EQUAL_UINT32(5, buffer.size());
+    TEST_ASSERT_EQUAL_UINT32(5, buffer.pop(out, 8));
+    for (int i = 0; i < 5; i++) {
+        TEST_ASSERT_EQUAL_INT(i + 3, out[i]);
+    }
+    TEST_ASSERT_TRUE(buffer.empty());
+
+    // run the indexes around several times
+    for (int i = 0; i < 100; i++) {
+        TEST_ASSERT_TRUE(buffer.push(i));
+        TEST_ASSERT_TRUE(buffer.pop(out[0]));
+        TEST_ASSERT_EQUAL_INT(i, out[0]);
+    }
+
+    buffer.push(data, 3);
+    buffer.reset();
+    TEST_ASSERT_TRUE(buffer.empty());
+}
+
+void test_spsc_spans()
+{
+    SPSCRingBuffer<char, 8> buffer;
+
+    RingBufferSpan<char> span = buffer.reserve(6);
+    TEST_ASSERT_EQUAL_UINT32(6, span.size);
+    memcpy(span.data, "abcdef", 6);
+
+    // publish only part of the reservation
+    span.size = 4;
+    buffer.commit(span);
+    TEST_ASSERT_EQUAL_UINT32(4, buffer.size());
+
+    span = buffer.peek();
+    TEST_ASSERT_EQUAL_UINT32(4, span.size);
+    TEST_ASSERT_EQUAL_INT(0, memcmp(span.data, "abcd", 4));
+    buffer.consume(3);
+
+    // the free space wraps around, the span stops at the end of the storage
+    span = buffer.reserve(8);
+    TEST_ASSERT_EQUAL_UINT32(4, span.size);
+    memcpy(span.data, "efgh", 4);
+    buffer.commit(span);
+
+    span = buffer.reserve(8);
+    TEST_ASSERT_EQUAL_UINT32(3, span.size);
+    memcpy(span.data, "ijk", 3);
+    buffer.commit(span);
+
+    TEST_ASSERT_TRUE(buffer.full());
+    TEST_ASSERT_EQUAL_UINT32(0, buffer.reserve(1).size);
+
+    char out[8];
+    TEST_ASSERT_EQUAL_UINT32(8, buffer.pop(out, 8));
+    TEST_ASSERT_EQUAL_INT(0, memcmp(out, "defghijk", 8));
+    TEST_ASSERT_EQUAL_UINT32(0, buffer.peek().size);
+}
+
+static MPSCRingBuffer<uint32_t, 64> mpsc_buffer;
+static volatile uint32_t isr_value;
+
+static void mpsc_isr_producer()
+{
+    if (isr_value < ISR_VALUES && mpsc_buffer.push(0x80000000 | isr_value)) {
+        isr_value++;
+    }
+}
+
+void test_mpsc_isr_and_thread()
+{
+    uint32_t thread_value = 0;
+    uint32_t expected[2] = { 0, 0 };
+
+    isr_value = 0;
+    Ticker ticker;
+    ticker.attach_us(mpsc_isr_producer, ISR_PERIOD_US);
+
+    while (expected[0] < ISR_VALUES || expected[1] < ISR_VALUES) {
+        // the thread produces in bursts so the interrupt hits reservations
+        uint32_t burst[4];
+        uint32_t count = 0;
+        while (count < 4 && thread_value + count < ISR_VALUES) {
+            burst[count] = thread_value + count;
+            count++;
+        }
+        thread_value += mpsc_buffer.push(burst, count);
+
+        uint32_t value;
+        while (mpsc_buffer.pop(value)) {
+            uint32_t producer = value >> 31;
+            TEST_ASSERT_EQUAL_UINT32(expected[producer], value & 0x7FFFFFFF);
+            expected[producer]++;
+        }
+    }
+
+    ticker.detach();
+    TEST_ASSERT_TRUE(mpsc_buffer.empty());
+    TEST_ASSERT_EQUAL_UINT32(0, mpsc_buffer.size());
+}
+
+void test_mpsc_spans()
+{
+    MPSCRingBuffer<char, 8> buffer;
+
+    RingBufferSpan<char> first = buffer.reserve(3);
+    RingBufferSpan<char> second = buffer.reserve(3);
+    TEST_ASSERT_EQUAL_UINT32(3, first.size);
+    TEST_ASSERT_EQUAL_UINT32(3, second.size);
+
+    // a later reservation committed first is not visible before the earlier one
+    memcpy(second.data, "def", 3);
+    buffer.commit(second);
+    TEST_ASSERT_TRUE(buffer.empty());
+    TEST_ASSERT_EQUAL_UINT32(0, buffer.peek().size);
+
+    memcpy(first.data, "abc", 3);
+    buffer.commit(first);
+
+    RingBufferSpan<char> span = buffer.peek();
+    TEST_ASSERT_EQUAL_UINT32(6, span.size);
+    TEST_ASSERT_EQUAL_INT(0, memcmp(span.data, "abcdef", 6));
+    buffer.consume(6);
+    TEST_ASSERT_TRUE(buffer.empty());
+}
+
+template <typename Buffer>
+static float bench_single(Buffer &buffer)
+{
+    Timer timer;
+    char c = 0;
+
+    timer.start();
+    for (uint32_t i = 0; i < BENCH_BYTES; i += BENCH_CHUNK) {
+        for (uint32_t j = 0; j < BENCH_CHUNK; j++) {
+            buffer.push(c++);
+        }
+        for (uint32_t j = 0; j < BENCH_CHUNK; j++) {
+            buffer.pop(c);
+        }
+    }
+    timer.stop();
+
+    return timer.read_us();
+}
+
+template <typename Buffer>
+static float bench_bulk(Buffer &buffer)
+{
+    Timer timer;
+    char chunk[BENCH_CHUNK] = { 0 };
+
+    timer.start();
+    for (uint32_t i = 0; i < BENCH_BYTES; i += BENCH_CHUNK) {
+        buffer.push(chunk, BENCH_CHUNK);
+        buffer.pop(chunk, BENCH_CHUNK);
+    }
+    timer.stop();
+
+    return timer.read_us();
+}
+
+/* Throughput of byte transfers through each buffer. CircularBuffer masks
+ * interrupts for the whole of each push and pop, so its per-byte time is also
+ * its worst-case interrupt masking time; the lock-free buffers never mask
+ * interrupts on cores with exclusive access instructions. */
+void test_benchmark()
+{
+    static CircularBuffer<char, BENCH_BUFFER_SIZE> circular;
+    static SPSCRingBuffer<char, BENCH_BUFFER_SIZE> spsc;
+    static MPSCRingBuffer<char, BENCH_BUFFER_SIZE> mpsc;
+
+    float circular_us = bench_single(circular);
+    float spsc_us = bench_single(spsc);
+    float spsc_bulk_us = bench_bulk(spsc);
+    float mpsc_us = bench_single(mpsc);
+    float mpsc_bulk_us = bench_bulk(mpsc);
+
+    printf("%u bytes through a %u bytes buffer:\r\n", BENCH_BYTES, BENCH_BUFFER_SIZE);
+    printf("  CircularBuffer         %8.0f us (%.3f us/byte, masked)\r\n",
+           circular_us, circular_us / BENCH_BYTES);
+    printf("  SPSCRingBuffer         %8.0f us (%.3f us/byte)\r\n",
+           spsc_us, spsc_us / BENCH_BYTES);
+    printf("  SPSCRingBuffer (bulk)  %8.0f us (%.3f us/byte)\r\n",
+           spsc_bulk_us, spsc_bulk_us / BENCH_BYTES);
+    printf("  MPSCRingBuffer         %8.0f us (%.3f us/byte)\r\n",
+           mpsc_us, mpsc_us / BENCH_BYTES);
+    printf("  MPSCRingBuffer (bulk)  %8.0f us (%.3f us/byte)\r\n",
+           mpsc_bulk_us, mpsc_bulk_us / BENCH_BYTES);
+
+    TEST_ASSERT_TRUE(spsc.empty());
+    TEST_ASSERT_TRUE(mpsc.empty());
+}
+
+utest::v1::status_t test_setup(const size_t number_of_cases)
+{
+    GREENTEA_SETUP(30, "default_auto");
+    return verbose_test_setup_handler(number_of_cases);
+}
+
+Case cases[] = {
+    Case("SPSC push and pop", test_spsc_push_pop),
+    Case("SPSC reserve, commit, peek and consume", test_spsc_spans),
+    Case("MPSC interrupt and thread producers", test_mpsc_isr_and_thread),
+    Case("MPSC out of order commits", test_mpsc_spans),
+    Case("Throughput against CircularBuffer", test_benchmark)
+};
+
+Specification specification(test_setup, cases);
+
+int main()
+{
+    return !Harness::run(specification);
+}
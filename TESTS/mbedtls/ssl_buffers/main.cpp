@@ -0,0 +1,468 @@
+/*
+ * Copyright (c) 2017, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "mbed.h"
+#include "greentea-client/test_env.h"
+#include "unity/unity.h"
+#include "utest/utest.h"
+
+#include "mbedtls/ssl.h"
+#include "mbedtls/ssl_internal.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/certs.h"
+
+#if !defined(MBEDTLS_SSL_CLI_C) || !defined(MBEDTLS_SSL_SRV_C) || \
+    !defined(MBEDTLS_KEY_EXCHANGE_PSK_ENABLED) || !defined(MBEDTLS_CTR_DRBG_C)
+#error [NOT_SUPPORTED] TLS client, server and PSK key exchange required
+#endif
+
+using namespace utest::v1;
+
+#ifndef MBED_CFG_SSL_BUFFERS_TRANSFER
+#define MBED_CFG_SSL_BUFFERS_TRANSFER 0x4000
+#endif
+
+#ifndef MBED_CFG_SSL_BUFFERS_CHUNK
+#define MBED_CFG_SSL_BUFFERS_CHUNK 512
+#endif
+
+#ifndef MBED_CFG_SSL_BUFFERS_PIPE
+#define MBED_CFG_SSL_BUFFERS_PIPE 2048
+#endif
+
+#define MAX_SESSIONS 8
+
+
+// One direction of an in-memory connection
+struct pipe {
+    unsigned char data[MBED_CFG_SSL_BUFFERS_PIPE];
+    size_t len;
+};
+
+// The ends of the pipes used by one side
+struct link {
+    struct pipe *tx;
+    struct pipe *rx;
+};
+
+static int pipe_send(void *ctx, const unsigned char *buf, size_t len)
+{
+    struct pipe *p = ((struct link *)ctx)->tx;
+    if (p->len == sizeof(p->data)) {
+        return MBEDTLS_ERR_SSL_WANT_WRITE;
+    }
+
+    if (len > sizeof(p->data) - p->len) {
+        len = sizeof(p->data) - p->len;
+    }
+    memcpy(&p->data[p->len], buf, len);
+    p->len += len;
+    return len;
+}
+
+static int pipe_recv(void *ctx, unsigned char *buf, size_t len)
+{
+    struct pipe *p = ((struct link *)ctx)->rx;
+    if (p->len == 0) {
+        return MBEDTLS_ERR_SSL_WANT_READ;
+    }
+
+    if (len > p->len) {
+        len = p->len;
+    }
+    memcpy(buf, p->data, len);
+    memmove(p->data, &p->data[len], p->len - len);
+    p->len -= len;
+    return len;
+}
+
+struct session {
+    mbedtls_ssl_context client;
+    mbedtls_ssl_context server;
+    struct pipe to_server;
+    struct pipe to_client;
+    struct link client_link;
+    struct link server_link;
+};
+
+namespace {
+    struct session sessions[MAX_SESSIONS];
+    mbedtls_ssl_config client_conf;
+    mbedtls_ssl_config server_conf;
+    mbedtls_ctr_drbg_context drbg;
+
+    unsigned char tx_buffer[MBED_CFG_SSL_BUFFERS_CHUNK];
+    unsigned char rx_buffer[MBED_CFG_SSL_BUFFERS_CHUNK];
+
+    const unsigned char psk[16] = {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+        0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+    };
+    const char psk_identity[] = "mbed";
+
+    const int psk_suites[] = {
+        MBEDTLS_TLS_PSK_WITH_AES_128_GCM_SHA256,
+        MBEDTLS_TLS_PSK_WITH_AES_128_CBC_SHA256,
+        0
+    };
+}
+
+// Not an entropy source, the test only needs a working DRBG
+static int test_entropy(void *data, unsigned char *output, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        output[i] = (unsigned char)(i * 31 + 7);
+    }
+    return 0;
+}
+
+// Heap use is only measured with MBED_HEAP_STATS_ENABLED
+static uint32_t heap_used()
+{
+#if MBED_HEAP_STATS_ENABLED
+    mbed_stats_heap_t stats;
+    mbed_stats_heap_get(&stats);
+    return stats.current_size;
+#else
+    return 0;
+#endif
+}
+
+static void confs_init(unsigned char mfl_code)
+{
+    mbedtls_ctr_drbg_init(&drbg);
+    TEST_ASSERT_EQUAL(0, mbedtls_ctr_drbg_seed(&drbg, test_entropy, NULL, NULL, 0));
+
+    mbedtls_ssl_config_init(&client_conf);
+    mbedtls_ssl_config_init(&server_conf);
+    TEST_ASSERT_EQUAL(0, mbedtls_ssl_config_defaults(&client_conf, MBEDTLS_SSL_IS_CLIENT,
+            MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT));
+    TEST_ASSERT_EQUAL(0, mbedtls_ssl_config_defaults(&server_conf, MBEDTLS_SSL_IS_SERVER,
+            MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT));
+
+    mbedtls_ssl_conf_rng(&client_conf, mbedtls_ctr_drbg_random, &drbg);
+    mbedtls_ssl_conf_rng(&server_conf, mbedtls_ctr_drbg_random, &drbg);
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+    TEST_ASSERT_EQUAL(0, mbedtls_ssl_conf_max_frag_len(&client_conf, mfl_code));
+#endif
+
+    TEST_ASSERT_EQUAL(0, mbedtls_ssl_conf_psk(&client_conf, psk, sizeof(psk),
+            (const unsigned char *)psk_identity, strlen(psk_identity)));
+    TEST_ASSERT_EQUAL(0, mbedtls_ssl_conf_psk(&server_conf, psk, sizeof(psk),
+            (const unsigned char *)psk_identity, strlen(psk_identity)));
+    mbedtls_ssl_conf_ciphersuites(&client_conf, psk_suites);
+    mbedtls_ssl_conf_ciphersuites(&server_conf, psk_suites);
+}
+
+static void confs_free()
+{
+    mbedtls_ssl_config_free(&client_conf);
+    mbedtls_ssl_config_free(&server_conf);
+    mbedtls_ctr_drbg_free(&drbg);
+}
+
+// Returns the number of sessions the heap had room for
+static int sessions_init(int count)
+{
+    for (int i = 0; i < count; i++) {
+        struct session *s = &sessions[i];
+        s->to_server.len = 0;
+        s->to_client.len = 0;
+        s->client_link.tx = &s->to_server;
+        s->client_link.rx = &s->to_client;
+        s->server_link.tx = &s->to_client;
+        s->server_link.rx = &s->to_server;
+
+        mbedtls_ssl_init(&s->client);
+        mbedtls_ssl_init(&s->server);
+        int ret = mbedtls_ssl_setup(&s->client, &client_conf);
+        if (ret == 0) {
+            ret = mbedtls_ssl_setup(&s->server, &server_conf);
+        }
+
+        if (ret == MBEDTLS_ERR_SSL_ALLOC_FAILED) {
+            mbedtls_ssl_free(&s->client);
+            mbedtls_ssl_free(&s->server);
+            return i;
+        }
+        TEST_ASSERT_EQUAL(0, ret);
+
+        mbedtls_ssl_set_bio(&s->client, &s->client_link, pipe_send, pipe_recv, NULL);
+        mbedtls_ssl_set_bio(&s->server, &s->server_link, pipe_send, pipe_recv, NULL);
+    }
+
+    return count;
+}
+
+static void sessions_free(int count)
+{
+    for (int i = 0; i < count; i++) {
+        mbedtls_ssl_free(&sessions[i].client);
+        mbedtls_ssl_free(&sessions[i].server);
+    }
+}
+
+static void check_progress(int ret)
+{
+    TEST_ASSERT(ret >= 0 || ret == MBEDTLS_ERR_SSL_WANT_READ ||
+                ret == MBEDTLS_ERR_SSL_WANT_WRITE);
+}
+
+// Steps every handshake in turn, and returns the peak heap use
+static uint32_t sessions_handshake(int count, uint32_t base)
+{
+    uint32_t peak = 0;
+    bool done = false;
+
+    while (!done) {
+        done = true;
+        for (int i = 0; i < count; i++) {
+            struct session *s = &sessions[i];
+            if (s->client.state != MBEDTLS_SSL_HANDSHAKE_OVER) {
+                check_progress(mbedtls_ssl_handshake_step(&s->client));
+                done = false;
+            }
+            if (s->server.state != MBEDTLS_SSL_HANDSHAKE_OVER) {
+                check_progress(mbedtls_ssl_handshake_step(&s->server));
+                done = false;
+            }
+
+            if (heap_used() - base > peak) {
+                peak = heap_used() - base;
+            }
+        }
+    }
+
+    return peak;
+}
+
+// Bytes of the stream, a pattern which does not line up with the chunks
+static unsigned char pattern(size_t offset)
+{
+    return (offset * 7 + offset / 251) & 0xff;
+}
+
+static void write_all(mbedtls_ssl_context *ssl, const unsigned char *data, size_t size)
+{
+    while (size > 0) {
+        int ret = mbedtls_ssl_write(ssl, data, size);
+        TEST_ASSERT(ret > 0);
+        data += ret;
+        size -= ret;
+    }
+}
+
+// Each chunk from a client is echoed back by its server, the sessions
+// taking turns
+static void sessions_echo(int count)
+{
+    for (size_t offset = 0; offset < MBED_CFG_SSL_BUFFERS_TRANSFER; offset += sizeof(tx_buffer)) {
+        for (size_t i = 0; i < sizeof(tx_buffer); i++) {
+            tx_buffer[i] = pattern(offset + i);
+        }
+
+        for (int i = 0; i < count; i++) {
+            struct session *s = &sessions[i];
+            write_all(&s->client, tx_buffer, sizeof(tx_buffer));
+
+            for (size_t echoed = 0; echoed < sizeof(tx_buffer); ) {
+                int ret = mbedtls_ssl_read(&s->server, rx_buffer, sizeof(rx_buffer));
+                TEST_ASSERT(ret > 0);
+                write_all(&s->server, rx_buffer, ret);
+                echoed += ret;
+            }
+
+            for (size_t received = 0; received < sizeof(tx_buffer); ) {
+                int ret = mbedtls_ssl_read(&s->client, rx_buffer, sizeof(rx_buffer) - received);
+                TEST_ASSERT(ret > 0);
+                TEST_ASSERT_EQUAL(0, memcmp(rx_buffer, &tx_buffer[received], ret));
+                received += ret;
+            }
+        }
+    }
+}
+
+// Heap per session, both of its ends, at the peak of the handshakes and
+// once connected, and the time taken to echo the data through every session
+template <int COUNT>
+void test_ssl_buffers_sessions()
+{
+    uint32_t base = heap_used();
+    confs_init(MBEDTLS_SSL_MAX_FRAG_LEN_NONE);
+    int count = sessions_init(COUNT);
+    if (count < COUNT) {
+        printf("MBED: %d sessions: heap only has room for %d\r\n", COUNT, count);
+        sessions_free(count);
+        confs_free();
+        return;
+    }
+
+    uint32_t peak = sessions_handshake(COUNT, base);
+    uint32_t connected = heap_used() - base;
+
+    Timer timer;
+    timer.start();
+    sessions_echo(COUNT);
+    timer.stop();
+    uint32_t transferred = heap_used() - base;
+
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+    for (int i = 0; i < COUNT; i++) {
+        TEST_ASSERT_EQUAL(MBEDTLS_SSL_MIN_CONTENT_LEN + MBEDTLS_SSL_BUFFER_OVERHEAD,
+                sessions[i].server.out_buf_len);
+        TEST_ASSERT_EQUAL(MBEDTLS_SSL_MIN_CONTENT_LEN + MBEDTLS_SSL_BUFFER_OVERHEAD,
+                sessions[i].client.in_buf_len);
+    }
+#endif
+
+    printf("MBED: %d sessions: heap per session %6lu peak, %6lu connected, %6lu after echo\r\n",
+            COUNT, (unsigned long)peak / COUNT, (unsigned long)connected / COUNT,
+            (unsigned long)transferred / COUNT);
+    printf("MBED: %d sessions: echoed %d bytes each in %d ms\r\n",
+            COUNT, MBED_CFG_SSL_BUFFERS_TRANSFER, timer.read_ms());
+
+    sessions_free(COUNT);
+    confs_free();
+}
+
+// A certificate chain does not fit the small buffers of the handshake, the
+// client grows its buffer to read it and shrinks it once connected
+void test_ssl_buffers_grow()
+{
+#if !defined(MBEDTLS_KEY_EXCHANGE_ECDHE_ECDSA_ENABLED) || !defined(MBEDTLS_CERTS_C) || \
+    !defined(MBEDTLS_PEM_PARSE_C) || !defined(MBEDTLS_ECP_DP_SECP256R1_ENABLED)
+    TEST_IGNORE_MESSAGE("ECDHE-ECDSA with the test certificates required");
+#else
+    static const int ecdsa_suites[] = {
+        MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+        0
+    };
+
+    mbedtls_x509_crt chain;
+    mbedtls_pk_context key;
+    mbedtls_x509_crt_init(&chain);
+    mbedtls_pk_init(&key);
+    // the server certificate followed by every test CA
+    TEST_ASSERT_EQUAL(0, mbedtls_x509_crt_parse(&chain,
+            (const unsigned char *)mbedtls_test_srv_crt_ec, mbedtls_test_srv_crt_ec_len));
+    TEST_ASSERT_EQUAL(0, mbedtls_x509_crt_parse(&chain,
+            (const unsigned char *)mbedtls_test_cas_pem, mbedtls_test_cas_pem_len));
+    TEST_ASSERT_EQUAL(0, mbedtls_pk_parse_key(&key,
+            (const unsigned char *)mbedtls_test_srv_key_ec, mbedtls_test_srv_key_ec_len, NULL, 0));
+
+    confs_init(MBEDTLS_SSL_MAX_FRAG_LEN_NONE);
+    mbedtls_ssl_conf_authmode(&client_conf, MBEDTLS_SSL_VERIFY_NONE);
+    mbedtls_ssl_conf_ciphersuites(&client_conf, ecdsa_suites);
+    mbedtls_ssl_conf_ciphersuites(&server_conf, ecdsa_suites);
+    TEST_ASSERT_EQUAL(0, mbedtls_ssl_conf_own_cert(&server_conf, &chain, &key));
+    TEST_ASSERT_EQUAL(1, sessions_init(1));
+
+    struct session *s = &sessions[0];
+    size_t max_in_buf = 0;
+    while (s->client.state != MBEDTLS_SSL_HANDSHAKE_OVER ||
+           s->server.state != MBEDTLS_SSL_HANDSHAKE_OVER) {
+        if (s->client.state != MBEDTLS_SSL_HANDSHAKE_OVER) {
+            check_progress(mbedtls_ssl_handshake_step(&s->client));
+        }
+        if (s->server.state != MBEDTLS_SSL_HANDSHAKE_OVER) {
+            check_progress(mbedtls_ssl_handshake_step(&s->server));
+        }
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+        if (s->client.in_buf_len > max_in_buf) {
+            max_in_buf = s->client.in_buf_len;
+        }
+#endif
+    }
+    sessions_echo(1);
+
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+    const size_t small = MBEDTLS_SSL_MIN_CONTENT_LEN + MBEDTLS_SSL_BUFFER_OVERHEAD;
+    TEST_ASSERT(max_in_buf > small);
+    TEST_ASSERT_EQUAL(small, s->client.in_buf_len);
+    TEST_ASSERT_EQUAL(small, s->client.out_buf_len);
+    TEST_ASSERT_EQUAL(small, s->server.in_buf_len);
+    TEST_ASSERT_EQUAL(small, s->server.out_buf_len);
+
+    // and again after a reset
+    TEST_ASSERT_EQUAL(0, mbedtls_ssl_session_reset(&s->client));
+    TEST_ASSERT_EQUAL(small, s->client.in_buf_len);
+    TEST_ASSERT_EQUAL(small, s->client.out_buf_len);
+#endif
+    (void)max_in_buf;
+
+    sessions_free(1);
+    confs_free();
+    mbedtls_x509_crt_free(&chain);
+    mbedtls_pk_free(&key);
+#endif
+}
+
+// A server sizes its buffers and records to the client's max_fragment_length
+void test_ssl_buffers_max_fragment_length()
+{
+#if !defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+    TEST_IGNORE_MESSAGE("MBEDTLS_SSL_MAX_FRAGMENT_LENGTH required");
+#else
+    confs_init(MBEDTLS_SSL_MAX_FRAG_LEN_512);
+    TEST_ASSERT_EQUAL(1, sessions_init(1));
+    sessions_handshake(1, 0);
+
+    struct session *s = &sessions[0];
+    TEST_ASSERT_EQUAL(512, mbedtls_ssl_get_max_frag_len(&s->server));
+    TEST_ASSERT_EQUAL(512, mbedtls_ssl_get_max_frag_len(&s->client));
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+    TEST_ASSERT_EQUAL(512 + MBEDTLS_SSL_BUFFER_OVERHEAD, s->server.in_buf_len);
+    TEST_ASSERT_EQUAL(512 + MBEDTLS_SSL_BUFFER_OVERHEAD, s->server.out_buf_len);
+#endif
+
+    // records of the server are cut to the negotiated length
+    uint8_t data[600];
+    memset(data, 0x5a, sizeof(data));
+    int ret = mbedtls_ssl_write(&s->server, data, sizeof(data));
+    TEST_ASSERT_EQUAL(512, ret);
+    TEST_ASSERT(s->to_client.len <= 512 + MBEDTLS_SSL_BUFFER_OVERHEAD);
+    TEST_ASSERT_EQUAL(512, mbedtls_ssl_read(&s->client, data, sizeof(data)));
+
+    sessions_echo(1);
+
+    sessions_free(1);
+    confs_free();
+#endif
+}
+
+
+utest::v1::status_t test_setup(const size_t number_of_cases)
+{
+    GREENTEA_SETUP(120, "default_auto");
+    return verbose_test_setup_handler(number_of_cases);
+}
+
+Case cases[] = {
+    Case("TLS buffers, 1 session", test_ssl_buffers_sessions<1>),
+    Case("TLS buffers, 4 sessions", test_ssl_buffers_sessions<4>),
+    Case("TLS buffers, 8 sessions", test_ssl_buffers_sessions<8>),
+    Case("TLS buffers grow for a certificate chain", test_ssl_buffers_grow),
+    Case("TLS buffers with max_fragment_length", test_ssl_buffers_max_fragment_length),
+};
+
+Specification specification(test_setup, cases);
+
+int main()
+{
+    return !Harness::run(specification);
+}
@@ -0,0 +1,345 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "mbed.h"
+#include "greentea-client/test_env.h"
+#include "unity.h"
+#include "utest.h"
+
+#include "nsapi_dns.h"
+#include <string.h>
+
+using namespace utest::v1;
+
+#if !MBED_CONF_NSAPI_DNS_CACHE_SIZE
+#error [NOT_SUPPORTED] DNS cache is disabled
+#endif
+
+
+// Answers of the DNS server, hosts not listed are not found
+const struct {
+    const char *host;
+    nsapi_version_t version;
+    const char *address;
+    uint32_t ttl;
+} RECORDS[] = {
+    {"cached.example.com", NSAPI_IPv4, "10.0.0.10", 300},
+    {"cached.example.com", NSAPI_IPv6, "2001:db8::10", 300},
+    {"short.example.com",  NSAPI_IPv4, "10.0.0.11", 1},
+    {"async.example.com",  NSAPI_IPv4, "10.0.0.12", 300},
+};
+
+// Time not found answers can be cached for
+#define NEGATIVE_TTL 1
+
+
+// Network stack answering DNS queries in place of the DNS servers
+class DNSServerStack : public NetworkStack {
+public:
+    DNSServerStack() : queries(0), _size(0), _callback(0), _data(0) {}
+
+    int queries;
+
+    virtual const char *get_ip_address()
+    {
+        return "10.0.0.2";
+    }
+
+protected:
+    virtual nsapi_error_t socket_open(nsapi_socket_t *handle, nsapi_protocol_t proto)
+    {
+        *handle = this;
+        _size = 0;
+        return NSAPI_ERROR_OK;
+    }
+
+    virtual nsapi_error_t socket_close(nsapi_socket_t handle)
+    {
+        _callback = 0;
+        return NSAPI_ERROR_OK;
+    }
+
+    virtual nsapi_error_t socket_bind(nsapi_socket_t handle, const SocketAddress &address)
+    {
+        return NSAPI_ERROR_UNSUPPORTED;
+    }
+
+    virtual nsapi_error_t socket_listen(nsapi_socket_t handle, int backlog)
+    {
+        return NSAPI_ERROR_UNSUPPORTED;
+    }
+
+    virtual nsapi_error_t socket_connect(nsapi_socket_t handle, const SocketAddress &address)
+    {
+        return NSAPI_ERROR_UNSUPPORTED;
+    }
+
+    virtual nsapi_error_t socket_accept(nsapi_socket_t server,
+            nsapi_socket_t *handle, SocketAddress *address = 0)
+    {
+        return NSAPI_ERROR_UNSUPPORTED;
+    }
+
+    virtual nsapi_size_or_error_t socket_send(nsapi_socket_t handle,
+            const void *data, nsapi_size_t size)
+    {
+        return NSAPI_ERROR_UNSUPPORTED;
+    }
+
+    virtual nsapi_size_or_error_t socket_recv(nsapi_socket_t handle,
+            void *data, nsapi_size_t size)
+    {
+        return NSAPI_ERROR_UNSUPPORTED;
+    }
+
+    virtual nsapi_size_or_error_t socket_sendto(nsapi_socket_t handle, const SocketAddress &address,
+            const void *data, nsapi_size_t size)
+    {
+        const uint8_t *question = (const uint8_t *)data;
+        queries += 1;
+
+        // read the name and type asked
+        char host[128] = "";
+        size_t i = 12;
+        while (question[i]) {
+            if (host[0]) {
+                strcat(host, ".");
+            }
+            strncat(host, (const char *)&question[i+1], question[i]);
+            i += 1 + question[i];
+        }
+        i += 1;
+        nsapi_version_t version = (question[i+1] == 28) ? NSAPI_IPv6 : NSAPI_IPv4;
+        i += 4;
+
+        // answer with the question, followed by the records
+        memcpy(_response, question, i);
+        _size = i;
+
+        uint16_t ancount = 0;
+        for (size_t r = 0; r < sizeof(RECORDS)/sizeof(RECORDS[0]); r++) {
+            if (strcmp(RECORDS[r].host, host) != 0 || RECORDS[r].version != version) {
+                continue;
+            }
+
+            SocketAddress record(RECORDS[r].address);
+            uint8_t len = (version == NSAPI_IPv6) ? NSAPI_IPv6_BYTES : NSAPI_IPv4_BYTES;
+            append_rr(version == NSAPI_IPv6 ? 28 : 1, RECORDS[r].ttl, len);
+            memcpy(&_response[_size], record.get_ip_bytes(), len);
+            _size += len;
+            ancount += 1;
+        }
+
+        _response[2] = 0x81;
+        _response[3] = 0x80;
+        _response[6] = ancount >> 8;
+        _response[7] = ancount;
+
+        if (!ancount) {
+            // not found, with the SOA record giving the negative ttl
+            _response[3] = 0x83;
+            _response[9] = 1;
+            append_rr(6, NEGATIVE_TTL, 22);
+            memset(&_response[_size], 0, 22);
+            _size += 22;
+        }
+
+        if (_callback) {
+            _callback(_data);
+        }
+
+        return size;
+    }
+
+    virtual nsapi_size_or_error_t socket_recvfrom(nsapi_socket_t handle, SocketAddress *address,
+            void *buffer, nsapi_size_t size)
+    {
+        if (!_size) {
+            return NSAPI_ERROR_WOULD_BLOCK;
+        }
+
+        nsapi_size_t len = _size < size ? _size : size;
+        memcpy(buffer, _response, len);
+        _size = 0;
+        return len;
+    }
+
+    virtual void socket_attach(nsapi_socket_t handle, void (*callback)(void *), void *data)
+    {
+        _callback = callback;
+        _data = data;
+    }
+
+private:
+    void append_rr(uint16_t type, uint32_t ttl, uint16_t length)
+    {
+        const uint8_t rr[] = {
+            0xc0, 0x0c,
+            (uint8_t)(type >> 8), (uint8_t)type,
+            0x00, 0x01,
+            (uint8_t)(ttl >> 24), (uint8_t)(ttl >> 16), (uint8_t)(ttl >> 8), (uint8_t)ttl,
+            (uint8_t)(length >> 8), (uint8_t)length,
+        };
+        memcpy(&_response[_size], rr, sizeof(rr));
+        _size += sizeof(rr);
+    }
+
+    uint8_t _response[512];
+    nsapi_size_t _size;
+    void (*_callback)(void *);
+    void *_data;
+};
+
+DNSServerStack stack;
+
+
+// Test functions
+void test_dns_cache_hit()
+{
+    SocketAddress address;
+    int queries = stack.queries;
+
+    TEST_ASSERT_EQUAL(0, stack.gethostbyname("cached.example.com", &address, NSAPI_IPv4));
+    TEST_ASSERT_EQUAL_STRING("10.0.0.10", address.get_ip_address());
+    TEST_ASSERT_EQUAL(queries + 1, stack.queries);
+
+    // answered from the cache
+    TEST_ASSERT_EQUAL(0, stack.gethostbyname("cached.example.com", &address, NSAPI_IPv4));
+    TEST_ASSERT_EQUAL_STRING("10.0.0.10", address.get_ip_address());
+    TEST_ASSERT_EQUAL(queries + 1, stack.queries);
+}
+
+void test_dns_cache_versions()
+{
+    SocketAddress address;
+    int queries = stack.queries;
+
+    // each version is cached on its own
+    TEST_ASSERT_EQUAL(0, stack.gethostbyname("cached.example.com", &address, NSAPI_IPv6));
+    TEST_ASSERT_EQUAL(NSAPI_IPv6, address.get_ip_version());
+    TEST_ASSERT_EQUAL(queries + 1, stack.queries);
+
+    TEST_ASSERT_EQUAL(0, stack.gethostbyname("cached.example.com", &address, NSAPI_IPv6));
+    TEST_ASSERT_EQUAL(NSAPI_IPv6, address.get_ip_version());
+    TEST_ASSERT_EQUAL(0, stack.gethostbyname("cached.example.com", &address, NSAPI_IPv4));
+    TEST_ASSERT_EQUAL(NSAPI_IPv4, address.get_ip_version());
+    TEST_ASSERT_EQUAL(queries + 1, stack.queries);
+}
+
+void test_dns_cache_ttl()
+{
+    SocketAddress address;
+    int queries = stack.queries;
+
+    TEST_ASSERT_EQUAL(0, stack.gethostbyname("short.example.com", &address, NSAPI_IPv4));
+    TEST_ASSERT_EQUAL(0, stack.gethostbyname("short.example.com", &address, NSAPI_IPv4));
+    TEST_ASSERT_EQUAL(queries + 1, stack.queries);
+
+    // asked again once expired
+    wait(2);
+    TEST_ASSERT_EQUAL(0, stack.gethostbyname("short.example.com", &address, NSAPI_IPv4));
+    TEST_ASSERT_EQUAL_STRING("10.0.0.11", address.get_ip_address());
+    TEST_ASSERT_EQUAL(queries + 2, stack.queries);
+}
+
+void test_dns_cache_negative()
+{
+    SocketAddress address;
+    int queries = stack.queries;
+
+    TEST_ASSERT_EQUAL(NSAPI_ERROR_DNS_FAILURE, stack.gethostbyname("missing.example.com", &address, NSAPI_IPv4));
+    TEST_ASSERT_EQUAL(NSAPI_ERROR_DNS_FAILURE, stack.gethostbyname("missing.example.com", &address, NSAPI_IPv4));
+    TEST_ASSERT_EQUAL(queries + 1, stack.queries);
+
+    wait(NEGATIVE_TTL + 1);
+    TEST_ASSERT_EQUAL(NSAPI_ERROR_DNS_FAILURE, stack.gethostbyname("missing.example.com", &address, NSAPI_IPv4));
+    TEST_ASSERT_EQUAL(queries + 2, stack.queries);
+}
+
+Semaphore async_done;
+nsapi_error_t async_result;
+SocketAddress async_address;
+
+void async_callback(nsapi_error_t result, SocketAddress *address)
+{
+    async_result = result;
+    if (address) {
+        async_address = *address;
+    }
+    async_done.release();
+}
+
+void test_dns_async()
+{
+    int queries = stack.queries;
+
+    nsapi_error_t err = stack.gethostbyname_async("async.example.com", async_callback, NSAPI_IPv4);
+    TEST_ASSERT_EQUAL(NSAPI_ERROR_IN_PROGRESS, err);
+    TEST_ASSERT_TRUE(async_done.wait(1000) > 0);
+    TEST_ASSERT_EQUAL(0, async_result);
+    TEST_ASSERT_EQUAL_STRING("10.0.0.12", async_address.get_ip_address());
+    TEST_ASSERT_EQUAL(queries + 1, stack.queries);
+
+    // the cached answer is given right away
+    async_address = SocketAddress();
+    err = stack.gethostbyname_async("async.example.com", async_callback, NSAPI_IPv4);
+    TEST_ASSERT_EQUAL(0, err);
+    TEST_ASSERT_TRUE(async_done.wait(0) > 0);
+    TEST_ASSERT_EQUAL_STRING("10.0.0.12", async_address.get_ip_address());
+    TEST_ASSERT_EQUAL(queries + 1, stack.queries);
+}
+
+void test_dns_async_not_found()
+{
+    nsapi_error_t err = stack.gethostbyname_async("nowhere.example.com", async_callback, NSAPI_IPv4);
+    TEST_ASSERT_EQUAL(NSAPI_ERROR_IN_PROGRESS, err);
+    TEST_ASSERT_TRUE(async_done.wait(1000) > 0);
+    TEST_ASSERT_EQUAL(NSAPI_ERROR_DNS_FAILURE, async_result);
+
+    // the negative answer is cached too
+    err = stack.gethostbyname_async("nowhere.example.com", async_callback, NSAPI_IPv4);
+    TEST_ASSERT_EQUAL(NSAPI_ERROR_DNS_FAILURE, err);
+}
+
+void test_dns_async_ip_address()
+{
+    nsapi_error_t err = stack.gethostbyname_async("10.0.0.13", async_callback, NSAPI_IPv4);
+    TEST_ASSERT_EQUAL(0, err);
+    TEST_ASSERT_TRUE(async_done.wait(0) > 0);
+    TEST_ASSERT_EQUAL_STRING("10.0.0.13", async_address.get_ip_address());
+}
+
+
+// Test setup
+utest::v1::status_t test_setup(const size_t number_of_cases) {
+    GREENTEA_SETUP(30, "default_auto");
+    return verbose_test_setup_handler(number_of_cases);
+}
+
+Case cases[] = {
+    Case("DNS cache hit", test_dns_cache_hit),
+    Case("DNS cache versions", test_dns_cache_versions),
+    Case("DNS cache ttl", test_dns_cache_ttl),
+    Case("DNS cache negative answers", test_dns_cache_negative),
+    Case("DNS asynchronous query", test_dns_async),
+    Case("DNS asynchronous query not found", test_dns_async_not_found),
+    Case("DNS asynchronous IP address", test_dns_async_ip_address),
+};
+
+Specification specification(test_setup, cases);
+
+int main() {
+    return !Harness::run(specification);
+}
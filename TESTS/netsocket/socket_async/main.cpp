@@ -0,0 +1,507 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "mbed.h"
+#include "greentea-client/test_env.h"
+#include "unity.h"
+#include "utest.h"
+
+#include "events/EventQueue.h"
+#include <string.h>
+
+using namespace utest::v1;
+
+
+#ifndef MBED_CFG_SOCKET_ASYNC_SOCKETS
+#define MBED_CFG_SOCKET_ASYNC_SOCKETS 100
+#endif
+
+#ifndef MBED_CFG_SOCKET_ASYNC_SIZE
+#define MBED_CFG_SOCKET_ASYNC_SIZE 1000
+#endif
+
+#ifndef MBED_CFG_SOCKET_ASYNC_BUFFER
+#define MBED_CFG_SOCKET_ASYNC_BUFFER 128
+#endif
+
+#ifndef MBED_CFG_SOCKET_ASYNC_CHUNK
+#define MBED_CFG_SOCKET_ASYNC_CHUNK 64
+#endif
+
+
+// Network stack echoing back what is sent on each socket, through a
+// buffer which only takes a few bytes at a time
+class EchoStack : public NetworkStack {
+public:
+    EchoStack() : accepted(0), refused(0), _sockets() {}
+
+    int accepted;
+    int refused;
+
+    virtual const char *get_ip_address()
+    {
+        return "10.0.0.2";
+    }
+
+protected:
+    struct echo {
+        bool open;
+        nsapi_protocol_t proto;
+        bool connecting;
+        bool connected;
+        uint8_t buffer[MBED_CFG_SOCKET_ASYNC_BUFFER];
+        nsapi_size_t size;
+        SocketAddress from;
+        void (*callback)(void *);
+        void *data;
+    };
+
+    static void signal(echo *s)
+    {
+        if (s->callback) {
+            s->callback(s->data);
+        }
+    }
+
+    virtual nsapi_error_t socket_open(nsapi_socket_t *handle, nsapi_protocol_t proto)
+    {
+        for (int i = 0; i < MBED_CFG_SOCKET_ASYNC_SOCKETS + 2; i++) {
+            if (!_sockets[i].open) {
+                _sockets[i] = echo();
+                _sockets[i].open = true;
+                _sockets[i].proto = proto;
+                *handle = &_sockets[i];
+                return NSAPI_ERROR_OK;
+            }
+        }
+
+        return NSAPI_ERROR_NO_SOCKET;
+    }
+
+    virtual nsapi_error_t socket_close(nsapi_socket_t handle)
+    {
+        echo *s = (echo *)handle;
+        s->open = false;
+        s->callback = 0;
+        return NSAPI_ERROR_OK;
+    }
+
+    virtual nsapi_error_t socket_bind(nsapi_socket_t handle, const SocketAddress &address)
+    {
+        return NSAPI_ERROR_OK;
+    }
+
+    virtual nsapi_error_t socket_listen(nsapi_socket_t handle, int backlog)
+    {
+        return NSAPI_ERROR_UNSUPPORTED;
+    }
+
+    // The connection is made as the stack signals the socket
+    virtual nsapi_error_t socket_connect(nsapi_socket_t handle, const SocketAddress &address)
+    {
+        echo *s = (echo *)handle;
+        if (s->connecting) {
+            s->connected = true;
+            return NSAPI_ERROR_IS_CONNECTED;
+        }
+
+        s->connecting = true;
+        signal(s);
+        return NSAPI_ERROR_IN_PROGRESS;
+    }
+
+    virtual nsapi_error_t socket_accept(nsapi_socket_t server,
+            nsapi_socket_t *handle, SocketAddress *address = 0)
+    {
+        return NSAPI_ERROR_UNSUPPORTED;
+    }
+
+    virtual nsapi_size_or_error_t socket_send(nsapi_socket_t handle,
+            const void *data, nsapi_size_t size)
+    {
+        echo *s = (echo *)handle;
+        if (!s->connected) {
+            return NSAPI_ERROR_NO_CONNECTION;
+        }
+
+        nsapi_size_t len = sizeof(s->buffer) - s->size;
+        if (!len) {
+            refused += 1;
+            return NSAPI_ERROR_WOULD_BLOCK;
+        }
+
+        len = size < len ? size : len;
+        memcpy(&s->buffer[s->size], data, len);
+        s->size += len;
+        accepted += len;
+        signal(s);
+        return len;
+    }
+
+    virtual nsapi_size_or_error_t socket_recv(nsapi_socket_t handle,
+            void *data, nsapi_size_t size)
+    {
+        echo *s = (echo *)handle;
+        if (!s->size) {
+            return NSAPI_ERROR_WOULD_BLOCK;
+        }
+
+        nsapi_size_t len = size < s->size ? size : s->size;
+        memcpy(data, s->buffer, len);
+        memmove(s->buffer, &s->buffer[len], s->size - len);
+        s->size -= len;
+        signal(s);
+        return len;
+    }
+
+    virtual nsapi_size_or_error_t socket_sendto(nsapi_socket_t handle, const SocketAddress &address,
+            const void *data, nsapi_size_t size)
+    {
+        echo *s = (echo *)handle;
+        if (s->size) {
+            return NSAPI_ERROR_WOULD_BLOCK;
+        }
+
+        s->size = size < sizeof(s->buffer) ? size : sizeof(s->buffer);
+        memcpy(s->buffer, data, s->size);
+        s->from = address;
+        signal(s);
+        return size;
+    }
+
+    virtual nsapi_size_or_error_t socket_recvfrom(nsapi_socket_t handle, SocketAddress *address,
+            void *data, nsapi_size_t size)
+    {
+        echo *s = (echo *)handle;
+        if (!s->size) {
+            return NSAPI_ERROR_WOULD_BLOCK;
+        }
+
+        nsapi_size_t len = size < s->size ? size : s->size;
+        memcpy(data, s->buffer, len);
+        *address = s->from;
+        s->size = 0;
+        signal(s);
+        return len;
+    }
+
+    virtual void socket_attach(nsapi_socket_t handle, void (*callback)(void *), void *data)
+    {
+        echo *s = (echo *)handle;
+        s->callback = callback;
+        s->data = data;
+    }
+
+private:
+    echo _sockets[MBED_CFG_SOCKET_ASYNC_SOCKETS + 2];
+};
+
+EchoStack stack;
+NetworkStack *net = &stack;
+events::EventQueue queue((MBED_CFG_SOCKET_ASYNC_SOCKETS + 8) * EVENTS_EVENT_SIZE);
+SocketAddress echo_addr("10.0.0.1", 7);
+
+// Bytes of the stream, a pattern which does not line up with the chunks
+uint8_t tx_buffer[MBED_CFG_SOCKET_ASYNC_SIZE];
+
+static uint8_t pattern(size_t offset)
+{
+    return (offset * 7 + offset / 251) & 0xff;
+}
+
+
+// Client echoing the pattern, entirely driven by its callbacks
+class EchoClient {
+public:
+    EchoClient() : received(0), sent(false), errors(0) {}
+
+    TCPSocket sock;
+    uint8_t rx_buffer[MBED_CFG_SOCKET_ASYNC_CHUNK];
+    size_t received;
+    bool sent;
+    int errors;
+
+    static int finished;
+
+    void start()
+    {
+        sock.open(net);
+        sock.set_event_queue(&queue);
+        if (sock.connect_async(echo_addr, callback(this, &EchoClient::connected))
+                != NSAPI_ERROR_IN_PROGRESS) {
+            errors += 1;
+        }
+    }
+
+    void connected(nsapi_error_t err)
+    {
+        if (err) {
+            errors += 1;
+            return;
+        }
+
+        if (sock.send_async(tx_buffer, sizeof(tx_buffer),
+                callback(this, &EchoClient::send_done)) != NSAPI_ERROR_IN_PROGRESS) {
+            errors += 1;
+        }
+        recv();
+    }
+
+    void recv()
+    {
+        if (sock.recv_async(rx_buffer, sizeof(rx_buffer),
+                callback(this, &EchoClient::recv_done)) != NSAPI_ERROR_IN_PROGRESS) {
+            errors += 1;
+        }
+    }
+
+    void send_done(nsapi_size_or_error_t size)
+    {
+        // held back until the peer has read all but a buffer of data
+        if (size != sizeof(tx_buffer) ||
+                received + MBED_CFG_SOCKET_ASYNC_BUFFER < sizeof(tx_buffer)) {
+            errors += 1;
+        }
+
+        sent = true;
+        done();
+    }
+
+    void recv_done(nsapi_size_or_error_t size)
+    {
+        if (size <= 0) {
+            errors += 1;
+            return;
+        }
+
+        for (int i = 0; i < size; i++) {
+            if (rx_buffer[i] != pattern(received + i)) {
+                errors += 1;
+                break;
+            }
+        }
+
+        received += size;
+        if (received < sizeof(tx_buffer)) {
+            recv();
+        } else {
+            done();
+        }
+    }
+
+    void done()
+    {
+        if (sent && received == sizeof(tx_buffer)) {
+            finished += 1;
+            if (finished == MBED_CFG_SOCKET_ASYNC_SOCKETS) {
+                queue.break_dispatch();
+            }
+        }
+    }
+};
+
+int EchoClient::finished = 0;
+
+
+// Test functions
+void test_socket_async_echo()
+{
+    for (size_t i = 0; i < sizeof(tx_buffer); i++) {
+        tx_buffer[i] = pattern(i);
+    }
+
+    EchoClient *clients = new EchoClient[MBED_CFG_SOCKET_ASYNC_SOCKETS];
+    for (int i = 0; i < MBED_CFG_SOCKET_ASYNC_SOCKETS; i++) {
+        clients[i].start();
+    }
+
+    // a single thread runs every socket
+    int accepted = stack.accepted;
+    queue.dispatch(10000);
+
+    TEST_ASSERT_EQUAL(MBED_CFG_SOCKET_ASYNC_SOCKETS, EchoClient::finished);
+    for (int i = 0; i < MBED_CFG_SOCKET_ASYNC_SOCKETS; i++) {
+        TEST_ASSERT_EQUAL(0, clients[i].errors);
+        TEST_ASSERT_EQUAL(sizeof(tx_buffer), clients[i].received);
+        TEST_ASSERT_EQUAL(0, clients[i].sock.close());
+    }
+    TEST_ASSERT_EQUAL(accepted + MBED_CFG_SOCKET_ASYNC_SOCKETS * sizeof(tx_buffer), stack.accepted);
+    TEST_ASSERT(stack.refused > 0);
+
+    printf("MBED: %d sockets echoed %d bytes each, %d sends held back\r\n",
+            MBED_CFG_SOCKET_ASYNC_SOCKETS, MBED_CFG_SOCKET_ASYNC_SIZE, stack.refused);
+    delete[] clients;
+}
+
+int async_calls;
+nsapi_size_or_error_t async_result;
+
+void async_callback(nsapi_size_or_error_t result)
+{
+    async_calls += 1;
+    async_result = result;
+}
+
+void test_socket_async_errors()
+{
+    TCPSocket sock;
+    uint8_t data[16];
+
+    // needs an open socket and a queue
+    TEST_ASSERT_EQUAL(NSAPI_ERROR_NO_SOCKET, sock.send_async(data, sizeof(data), async_callback));
+    TEST_ASSERT_EQUAL(0, sock.open(net));
+    TEST_ASSERT_EQUAL(NSAPI_ERROR_UNSUPPORTED, sock.send_async(data, sizeof(data), async_callback));
+
+    // one operation in each direction
+    sock.set_event_queue(&queue);
+    async_calls = 0;
+    TEST_ASSERT_EQUAL(NSAPI_ERROR_IN_PROGRESS, sock.connect_async(echo_addr, async_callback));
+    TEST_ASSERT_EQUAL(NSAPI_ERROR_ALREADY, sock.send_async(data, sizeof(data), async_callback));
+    TEST_ASSERT_EQUAL(NSAPI_ERROR_IN_PROGRESS, sock.recv_async(data, sizeof(data), async_callback));
+    TEST_ASSERT_EQUAL(NSAPI_ERROR_ALREADY, sock.recv_async(data, sizeof(data), async_callback));
+    TEST_ASSERT_EQUAL(0, async_calls);
+
+    queue.dispatch(10);
+    TEST_ASSERT_EQUAL(1, async_calls);
+    TEST_ASSERT_EQUAL(NSAPI_ERROR_OK, async_result);
+
+    // pending operations are dropped on close
+    TEST_ASSERT_EQUAL(0, sock.close());
+    queue.dispatch(10);
+    TEST_ASSERT_EQUAL(1, async_calls);
+
+    // a full queue fails the operation instead of dropping it
+    events::EventQueue full(4 * EVENTS_EVENT_SIZE);
+    while (full.call(async_callback, 0)) {
+    }
+    TEST_ASSERT_EQUAL(0, sock.open(net));
+    sock.set_event_queue(&full);
+    TEST_ASSERT_EQUAL(NSAPI_ERROR_NO_MEMORY, sock.connect_async(echo_addr, async_callback));
+    TEST_ASSERT_FALSE(sock.cancel_send());
+
+    sock.set_event_queue(&queue);
+    async_calls = 0;
+    TEST_ASSERT_EQUAL(NSAPI_ERROR_IN_PROGRESS, sock.connect_async(echo_addr, async_callback));
+    queue.dispatch(10);
+    TEST_ASSERT_EQUAL(1, async_calls);
+    TEST_ASSERT_EQUAL(NSAPI_ERROR_OK, async_result);
+    TEST_ASSERT_EQUAL(0, sock.close());
+}
+
+void test_socket_async_cancel()
+{
+    TCPSocket sock;
+    uint8_t data[16];
+    memset(data, 0x5a, sizeof(data));
+
+    TEST_ASSERT_EQUAL(0, sock.open(net));
+    sock.set_event_queue(&queue);
+    async_calls = 0;
+    TEST_ASSERT_EQUAL(NSAPI_ERROR_IN_PROGRESS, sock.connect_async(echo_addr, async_callback));
+    queue.dispatch(10);
+    TEST_ASSERT_EQUAL(1, async_calls);
+
+    TEST_ASSERT_EQUAL(NSAPI_ERROR_IN_PROGRESS, sock.recv_async(tx_buffer, sizeof(tx_buffer), async_callback));
+    TEST_ASSERT_TRUE(sock.cancel_recv());
+    TEST_ASSERT_FALSE(sock.cancel_recv());
+
+    // the data stays with the stack until asked for again
+    TEST_ASSERT_EQUAL(NSAPI_ERROR_IN_PROGRESS, sock.send_async(data, sizeof(data), async_callback));
+    queue.dispatch(10);
+    TEST_ASSERT_EQUAL(2, async_calls);
+    TEST_ASSERT_EQUAL(sizeof(data), async_result);
+
+    memset(data, 0, sizeof(data));
+    TEST_ASSERT_EQUAL(NSAPI_ERROR_IN_PROGRESS, sock.recv_async(data, sizeof(data), async_callback));
+    queue.dispatch(10);
+    TEST_ASSERT_EQUAL(3, async_calls);
+    TEST_ASSERT_EQUAL(sizeof(data), async_result);
+    TEST_ASSERT_EQUAL(0x5a, data[sizeof(data) - 1]);
+
+    // removing the queue cancels too
+    TEST_ASSERT_EQUAL(NSAPI_ERROR_IN_PROGRESS, sock.recv_async(data, sizeof(data), async_callback));
+    sock.set_event_queue(NULL);
+    TEST_ASSERT_FALSE(sock.cancel_recv());
+    queue.dispatch(10);
+    TEST_ASSERT_EQUAL(3, async_calls);
+    TEST_ASSERT_EQUAL(0, sock.close());
+}
+
+TCPSocket *closing;
+
+void close_callback(nsapi_size_or_error_t result)
+{
+    async_calls += 1;
+    delete closing;
+    closing = 0;
+}
+
+void test_socket_async_destroy()
+{
+    uint8_t data[16];
+    closing = new TCPSocket();
+    TEST_ASSERT_EQUAL(0, closing->open(net));
+    closing->set_event_queue(&queue);
+    async_calls = 0;
+
+    // the socket is destroyed by its own callback, with a receive pending
+    TEST_ASSERT_EQUAL(NSAPI_ERROR_IN_PROGRESS, closing->connect_async(echo_addr, close_callback));
+    TEST_ASSERT_EQUAL(NSAPI_ERROR_IN_PROGRESS, closing->recv_async(data, sizeof(data), close_callback));
+    queue.dispatch(10);
+    TEST_ASSERT_EQUAL(1, async_calls);
+    TEST_ASSERT_NULL(closing);
+}
+
+void test_udp_async_echo()
+{
+    UDPSocket sock;
+    uint8_t data[16];
+    SocketAddress from;
+
+    TEST_ASSERT_EQUAL(0, sock.open(net));
+    sock.set_event_queue(&queue);
+    async_calls = 0;
+
+    TEST_ASSERT_EQUAL(NSAPI_ERROR_IN_PROGRESS, sock.recvfrom_async(&from, data, sizeof(data), async_callback));
+    TEST_ASSERT_EQUAL(NSAPI_ERROR_IN_PROGRESS, sock.sendto_async(echo_addr, "hello", 5, async_callback));
+    queue.dispatch(10);
+    TEST_ASSERT_EQUAL(2, async_calls);
+    TEST_ASSERT_EQUAL(5, async_result);
+    TEST_ASSERT_EQUAL(0, memcmp(data, "hello", 5));
+    TEST_ASSERT_TRUE(from == echo_addr);
+    TEST_ASSERT_EQUAL(0, sock.close());
+}
+
+
+// Test setup
+utest::v1::status_t test_setup(const size_t number_of_cases) {
+    GREENTEA_SETUP(30, "default_auto");
+    return verbose_test_setup_handler(number_of_cases);
+}
+
+Case cases[] = {
+    Case("Socket asynchronous echo", test_socket_async_echo),
+    Case("Socket asynchronous errors", test_socket_async_errors),
+    Case("Socket asynchronous cancel", test_socket_async_cancel),
+    Case("Socket destroyed from its callback", test_socket_async_destroy),
+    Case("UDP asynchronous echo", test_udp_async_echo),
+};
+
+Specification specification(test_setup, cases);
+
+int main()
+{
+    return !Harness::run(specification);
+}
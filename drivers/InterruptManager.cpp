@@ -20,8 +20,6 @@
 #include "platform/mbed_critical.h"
 #include <string.h>
 
-#define CHAIN_INITIAL_SIZE    4
-
 namespace mbed {
 
 typedef void (*pvoidf)(void);
@@ -51,7 +49,7 @@ InterruptManager* InterruptManager::get() {
 
 InterruptManager::InterruptManager() {
     // No mutex needed in constructor
-    memset(_chains, 0, NVIC_NUM_VECTORS * sizeof(CallChain*));
+    memset(_chains, 0, NVIC_NUM_VECTORS * sizeof(Chain*));
 }
 
 void InterruptManager::destroy() {
@@ -76,7 +74,7 @@ bool InterruptManager::must_replace_vector(IRQn_Type irq) {
     int ret = false;
     int irq_pos = get_irq_index(irq);
     if (NULL == _chains[irq_pos]) {
-        _chains[irq_pos] = new CallChain(CHAIN_INITIAL_SIZE);
+        _chains[irq_pos] = new Chain();
         _chains[irq_pos]->add((pvoidf)NVIC_GetVector(irq));
         ret = true;
     }
@@ -18,6 +18,7 @@
 
 #include "cmsis.h"
 #include "platform/CallChain.h"
+#include "platform/StaticCallChain.h"
 #include "platform/PlatformMutex.h"
 #include "platform/NonCopyable.h"
 #include <string.h>
@@ -159,7 +160,15 @@ private:
     void add_helper(void (*function)(void), IRQn_Type irq, bool front=false);
     static void static_irq_helper();
 
-    CallChain* _chains[NVIC_NUM_VECTORS];
+#if MBED_CONF_DRIVERS_INTERRUPT_MANAGER_CHAIN_CAPACITY
+    // Handlers are stored without heap allocations, add_handler() and
+    // add_handler_front() return NULL once a chain is full
+    typedef StaticCallChain<MBED_CONF_DRIVERS_INTERRUPT_MANAGER_CHAIN_CAPACITY> Chain;
+#else
+    typedef CallChain Chain;
+#endif
+
+    Chain* _chains[NVIC_NUM_VECTORS];
     static InterruptManager* _instance;
     PlatformMutex _mutex;
 };
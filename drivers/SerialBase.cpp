@@ -189,8 +189,8 @@ void SerialBase::start_write(const void *buffer, int buffer_size, char buffer_wi
 
 void SerialBase::abort_write(void)
 {
-    // rx might still be active
-    if (_rx_callback) {
+    // deep sleep is locked until an ongoing transfer completes
+    if (serial_tx_active(&_serial)) {
         sleep_manager_unlock_deep_sleep();
     }
     _tx_callback = NULL;
@@ -199,8 +199,8 @@ void SerialBase::abort_write(void)
 
 void SerialBase::abort_read(void)
 {
-    // tx might still be active
-    if (_tx_callback) {
+    // deep sleep is locked until an ongoing transfer completes
+    if (serial_rx_active(&_serial)) {
         sleep_manager_unlock_deep_sleep();
     }
     _rx_callback = NULL;
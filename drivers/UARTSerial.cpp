@@ -28,13 +28,47 @@ UARTSerial::UARTSerial(PinName tx, PinName rx, int baud) :
         _blocking(true),
         _tx_irq_enabled(false),
         _dcd_irq(NULL)
+#if UARTSERIAL_BLOCK_MODE
+        , _rx_committed(0),
+        _rx_last_count(0),
+        _tx_size(0),
+        _rx_block(false),
+        _rx_active(false),
+        _rx_head(false),
+        _tx_active(false)
+#endif
 {
+#if UARTSERIAL_BLOCK_MODE
+    SerialBase::set_dma_usage_tx(DMA_USAGE_OPPORTUNISTIC);
+    SerialBase::set_dma_usage_rx(DMA_USAGE_OPPORTUNISTIC);
+
+    /* Received blocks can only be flushed before they are complete if the
+     * target reports partial transfers. Otherwise data would be held until
+     * a block fills up, so keep receiving a character at a time. */
+    if (serial_rx_asynch_count(&_serial) >= 0) {
+        _rx_block = true;
+        core_util_critical_section_enter();
+        rx_start();
+        core_util_critical_section_exit();
+        return;
+    }
+#endif
+
     /* Attatch IRQ routines to the serial device. */
     SerialBase::attach(callback(this, &UARTSerial::rx_irq), RxIrq);
 }
 
 UARTSerial::~UARTSerial()
 {
+#if UARTSERIAL_BLOCK_MODE
+    _rx_idle.detach();
+    if (_rx_active) {
+        SerialBase::abort_read();
+    }
+    if (_tx_active) {
+        SerialBase::abort_write();
+    }
+#endif
     delete _dcd_irq;
 }
 
@@ -128,12 +162,21 @@ ssize_t UARTSerial::write(const void* buffer, size_t length)
         api_lock();
     }
 
+#if UARTSERIAL_LOCK_FREE_BUFFERS
+    data_written = _txbuf.push(buf_ptr, length);
+#else
     while (data_written < length && !_txbuf.full()) {
         _txbuf.push(*buf_ptr++);
         data_written++;
     }
+#endif
 
     core_util_critical_section_enter();
+#if UARTSERIAL_BLOCK_MODE
+    if (!_tx_active) {
+        tx_start();
+    }
+#else
     if (!_tx_irq_enabled) {
         UARTSerial::tx_irq();                // only write to hardware in one place
         if (!_txbuf.empty()) {
@@ -141,6 +184,7 @@ ssize_t UARTSerial::write(const void* buffer, size_t length)
             _tx_irq_enabled = true;
         }
     }
+#endif
     core_util_critical_section_exit();
 
     api_unlock();
@@ -166,16 +210,61 @@ ssize_t UARTSerial::read(void* buffer, size_t length)
         api_lock();
     }
 
+#if UARTSERIAL_LOCK_FREE_BUFFERS
+    data_read = _rxbuf.pop(ptr, length);
+#else
     while (data_read < length && !_rxbuf.empty()) {
         _rxbuf.pop(*ptr++);
         data_read++;
     }
+#endif
+
+#if UARTSERIAL_BLOCK_MODE
+    rx_resume();
+#endif
 
     api_unlock();
 
     return data_read;
 }
 
+#if UARTSERIAL_LOCK_FREE_BUFFERS
+ssize_t UARTSerial::read_span(const void **data)
+{
+    api_lock();
+
+    while (_rxbuf.empty()) {
+        if (!_blocking) {
+            api_unlock();
+            return -EAGAIN;
+        }
+        api_unlock();
+        wait_ms(1);  // XXX todo - proper wait, WFE for non-rtos ?
+        api_lock();
+    }
+
+    RingBufferSpan<char> span = _rxbuf.peek();
+    *data = span.data;
+
+    api_unlock();
+
+    return span.size;
+}
+
+void UARTSerial::consume(size_t length)
+{
+    api_lock();
+
+    _rxbuf.consume(length);
+
+#if UARTSERIAL_BLOCK_MODE
+    rx_resume();
+#endif
+
+    api_unlock();
+}
+#endif
+
 bool UARTSerial::hup() const
 {
     return _dcd_irq && _dcd_irq->read() != 0;
@@ -183,11 +272,17 @@ bool UARTSerial::hup() const
 
 void UARTSerial::wake()
 {
+    wake_pollers();
     if (_sigio_cb) {
         _sigio_cb();
     }
 }
 
+bool UARTSerial::wakes_pollers() const
+{
+    return true;
+}
+
 short UARTSerial::poll(short events) const {
 
     short revents = 0;
@@ -277,6 +372,125 @@ void UARTSerial::tx_irq(void)
     }
 }
 
+#if UARTSERIAL_BLOCK_MODE
+// Called with interrupts disabled
+void UARTSerial::rx_start(void)
+{
+    _rx_span = _rxbuf.reserve(MBED_CONF_DRIVERS_UART_SERIAL_RX_BLOCK_SIZE);
+    _rx_committed = 0;
+
+    /* If the receive buffer is full, reception resumes once data is read.
+     * A block starts with a single character, whose completion tells that
+     * data is arriving, so nothing runs while the line is idle. */
+    _rx_active = _rx_span.size != 0;
+    _rx_head = true;
+    if (_rx_active) {
+        SerialBase::read(reinterpret_cast<uint8_t *>(_rx_span.data), 1,
+                         callback(this, &UARTSerial::rx_done), SERIAL_EVENT_RX_ALL);
+    }
+}
+
+void UARTSerial::rx_resume(void)
+{
+    core_util_critical_section_enter();
+    if (_rx_block && !_rx_active) {
+        rx_start();
+    }
+    core_util_critical_section_exit();
+}
+
+// Called with interrupts disabled
+void UARTSerial::rx_flush(uint32_t count)
+{
+    if (count <= _rx_committed) {
+        return;
+    }
+
+    bool was_empty = _rxbuf.empty();
+
+    RingBufferSpan<char> span = { _rx_span.data + _rx_committed, count - _rx_committed };
+    _rxbuf.commit(span);
+    _rx_committed = count;
+
+    if (was_empty) {
+        wake();
+    }
+}
+
+void UARTSerial::rx_done(int event)
+{
+    core_util_critical_section_enter();
+
+    if (_rx_head && (event & SERIAL_EVENT_RX_COMPLETE) && _rx_span.size > 1) {
+        /* Hand over the first character and receive the rest of the block,
+         * checking for an idle line while it holds data. */
+        rx_flush(1);
+        _rx_head = false;
+        _rx_last_count = 1;
+        SerialBase::read(reinterpret_cast<uint8_t *>(_rx_span.data + 1), _rx_span.size - 1,
+                         callback(this, &UARTSerial::rx_done), SERIAL_EVENT_RX_ALL);
+        _rx_idle.attach_us(callback(this, &UARTSerial::rx_idle), MBED_CONF_DRIVERS_UART_SERIAL_RX_IDLE_TIMEOUT);
+    } else {
+        /* On errors, only the data already flushed is kept. */
+        if (event & SERIAL_EVENT_RX_COMPLETE) {
+            rx_flush(_rx_span.size);
+        }
+        _rx_idle.detach();
+        rx_start();
+    }
+
+    core_util_critical_section_exit();
+}
+
+void UARTSerial::rx_idle(void)
+{
+    core_util_critical_section_enter();
+
+    if (_rx_active && !_rx_head) {
+        int count = 1 + serial_rx_asynch_count(&_serial);
+        if (count != _rx_last_count) {
+            /* Data arrived since the previous check */
+            _rx_last_count = count;
+            _rx_idle.attach_us(callback(this, &UARTSerial::rx_idle), MBED_CONF_DRIVERS_UART_SERIAL_RX_IDLE_TIMEOUT);
+        } else {
+            /* The line is idle, end the block with what it holds. The count
+             * of an aborted transfer is final, so nothing is lost. */
+            SerialBase::abort_read();
+            rx_flush(1 + serial_rx_asynch_count(&_serial));
+            rx_start();
+        }
+    }
+
+    core_util_critical_section_exit();
+}
+
+// Called with interrupts disabled
+void UARTSerial::tx_start(void)
+{
+    RingBufferSpan<char> span = _txbuf.peek();
+    _tx_size = span.size;
+
+    _tx_active = span.size != 0;
+    if (_tx_active) {
+        SerialBase::write(reinterpret_cast<const uint8_t *>(span.data), span.size,
+                          callback(this, &UARTSerial::tx_done), SERIAL_EVENT_TX_COMPLETE);
+    }
+}
+
+void UARTSerial::tx_done(int event)
+{
+    bool was_full = _txbuf.full();
+
+    _txbuf.consume(_tx_size);
+    tx_start();
+
+    /* Report the File handler that data can be written to peripheral. */
+    if (was_full && !_txbuf.full() && !hup()) {
+        wake();
+    }
+}
+#endif
+
 } //namespace mbed
 
 #endif //(DEVICE_SERIAL && DEVICE_INTERRUPTIN)
@@ -24,9 +24,11 @@
 #include "FileHandle.h"
 #include "SerialBase.h"
 #include "InterruptIn.h"
+#include "Timeout.h"
 #include "PlatformMutex.h"
 #include "serial_api.h"
 #include "CircularBuffer.h"
+#include "LockFreeRingBuffer.h"
 #include "platform/NonCopyable.h"
 
 #ifndef MBED_CONF_DRIVERS_UART_SERIAL_RXBUF_SIZE
@@ -37,6 +39,37 @@
 #define MBED_CONF_DRIVERS_UART_SERIAL_TXBUF_SIZE  256
 #endif
 
+#ifndef MBED_CONF_DRIVERS_UART_SERIAL_LOCK_FREE_BUFFERS
+#define MBED_CONF_DRIVERS_UART_SERIAL_LOCK_FREE_BUFFERS  0
+#endif
+
+#ifndef MBED_CONF_DRIVERS_UART_SERIAL_BLOCK_MODE
+#define MBED_CONF_DRIVERS_UART_SERIAL_BLOCK_MODE  0
+#endif
+
+#ifndef MBED_CONF_DRIVERS_UART_SERIAL_RX_BLOCK_SIZE
+#define MBED_CONF_DRIVERS_UART_SERIAL_RX_BLOCK_SIZE  64
+#endif
+
+#ifndef MBED_CONF_DRIVERS_UART_SERIAL_RX_IDLE_TIMEOUT
+#define MBED_CONF_DRIVERS_UART_SERIAL_RX_IDLE_TIMEOUT  1000
+#endif
+
+/* Block mode moves data with the asynchronous serial API, it is only
+ * available on targets supporting it. */
+#if MBED_CONF_DRIVERS_UART_SERIAL_BLOCK_MODE && DEVICE_SERIAL_ASYNCH
+#define UARTSERIAL_BLOCK_MODE 1
+#else
+#define UARTSERIAL_BLOCK_MODE 0
+#endif
+
+/* Transfers in place and read_span() need the lock-free buffers. */
+#if MBED_CONF_DRIVERS_UART_SERIAL_LOCK_FREE_BUFFERS || UARTSERIAL_BLOCK_MODE
+#define UARTSERIAL_LOCK_FREE_BUFFERS 1
+#else
+#define UARTSERIAL_LOCK_FREE_BUFFERS 0
+#endif
+
 namespace mbed {
 
 class UARTSerial : private SerialBase, public FileHandle, private NonCopyable<UARTSerial> {
@@ -78,6 +111,28 @@ public:
      */
     virtual ssize_t read(void* buffer, size_t length);
 
+#if UARTSERIAL_LOCK_FREE_BUFFERS || defined(DOXYGEN_ONLY)
+    /** Access received data in place, without copying it
+     *
+     *  Follows the same blocking semantics as read(). The data stays in the
+     *  receive buffer until it is released with consume(), the span may be
+     *  shorter than the data available if it wraps around the buffer.
+     *
+     *  Only available with the lock-free buffers or the block mode. Must not
+     *  be used concurrently with read().
+     *
+     *  @param data     Set to the first byte available
+     *  @return         The number of contiguous bytes available at data, negative error on failure
+     */
+    ssize_t read_span(const void **data);
+
+    /** Release data obtained with read_span()
+     *
+     *  @param length   The number of bytes to release, at most the size returned by read_span()
+     */
+    void consume(size_t length);
+#endif
+
     /** Close a file
      *
      *  @return         0 on success, negative error code on failure
@@ -142,6 +197,12 @@ public:
      */
     virtual void sigio(Callback<void()> func);
 
+    /** Check whether this file calls wake_pollers() on every state change
+     *
+     *  @returns        true, state changes wake the threads in mbed::poll()
+     */
+    virtual bool wakes_pollers() const;
+
     /** Setup interrupt handler for DCD line
      *
      *  If DCD line is connected, an IRQ handler will be setup.
@@ -175,8 +236,17 @@ private:
     /** Software serial buffers
      *  By default buffer size is 256 for TX and 256 for RX. Configurable through mbed_app.json
      */
+#if UARTSERIAL_LOCK_FREE_BUFFERS
+    // The receive buffer is fed by the RX interrupt and drained by read(),
+    // the transmit buffer is fed by write() under the API lock and drained
+    // by the TX interrupt, so each has a single producer and consumer.
+    // In block mode the transfers read and write them in place.
+    SPSCRingBuffer<char, MBED_CONF_DRIVERS_UART_SERIAL_RXBUF_SIZE> _rxbuf;
+    SPSCRingBuffer<char, MBED_CONF_DRIVERS_UART_SERIAL_TXBUF_SIZE> _txbuf;
+#else
     CircularBuffer<char, MBED_CONF_DRIVERS_UART_SERIAL_RXBUF_SIZE> _rxbuf;
     CircularBuffer<char, MBED_CONF_DRIVERS_UART_SERIAL_TXBUF_SIZE> _txbuf;
+#endif
 
     PlatformMutex _mutex;
 
@@ -186,6 +256,18 @@ private:
     bool _tx_irq_enabled;
     InterruptIn *_dcd_irq;
 
+#if UARTSERIAL_BLOCK_MODE
+    Timeout _rx_idle;
+    RingBufferSpan<char> _rx_span;
+    uint32_t _rx_committed;
+    int _rx_last_count;
+    uint32_t _tx_size;
+    bool _rx_block;
+    bool _rx_active;
+    bool _rx_head;
+    bool _tx_active;
+#endif
+
     /** Device Hanged up
      *  Determines if the device hanged up on us.
      *
@@ -201,6 +283,21 @@ private:
     void tx_irq(void);
     void rx_irq(void);
 
+#if UARTSERIAL_BLOCK_MODE
+    /** Block mode transfers
+     *  Receive in place into the free space of the receive buffer, a single
+     *  character then the rest of the block, flushing partial blocks once the
+     *  line has been idle, and transmit the transmit buffer in place.
+     */
+    void rx_start(void);
+    void rx_resume(void);
+    void rx_flush(uint32_t count);
+    void rx_done(int event);
+    void rx_idle(void);
+    void tx_start(void);
+    void tx_done(int event);
+#endif
+
     void wake(void);
 
     void dcd_irq(void);
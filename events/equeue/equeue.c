@@ -74,6 +74,9 @@ int equeue_create_inplace(equeue_t *q, size_t size, void *buffer) {
     q->tick = equeue_tick();
     q->generation = 0;
     q->breaks = 0;
+#ifdef EQUEUE_HEAP
+    q->order = 0;
+#endif
 
     q->background.active = false;
     q->background.update = 0;
@@ -99,8 +102,21 @@ int equeue_create_inplace(equeue_t *q, size_t size, void *buffer) {
     return 0;
 }
 
+#ifdef EQUEUE_HEAP
+static void equeue_heap_remove(equeue_t *q, struct equeue_event *e);
+#endif
+
 void equeue_destroy(equeue_t *q) {
     // call destructors on pending events
+#ifdef EQUEUE_HEAP
+    while (q->queue) {
+        struct equeue_event *e = q->queue;
+        equeue_heap_remove(q, e);
+        if (e->dtor) {
+            e->dtor(e + 1);
+        }
+    }
+#else
     for (struct equeue_event *es = q->queue; es; es = es->next) {
         for (struct equeue_event *e = q->queue; e; e = e->sibling) {
             if (e->dtor) {
@@ -108,6 +124,7 @@ void equeue_destroy(equeue_t *q) {
             }
         }
     }
+#endif
 
     // notify background timer
     if (q->background.update) {
@@ -207,6 +224,93 @@ void equeue_dealloc(equeue_t *q, void *p) {
 }
 
 
+// equeue pairing heap functions
+#ifdef EQUEUE_HEAP
+// events are ordered by target, with ties broken by insertion order so
+// events with the same target still dispatch in the order they were posted
+static inline bool equeue_heap_before(
+        struct equeue_event *a, struct equeue_event *b) {
+    int diff = equeue_tickdiff(a->target, b->target);
+    return diff < 0 || (diff == 0 && (int)(a->order - b->order) < 0);
+}
+
+// link two heap roots, the loser becomes the first child of the winner
+static struct equeue_event *equeue_heap_link(
+        struct equeue_event *a, struct equeue_event *b) {
+    if (equeue_heap_before(b, a)) {
+        struct equeue_event *t = a;
+        a = b;
+        b = t;
+    }
+
+    b->next = a->sibling;
+    if (b->next) {
+        b->next->ref = &b->next;
+    }
+
+    a->sibling = b;
+    b->ref = &a->sibling;
+    return a;
+}
+
+// two-pass pairing of a list of siblings into a single heap
+static struct equeue_event *equeue_heap_pair(struct equeue_event *es) {
+    // link pairs left to right, stacking the results
+    struct equeue_event *pairs = 0;
+    while (es) {
+        struct equeue_event *a = es;
+        struct equeue_event *b = a->next;
+        if (b) {
+            es = b->next;
+            a = equeue_heap_link(a, b);
+        } else {
+            es = 0;
+        }
+
+        a->next = pairs;
+        pairs = a;
+    }
+
+    // link the stacked pairs right to left
+    struct equeue_event *root = pairs;
+    if (root) {
+        pairs = root->next;
+        while (pairs) {
+            struct equeue_event *a = pairs;
+            pairs = a->next;
+            root = equeue_heap_link(root, a);
+        }
+    }
+
+    return root;
+}
+
+// meld a heap into the queue
+static void equeue_heap_meld(equeue_t *q, struct equeue_event *e) {
+    if (q->queue) {
+        e = equeue_heap_link(q->queue, e);
+    }
+
+    e->next = 0;
+    e->ref = &q->queue;
+    q->queue = e;
+}
+
+// remove an arbitrary event from the queue
+static void equeue_heap_remove(equeue_t *q, struct equeue_event *e) {
+    *e->ref = e->next;
+    if (e->next) {
+        e->next->ref = e->ref;
+    }
+
+    struct equeue_event *children = equeue_heap_pair(e->sibling);
+    if (children) {
+        equeue_heap_meld(q, children);
+    }
+}
+#endif
+
+
 // equeue scheduling functions
 static int equeue_enqueue(equeue_t *q, struct equeue_event *e, unsigned tick) {
     // setup event and hash local id with buffer offset for unique id
@@ -216,6 +320,19 @@ static int equeue_enqueue(equeue_t *q, struct equeue_event *e, unsigned tick) {
 
     equeue_mutex_lock(&q->queuelock);
 
+#ifdef EQUEUE_HEAP
+    // insert as a single node heap
+    e->order = q->order++;
+    e->sibling = 0;
+    equeue_heap_meld(q, e);
+
+    // notify background timer
+    if ((q->background.update && q->background.active) &&
+        q->queue == e) {
+        q->background.update(q->background.timer,
+                equeue_clampdiff(e->target, tick));
+    }
+#else
     // find the event slot
     struct equeue_event **p = &q->queue;
     while (*p && equeue_tickdiff((*p)->target, e->target) < 0) {
@@ -230,6 +347,7 @@ static int equeue_enqueue(equeue_t *q, struct equeue_event *e, unsigned tick) {
         }
 
         e->sibling = *p;
+        e->sibling->next = 0;
         e->sibling->ref = &e->sibling;
     } else {
         e->next = *p;
@@ -249,6 +367,7 @@ static int equeue_enqueue(equeue_t *q, struct equeue_event *e, unsigned tick) {
         q->background.update(q->background.timer,
                 equeue_clampdiff(e->target, tick));
     }
+#endif
 
     equeue_mutex_unlock(&q->queuelock);
 
@@ -277,6 +396,9 @@ static struct equeue_event *equeue_unqueue(equeue_t *q, int id) {
     }
 
     // disentangle from queue
+#ifdef EQUEUE_HEAP
+    equeue_heap_remove(q, e);
+#else
     if (e->sibling) {
         e->sibling->next = e->next;
         if (e->sibling->next) {
@@ -291,6 +413,7 @@ static struct equeue_event *equeue_unqueue(equeue_t *q, int id) {
             e->next->ref = e->ref;
         }
     }
+#endif
 
     equeue_incid(q, e);
     equeue_mutex_unlock(&q->queuelock);
@@ -307,6 +430,23 @@ static struct equeue_event *equeue_dequeue(equeue_t *q, unsigned target) {
         q->tick = target;
     }
 
+#ifdef EQUEUE_HEAP
+    // pop expired events in order, heap order already matches insertion
+    // order for events with the same target
+    struct equeue_event *head = 0;
+    struct equeue_event **tail = &head;
+    while (q->queue && equeue_tickdiff(q->queue->target, target) <= 0) {
+        struct equeue_event *e = q->queue;
+        equeue_heap_remove(q, e);
+
+        *tail = e;
+        tail = &e->next;
+    }
+
+    *tail = 0;
+
+    equeue_mutex_unlock(&q->queuelock);
+#else
     struct equeue_event *head = q->queue;
     struct equeue_event **p = &head;
     while (*p && equeue_tickdiff((*p)->target, target) <= 0) {
@@ -338,6 +478,7 @@ static struct equeue_event *equeue_dequeue(equeue_t *q, unsigned target) {
         *tail = prev;
         tail = &es->next;
     }
+#endif
 
     return head;
 }
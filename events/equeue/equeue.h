@@ -32,11 +32,30 @@ extern "C" {
 #include <stdint.h>
 
 
+// Event list backend
+//
+// By default, pending events are kept in a sorted list of time slots, which
+// keeps dispatch cheap but makes posting a delayed event O(n) in the number
+// of pending events. Defining EQUEUE_HEAP stores pending events in an
+// intrusive pairing heap instead, giving O(1) post and next-deadline lookup
+// and O(log n) amortized cancel and dispatch, at the cost of one extra
+// word per event.
+#if !defined(EQUEUE_HEAP) && defined(MBED_CONF_EVENTS_USE_HEAP_QUEUE)
+#if MBED_CONF_EVENTS_USE_HEAP_QUEUE
+#define EQUEUE_HEAP
+#endif
+#endif
+
 // The minimum size of an event
 // This size is guaranteed to fit events created by event_call
 #define EQUEUE_EVENT_SIZE (sizeof(struct equeue_event) + 2*sizeof(void*))
 
 // Internal event structure
+//
+// In the list backend, next links time slots, sibling links events within
+// a slot and ref points to whatever points to the event. In the heap
+// backend, next links siblings in the parent's child list, sibling points
+// to the first child and ref points back to whatever points to the event.
 struct equeue_event {
     unsigned size;
     uint8_t id;
@@ -45,6 +64,9 @@ struct equeue_event {
     struct equeue_event *next;
     struct equeue_event *sibling;
     struct equeue_event **ref;
+#ifdef EQUEUE_HEAP
+    unsigned order;
+#endif
 
     unsigned target;
     int period;
@@ -60,6 +82,9 @@ typedef struct equeue {
     unsigned tick;
     unsigned breaks;
     uint8_t generation;
+#ifdef EQUEUE_HEAP
+    unsigned order;
+#endif
 
     unsigned char *buffer;
     unsigned npw2;
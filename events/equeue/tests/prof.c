@@ -319,6 +319,72 @@ void equeue_cancel_many_prof(int count) {
     equeue_destroy(&q);
 }
 
+void equeue_post_pending_prof(int count) {
+    struct equeue q;
+    equeue_create(&q, count*EQUEUE_EVENT_SIZE);
+
+    srand(0);
+    for (int i = 0; i < count-1; i++) {
+        equeue_call_in(&q, 1000 + rand() % 10000, no_func, 0);
+    }
+
+    prof_loop() {
+        void *e = equeue_alloc(&q, 0);
+        equeue_event_delay(e, 1000 + rand() % 10000);
+
+        prof_start();
+        int id = equeue_post(&q, no_func, e);
+        prof_stop();
+
+        equeue_cancel(&q, id);
+    }
+
+    equeue_destroy(&q);
+}
+
+void equeue_cancel_pending_prof(int count) {
+    struct equeue q;
+    equeue_create(&q, count*EQUEUE_EVENT_SIZE);
+
+    srand(0);
+    int ids[count];
+    for (int i = 0; i < count; i++) {
+        ids[i] = equeue_call_in(&q, 1000 + rand() % 10000, no_func, 0);
+    }
+
+    prof_loop() {
+        int i = rand() % count;
+
+        prof_start();
+        equeue_cancel(&q, ids[i]);
+        prof_stop();
+
+        ids[i] = equeue_call_in(&q, 1000 + rand() % 10000, no_func, 0);
+    }
+
+    equeue_destroy(&q);
+}
+
+void equeue_dispatch_pending_prof(int count) {
+    struct equeue q;
+    equeue_create(&q, count*EQUEUE_EVENT_SIZE);
+
+    srand(0);
+    for (int i = 0; i < count-1; i++) {
+        equeue_call_in(&q, 1000 + rand() % 10000, no_func, 0);
+    }
+
+    prof_loop() {
+        equeue_call(&q, no_func, 0);
+
+        prof_start();
+        equeue_dispatch(&q, 0);
+        prof_stop();
+    }
+
+    equeue_destroy(&q);
+}
+
 void equeue_alloc_size_prof(void) {
     size_t size = 32*EQUEUE_EVENT_SIZE;
 
@@ -399,6 +465,16 @@ int main() {
     prof_measure(equeue_dispatch_many_prof, 100);
     prof_measure(equeue_cancel_many_prof, 100);
 
+    prof_measure(equeue_post_pending_prof, 10);
+    prof_measure(equeue_post_pending_prof, 100);
+    prof_measure(equeue_post_pending_prof, 1000);
+    prof_measure(equeue_cancel_pending_prof, 10);
+    prof_measure(equeue_cancel_pending_prof, 100);
+    prof_measure(equeue_cancel_pending_prof, 1000);
+    prof_measure(equeue_dispatch_pending_prof, 10);
+    prof_measure(equeue_dispatch_pending_prof, 100);
+    prof_measure(equeue_dispatch_pending_prof, 1000);
+
     prof_measure(equeue_alloc_size_prof);
     prof_measure(equeue_alloc_many_size_prof, 1000);
     prof_measure(equeue_alloc_fragmented_size_prof, 1000);
@@ -119,6 +119,19 @@ void cancel_func(void *p) {
     equeue_cancel(cancel->q, cancel->id);
 }
 
+struct order {
+    int *last;
+    int *count;
+    int key;
+};
+
+void order_func(void *p) {
+    struct order *order = (struct order *)p;
+    test_assert(order->key > *order->last);
+    *order->last = order->key;
+    (*order->count)++;
+}
+
 struct nest {
     equeue_t *q;
     void (*cb)(void *);
@@ -293,6 +306,42 @@ void cancel_test(int N) {
     equeue_destroy(&q);
 }
 
+void ordering_test(int N) {
+    equeue_t q;
+    int err = equeue_create(&q, N*(EQUEUE_EVENT_SIZE+sizeof(struct order)));
+    test_assert(!err);
+
+    int last = -1;
+    int count = 0;
+    int *ids = malloc(N*sizeof(int));
+
+    // post events out of order with many shared targets
+    for (int i = 0; i < N; i++) {
+        int delay = (i*7) % 10;
+        struct order *o = equeue_alloc(&q, sizeof(struct order));
+        test_assert(o);
+
+        o->last = &last;
+        o->count = &count;
+        o->key = delay*N + i;
+        equeue_event_delay(o, delay);
+        ids[i] = equeue_post(&q, order_func, o);
+        test_assert(ids[i]);
+    }
+
+    // cancelling must not disturb the order of the remaining events
+    for (int i = 0; i < N; i += 3) {
+        equeue_cancel(&q, ids[i]);
+    }
+
+    free(ids);
+
+    equeue_dispatch(&q, 20);
+    test_assert(count == N - (N+2)/3);
+
+    equeue_destroy(&q);
+}
+
 void cancel_inflight_test(void) {
     equeue_t q;
     int err = equeue_create(&q, 2048);
@@ -698,6 +747,7 @@ int main() {
     test_run(destructor_test);
     test_run(allocation_failure_test);
     test_run(cancel_test, 20);
+    test_run(ordering_test, 100);
     test_run(cancel_inflight_test);
     test_run(cancel_unnecessarily_test);
     test_run(loop_protect_test);
@@ -304,6 +304,36 @@ typedef struct sn_nsdl_addr_ {
  */
 extern sn_coap_hdr_s *sn_coap_parser(struct coap_s *handle, uint16_t packet_data_len, uint8_t *packet_data_ptr, coap_version_e *coap_version_ptr);
 
+/**
+ * \fn sn_coap_hdr_s *sn_coap_parser_zero_copy(uint16_t packet_data_len, uint8_t *packet_data_ptr, sn_coap_hdr_s *dst_coap_msg_ptr, sn_coap_options_list_s *dst_options_ptr, coap_version_e *coap_version_ptr)
+ *
+ * \brief Parses CoAP message from given Packet data without allocating memory
+ *
+ *        Token, option values and payload of the parsed message point into the
+ *        Packet data, which must be kept as long as the message is used. Parts
+ *        of repeatable options (e.g. Uri-Path) are joined in place, so the Packet
+ *        data is modified. Message must not be released with
+ *        sn_coap_parser_release_allocated_coap_msg_mem().
+ *
+ * \param packet_data_len is length of given Packet data to be parsed to CoAP message
+ *
+ * \param *packet_data_ptr is source for Packet data to be parsed to CoAP message
+ *
+ * \param *dst_coap_msg_ptr is destination for parsed CoAP message
+ *
+ * \param *dst_options_ptr is destination for parsed less used options, set as
+ *          options_list_ptr of the message. If NULL, messages having such options
+ *          fail to parse
+ *
+ * \param *coap_version_ptr is destination for parsed CoAP specification version
+ *
+ * \return Return value is dst_coap_msg_ptr, with coap_status set to
+ *         COAP_STATUS_PARSER_ERROR_IN_HEADER if the message is not valid.\n
+ *         NULL is returned in failure in given pointer (= NULL)
+ */
+extern sn_coap_hdr_s *sn_coap_parser_zero_copy(uint16_t packet_data_len, uint8_t *packet_data_ptr, sn_coap_hdr_s *dst_coap_msg_ptr,
+                                               sn_coap_options_list_s *dst_options_ptr, coap_version_e *coap_version_ptr);
+
 /**
  * \fn void sn_coap_parser_release_allocated_coap_msg_mem(struct coap_s *handle, sn_coap_hdr_s *freed_coap_msg_ptr)
  *
@@ -362,6 +392,28 @@ extern uint16_t sn_coap_builder_calc_needed_packet_data_size(sn_coap_hdr_s *src_
  */
 extern int16_t sn_coap_builder_2(uint8_t *dst_packet_data_ptr, sn_coap_hdr_s *src_coap_msg_ptr, uint16_t blockwise_payload_size);
 
+/**
+ * \fn int16_t sn_coap_builder_3(uint8_t *dst_packet_data_ptr, uint16_t dst_packet_data_len, sn_coap_hdr_s *src_coap_msg_ptr)
+ *
+ * \brief Builds an outgoing message buffer from a CoAP header structure in one pass.
+ *
+ *        Unlike sn_coap_builder_2(), the needed size is not calculated before
+ *        building. Use sn_coap_builder_calc_needed_packet_data_size_2() to size
+ *        the buffer if needed, e.g. when allocating it.
+ *
+ * \param *dst_packet_data_ptr is pointer to destination to built CoAP packet
+ *
+ * \param dst_packet_data_len is size of the destination
+ *
+ * \param *src_coap_msg_ptr is pointer to source structure for building Packet data
+ *
+ * \return Return value is byte count of built Packet data. In failure cases:\n
+ *          -1 = Failure in given CoAP header structure\n
+ *          -2 = Failure in given pointer (= NULL)\n
+ *          -3 = Destination too small
+ */
+extern int16_t sn_coap_builder_3(uint8_t *dst_packet_data_ptr, uint16_t dst_packet_data_len, sn_coap_hdr_s *src_coap_msg_ptr);
+
 /**
  * \fn uint16_t sn_coap_builder_calc_needed_packet_data_size_2(sn_coap_hdr_s *src_coap_msg_ptr, uint16_t blockwise_payload_size)
  *
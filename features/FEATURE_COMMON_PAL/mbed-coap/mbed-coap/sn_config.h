@@ -83,6 +83,35 @@
  */
 #undef SN_COAP_MAX_INCOMING_MESSAGE_SIZE    /* UINT16_MAX */
 
+/**
+ * \def SN_COAP_MAX_ALLOWED_DUPLICATION_MESSAGE_COUNT
+ *
+ * \brief Sets the maximum count of messages stored for
+ * duplication detection that the application can set with
+ * sn_coap_protocol_set_duplicate_buffer_size(). Default is 6.
+ */
+#undef SN_COAP_MAX_ALLOWED_DUPLICATION_MESSAGE_COUNT /* 6 */
+
+/**
+ * \def SN_COAP_MAX_ALLOWED_RESENDING_BUFF_SIZE_MSGS
+ *
+ * \brief Sets the maximum number of messages in the resending
+ * queue that the application can set with
+ * sn_coap_protocol_set_retransmission_buffer(). Default is 6.
+ */
+#undef SN_COAP_MAX_ALLOWED_RESENDING_BUFF_SIZE_MSGS /* 6 */
+
+/**
+ * \def SN_COAP_HASH_BUCKETS
+ *
+ * \brief Sets the number of hash buckets used for finding
+ * the messages stored for duplication detection and resending
+ * by address, port and message ID. Must be a power of 2, each
+ * bucket takes one pointer per table. Servers with many peers
+ * and large buffers should use more buckets. Default is 8.
+ */
+#undef SN_COAP_HASH_BUCKETS                 /* 8 */
+
 #ifdef MBED_CLIENT_USER_CONFIG_FILE
 #include MBED_CLIENT_USER_CONFIG_FILE
 #endif
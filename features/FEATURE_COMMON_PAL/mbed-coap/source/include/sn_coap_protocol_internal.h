@@ -67,7 +67,13 @@ struct sn_coap_hdr_;
 
 /* These parameters sets maximum values application can set with API */
 #define SN_COAP_MAX_ALLOWED_RESENDING_COUNT             6   /**< Maximum allowed count of re-sending */
+#ifdef MBED_CONF_MBED_CLIENT_SN_COAP_MAX_ALLOWED_RESENDING_BUFF_SIZE_MSGS
+#define SN_COAP_MAX_ALLOWED_RESENDING_BUFF_SIZE_MSGS MBED_CONF_MBED_CLIENT_SN_COAP_MAX_ALLOWED_RESENDING_BUFF_SIZE_MSGS
+#endif
+
+#ifndef SN_COAP_MAX_ALLOWED_RESENDING_BUFF_SIZE_MSGS
 #define SN_COAP_MAX_ALLOWED_RESENDING_BUFF_SIZE_MSGS    6   /**< Maximum allowed number of saved re-sending messages */
+#endif
 #define SN_COAP_MAX_ALLOWED_RESENDING_BUFF_SIZE_BYTES   512 /**< Maximum allowed size of re-sending buffer */
 #define SN_COAP_MAX_ALLOWED_RESPONSE_TIMEOUT            40  /**< Maximum allowed re-sending timeout */
 
@@ -92,11 +98,36 @@ struct sn_coap_hdr_;
 
 
 /* Maximum allowed number of saved messages for duplicate searching */
+#ifdef MBED_CONF_MBED_CLIENT_SN_COAP_MAX_ALLOWED_DUPLICATION_MESSAGE_COUNT
+#define SN_COAP_MAX_ALLOWED_DUPLICATION_MESSAGE_COUNT MBED_CONF_MBED_CLIENT_SN_COAP_MAX_ALLOWED_DUPLICATION_MESSAGE_COUNT
+#endif
+
+#ifndef SN_COAP_MAX_ALLOWED_DUPLICATION_MESSAGE_COUNT
 #define SN_COAP_MAX_ALLOWED_DUPLICATION_MESSAGE_COUNT   6
+#endif
 
 /* Maximum time in seconds of messages to be stored for duplication detection */
 #define SN_COAP_DUPLICATION_MAX_TIME_MSGS_STORED    60 /* RESPONSE_TIMEOUT * RESPONSE_RANDOM_FACTOR * (2 ^ MAX_RETRANSMIT - 1) + the expected maximum round trip time */
 
+/* * For Message lookup * */
+
+/* Number of hash buckets used for finding stored duplication infos and resending messages by    */
+/* address, port and Message ID. Must be a power of 2; a bucket costs one pointer per table       */
+
+#ifdef YOTTA_CFG_COAP_HASH_BUCKETS
+#define SN_COAP_HASH_BUCKETS YOTTA_CFG_COAP_HASH_BUCKETS
+#elif defined MBED_CONF_MBED_CLIENT_SN_COAP_HASH_BUCKETS
+#define SN_COAP_HASH_BUCKETS MBED_CONF_MBED_CLIENT_SN_COAP_HASH_BUCKETS
+#endif
+
+#ifndef SN_COAP_HASH_BUCKETS
+#define SN_COAP_HASH_BUCKETS                        8
+#endif
+
+#if SN_COAP_HASH_BUCKETS & (SN_COAP_HASH_BUCKETS - 1)
+#error "SN_COAP_HASH_BUCKETS must be a power of 2"
+#endif
+
 /* * For Message blockwising * */
 
 /* Init value for the maximum payload size to be sent and received at one blockwise message                         */
@@ -151,6 +182,7 @@ typedef struct coap_send_msg_ {
     struct coap_s       *coap;              /* CoAP library handle */
     void                *param;             /* Extra parameter that will be passed to TX/RX callback functions */
 
+    struct coap_send_msg_ *hash_next;       /* Next message in the same hash bucket */
     ns_list_link_t      link;
 } coap_send_msg_s;
 
@@ -165,6 +197,7 @@ typedef struct coap_duplication_info_ {
     struct coap_s       *coap;  /* CoAP library handle */
     sn_nsdl_addr_s      *address;
     void                *param;
+    struct coap_duplication_info_ *hash_next; /* Next duplication info in the same hash bucket */
     ns_list_link_t      link;
 } coap_duplication_info_s;
 
@@ -208,18 +241,21 @@ struct coap_s {
     int8_t (*sn_coap_rx_callback)(sn_coap_hdr_s *, sn_nsdl_addr_s *, void *);
 
     #if ENABLE_RESENDINGS /* If Message resending is not used at all, this part of code will not be compiled */
-        coap_send_msg_list_t linked_list_resent_msgs; /* Active resending messages are stored to this Linked list */
+        coap_send_msg_list_t linked_list_resent_msgs; /* Active resending messages are stored to this Linked list, in resending time order */
+        coap_send_msg_s     *hash_resent_msgs[SN_COAP_HASH_BUCKETS]; /* Same messages by address, port and Message ID */
         uint16_t count_resent_msgs;
+        uint16_t size_resent_msgs; /* Total packet length of the active resending messages */
     #endif
 
     #if SN_COAP_DUPLICATION_MAX_MSGS_COUNT /* If Message duplication detection is not used at all, this part of code will not be compiled */
-        coap_duplication_info_list_t  linked_list_duplication_msgs; /* Messages for duplicated messages detection is stored to this Linked list */
+        coap_duplication_info_list_t  linked_list_duplication_msgs; /* Messages for duplicated messages detection is stored to this Linked list, oldest first */
+        coap_duplication_info_s      *hash_duplication_msgs[SN_COAP_HASH_BUCKETS]; /* Same messages by address, port and Message ID */
         uint16_t                      count_duplication_msgs;
     #endif
 
     #if SN_COAP_MAX_BLOCKWISE_PAYLOAD_SIZE /* If Message blockwise is not used at all, this part of code will not be compiled */
-        coap_blockwise_msg_list_t     linked_list_blockwise_sent_msgs; /* Blockwise message to to be sent is stored to this Linked list */
-        coap_blockwise_payload_list_t linked_list_blockwise_received_payloads; /* Blockwise payload to to be received is stored to this Linked list */
+        coap_blockwise_msg_list_t     linked_list_blockwise_sent_msgs; /* Blockwise message to to be sent is stored to this Linked list, oldest first */
+        coap_blockwise_payload_list_t linked_list_blockwise_received_payloads; /* Blockwise payload to to be received is stored to this Linked list, oldest first */
     #endif
 
     uint32_t system_time;    /* System time seconds */
@@ -38,15 +38,15 @@
 #define TRACE_GROUP "coap"
 /* * * * LOCAL FUNCTION PROTOTYPES * * * */
 static int8_t   sn_coap_builder_header_build(uint8_t **dst_packet_data_pptr, sn_coap_hdr_s *src_coap_msg_ptr);
-static int8_t   sn_coap_builder_options_build(uint8_t **dst_packet_data_pptr, sn_coap_hdr_s *src_coap_msg_ptr);
+static int16_t  sn_coap_builder_options_build(uint8_t **dst_packet_data_pptr, uint8_t *dst_packet_data_end_ptr, sn_coap_hdr_s *src_coap_msg_ptr);
 static uint16_t sn_coap_builder_options_calc_option_size(uint16_t query_len, uint8_t *query_ptr, sn_coap_option_numbers_e option);
-static int16_t  sn_coap_builder_options_build_add_one_option(uint8_t **dst_packet_data_pptr, uint16_t option_len, uint8_t *option_ptr, sn_coap_option_numbers_e option_number, uint16_t *previous_option_number);
-static int16_t  sn_coap_builder_options_build_add_multiple_option(uint8_t **dst_packet_data_pptr, uint8_t **src_pptr, uint16_t *src_len_ptr, sn_coap_option_numbers_e option, uint16_t *previous_option_number);
-static uint8_t  sn_coap_builder_options_build_add_uint_option(uint8_t **dst_packet_data_pptr, uint32_t value, sn_coap_option_numbers_e option_number, uint16_t *previous_option_number);
-static uint8_t  sn_coap_builder_options_get_option_part_count(uint16_t query_len, uint8_t *query_ptr, sn_coap_option_numbers_e option);
-static uint16_t sn_coap_builder_options_get_option_part_length_from_whole_option_string(uint16_t query_len, uint8_t *query_ptr, uint8_t query_index, sn_coap_option_numbers_e option);
-static int16_t  sn_coap_builder_options_get_option_part_position(uint16_t query_len, uint8_t *query_ptr, uint8_t query_index, sn_coap_option_numbers_e option);
-static void     sn_coap_builder_payload_build(uint8_t **dst_packet_data_pptr, sn_coap_hdr_s *src_coap_msg_ptr);
+static int16_t  sn_coap_builder_options_build_add_one_option(uint8_t **dst_packet_data_pptr, uint8_t *dst_packet_data_end_ptr, uint16_t option_len, uint8_t *option_ptr, sn_coap_option_numbers_e option_number, uint16_t *previous_option_number);
+static int16_t  sn_coap_builder_options_build_add_multiple_option(uint8_t **dst_packet_data_pptr, uint8_t *dst_packet_data_end_ptr, uint8_t *src_ptr, uint16_t src_len, sn_coap_option_numbers_e option, uint16_t *previous_option_number);
+static int16_t  sn_coap_builder_options_build_add_uint_option(uint8_t **dst_packet_data_pptr, uint8_t *dst_packet_data_end_ptr, uint32_t value, sn_coap_option_numbers_e option_number, uint16_t *previous_option_number);
+static uint8_t  sn_coap_builder_options_get_option_parts(uint16_t query_len, uint8_t *query_ptr, sn_coap_option_numbers_e option, uint32_t *first_ptr, uint32_t *end_ptr);
+static uint16_t sn_coap_builder_options_get_option_part_length(uint8_t *query_ptr, uint32_t offset, uint32_t end, uint8_t separator);
+static int8_t   sn_coap_builder_options_check_option_part_length(uint16_t one_query_part_len, sn_coap_option_numbers_e option);
+static int16_t  sn_coap_builder_payload_build(uint8_t **dst_packet_data_pptr, uint8_t *dst_packet_data_end_ptr, sn_coap_hdr_s *src_coap_msg_ptr);
 static uint8_t  sn_coap_builder_options_calculate_jump_need(sn_coap_hdr_s *src_coap_msg_ptr/*, uint8_t block_option*/);
 
 sn_coap_hdr_s *sn_coap_build_response(struct coap_s *handle, sn_coap_hdr_s *coap_packet_ptr, uint8_t msg_code)
@@ -100,31 +100,47 @@ int16_t sn_coap_builder(uint8_t *dst_packet_data_ptr, sn_coap_hdr_s *src_coap_ms
 
 int16_t sn_coap_builder_2(uint8_t *dst_packet_data_ptr, sn_coap_hdr_s *src_coap_msg_ptr, uint16_t blockwise_payload_size)
 {
-    uint8_t *base_packet_data_ptr = NULL;
-
     /* * * * Check given pointers  * * * */
     if (dst_packet_data_ptr == NULL || src_coap_msg_ptr == NULL) {
         return -2;
     }
 
-    /* Initialize given Packet data memory area with zero values */
+    /* The destination was sized by the caller from this, which also validates the message */
     uint16_t dst_byte_count_to_be_built = sn_coap_builder_calc_needed_packet_data_size_2(src_coap_msg_ptr, blockwise_payload_size);
     if (!dst_byte_count_to_be_built) {
         tr_error("sn_coap_builder_2 - failed to allocate message!");
         return -1;
     }
 
-    memset(dst_packet_data_ptr, 0, dst_byte_count_to_be_built);
+    return sn_coap_builder_3(dst_packet_data_ptr, dst_byte_count_to_be_built, src_coap_msg_ptr);
+}
+
+int16_t sn_coap_builder_3(uint8_t *dst_packet_data_ptr, uint16_t dst_packet_data_len, sn_coap_hdr_s *src_coap_msg_ptr)
+{
+    uint8_t *base_packet_data_ptr = NULL;
+    uint8_t *end_packet_data_ptr  = NULL;
+    int16_t  ret_status           = 0;
+
+    /* * * * Check given pointers  * * * */
+    if (dst_packet_data_ptr == NULL || src_coap_msg_ptr == NULL) {
+        return -2;
+    }
+
+    if (dst_packet_data_len < COAP_HEADER_LENGTH) {
+        tr_error("sn_coap_builder_3 - destination too small!");
+        return -3;
+    }
 
-    /* * * * Store base (= original) destination Packet data pointer for later usage * * * */
+    /* * * * Store base (= original) and end destination Packet data pointers for later usage * * * */
     base_packet_data_ptr = dst_packet_data_ptr;
+    end_packet_data_ptr = dst_packet_data_ptr + dst_packet_data_len;
 
     /* * * * * * * * * * * * * * * * * * */
     /* * * * Header part building  * * * */
     /* * * * * * * * * * * * * * * * * * */
     if (sn_coap_builder_header_build(&dst_packet_data_ptr, src_coap_msg_ptr) != 0) {
         /* Header building failed */
-        tr_error("sn_coap_builder_2 - header building failed!");
+        tr_error("sn_coap_builder_3 - header building failed!");
         return -1;
     }
 
@@ -133,12 +149,19 @@ int16_t sn_coap_builder_2(uint8_t *dst_packet_data_ptr, sn_coap_hdr_s *src_coap_
         /* * * * * * * * * * * * * * * * * * */
         /* * * * Options part building * * * */
         /* * * * * * * * * * * * * * * * * * */
-        sn_coap_builder_options_build(&dst_packet_data_ptr, src_coap_msg_ptr);
+        ret_status = sn_coap_builder_options_build(&dst_packet_data_ptr, end_packet_data_ptr, src_coap_msg_ptr);
+        if (ret_status < 0) {
+            tr_error("sn_coap_builder_3 - options building failed!");
+            return ret_status;
+        }
 
         /* * * * * * * * * * * * * * * * * * */
         /* * * * Payload part building * * * */
         /* * * * * * * * * * * * * * * * * * */
-        sn_coap_builder_payload_build(&dst_packet_data_ptr, src_coap_msg_ptr);
+        if (sn_coap_builder_payload_build(&dst_packet_data_ptr, end_packet_data_ptr, src_coap_msg_ptr) < 0) {
+            tr_error("sn_coap_builder_3 - destination too small!");
+            return -3;
+        }
     }
     /* * * * Return built Packet data length * * * */
     return (dst_packet_data_ptr - base_packet_data_ptr);
@@ -195,7 +218,7 @@ uint16_t sn_coap_builder_calc_needed_packet_data_size_2(sn_coap_hdr_s *src_coap_
                 return 0;
             }
 
-            returned_byte_count += sn_coap_builder_options_build_add_uint_option(NULL, src_coap_msg_ptr->content_format, COAP_OPTION_CONTENT_FORMAT, &tempInt);
+            returned_byte_count += sn_coap_builder_options_build_add_uint_option(NULL, NULL, src_coap_msg_ptr->content_format, COAP_OPTION_CONTENT_FORMAT, &tempInt);
         }
         /* If options list pointer exists */
         if (src_coap_msg_ptr->options_list_ptr != NULL) {
@@ -206,11 +229,11 @@ uint16_t sn_coap_builder_calc_needed_packet_data_size_2(sn_coap_hdr_s *src_coap_
                     return 0;
                 }
 
-                returned_byte_count += sn_coap_builder_options_build_add_uint_option(NULL, src_coap_msg_ptr->options_list_ptr->accept, COAP_OPTION_ACCEPT, &tempInt);
+                returned_byte_count += sn_coap_builder_options_build_add_uint_option(NULL, NULL, src_coap_msg_ptr->options_list_ptr->accept, COAP_OPTION_ACCEPT, &tempInt);
             }
             /* MAX AGE - An integer option, omitted for default. Up to 4 bytes */
             if (src_coap_msg_ptr->options_list_ptr->max_age != COAP_OPTION_MAX_AGE_DEFAULT) {
-                returned_byte_count += sn_coap_builder_options_build_add_uint_option(NULL, src_coap_msg_ptr->options_list_ptr->max_age, COAP_OPTION_MAX_AGE, &tempInt);
+                returned_byte_count += sn_coap_builder_options_build_add_uint_option(NULL, NULL, src_coap_msg_ptr->options_list_ptr->max_age, COAP_OPTION_MAX_AGE, &tempInt);
             }
             /* PROXY URI - Length of this option is  1-1034 bytes */
             if (src_coap_msg_ptr->options_list_ptr->proxy_uri_ptr != NULL) {
@@ -279,7 +302,7 @@ uint16_t sn_coap_builder_calc_needed_packet_data_size_2(sn_coap_hdr_s *src_coap_
                     tr_error("sn_coap_builder_calc_needed_packet_data_size_2 - uri port too large!");
                     return 0;
                 }
-                returned_byte_count += sn_coap_builder_options_build_add_uint_option(NULL, src_coap_msg_ptr->options_list_ptr->uri_port, COAP_OPTION_URI_PORT, &tempInt);
+                returned_byte_count += sn_coap_builder_options_build_add_uint_option(NULL, NULL, src_coap_msg_ptr->options_list_ptr->uri_port, COAP_OPTION_URI_PORT, &tempInt);
             }
             /* lOCATION QUERY - Repeatable option. Length of this option is 0-255 bytes */
             if (src_coap_msg_ptr->options_list_ptr->location_query_ptr != NULL) {
@@ -297,7 +320,7 @@ uint16_t sn_coap_builder_calc_needed_packet_data_size_2(sn_coap_hdr_s *src_coap_
                 if ((uint32_t) src_coap_msg_ptr->options_list_ptr->observe > 0xffffff) {
                     return 0;
                 }
-                returned_byte_count += sn_coap_builder_options_build_add_uint_option(NULL, src_coap_msg_ptr->options_list_ptr->observe, COAP_OPTION_OBSERVE, &tempInt);
+                returned_byte_count += sn_coap_builder_options_build_add_uint_option(NULL, NULL, src_coap_msg_ptr->options_list_ptr->observe, COAP_OPTION_OBSERVE, &tempInt);
             }
             /* URI QUERY - Repeatable option. Length of this option is 1-255 */
             if (src_coap_msg_ptr->options_list_ptr->uri_query_ptr != NULL) {
@@ -317,11 +340,11 @@ uint16_t sn_coap_builder_calc_needed_packet_data_size_2(sn_coap_hdr_s *src_coap_
                     tr_error("sn_coap_builder_calc_needed_packet_data_size_2 - block1 too large!");
                     return 0;
                 }
-                returned_byte_count += sn_coap_builder_options_build_add_uint_option(NULL, src_coap_msg_ptr->options_list_ptr->block1, COAP_OPTION_BLOCK1, &tempInt);
+                returned_byte_count += sn_coap_builder_options_build_add_uint_option(NULL, NULL, src_coap_msg_ptr->options_list_ptr->block1, COAP_OPTION_BLOCK1, &tempInt);
             }
             /* SIZE1 - Length of this option is 0-4 bytes */
             if (src_coap_msg_ptr->options_list_ptr->use_size1) {
-                returned_byte_count += sn_coap_builder_options_build_add_uint_option(NULL, src_coap_msg_ptr->options_list_ptr->size1, COAP_OPTION_SIZE1, &tempInt);
+                returned_byte_count += sn_coap_builder_options_build_add_uint_option(NULL, NULL, src_coap_msg_ptr->options_list_ptr->size1, COAP_OPTION_SIZE1, &tempInt);
             }
             /* BLOCK 2 - An integer option, up to 3 bytes */
             if (src_coap_msg_ptr->options_list_ptr->block2 != COAP_OPTION_BLOCK_NONE) {
@@ -329,11 +352,11 @@ uint16_t sn_coap_builder_calc_needed_packet_data_size_2(sn_coap_hdr_s *src_coap_
                     tr_error("sn_coap_builder_calc_needed_packet_data_size_2 - block2 too large!");
                     return 0;
                 }
-                returned_byte_count += sn_coap_builder_options_build_add_uint_option(NULL, src_coap_msg_ptr->options_list_ptr->block2, COAP_OPTION_BLOCK2, &tempInt);
+                returned_byte_count += sn_coap_builder_options_build_add_uint_option(NULL, NULL, src_coap_msg_ptr->options_list_ptr->block2, COAP_OPTION_BLOCK2, &tempInt);
             }
             /* SIZE2 - Length of this option is 0-4 bytes */
             if (src_coap_msg_ptr->options_list_ptr->use_size2) {
-                returned_byte_count += sn_coap_builder_options_build_add_uint_option(NULL, src_coap_msg_ptr->options_list_ptr->size2, COAP_OPTION_SIZE2, &tempInt);
+                returned_byte_count += sn_coap_builder_options_build_add_uint_option(NULL, NULL, src_coap_msg_ptr->options_list_ptr->size2, COAP_OPTION_SIZE2, &tempInt);
             }
         }
 #if SN_COAP_MAX_BLOCKWISE_PAYLOAD_SIZE
@@ -502,7 +525,7 @@ static int8_t sn_coap_builder_header_build(uint8_t **dst_packet_data_pptr, sn_co
     }
 
     /* * * Add CoAP Version * * */
-    **dst_packet_data_pptr += COAP_VERSION;
+    **dst_packet_data_pptr = COAP_VERSION;
 
     /* * * Add Message type * * */
     **dst_packet_data_pptr += src_coap_msg_ptr->msg_type;
@@ -526,18 +549,23 @@ static int8_t sn_coap_builder_header_build(uint8_t **dst_packet_data_pptr, sn_co
 }
 
 /**
- * \fn static int8_t sn_coap_builder_options_build(uint8_t **dst_packet_data_pptr, sn_coap_hdr_s *src_coap_msg_ptr)
+ * \fn static int16_t sn_coap_builder_options_build(uint8_t **dst_packet_data_pptr, uint8_t *dst_packet_data_end_ptr, sn_coap_hdr_s *src_coap_msg_ptr)
  *
  * \brief Builds Options part of Packet data
  *
  * \param **dst_packet_data_pptr is destination for built Packet data
  *
+ * \param *dst_packet_data_end_ptr is end of the destination
+ *
  * \param *src_coap_msg_ptr is source for building Packet data
  *
- * \return Return value is 0 in every case
+ * \return Return value is 0 in ok case, -1 if an option is not valid and -3 if
+ *         the destination is too small
  */
-static int8_t sn_coap_builder_options_build(uint8_t **dst_packet_data_pptr, sn_coap_hdr_s *src_coap_msg_ptr)
+static int16_t sn_coap_builder_options_build(uint8_t **dst_packet_data_pptr, uint8_t *dst_packet_data_end_ptr, sn_coap_hdr_s *src_coap_msg_ptr)
 {
+    int16_t ret_status = 0;
+
     /* * * * Check if Options are used at all  * * * */
     if (src_coap_msg_ptr->uri_path_ptr == NULL && src_coap_msg_ptr->token_ptr == NULL &&
             src_coap_msg_ptr->content_format == COAP_CT_NONE && src_coap_msg_ptr->options_list_ptr == NULL) {
@@ -546,8 +574,16 @@ static int8_t sn_coap_builder_options_build(uint8_t **dst_packet_data_pptr, sn_c
     }
 
     /* * * * First add Token option  * * * */
+    if (src_coap_msg_ptr->token_len > 8) {
+        return -1;
+    }
+    if (dst_packet_data_end_ptr - *dst_packet_data_pptr < src_coap_msg_ptr->token_len) {
+        return -3;
+    }
     if (src_coap_msg_ptr->token_len && src_coap_msg_ptr->token_ptr) {
         memcpy(*dst_packet_data_pptr, src_coap_msg_ptr->token_ptr, src_coap_msg_ptr->token_len);
+    } else {
+        memset(*dst_packet_data_pptr, 0, src_coap_msg_ptr->token_len);
     }
     (*dst_packet_data_pptr) += src_coap_msg_ptr->token_len;
 
@@ -561,89 +597,137 @@ static int8_t sn_coap_builder_options_build(uint8_t **dst_packet_data_pptr, sn_c
     /* Check if less used options are used at all */
     if (src_coap_msg_ptr->options_list_ptr != NULL) {
         /* * * * Build Uri-Host option * * * */
-        sn_coap_builder_options_build_add_one_option(dst_packet_data_pptr, src_coap_msg_ptr->options_list_ptr->uri_host_len,
+        ret_status = sn_coap_builder_options_build_add_one_option(dst_packet_data_pptr, dst_packet_data_end_ptr, src_coap_msg_ptr->options_list_ptr->uri_host_len,
                      src_coap_msg_ptr->options_list_ptr->uri_host_ptr, COAP_OPTION_URI_HOST, &previous_option_number);
+        if (ret_status < 0) {
+            return ret_status;
+        }
 
         /* * * * Build ETag option  * * * */
-        sn_coap_builder_options_build_add_multiple_option(dst_packet_data_pptr, &src_coap_msg_ptr->options_list_ptr->etag_ptr,
-                     (uint16_t *)&src_coap_msg_ptr->options_list_ptr->etag_len, COAP_OPTION_ETAG, &previous_option_number);
+        ret_status = sn_coap_builder_options_build_add_multiple_option(dst_packet_data_pptr, dst_packet_data_end_ptr, src_coap_msg_ptr->options_list_ptr->etag_ptr,
+                     src_coap_msg_ptr->options_list_ptr->etag_len, COAP_OPTION_ETAG, &previous_option_number);
+        if (ret_status < 0) {
+            return ret_status;
+        }
 
         /* * * * Build Observe option  * * * * */
         if (src_coap_msg_ptr->options_list_ptr->observe != COAP_OBSERVE_NONE) {
-            sn_coap_builder_options_build_add_uint_option(dst_packet_data_pptr, src_coap_msg_ptr->options_list_ptr->observe,
+            ret_status = sn_coap_builder_options_build_add_uint_option(dst_packet_data_pptr, dst_packet_data_end_ptr, src_coap_msg_ptr->options_list_ptr->observe,
                          COAP_OPTION_OBSERVE, &previous_option_number);
+            if (ret_status < 0) {
+                return ret_status;
+            }
         }
 
         /* * * * Build Uri-Port option * * * */
         if (src_coap_msg_ptr->options_list_ptr->uri_port != COAP_OPTION_URI_PORT_NONE) {
-            sn_coap_builder_options_build_add_uint_option(dst_packet_data_pptr, src_coap_msg_ptr->options_list_ptr->uri_port,
+            ret_status = sn_coap_builder_options_build_add_uint_option(dst_packet_data_pptr, dst_packet_data_end_ptr, src_coap_msg_ptr->options_list_ptr->uri_port,
                          COAP_OPTION_URI_PORT, &previous_option_number);
+            if (ret_status < 0) {
+                return ret_status;
+            }
         }
 
         /* * * * Build Location-Path option  * * * */
-        sn_coap_builder_options_build_add_multiple_option(dst_packet_data_pptr, &src_coap_msg_ptr->options_list_ptr->location_path_ptr,
-                     &src_coap_msg_ptr->options_list_ptr->location_path_len, COAP_OPTION_LOCATION_PATH, &previous_option_number);
+        ret_status = sn_coap_builder_options_build_add_multiple_option(dst_packet_data_pptr, dst_packet_data_end_ptr, src_coap_msg_ptr->options_list_ptr->location_path_ptr,
+                     src_coap_msg_ptr->options_list_ptr->location_path_len, COAP_OPTION_LOCATION_PATH, &previous_option_number);
+        if (ret_status < 0) {
+            return ret_status;
+        }
     }
     /* * * * Build Uri-Path option * * * */
-    sn_coap_builder_options_build_add_multiple_option(dst_packet_data_pptr, &src_coap_msg_ptr->uri_path_ptr,
-             &src_coap_msg_ptr->uri_path_len, COAP_OPTION_URI_PATH, &previous_option_number);
+    ret_status = sn_coap_builder_options_build_add_multiple_option(dst_packet_data_pptr, dst_packet_data_end_ptr, src_coap_msg_ptr->uri_path_ptr,
+             src_coap_msg_ptr->uri_path_len, COAP_OPTION_URI_PATH, &previous_option_number);
+    if (ret_status < 0) {
+        return ret_status;
+    }
 
     /* * * * Build Content-Type option * * * */
     if (src_coap_msg_ptr->content_format != COAP_CT_NONE) {
-        sn_coap_builder_options_build_add_uint_option(dst_packet_data_pptr, src_coap_msg_ptr->content_format,
+        ret_status = sn_coap_builder_options_build_add_uint_option(dst_packet_data_pptr, dst_packet_data_end_ptr, src_coap_msg_ptr->content_format,
                      COAP_OPTION_CONTENT_FORMAT, &previous_option_number);
+        if (ret_status < 0) {
+            return ret_status;
+        }
     }
 
     if (src_coap_msg_ptr->options_list_ptr != NULL) {
         /* * * * Build Max-Age option  * * * */
         if (src_coap_msg_ptr->options_list_ptr->max_age != COAP_OPTION_MAX_AGE_DEFAULT) {
-            sn_coap_builder_options_build_add_uint_option(dst_packet_data_pptr, src_coap_msg_ptr->options_list_ptr->max_age,
+            ret_status = sn_coap_builder_options_build_add_uint_option(dst_packet_data_pptr, dst_packet_data_end_ptr, src_coap_msg_ptr->options_list_ptr->max_age,
                          COAP_OPTION_MAX_AGE, &previous_option_number);
+            if (ret_status < 0) {
+                return ret_status;
+            }
         }
 
         /* * * * Build Uri-Query option  * * * * */
-        sn_coap_builder_options_build_add_multiple_option(dst_packet_data_pptr, &src_coap_msg_ptr->options_list_ptr->uri_query_ptr,
-                     &src_coap_msg_ptr->options_list_ptr->uri_query_len, COAP_OPTION_URI_QUERY, &previous_option_number);
+        ret_status = sn_coap_builder_options_build_add_multiple_option(dst_packet_data_pptr, dst_packet_data_end_ptr, src_coap_msg_ptr->options_list_ptr->uri_query_ptr,
+                     src_coap_msg_ptr->options_list_ptr->uri_query_len, COAP_OPTION_URI_QUERY, &previous_option_number);
+        if (ret_status < 0) {
+            return ret_status;
+        }
 
         /* * * * Build Accept option  * * * * */
         if (src_coap_msg_ptr->options_list_ptr->accept != COAP_CT_NONE) {
-            sn_coap_builder_options_build_add_uint_option(dst_packet_data_pptr, src_coap_msg_ptr->options_list_ptr->accept,
+            ret_status = sn_coap_builder_options_build_add_uint_option(dst_packet_data_pptr, dst_packet_data_end_ptr, src_coap_msg_ptr->options_list_ptr->accept,
                          COAP_OPTION_ACCEPT, &previous_option_number);
+            if (ret_status < 0) {
+                return ret_status;
+            }
         }
     }
 
     if (src_coap_msg_ptr->options_list_ptr != NULL) {
         /* * * * Build Location-Query option * * * */
-        sn_coap_builder_options_build_add_multiple_option(dst_packet_data_pptr, &src_coap_msg_ptr->options_list_ptr->location_query_ptr,
-                     &src_coap_msg_ptr->options_list_ptr->location_query_len, COAP_OPTION_LOCATION_QUERY, &previous_option_number);
+        ret_status = sn_coap_builder_options_build_add_multiple_option(dst_packet_data_pptr, dst_packet_data_end_ptr, src_coap_msg_ptr->options_list_ptr->location_query_ptr,
+                     src_coap_msg_ptr->options_list_ptr->location_query_len, COAP_OPTION_LOCATION_QUERY, &previous_option_number);
+        if (ret_status < 0) {
+            return ret_status;
+        }
 
         /* * * * Build Block2 option * * * * */
         if (src_coap_msg_ptr->options_list_ptr->block2 != COAP_OPTION_BLOCK_NONE) {
-            sn_coap_builder_options_build_add_uint_option(dst_packet_data_pptr, src_coap_msg_ptr->options_list_ptr->block2,
+            ret_status = sn_coap_builder_options_build_add_uint_option(dst_packet_data_pptr, dst_packet_data_end_ptr, src_coap_msg_ptr->options_list_ptr->block2,
                          COAP_OPTION_BLOCK2, &previous_option_number);
+            if (ret_status < 0) {
+                return ret_status;
+            }
         }
 
         /* * * * Build Block1 option * * * * */
         if (src_coap_msg_ptr->options_list_ptr->block1 != COAP_OPTION_BLOCK_NONE) {
-            sn_coap_builder_options_build_add_uint_option(dst_packet_data_pptr, src_coap_msg_ptr->options_list_ptr->block1,
+            ret_status = sn_coap_builder_options_build_add_uint_option(dst_packet_data_pptr, dst_packet_data_end_ptr, src_coap_msg_ptr->options_list_ptr->block1,
                          COAP_OPTION_BLOCK1, &previous_option_number);
+            if (ret_status < 0) {
+                return ret_status;
+            }
         }
 
         /* * * * Build Size2 option * * * */
         if (src_coap_msg_ptr->options_list_ptr->use_size2) {
-            sn_coap_builder_options_build_add_uint_option(dst_packet_data_pptr, src_coap_msg_ptr->options_list_ptr->size2,
+            ret_status = sn_coap_builder_options_build_add_uint_option(dst_packet_data_pptr, dst_packet_data_end_ptr, src_coap_msg_ptr->options_list_ptr->size2,
                          COAP_OPTION_SIZE2, &previous_option_number);
+            if (ret_status < 0) {
+                return ret_status;
+            }
         }
 
         /* * * * Build Proxy-Uri option * * * */
-        sn_coap_builder_options_build_add_one_option(dst_packet_data_pptr, src_coap_msg_ptr->options_list_ptr->proxy_uri_len,
+        ret_status = sn_coap_builder_options_build_add_one_option(dst_packet_data_pptr, dst_packet_data_end_ptr, src_coap_msg_ptr->options_list_ptr->proxy_uri_len,
                      src_coap_msg_ptr->options_list_ptr->proxy_uri_ptr, COAP_OPTION_PROXY_URI, &previous_option_number);
+        if (ret_status < 0) {
+            return ret_status;
+        }
 
 
         /* * * * Build Size1 option * * * */
         if (src_coap_msg_ptr->options_list_ptr->use_size1) {
-            sn_coap_builder_options_build_add_uint_option(dst_packet_data_pptr, src_coap_msg_ptr->options_list_ptr->size1,
+            ret_status = sn_coap_builder_options_build_add_uint_option(dst_packet_data_pptr, dst_packet_data_end_ptr, src_coap_msg_ptr->options_list_ptr->size1,
                          COAP_OPTION_SIZE1, &previous_option_number);
+            if (ret_status < 0) {
+                return ret_status;
+            }
         }
     }
 
@@ -652,29 +736,44 @@ static int8_t sn_coap_builder_options_build(uint8_t **dst_packet_data_pptr, sn_c
 }
 
 /**
- * \fn static int16_t sn_coap_builder_options_build_add_one_option(uint8_t **dst_packet_data_pptr, uint16_t option_value_len, uint8_t *option_value_ptr, sn_coap_option_numbers_e option_number)
+ * \fn static int16_t sn_coap_builder_options_build_add_one_option(uint8_t **dst_packet_data_pptr, uint8_t *dst_packet_data_end_ptr, uint16_t option_value_len, uint8_t *option_value_ptr, sn_coap_option_numbers_e option_number)
  *
  * \brief Adds Options part of Packet data
  *
  * \param **dst_packet_data_pptr is destination for built Packet data
  *
+ * \param *dst_packet_data_end_ptr is end of the destination
+ *
  * \param option_value_len is Option value length to be added
  *
  * \param *option_value_ptr is pointer to Option value data to be added
  *
  * \param option_number is Option number to be added
  *
- * \return Return value is 0 if option was not added, 1 if added
+ * \return Return value is 0 if option was not added, 1 if added and -3 if
+ *         the destination is too small
  */
-static int16_t sn_coap_builder_options_build_add_one_option(uint8_t **dst_packet_data_pptr, uint16_t option_len,
+static int16_t sn_coap_builder_options_build_add_one_option(uint8_t **dst_packet_data_pptr, uint8_t *dst_packet_data_end_ptr, uint16_t option_len,
         uint8_t *option_ptr, sn_coap_option_numbers_e option_number, uint16_t *previous_option_number)
 {
     /* Check if there is option at all */
     if (option_ptr != NULL) {
         uint16_t option_delta;
+        uint32_t option_header_len = 1;
 
         option_delta = (option_number - *previous_option_number);
 
+        /* * * Check that option header and value fit * * */
+        if (option_delta > 12) {
+            option_header_len += (option_delta < 269) ? 1 : 2;
+        }
+        if (option_len > 12) {
+            option_header_len += (option_len < 269) ? 1 : 2;
+        }
+        if (dst_packet_data_end_ptr - *dst_packet_data_pptr < (int32_t)(option_header_len + option_len)) {
+            return -3;
+        }
+
         /* * * Build option header * * */
 
         /* First option length without extended part */
@@ -746,13 +845,15 @@ static int16_t sn_coap_builder_options_build_add_one_option(uint8_t **dst_packet
  * \param **dst_packet_data_pptr is destination for built Packet data; NULL
  *        to compute size only.
  *
+ * \param *dst_packet_data_end_ptr is end of the destination
+ *
  * \param option_value is Option value to be added
  *
  * \param option_number is Option number to be added
  *
- * \return Return value is total option size, or -1 in write failure case
+ * \return Return value is total option size, or -3 if the destination is too small
  */
-static uint8_t sn_coap_builder_options_build_add_uint_option(uint8_t **dst_packet_data_pptr, uint32_t option_value, sn_coap_option_numbers_e option_number, uint16_t *previous_option_number)
+static int16_t sn_coap_builder_options_build_add_uint_option(uint8_t **dst_packet_data_pptr, uint8_t *dst_packet_data_end_ptr, uint32_t option_value, sn_coap_option_numbers_e option_number, uint16_t *previous_option_number)
 {
     uint8_t payload[4];
     uint8_t len = 0;
@@ -766,8 +867,7 @@ static uint8_t sn_coap_builder_options_build_add_uint_option(uint8_t **dst_packe
 
     /* If output pointer isn't NULL, write it out */
     if (dst_packet_data_pptr) {
-        int16_t ret = sn_coap_builder_options_build_add_one_option(dst_packet_data_pptr, len, payload, option_number, previous_option_number);
-        /* Allow for failure returns when writing (why even permit failure returns?) */
+        int16_t ret = sn_coap_builder_options_build_add_one_option(dst_packet_data_pptr, dst_packet_data_end_ptr, len, payload, option_number, previous_option_number);
         if (ret < 0) {
             return ret;
         }
@@ -778,44 +878,48 @@ static uint8_t sn_coap_builder_options_build_add_uint_option(uint8_t **dst_packe
 }
 
 /**
- * \fn static int16_t sn_coap_builder_options_build_add_multiple_option(uint8_t **dst_packet_data_pptr, uint8_t **src_pptr, uint16_t *src_len_ptr, sn_coap_option_numbers_e option)
+ * \fn static int16_t sn_coap_builder_options_build_add_multiple_option(uint8_t **dst_packet_data_pptr, uint8_t *dst_packet_data_end_ptr, uint8_t *src_ptr, uint16_t src_len, sn_coap_option_numbers_e option)
  *
  * \brief Builds Option Uri-Query from given CoAP Header structure to Packet data
  *
  * \param **dst_packet_data_pptr is destination for built Packet data
  *
- * \param uint8_t **src_pptr
+ * \param *dst_packet_data_end_ptr is end of the destination
  *
- *  \param uint16_t *src_len_ptr
+ * \param uint8_t *src_ptr
+ *
+ *  \param uint16_t src_len
  *
  *  \paramsn_coap_option_numbers_e option option to be added
  *
- * \return Return value is 0 always
+ * \return Return value is 0 in ok case, -1 if a part is not valid and -3 if
+ *         the destination is too small
  */
-static int16_t sn_coap_builder_options_build_add_multiple_option(uint8_t **dst_packet_data_pptr, uint8_t **src_pptr, uint16_t *src_len_ptr, sn_coap_option_numbers_e option, uint16_t *previous_option_number)
+static int16_t sn_coap_builder_options_build_add_multiple_option(uint8_t **dst_packet_data_pptr, uint8_t *dst_packet_data_end_ptr, uint8_t *src_ptr, uint16_t src_len, sn_coap_option_numbers_e option, uint16_t *previous_option_number)
 {
     /* Check if there is option at all */
-    if (*src_pptr != NULL) {
-        uint8_t    *query_ptr               = *src_pptr;
-        uint8_t     query_part_count        = 0;
-        uint16_t    query_len               = *src_len_ptr;
-        uint8_t     i                       = 0;
-        uint16_t    query_part_offset       = 0;
-
-        /* Get query part count */
-        query_part_count = sn_coap_builder_options_get_option_part_count(query_len, query_ptr, option);
+    if (src_ptr != NULL) {
+        uint32_t    query_part_offset       = 0;
+        uint32_t    query_end               = 0;
+        uint8_t     separator               = sn_coap_builder_options_get_option_parts(src_len, src_ptr, option, &query_part_offset, &query_end);
 
         /* * * * Options by adding all parts to option * * * */
-        for (i = 0; i < query_part_count; i++) {
+        do {
             /* Get length of query part */
-            uint16_t one_query_part_len = sn_coap_builder_options_get_option_part_length_from_whole_option_string(query_len, query_ptr, i, option);
+            uint16_t one_query_part_len = sn_coap_builder_options_get_option_part_length(src_ptr, query_part_offset, query_end, separator);
 
-            /* Get position of query part */
-            query_part_offset = sn_coap_builder_options_get_option_part_position(query_len, query_ptr, i, option);
+            if (sn_coap_builder_options_check_option_part_length(one_query_part_len, option) != 0) {
+                return -1;
+            }
 
             /* Add Uri-query's one part to Options */
-            sn_coap_builder_options_build_add_one_option(dst_packet_data_pptr, one_query_part_len, *src_pptr + query_part_offset, option, previous_option_number);
-        }
+            if (sn_coap_builder_options_build_add_one_option(dst_packet_data_pptr, dst_packet_data_end_ptr, one_query_part_len, src_ptr + query_part_offset, option, previous_option_number) < 0) {
+                return -3;
+            }
+
+            /* Move over the part and its separator */
+            query_part_offset += one_query_part_len + 1;
+        } while (query_part_offset <= query_end);
     }
     /* Success */
     return 0;
@@ -835,45 +939,23 @@ static int16_t sn_coap_builder_options_build_add_multiple_option(uint8_t **dst_p
  */
 static uint16_t sn_coap_builder_options_calc_option_size(uint16_t query_len, uint8_t *query_ptr, sn_coap_option_numbers_e option)
 {
-    uint8_t     query_part_count    = sn_coap_builder_options_get_option_part_count(query_len, query_ptr, option);
-    uint8_t     i                   = 0;
+    uint32_t    query_part_offset   = 0;
+    uint32_t    query_end           = 0;
+    uint8_t     separator           = sn_coap_builder_options_get_option_parts(query_len, query_ptr, option, &query_part_offset, &query_end);
     uint16_t    ret_value           = 0;
 
     /* * * * * * * * * * * * * * * * * * * * * * * * */
     /* * * * Calculate Uri-query options length  * * */
     /* * * * * * * * * * * * * * * * * * * * * * * * */
-    for (i = 0; i < query_part_count; i++) {
+    do {
         /* * * Length of Option number and Option value length * * */
 
         /* Get length of Query part */
-        uint16_t one_query_part_len = sn_coap_builder_options_get_option_part_length_from_whole_option_string(query_len, query_ptr, i, option);
+        uint16_t one_query_part_len = sn_coap_builder_options_get_option_part_length(query_ptr, query_part_offset, query_end, separator);
 
         /* Check option length */
-        switch (option) {
-            case (COAP_OPTION_ETAG):            /* Length 1-8 */
-                if (one_query_part_len < 1 || one_query_part_len > 8) {
-                    return 0;
-                }
-                break;
-            case (COAP_OPTION_LOCATION_PATH):   /* Length 0-255 */
-            case (COAP_OPTION_URI_PATH):        /* Length 0-255 */
-            case (COAP_OPTION_LOCATION_QUERY):  /* Length 0-255 */
-                if (one_query_part_len > 255) {
-                    return 0;
-                }
-                break;
-            case (COAP_OPTION_URI_QUERY):       /* Length 1-255 */
-                if (one_query_part_len < 1 || one_query_part_len > 255) {
-                    return 0;
-                }
-                break;
-//            case (COAP_OPTION_ACCEPT):          /* Length 0-2 */
-//                if (one_query_part_len > 2) {
-//                    return 0;
-//                }
-//                break;
-            default:
-                break; //impossible scenario currently
+        if (sn_coap_builder_options_check_option_part_length(one_query_part_len, option) != 0) {
+            return 0;
         }
 
         /* Check if 4 bits are enough for writing Option value length */
@@ -895,182 +977,129 @@ static uint16_t sn_coap_builder_options_calc_option_size(uint16_t query_len, uin
 
         /* Increase options length */
         ret_value += one_query_part_len;
-    }
+
+        /* Move over the part and its separator */
+        query_part_offset += one_query_part_len + 1;
+    } while (query_part_offset <= query_end);
 
     /* Success */
     return ret_value;
 }
 
-
-
 /**
- * \fn static uint8_t sn_coap_builder_options_get_option_part_count(uint16_t query_len, uint8_t *query_ptr, sn_coap_option_numbers_e option)
- *
- * \brief Gets query part count from whole option string
- *
- * \param query_len is length of whole Path
+ * \fn static int8_t sn_coap_builder_options_check_option_part_length(uint16_t one_query_part_len, sn_coap_option_numbers_e option)
  *
- * \param *query_ptr is pointer to the start of whole Path
+ * \brief Checks the length of one part of a repeatable option
  *
- * \return Return value is count of query parts
+ * \return Return value is 0 if the length is valid, -1 if not
  */
-static uint8_t sn_coap_builder_options_get_option_part_count(uint16_t query_len, uint8_t *query_ptr, sn_coap_option_numbers_e option)
+static int8_t sn_coap_builder_options_check_option_part_length(uint16_t one_query_part_len, sn_coap_option_numbers_e option)
 {
-    uint8_t  returned_query_count = 0;
-    uint16_t query_len_index      = 0;
-    uint8_t  char_to_search       = '&';
-
-    if (option == COAP_OPTION_URI_PATH || option == COAP_OPTION_LOCATION_PATH) {
-        char_to_search = '/';
-    }
-
-    /* Loop whole query and search '\0' characters (not first and last char) */
-    for (query_len_index = 1; query_len_index < query_len - 1; query_len_index++) {
-        /* If new query part starts */
-        if (*(query_ptr + query_len_index) == char_to_search) { /* If match */
-            returned_query_count++;
-        }
+    switch (option) {
+        case (COAP_OPTION_ETAG):            /* Length 1-8 */
+            if (one_query_part_len < 1 || one_query_part_len > 8) {
+                return -1;
+            }
+            break;
+        case (COAP_OPTION_LOCATION_PATH):   /* Length 0-255 */
+        case (COAP_OPTION_URI_PATH):        /* Length 0-255 */
+        case (COAP_OPTION_LOCATION_QUERY):  /* Length 0-255 */
+            if (one_query_part_len > 255) {
+                return -1;
+            }
+            break;
+        case (COAP_OPTION_URI_QUERY):       /* Length 1-255 */
+            if (one_query_part_len < 1 || one_query_part_len > 255) {
+                return -1;
+            }
+            break;
+        default:
+            break; //impossible scenario currently
     }
-
-    returned_query_count++;
-
-    return returned_query_count;
+    return 0;
 }
 
 /**
- * \fn static uint16_t sn_coap_builder_options_get_option_part_length_from_whole_option_string(uint16_t query_len,
-                                                                             uint8_t *query_ptr,
-                                                                             uint8_t query_index, sn_coap_option_numbers_e option)
+ * \fn static uint8_t sn_coap_builder_options_get_option_parts(uint16_t query_len, uint8_t *query_ptr, sn_coap_option_numbers_e option, uint32_t *first_ptr, uint32_t *end_ptr)
+ *
+ * \brief Gets the range of the parts in whole option string
  *
- * \brief Gets one's query part length from whole query string
+ *        Parts are separated with '/' in paths and '&' in other options. A
+ *        separator at the start or at the end of the whole string is skipped.
  *
  * \param query_len is length of whole string
  *
  * \param *query_ptr is pointer to the start of whole string
  *
- * \param query_index is query part index to be found
+ * \param option is option number of the option
  *
- * \param sn_coap_option_numbers_e option is option number of the option
+ * \param *first_ptr is destination for the offset of the first part
  *
- * \return Return value is length of query part
+ * \param *end_ptr is destination for the offset of the end of the last part
+ *
+ * \return Return value is the separator of the parts
  */
-static uint16_t sn_coap_builder_options_get_option_part_length_from_whole_option_string(uint16_t query_len, uint8_t *query_ptr,
-        uint8_t query_index, sn_coap_option_numbers_e option)
+static uint8_t sn_coap_builder_options_get_option_parts(uint16_t query_len, uint8_t *query_ptr, sn_coap_option_numbers_e option, uint32_t *first_ptr, uint32_t *end_ptr)
 {
-    uint16_t returned_query_part_len = 0;
-    uint8_t  temp_query_index        = 0;
-    uint16_t query_len_index         = 0;
-    uint8_t  char_to_search          = '&';
+    uint8_t separator = '&';
 
     if (option == COAP_OPTION_URI_PATH || option == COAP_OPTION_LOCATION_PATH) {
-        char_to_search = '/';
+        separator = '/';
     }
 
-    /* Loop whole query and search '\0' characters */
-    for (query_len_index = 0; query_len_index < query_len; query_len_index++) {
-        /* Store character to temp_char for helping debugging */
-        uint8_t temp_char = *query_ptr;
-
-        /* If new query part starts */
-        if (temp_char == char_to_search && returned_query_part_len > 0) { /* returned_query_part_len > 0 is for querys which start with "\0" */
-            /* If query part index is wanted */
-            if (temp_query_index == query_index) {
-                /* Return length of query part */
-                return returned_query_part_len;
-            } else {
-                /* Reset length of query part because wanted query part finding continues*/
-                returned_query_part_len = 0;
-            }
+    *first_ptr = 0;
+    *end_ptr = query_len;
 
-            /* Next query part is looped */
-            temp_query_index++;
-        } else if (temp_char != char_to_search) { /* Else if query part continues */
-            /* Increase query part length */
-            returned_query_part_len++;
-        }
-
-        query_ptr++;
+    if (query_len > 0 && query_ptr[0] == separator) {
+        *first_ptr = 1;
+    }
+    if (query_len > 1 && query_ptr[query_len - 1] == separator) {
+        *end_ptr = query_len - 1;
     }
 
-    /* Return length of query part in cases that query part does not finish to '\0' character (last query part can be like that) */
-    return returned_query_part_len;
+    return separator;
 }
 
 /**
- * \fn static uint16_t sn_coap_builder_options_get_option_part_position(uint16_t query_len,
-                                                               uint8_t *query_ptr,
-                                                               uint8_t query_index, sn_coap_option_numbers_e option)
- *
- * \brief Gets query part position in whole query
+ * \fn static uint16_t sn_coap_builder_options_get_option_part_length(uint8_t *query_ptr, uint32_t offset, uint32_t end, uint8_t separator)
  *
- * \param query_len is length of whole query
+ * \brief Gets length of the part starting at offset in whole option string
  *
- * \param *query_ptr is pointer to the start of whole query
- *
- * \param query_index is query part index to be found
- *
- * \return Return value is position (= offset) of query part in whole query. In
- *         fail cases -1 is returned.
+ * \return Return value is length of query part
  */
-static int16_t sn_coap_builder_options_get_option_part_position(uint16_t query_len, uint8_t *query_ptr,
-        uint8_t query_index, sn_coap_option_numbers_e option)
+static uint16_t sn_coap_builder_options_get_option_part_length(uint8_t *query_ptr, uint32_t offset, uint32_t end, uint8_t separator)
 {
-    uint16_t returned_query_part_offset = 0;
-    uint8_t  temp_query_index           = 0;
-    uint16_t query_len_index            = 0;
-    uint8_t  char_to_search             = '&';
+    uint32_t query_len_index = offset;
 
-    if (option == COAP_OPTION_URI_PATH || option == COAP_OPTION_LOCATION_PATH) {
-        char_to_search = '/';
-    }
-
-    if (query_index == 0) {
-        if (*query_ptr == 0 || *query_ptr == char_to_search) {
-            return 1;
-        } else {
-            return 0;
-        }
+    while (query_len_index < end && query_ptr[query_len_index] != separator) {
+        query_len_index++;
     }
 
-    /* Loop whole query and search separator characters */
-    for (query_len_index = 0; query_len_index < query_len; query_len_index++) {
-        /* Store character to temp_char for helping debugging */
-        uint8_t temp_char = *query_ptr;
-
-        /* If new query part starts */
-        if (temp_char == char_to_search && returned_query_part_offset > 0) { /* returned_query_part_offset > 0 is for querys which start with searched char */
-            /* If query part index is wanted */
-            if (temp_query_index == (query_index - 1)) {
-                /* Return offset of query part */
-                return (returned_query_part_offset + 1); /* Plus one is for passing separator */
-            }
-
-            /* Next query part is looped */
-            temp_query_index++;
-        }
-
-        returned_query_part_offset++;
-
-        query_ptr++;
-    }
-
-    return -1; //Dead code?
+    return query_len_index - offset;
 }
 
 
 /**
- * \fn static void sn_coap_builder_payload_build(uint8_t **dst_packet_data_pptr, sn_coap_hdr_s *src_coap_msg_ptr)
+ * \fn static int16_t sn_coap_builder_payload_build(uint8_t **dst_packet_data_pptr, uint8_t *dst_packet_data_end_ptr, sn_coap_hdr_s *src_coap_msg_ptr)
  *
  * \brief Builds Options part of Packet data
  *
  * \param **dst_packet_data_pptr is destination for built Packet data
  *
+ * \param *dst_packet_data_end_ptr is end of the destination
+ *
  * \param *src_coap_msg_ptr is source for building Packet data
+ *
+ * \return Return value is 0 in ok case and -3 if the destination is too small
  */
-static void sn_coap_builder_payload_build(uint8_t **dst_packet_data_pptr, sn_coap_hdr_s *src_coap_msg_ptr)
+static int16_t sn_coap_builder_payload_build(uint8_t **dst_packet_data_pptr, uint8_t *dst_packet_data_end_ptr, sn_coap_hdr_s *src_coap_msg_ptr)
 {
     /* Check if Payload is used at all */
     if (src_coap_msg_ptr->payload_len && src_coap_msg_ptr->payload_ptr != NULL) {
+        if (dst_packet_data_end_ptr - *dst_packet_data_pptr < 1 + (int32_t)src_coap_msg_ptr->payload_len) {
+            return -3;
+        }
+
         /* Write Payload marker */
 
         **dst_packet_data_pptr = 0xff;
@@ -1082,4 +1111,5 @@ static void sn_coap_builder_payload_build(uint8_t **dst_packet_data_pptr, sn_coa
         /* Increase destination Packet data pointer */
         (*dst_packet_data_pptr) += src_coap_msg_ptr->payload_len;
     }
+    return 0;
 }
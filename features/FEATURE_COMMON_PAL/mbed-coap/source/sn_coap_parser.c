@@ -47,6 +47,9 @@ static int8_t   sn_coap_parser_options_parse(struct coap_s *handle, uint8_t **pa
 static int8_t   sn_coap_parser_options_parse_multiple_options(struct coap_s *handle, uint8_t **packet_data_pptr, uint16_t packet_left_len,  uint8_t **dst_pptr, uint16_t *dst_len_ptr, sn_coap_option_numbers_e option, uint16_t option_number_len);
 static int16_t  sn_coap_parser_options_count_needed_memory_multiple_option(uint8_t *packet_data_ptr, uint16_t packet_left_len, sn_coap_option_numbers_e option, uint16_t option_number_len);
 static int8_t   sn_coap_parser_payload_parse(uint16_t packet_data_len, uint8_t *packet_data_start_ptr, uint8_t **packet_data_pptr, sn_coap_hdr_s *dst_coap_msg_ptr);
+static void     sn_coap_parser_init_options(sn_coap_options_list_s *options_ptr);
+static uint8_t *sn_coap_parser_options_get_value(struct coap_s *handle, uint8_t *value_ptr, uint16_t value_len);
+static sn_coap_hdr_s *sn_coap_parser_parse(struct coap_s *handle, uint16_t packet_data_len, uint8_t *packet_data_ptr, sn_coap_hdr_s *dst_coap_msg_ptr, coap_version_e *coap_version_ptr);
 
 sn_coap_hdr_s *sn_coap_parser_init_message(sn_coap_hdr_s *coap_msg_ptr)
 {
@@ -81,8 +84,8 @@ sn_coap_hdr_s *sn_coap_parser_alloc_message(struct coap_s *handle)
 
 sn_coap_options_list_s *sn_coap_parser_alloc_options(struct coap_s *handle, sn_coap_hdr_s *coap_msg_ptr)
 {
-    /* * * * Check given pointers * * * */
-    if (handle == NULL || coap_msg_ptr == NULL) {
+    /* * * * Check given pointer * * * */
+    if (coap_msg_ptr == NULL) {
         return NULL;
     }
 
@@ -91,6 +94,11 @@ sn_coap_options_list_s *sn_coap_parser_alloc_options(struct coap_s *handle, sn_c
         return coap_msg_ptr->options_list_ptr;
     }
 
+    /* * * * Without a handle, e.g. when parsing without copies, nothing is allocated * * * */
+    if (handle == NULL) {
+        return NULL;
+    }
+
     /* * * * Allocate memory for options and initialize allocated memory with with default values  * * * */
     coap_msg_ptr->options_list_ptr = handle->sn_coap_protocol_malloc(sizeof(sn_coap_options_list_s));
 
@@ -99,22 +107,13 @@ sn_coap_options_list_s *sn_coap_parser_alloc_options(struct coap_s *handle, sn_c
         return NULL;
     }
 
-    /* XXX not technically legal to memset pointers to 0 */
-    memset(coap_msg_ptr->options_list_ptr, 0x00, sizeof(sn_coap_options_list_s));
-
-    coap_msg_ptr->options_list_ptr->max_age = COAP_OPTION_MAX_AGE_DEFAULT;
-    coap_msg_ptr->options_list_ptr->uri_port = COAP_OPTION_URI_PORT_NONE;
-    coap_msg_ptr->options_list_ptr->observe = COAP_OBSERVE_NONE;
-    coap_msg_ptr->options_list_ptr->accept = COAP_CT_NONE;
-    coap_msg_ptr->options_list_ptr->block2 = COAP_OPTION_BLOCK_NONE;
-    coap_msg_ptr->options_list_ptr->block1 = COAP_OPTION_BLOCK_NONE;
+    sn_coap_parser_init_options(coap_msg_ptr->options_list_ptr);
 
     return coap_msg_ptr->options_list_ptr;
 }
 
 sn_coap_hdr_s *sn_coap_parser(struct coap_s *handle, uint16_t packet_data_len, uint8_t *packet_data_ptr, coap_version_e *coap_version_ptr)
 {
-    uint8_t       *data_temp_ptr                    = packet_data_ptr;
     sn_coap_hdr_s *parsed_and_returned_coap_msg_ptr = NULL;
 
     /* * * * Check given pointer * * * */
@@ -130,23 +129,58 @@ sn_coap_hdr_s *sn_coap_parser(struct coap_s *handle, uint16_t packet_data_len, u
         return NULL;
     }
 
+    return sn_coap_parser_parse(handle, packet_data_len, packet_data_ptr, parsed_and_returned_coap_msg_ptr, coap_version_ptr);
+}
+
+sn_coap_hdr_s *sn_coap_parser_zero_copy(uint16_t packet_data_len, uint8_t *packet_data_ptr, sn_coap_hdr_s *dst_coap_msg_ptr,
+                                        sn_coap_options_list_s *dst_options_ptr, coap_version_e *coap_version_ptr)
+{
+    /* * * * Check given pointer * * * */
+    if (packet_data_ptr == NULL || packet_data_len < 4 || dst_coap_msg_ptr == NULL) {
+        return NULL;
+    }
+
+    /* * * * Initialize CoAP message, options are only used if given  * * * */
+    sn_coap_parser_init_message(dst_coap_msg_ptr);
+
+    if (dst_options_ptr != NULL) {
+        sn_coap_parser_init_options(dst_options_ptr);
+        dst_coap_msg_ptr->options_list_ptr = dst_options_ptr;
+    }
+
+    return sn_coap_parser_parse(NULL, packet_data_len, packet_data_ptr, dst_coap_msg_ptr, coap_version_ptr);
+}
+
+/**
+ * \fn static sn_coap_hdr_s *sn_coap_parser_parse(struct coap_s *handle, uint16_t packet_data_len, uint8_t *packet_data_ptr, sn_coap_hdr_s *dst_coap_msg_ptr, coap_version_e *coap_version_ptr)
+ *
+ * \brief Parses CoAP message from given Packet data to an initialized message
+ *
+ * \param *handle Pointer to CoAP library handle, or NULL to leave option values in the Packet data
+ *
+ * \return Return value is dst_coap_msg_ptr, with coap_status set in failure case
+ */
+static sn_coap_hdr_s *sn_coap_parser_parse(struct coap_s *handle, uint16_t packet_data_len, uint8_t *packet_data_ptr, sn_coap_hdr_s *dst_coap_msg_ptr, coap_version_e *coap_version_ptr)
+{
+    uint8_t *data_temp_ptr = packet_data_ptr;
+
     /* * * * Header parsing, move pointer over the header...  * * * */
-    sn_coap_parser_header_parse(&data_temp_ptr, parsed_and_returned_coap_msg_ptr, coap_version_ptr);
+    sn_coap_parser_header_parse(&data_temp_ptr, dst_coap_msg_ptr, coap_version_ptr);
 
     /* * * * Options parsing, move pointer over the options... * * * */
-    if (sn_coap_parser_options_parse(handle, &data_temp_ptr, parsed_and_returned_coap_msg_ptr, packet_data_ptr, packet_data_len) != 0) {
-        parsed_and_returned_coap_msg_ptr->coap_status = COAP_STATUS_PARSER_ERROR_IN_HEADER;
-        return parsed_and_returned_coap_msg_ptr;
+    if (sn_coap_parser_options_parse(handle, &data_temp_ptr, dst_coap_msg_ptr, packet_data_ptr, packet_data_len) != 0) {
+        dst_coap_msg_ptr->coap_status = COAP_STATUS_PARSER_ERROR_IN_HEADER;
+        return dst_coap_msg_ptr;
     }
 
     /* * * * Payload parsing * * * */
-    if (sn_coap_parser_payload_parse(packet_data_len, packet_data_ptr, &data_temp_ptr, parsed_and_returned_coap_msg_ptr) == -1) {
-        parsed_and_returned_coap_msg_ptr->coap_status = COAP_STATUS_PARSER_ERROR_IN_HEADER;
-        return parsed_and_returned_coap_msg_ptr;
+    if (sn_coap_parser_payload_parse(packet_data_len, packet_data_ptr, &data_temp_ptr, dst_coap_msg_ptr) == -1) {
+        dst_coap_msg_ptr->coap_status = COAP_STATUS_PARSER_ERROR_IN_HEADER;
+        return dst_coap_msg_ptr;
     }
 
     /* * * * Return parsed CoAP message  * * * * */
-    return parsed_and_returned_coap_msg_ptr;
+    return dst_coap_msg_ptr;
 }
 
 void sn_coap_parser_release_allocated_coap_msg_mem(struct coap_s *handle, sn_coap_hdr_s *freed_coap_msg_ptr)
@@ -196,6 +230,24 @@ void sn_coap_parser_release_allocated_coap_msg_mem(struct coap_s *handle, sn_coa
     }
 }
 
+/**
+ * \fn static void sn_coap_parser_init_options(sn_coap_options_list_s *options_ptr)
+ *
+ * \brief Initializes options list structure with default values
+ */
+static void sn_coap_parser_init_options(sn_coap_options_list_s *options_ptr)
+{
+    /* XXX not technically legal to memset pointers to 0 */
+    memset(options_ptr, 0x00, sizeof(sn_coap_options_list_s));
+
+    options_ptr->max_age = COAP_OPTION_MAX_AGE_DEFAULT;
+    options_ptr->uri_port = COAP_OPTION_URI_PORT_NONE;
+    options_ptr->observe = COAP_OBSERVE_NONE;
+    options_ptr->accept = COAP_CT_NONE;
+    options_ptr->block2 = COAP_OPTION_BLOCK_NONE;
+    options_ptr->block1 = COAP_OPTION_BLOCK_NONE;
+}
+
 /**
  * \fn static void sn_coap_parser_header_parse(uint8_t **packet_data_pptr, sn_coap_hdr_s *dst_coap_msg_ptr, coap_version_e *coap_version_ptr)
  *
@@ -243,6 +295,31 @@ static uint32_t sn_coap_parser_options_parse_uint(uint8_t **packet_data_pptr, ui
     return value;
 }
 
+/**
+ * \brief Gets the value of an option
+ *
+ * \param *handle Pointer to CoAP library handle, or NULL to use the value in place
+ * \param *value_ptr is the option value in Packet data
+ * \param value_len is length of the option value
+ *
+ * \return Return value is pointer to the value, copied to allocated memory if
+ *         handle is given. NULL in allocation failure case.
+ */
+static uint8_t *sn_coap_parser_options_get_value(struct coap_s *handle, uint8_t *value_ptr, uint16_t value_len)
+{
+    uint8_t *dst_ptr;
+
+    if (handle == NULL) {
+        return value_ptr;
+    }
+
+    dst_ptr = handle->sn_coap_protocol_malloc(value_len);
+    if (dst_ptr != NULL) {
+        memcpy(dst_ptr, value_ptr, value_len);
+    }
+    return dst_ptr;
+}
+
 /**
  * \fn static uint8_t sn_coap_parser_options_parse(uint8_t **packet_data_pptr, sn_coap_hdr_s *dst_coap_msg_ptr)
  *
@@ -264,19 +341,19 @@ static int8_t sn_coap_parser_options_parse(struct coap_s *handle, uint8_t **pack
     dst_coap_msg_ptr->token_len = *packet_data_start_ptr & COAP_HEADER_TOKEN_LENGTH_MASK;
 
     if (dst_coap_msg_ptr->token_len) {
-        if ((dst_coap_msg_ptr->token_len > 8) || dst_coap_msg_ptr->token_ptr) {
+        if ((dst_coap_msg_ptr->token_len > 8) || dst_coap_msg_ptr->token_ptr ||
+                (dst_coap_msg_ptr->token_len > packet_len - COAP_HEADER_LENGTH)) {
             tr_error("sn_coap_parser_options_parse - token not valid!");
             return -1;
         }
 
-        dst_coap_msg_ptr->token_ptr = handle->sn_coap_protocol_malloc(dst_coap_msg_ptr->token_len);
+        dst_coap_msg_ptr->token_ptr = sn_coap_parser_options_get_value(handle, *packet_data_pptr, dst_coap_msg_ptr->token_len);
 
         if (dst_coap_msg_ptr->token_ptr == NULL) {
             tr_error("sn_coap_parser_options_parse - failed to allocate token!");
             return -1;
         }
 
-        memcpy(dst_coap_msg_ptr->token_ptr, *packet_data_pptr, dst_coap_msg_ptr->token_len);
         (*packet_data_pptr) += dst_coap_msg_ptr->token_len;
     }
 
@@ -291,6 +368,12 @@ static int8_t sn_coap_parser_options_parse(struct coap_s *handle, uint8_t **pack
         /* Resolve option delta */
         uint16_t  option_number = (**packet_data_pptr >> COAP_OPTIONS_OPTION_NUMBER_SHIFT);
 
+        /* Check that the extensions of the option header are within the message */
+        if (message_left < 1 + (option_number == 13) + 2 * (option_number == 14) + (option_len == 13) + 2 * (option_len == 14)) {
+            tr_error("sn_coap_parser_options_parse - option header overflow!");
+            return -1;
+        }
+
         if (option_number == 13) {
             option_number = *(*packet_data_pptr + 1) + 13;
             (*packet_data_pptr)++;
@@ -325,6 +408,12 @@ static int8_t sn_coap_parser_options_parse(struct coap_s *handle, uint8_t **pack
 
         message_left = packet_len - (*packet_data_pptr - packet_data_start_ptr);
 
+        /* Check that the option value, after the last header byte, is within the message */
+        if (option_len >= message_left) {
+            tr_error("sn_coap_parser_options_parse - option value overflow!");
+            return -1;
+        }
+
         /* * * Parse option itself * * */
         /* Some options are handled independently in own functions */
         previous_option_number = option_number;
@@ -379,14 +468,13 @@ static int8_t sn_coap_parser_options_parse(struct coap_s *handle, uint8_t **pack
                 dst_coap_msg_ptr->options_list_ptr->proxy_uri_len = option_len;
                 (*packet_data_pptr)++;
 
-                dst_coap_msg_ptr->options_list_ptr->proxy_uri_ptr = handle->sn_coap_protocol_malloc(option_len);
+                dst_coap_msg_ptr->options_list_ptr->proxy_uri_ptr = sn_coap_parser_options_get_value(handle, *packet_data_pptr, option_len);
 
                 if (dst_coap_msg_ptr->options_list_ptr->proxy_uri_ptr == NULL) {
                     tr_error("sn_coap_parser_options_parse - COAP_OPTION_PROXY_URI allocation failed!");
                     return -1;
                 }
 
-                memcpy(dst_coap_msg_ptr->options_list_ptr->proxy_uri_ptr, *packet_data_pptr, option_len);
                 (*packet_data_pptr) += option_len;
 
                 break;
@@ -415,13 +503,12 @@ static int8_t sn_coap_parser_options_parse(struct coap_s *handle, uint8_t **pack
                 dst_coap_msg_ptr->options_list_ptr->uri_host_len = option_len;
                 (*packet_data_pptr)++;
 
-                dst_coap_msg_ptr->options_list_ptr->uri_host_ptr = handle->sn_coap_protocol_malloc(option_len);
+                dst_coap_msg_ptr->options_list_ptr->uri_host_ptr = sn_coap_parser_options_get_value(handle, *packet_data_pptr, option_len);
 
                 if (dst_coap_msg_ptr->options_list_ptr->uri_host_ptr == NULL) {
                     tr_error("sn_coap_parser_options_parse - COAP_OPTION_URI_HOST allocation failed!");
                     return -1;
                 }
-                memcpy(dst_coap_msg_ptr->options_list_ptr->uri_host_ptr, *packet_data_pptr, option_len);
                 (*packet_data_pptr) += option_len;
 
                 break;
@@ -604,7 +691,12 @@ static int8_t sn_coap_parser_options_parse_multiple_options(struct coap_s *handl
     }
 
     if (uri_query_needed_heap) {
-        *dst_pptr = (uint8_t *) handle->sn_coap_protocol_malloc(uri_query_needed_heap);
+        /* Without a handle the parts are joined in place, over the headers of the options that follow the first one */
+        if (handle == NULL) {
+            *dst_pptr = *packet_data_pptr + 1;
+        } else {
+            *dst_pptr = (uint8_t *) handle->sn_coap_protocol_malloc(uri_query_needed_heap);
+        }
 
         if (*dst_pptr == NULL) {
             tr_error("sn_coap_parser_options_parse_multiple_options - failed to allocate options!");
@@ -639,7 +731,7 @@ static int8_t sn_coap_parser_options_parse_multiple_options(struct coap_s *handl
             return -1;
         }
 
-        memcpy(temp_parsed_uri_query_ptr, *packet_data_pptr, option_number_len);
+        memmove(temp_parsed_uri_query_ptr, *packet_data_pptr, option_number_len);
 
         (*packet_data_pptr) += option_number_len;
         temp_parsed_uri_query_ptr += option_number_len;
@@ -48,10 +48,13 @@
 /* * * * * * * * * * * * * * * * * * * * */
 
 static void                  sn_coap_protocol_send_rst(struct coap_s *handle, uint16_t msg_id, sn_nsdl_addr_s *addr_ptr, void *param);
+#if ENABLE_RESENDINGS || SN_COAP_DUPLICATION_MAX_MSGS_COUNT
+static uint16_t              sn_coap_protocol_hash(const uint8_t *addr_ptr, uint8_t addr_len, uint16_t port, uint16_t msg_id);
+#endif
 #if SN_COAP_DUPLICATION_MAX_MSGS_COUNT/* If Message duplication detection is not used at all, this part of code will not be compiled */
 static void                  sn_coap_protocol_linked_list_duplication_info_store(struct coap_s *handle, sn_nsdl_addr_s *src_addr_ptr, uint16_t msg_id, void *param);
 static coap_duplication_info_s *sn_coap_protocol_linked_list_duplication_info_search(struct coap_s *handle, sn_nsdl_addr_s *scr_addr_ptr, uint16_t msg_id);
-static void                  sn_coap_protocol_linked_list_duplication_info_remove(struct coap_s *handle, uint8_t *scr_addr_ptr, uint16_t port, uint16_t msg_id);
+static void                  sn_coap_protocol_linked_list_duplication_info_remove(struct coap_s *handle, coap_duplication_info_s *removed_duplication_info_ptr);
 static void                  sn_coap_protocol_linked_list_duplication_info_remove_old_ones(struct coap_s *handle);
 #endif
 #if SN_COAP_MAX_BLOCKWISE_PAYLOAD_SIZE /* If Message blockwising is not used at all, this part of code will not be compiled */
@@ -69,11 +72,13 @@ static sn_coap_hdr_s        *sn_coap_protocol_copy_header(struct coap_s *handle,
 #endif
 #if ENABLE_RESENDINGS
 static uint8_t               sn_coap_protocol_linked_list_send_msg_store(struct coap_s *handle, sn_nsdl_addr_s *dst_addr_ptr, uint16_t send_packet_data_len, uint8_t *send_packet_data_ptr, uint32_t sending_time, void *param);
-static sn_nsdl_transmit_s   *sn_coap_protocol_linked_list_send_msg_search(struct coap_s *handle,sn_nsdl_addr_s *src_addr_ptr, uint16_t msg_id);
-static void                  sn_coap_protocol_linked_list_send_msg_remove(struct coap_s *handle, sn_nsdl_addr_s *src_addr_ptr, uint16_t msg_id);
+static void                  sn_coap_protocol_linked_list_send_msg_queue(struct coap_s *handle, coap_send_msg_s *queued_msg_ptr);
+static coap_send_msg_s      *sn_coap_protocol_linked_list_send_msg_search(struct coap_s *handle,sn_nsdl_addr_s *src_addr_ptr, uint16_t msg_id);
+static void                  sn_coap_protocol_linked_list_send_msg_unlink(struct coap_s *handle, coap_send_msg_s *removed_msg_ptr);
+static void                  sn_coap_protocol_linked_list_send_msg_remove(struct coap_s *handle, coap_send_msg_s *removed_msg_ptr);
+static uint16_t              sn_coap_protocol_send_msg_id(const coap_send_msg_s *msg_ptr);
 static coap_send_msg_s      *sn_coap_protocol_allocate_mem_for_msg(struct coap_s *handle, sn_nsdl_addr_s *dst_addr_ptr, uint16_t packet_data_len);
 static void                  sn_coap_protocol_release_allocated_send_msg_mem(struct coap_s *handle, coap_send_msg_s *freed_send_msg_ptr);
-static uint16_t              sn_coap_count_linked_list_size(const coap_send_msg_list_t *linked_list_ptr);
 static uint32_t              sn_coap_calculate_new_resend_time(const uint32_t current_time, const uint8_t interval, const uint8_t counter);
 #endif
 
@@ -96,22 +101,7 @@ int8_t sn_coap_protocol_destroy(struct coap_s *handle)
 #if SN_COAP_DUPLICATION_MAX_MSGS_COUNT /* If Message duplication detection is not used at all, this part of code will not be compiled */
     ns_list_foreach_safe(coap_duplication_info_s, tmp, &handle->linked_list_duplication_msgs) {
         if (tmp->coap == handle) {
-            if (tmp->address) {
-                if (tmp->address->addr_ptr) {
-                    handle->sn_coap_protocol_free(tmp->address->addr_ptr);
-                    tmp->address->addr_ptr = 0;
-                }
-                handle->sn_coap_protocol_free(tmp->address);
-                tmp->address = 0;
-            }
-            if (tmp->packet_ptr) {
-                handle->sn_coap_protocol_free(tmp->packet_ptr);
-                tmp->packet_ptr = 0;
-            }
-            ns_list_remove(&handle->linked_list_duplication_msgs, tmp);
-            handle->count_duplication_msgs--;
-            handle->sn_coap_protocol_free(tmp);
-            tmp = 0;
+            sn_coap_protocol_linked_list_duplication_info_remove(handle, tmp);
         }
     }
 
@@ -311,9 +301,7 @@ void sn_coap_protocol_clear_retransmission_buffer(struct coap_s *handle)
         return;
     }
     ns_list_foreach_safe(coap_send_msg_s, tmp, &handle->linked_list_resent_msgs) {
-        ns_list_remove(&handle->linked_list_resent_msgs, tmp);
-        sn_coap_protocol_release_allocated_send_msg_mem(handle, tmp);
-        --handle->count_resent_msgs;
+        sn_coap_protocol_linked_list_send_msg_remove(handle, tmp);
     }
 #endif
 }
@@ -326,12 +314,8 @@ int8_t sn_coap_protocol_delete_retransmission(struct coap_s *handle, uint16_t ms
     }
     ns_list_foreach_safe(coap_send_msg_s, tmp, &handle->linked_list_resent_msgs) {
         if (tmp->send_msg_ptr && tmp->send_msg_ptr->packet_ptr ) {
-            uint16_t temp_msg_id = (tmp->send_msg_ptr->packet_ptr[2] << 8);
-            temp_msg_id += (uint16_t)tmp->send_msg_ptr->packet_ptr[3];
-            if(temp_msg_id == msg_id){
-                ns_list_remove(&handle->linked_list_resent_msgs, tmp);
-                --handle->count_resent_msgs;
-                sn_coap_protocol_release_allocated_send_msg_mem(handle, tmp);
+            if (sn_coap_protocol_send_msg_id(tmp) == msg_id) {
+                sn_coap_protocol_linked_list_send_msg_remove(handle, tmp);
                 return 0;
             }
         }
@@ -629,7 +613,10 @@ sn_coap_hdr_s *sn_coap_protocol_parse(struct coap_s *handle, sn_nsdl_addr_s *src
     if ((returned_dst_coap_msg_ptr->msg_type == COAP_MSG_TYPE_CONFIRMABLE ||
             returned_dst_coap_msg_ptr->msg_type == COAP_MSG_TYPE_NON_CONFIRMABLE) &&
             handle->sn_coap_duplication_buffer_size != 0) {
-        if (sn_coap_protocol_linked_list_duplication_info_search(handle, src_addr_ptr, returned_dst_coap_msg_ptr->msg_id) == NULL) {
+        coap_duplication_info_s* response = sn_coap_protocol_linked_list_duplication_info_search(handle,
+                                                                                                 src_addr_ptr,
+                                                                                                 returned_dst_coap_msg_ptr->msg_id);
+        if (response == NULL) {
             /* * * No Message duplication: Store received message for detecting later duplication * * */
 
             /* Get count of stored duplication messages */
@@ -637,14 +624,9 @@ sn_coap_hdr_s *sn_coap_protocol_parse(struct coap_s *handle, sn_nsdl_addr_s *src
 
             /* Check if there is no room to store message for duplication detection purposes */
             if (stored_duplication_msgs_count >= handle->sn_coap_duplication_buffer_size) {
-                /* Get oldest stored duplication message */
-                coap_duplication_info_s *stored_duplication_info_ptr = ns_list_get_first(&handle->linked_list_duplication_msgs);
-
                 /* Remove oldest stored duplication message for getting room for new duplication message */
                 sn_coap_protocol_linked_list_duplication_info_remove(handle,
-                                                                     stored_duplication_info_ptr->address->addr_ptr,
-                                                                     stored_duplication_info_ptr->address->port,
-                                                                     stored_duplication_info_ptr->msg_id);
+                                                                     ns_list_get_first(&handle->linked_list_duplication_msgs));
             }
 
             /* Store Duplication info to Linked list */
@@ -652,16 +634,11 @@ sn_coap_hdr_s *sn_coap_protocol_parse(struct coap_s *handle, sn_nsdl_addr_s *src
         } else { /* * * Message duplication detected * * */
             /* Set returned status to User */
             returned_dst_coap_msg_ptr->coap_status = COAP_STATUS_PARSER_DUPLICATED_MSG;
-            coap_duplication_info_s* response = sn_coap_protocol_linked_list_duplication_info_search(handle,
-                                                                                                     src_addr_ptr,
-                                                                                                     returned_dst_coap_msg_ptr->msg_id);
-            /* Send ACK response */
-            if (response) {
-                /* Check that response has been created */
-                if (response->packet_ptr) {
-                    response->coap->sn_coap_tx_callback(response->packet_ptr,
-                            response->packet_len, response->address, response->param);
-                }
+
+            /* Send ACK response, check that response has been created */
+            if (response->packet_ptr) {
+                response->coap->sn_coap_tx_callback(response->packet_ptr,
+                        response->packet_len, response->address, response->param);
             }
 
             return returned_dst_coap_msg_ptr;
@@ -735,14 +712,14 @@ sn_coap_hdr_s *sn_coap_protocol_parse(struct coap_s *handle, sn_nsdl_addr_s *src
 
         /* Check if there is ongoing active message resendings */
         if (stored_resending_msgs_count > 0) {
-            sn_nsdl_transmit_s *removed_msg_ptr = NULL;
+            coap_send_msg_s *removed_msg_ptr = NULL;
 
             /* Check if received message was confirmation for some active resending message */
             removed_msg_ptr = sn_coap_protocol_linked_list_send_msg_search(handle, src_addr_ptr, returned_dst_coap_msg_ptr->msg_id);
 
             if (removed_msg_ptr != NULL) {
                 /* Remove resending message from active message resending Linked list */
-                sn_coap_protocol_linked_list_send_msg_remove(handle, src_addr_ptr, returned_dst_coap_msg_ptr->msg_id);
+                sn_coap_protocol_linked_list_send_msg_remove(handle, removed_msg_ptr);
             }
         }
     }
@@ -773,59 +750,48 @@ int8_t sn_coap_protocol_exec(struct coap_s *handle, uint32_t current_time)
 #endif
 
 #if ENABLE_RESENDINGS
-    /* Check if there is ongoing active message sendings */
-    /* foreach_safe isn't sufficient because callback routine could cancel messages. */
-rescan:
-    ns_list_foreach(coap_send_msg_s, stored_msg_ptr, &handle->linked_list_resent_msgs) {
-        // First check that msg belongs to handle
-        if( stored_msg_ptr->coap == handle ){
-            /* Check if it is time to send this message */
-            if (current_time >= stored_msg_ptr->resending_time) {
-                /* * * Increase Resending counter  * * */
-                stored_msg_ptr->resending_counter++;
-
-                /* Check if all re-sendings have been done */
-                if (stored_msg_ptr->resending_counter > handle->sn_coap_resending_count) {
-                    coap_version_e coap_version = COAP_VERSION_UNKNOWN;
-
-                    /* Get message ID from stored sending message */
-                    uint16_t temp_msg_id = (stored_msg_ptr->send_msg_ptr->packet_ptr[2] << 8);
-                    temp_msg_id += (uint16_t)stored_msg_ptr->send_msg_ptr->packet_ptr[3];
-
-                    /* Remove message from Linked list */
-                    ns_list_remove(&handle->linked_list_resent_msgs, stored_msg_ptr);
-                    --handle->count_resent_msgs;
-
-                    /* If RX callback have been defined.. */
-                    if (stored_msg_ptr->coap->sn_coap_rx_callback != 0) {
-                        sn_coap_hdr_s *tmp_coap_hdr_ptr;
-                        /* Parse CoAP message, set status and call RX callback */
-                        tmp_coap_hdr_ptr = sn_coap_parser(stored_msg_ptr->coap, stored_msg_ptr->send_msg_ptr->packet_len, stored_msg_ptr->send_msg_ptr->packet_ptr, &coap_version);
-
-                        if (tmp_coap_hdr_ptr != 0) {
-                            tmp_coap_hdr_ptr->coap_status = COAP_STATUS_BUILDER_MESSAGE_SENDING_FAILED;
-                            stored_msg_ptr->coap->sn_coap_rx_callback(tmp_coap_hdr_ptr, stored_msg_ptr->send_msg_ptr->dst_addr_ptr, stored_msg_ptr->param);
-
-                            sn_coap_parser_release_allocated_coap_msg_mem(stored_msg_ptr->coap, tmp_coap_hdr_ptr);
-                        }
-                    }
-
-                    /* Free memory of stored message */
-                    sn_coap_protocol_release_allocated_send_msg_mem(handle, stored_msg_ptr);
-                } else {
-                    /* Send message  */
-                    stored_msg_ptr->coap->sn_coap_tx_callback(stored_msg_ptr->send_msg_ptr->packet_ptr,
-                            stored_msg_ptr->send_msg_ptr->packet_len, stored_msg_ptr->send_msg_ptr->dst_addr_ptr, stored_msg_ptr->param);
-
-                    /* * * Count new Resending time  * * */
-                    stored_msg_ptr->resending_time = sn_coap_calculate_new_resend_time(current_time,
-                                                                                       handle->sn_coap_resending_intervall,
-                                                                                       stored_msg_ptr->resending_counter);
+    /* Messages are kept in resending time order, so only the first ones can be due. */
+    /* The first message is taken again after each one because callback routine could cancel messages. */
+    coap_send_msg_s *stored_msg_ptr;
+    while ((stored_msg_ptr = ns_list_get_first(&handle->linked_list_resent_msgs)) != NULL &&
+            current_time >= stored_msg_ptr->resending_time) {
+        /* * * Increase Resending counter  * * */
+        stored_msg_ptr->resending_counter++;
+
+        /* Check if all re-sendings have been done */
+        if (stored_msg_ptr->resending_counter > handle->sn_coap_resending_count) {
+            coap_version_e coap_version = COAP_VERSION_UNKNOWN;
+
+            /* Remove message from Linked list */
+            sn_coap_protocol_linked_list_send_msg_unlink(handle, stored_msg_ptr);
+
+            /* If RX callback have been defined.. */
+            if (stored_msg_ptr->coap->sn_coap_rx_callback != 0) {
+                sn_coap_hdr_s *tmp_coap_hdr_ptr;
+                /* Parse CoAP message, set status and call RX callback */
+                tmp_coap_hdr_ptr = sn_coap_parser(stored_msg_ptr->coap, stored_msg_ptr->send_msg_ptr->packet_len, stored_msg_ptr->send_msg_ptr->packet_ptr, &coap_version);
+
+                if (tmp_coap_hdr_ptr != 0) {
+                    tmp_coap_hdr_ptr->coap_status = COAP_STATUS_BUILDER_MESSAGE_SENDING_FAILED;
+                    stored_msg_ptr->coap->sn_coap_rx_callback(tmp_coap_hdr_ptr, stored_msg_ptr->send_msg_ptr->dst_addr_ptr, stored_msg_ptr->param);
+
+                    sn_coap_parser_release_allocated_coap_msg_mem(stored_msg_ptr->coap, tmp_coap_hdr_ptr);
                 }
-                /* Callback routine could have wiped the list (eg as a response to sending failed) */
-                /* Be super cautious and rescan from the start */
-                goto rescan;
             }
+
+            /* Free memory of stored message */
+            sn_coap_protocol_release_allocated_send_msg_mem(handle, stored_msg_ptr);
+        } else {
+            /* * * Count new Resending time and move the message to its place in Linked list * * */
+            stored_msg_ptr->resending_time = sn_coap_calculate_new_resend_time(current_time,
+                                                                               handle->sn_coap_resending_intervall,
+                                                                               stored_msg_ptr->resending_counter);
+            ns_list_remove(&handle->linked_list_resent_msgs, stored_msg_ptr);
+            sn_coap_protocol_linked_list_send_msg_queue(handle, stored_msg_ptr);
+
+            /* Send message, it is not used after the callback which could remove it */
+            stored_msg_ptr->coap->sn_coap_tx_callback(stored_msg_ptr->send_msg_ptr->packet_ptr,
+                    stored_msg_ptr->send_msg_ptr->packet_len, stored_msg_ptr->send_msg_ptr->dst_addr_ptr, stored_msg_ptr->param);
         }
     }
 
@@ -874,7 +840,7 @@ static uint8_t sn_coap_protocol_linked_list_send_msg_store(struct coap_s *handle
 
     /* Count resending queue size, if buffer size is defined */
     if (handle->sn_coap_resending_queue_bytes > 0) {
-        if ((sn_coap_count_linked_list_size(&handle->linked_list_resent_msgs) + send_packet_data_len) > handle->sn_coap_resending_queue_bytes) {
+        if ((handle->size_resent_msgs + send_packet_data_len) > handle->sn_coap_resending_queue_bytes) {
             tr_error("sn_coap_protocol_linked_list_send_msg_store - resend buffer size reached!");
             return 0;
         }
@@ -906,16 +872,47 @@ static uint8_t sn_coap_protocol_linked_list_send_msg_store(struct coap_s *handle
     stored_msg_ptr->coap = handle;
     stored_msg_ptr->param = param;
 
-    /* Storing Resending message to Linked list */
-    ns_list_add_to_end(&handle->linked_list_resent_msgs, stored_msg_ptr);
+    /* Storing Resending message to Linked list and to its hash bucket */
+    sn_coap_protocol_linked_list_send_msg_queue(handle, stored_msg_ptr);
+
+    coap_send_msg_s **bucket_pptr = &handle->hash_resent_msgs[sn_coap_protocol_hash(dst_addr_ptr->addr_ptr, dst_addr_ptr->addr_len,
+                                                                                  dst_addr_ptr->port, sn_coap_protocol_send_msg_id(stored_msg_ptr))];
+    stored_msg_ptr->hash_next = *bucket_pptr;
+    *bucket_pptr = stored_msg_ptr;
+
     ++handle->count_resent_msgs;
+    handle->size_resent_msgs += send_packet_data_len;
     return 1;
 }
 
 /**************************************************************************//**
- * \fn static sn_nsdl_transmit_s *sn_coap_protocol_linked_list_send_msg_search(sn_nsdl_addr_s *src_addr_ptr, uint16_t msg_id)
+ * \fn static void sn_coap_protocol_linked_list_send_msg_queue(struct coap_s *handle, coap_send_msg_s *queued_msg_ptr)
  *
- * \brief Searches stored resending message from Linked list
+ * \brief Inserts message to Linked list in resending time order
+ *
+ * \param *queued_msg_ptr is message to be inserted, its resending time is set
+ *****************************************************************************/
+
+static void sn_coap_protocol_linked_list_send_msg_queue(struct coap_s *handle, coap_send_msg_s *queued_msg_ptr)
+{
+    /* New resending times are mostly the latest ones, so search from the end */
+    coap_send_msg_s *previous_msg_ptr = ns_list_get_last(&handle->linked_list_resent_msgs);
+
+    while (previous_msg_ptr != NULL && previous_msg_ptr->resending_time > queued_msg_ptr->resending_time) {
+        previous_msg_ptr = ns_list_get_previous(&handle->linked_list_resent_msgs, previous_msg_ptr);
+    }
+
+    if (previous_msg_ptr != NULL) {
+        ns_list_add_after(&handle->linked_list_resent_msgs, previous_msg_ptr, queued_msg_ptr);
+    } else {
+        ns_list_add_to_start(&handle->linked_list_resent_msgs, queued_msg_ptr);
+    }
+}
+
+/**************************************************************************//**
+ * \fn static coap_send_msg_s *sn_coap_protocol_linked_list_send_msg_search(struct coap_s *handle, sn_nsdl_addr_s *src_addr_ptr, uint16_t msg_id)
+ *
+ * \brief Searches stored resending message from its hash bucket
  *
  * \param *src_addr_ptr is searching key for searched message
  *
@@ -925,68 +922,77 @@ static uint8_t sn_coap_protocol_linked_list_send_msg_store(struct coap_s *handle
  *         list or NULL if message not found
  *****************************************************************************/
 
-static sn_nsdl_transmit_s *sn_coap_protocol_linked_list_send_msg_search(struct coap_s *handle,
+static coap_send_msg_s *sn_coap_protocol_linked_list_send_msg_search(struct coap_s *handle,
         sn_nsdl_addr_s *src_addr_ptr, uint16_t msg_id)
 {
-    /* Loop all stored resending messages Linked list */
-    ns_list_foreach(coap_send_msg_s, stored_msg_ptr, &handle->linked_list_resent_msgs) {
-        /* Get message ID from stored resending message */
-        uint16_t temp_msg_id = (stored_msg_ptr->send_msg_ptr->packet_ptr[2] << 8);
-        temp_msg_id += (uint16_t)stored_msg_ptr->send_msg_ptr->packet_ptr[3];
-
-        /* If message's Message ID is same than is searched */
-        if (temp_msg_id == msg_id) {
-            /* If message's Source address is same than is searched */
-            if (0 == memcmp(src_addr_ptr->addr_ptr, stored_msg_ptr->send_msg_ptr->dst_addr_ptr->addr_ptr, src_addr_ptr->addr_len)) {
-                /* If message's Source address port is same than is searched */
-                if (stored_msg_ptr->send_msg_ptr->dst_addr_ptr->port == src_addr_ptr->port) {
-                    /* * * Message found, return pointer to that stored resending message * * * */
-                    return stored_msg_ptr->send_msg_ptr;
-                }
-            }
+    coap_send_msg_s *stored_msg_ptr = handle->hash_resent_msgs[sn_coap_protocol_hash(src_addr_ptr->addr_ptr, src_addr_ptr->addr_len,
+                                                                                     src_addr_ptr->port, msg_id)];
+
+    /* Loop stored resending messages with the same hash */
+    for (; stored_msg_ptr != NULL; stored_msg_ptr = stored_msg_ptr->hash_next) {
+        sn_nsdl_addr_s *stored_addr_ptr = stored_msg_ptr->send_msg_ptr->dst_addr_ptr;
+
+        /* If message's Message ID, Source address and port are same than is searched */
+        if (sn_coap_protocol_send_msg_id(stored_msg_ptr) == msg_id &&
+                stored_addr_ptr->port == src_addr_ptr->port &&
+                stored_addr_ptr->addr_len == src_addr_ptr->addr_len &&
+                0 == memcmp(src_addr_ptr->addr_ptr, stored_addr_ptr->addr_ptr, src_addr_ptr->addr_len)) {
+            /* * * Message found, return pointer to that stored resending message * * * */
+            return stored_msg_ptr;
         }
     }
 
     /* Message not found */
     return NULL;
 }
+
 /**************************************************************************//**
- * \fn static void sn_coap_protocol_linked_list_send_msg_remove(sn_nsdl_addr_s *src_addr_ptr, uint16_t msg_id)
+ * \fn static void sn_coap_protocol_linked_list_send_msg_unlink(struct coap_s *handle, coap_send_msg_s *removed_msg_ptr)
  *
- * \brief Removes stored resending message from Linked list
+ * \brief Removes stored resending message from Linked list and its hash bucket,
+ *        without freeing it
  *
- * \param *src_addr_ptr is searching key for searched message
- * \param msg_id is searching key for removed message
+ * \param *removed_msg_ptr is message to be removed
  *****************************************************************************/
 
-static void sn_coap_protocol_linked_list_send_msg_remove(struct coap_s *handle, sn_nsdl_addr_s *src_addr_ptr, uint16_t msg_id)
+static void sn_coap_protocol_linked_list_send_msg_unlink(struct coap_s *handle, coap_send_msg_s *removed_msg_ptr)
 {
-    /* Loop all stored resending messages in Linked list */
-    ns_list_foreach(coap_send_msg_s, stored_msg_ptr, &handle->linked_list_resent_msgs) {
-        /* Get message ID from stored resending message */
-        uint16_t temp_msg_id = (stored_msg_ptr->send_msg_ptr->packet_ptr[2] << 8);
-        temp_msg_id += (uint16_t)stored_msg_ptr->send_msg_ptr->packet_ptr[3];
-
-        /* If message's Message ID is same than is searched */
-        if (temp_msg_id == msg_id) {
-            /* If message's Source address is same than is searched */
-            if (0 == memcmp(src_addr_ptr->addr_ptr, stored_msg_ptr->send_msg_ptr->dst_addr_ptr->addr_ptr, src_addr_ptr->addr_len)) {
-                /* If message's Source address port is same than is searched */
-                if (stored_msg_ptr->send_msg_ptr->dst_addr_ptr->port == src_addr_ptr->port) {
-                    /* * * Message found * * */
-
-                    /* Remove message from Linked list */
-                    ns_list_remove(&handle->linked_list_resent_msgs, stored_msg_ptr);
-                    --handle->count_resent_msgs;
-
-                    /* Free memory of stored message */
-                    sn_coap_protocol_release_allocated_send_msg_mem(handle, stored_msg_ptr);
-
-                    return;
-                }
-            }
-        }
+    sn_nsdl_addr_s *addr_ptr = removed_msg_ptr->send_msg_ptr->dst_addr_ptr;
+    coap_send_msg_s **link_pptr = &handle->hash_resent_msgs[sn_coap_protocol_hash(addr_ptr->addr_ptr, addr_ptr->addr_len,
+                                                                                   addr_ptr->port, sn_coap_protocol_send_msg_id(removed_msg_ptr))];
+
+    while (*link_pptr != NULL && *link_pptr != removed_msg_ptr) {
+        link_pptr = &(*link_pptr)->hash_next;
+    }
+    if (*link_pptr != NULL) {
+        *link_pptr = removed_msg_ptr->hash_next;
     }
+
+    ns_list_remove(&handle->linked_list_resent_msgs, removed_msg_ptr);
+    --handle->count_resent_msgs;
+    handle->size_resent_msgs -= removed_msg_ptr->send_msg_ptr->packet_len;
+}
+
+/**************************************************************************//**
+ * \fn static void sn_coap_protocol_linked_list_send_msg_remove(struct coap_s *handle, coap_send_msg_s *removed_msg_ptr)
+ *
+ * \brief Removes stored resending message from Linked list and frees it
+ *
+ * \param *removed_msg_ptr is message to be removed
+ *****************************************************************************/
+
+static void sn_coap_protocol_linked_list_send_msg_remove(struct coap_s *handle, coap_send_msg_s *removed_msg_ptr)
+{
+    sn_coap_protocol_linked_list_send_msg_unlink(handle, removed_msg_ptr);
+
+    /* Free memory of stored message */
+    sn_coap_protocol_release_allocated_send_msg_mem(handle, removed_msg_ptr);
+}
+
+static uint16_t sn_coap_protocol_send_msg_id(const coap_send_msg_s *msg_ptr)
+{
+    /* Message ID is in the 3rd and 4th bytes of stored Packet data */
+    return (msg_ptr->send_msg_ptr->packet_ptr[2] << 8) | msg_ptr->send_msg_ptr->packet_ptr[3];
 }
 
 uint32_t sn_coap_calculate_new_resend_time(const uint32_t current_time, const uint8_t interval, const uint8_t counter)
@@ -1017,6 +1023,37 @@ static void sn_coap_protocol_send_rst(struct coap_s *handle, uint16_t msg_id, sn
     handle->sn_coap_tx_callback(packet_ptr, 4, addr_ptr, param);
 
 }
+
+#if ENABLE_RESENDINGS || SN_COAP_DUPLICATION_MAX_MSGS_COUNT
+/**************************************************************************//**
+ * \fn static uint16_t sn_coap_protocol_hash(const uint8_t *addr_ptr, uint8_t addr_len, uint16_t port, uint16_t msg_id)
+ *
+ * \brief Counts hash bucket of a message (FNV-1a of address, port and Message ID)
+ *
+ * \param *addr_ptr is pointer to Address of the message
+ * \param addr_len is length of Address
+ * \param port is Port of the message
+ * \param msg_id is Message ID of the message
+ *
+ * \return Return value is index of the hash bucket, less than SN_COAP_HASH_BUCKETS
+ *****************************************************************************/
+
+static uint16_t sn_coap_protocol_hash(const uint8_t *addr_ptr, uint8_t addr_len, uint16_t port, uint16_t msg_id)
+{
+    const uint8_t key[4] = {port >> 8, (uint8_t)port, msg_id >> 8, (uint8_t)msg_id};
+    uint32_t hash = 2166136261u;
+
+    for (uint8_t i = 0; i < addr_len; i++) {
+        hash = (hash ^ addr_ptr[i]) * 16777619u;
+    }
+    for (uint8_t i = 0; i < sizeof(key); i++) {
+        hash = (hash ^ key[i]) * 16777619u;
+    }
+
+    /* Fold the upper bits, FNV mixes them better than the lower ones */
+    return (hash ^ (hash >> 16)) & (SN_COAP_HASH_BUCKETS - 1);
+}
+#endif
 #if SN_COAP_DUPLICATION_MAX_MSGS_COUNT /* If Message duplication detection is not used at all, this part of code will not be compiled */
 
 /**************************************************************************//**
@@ -1075,85 +1112,84 @@ static void sn_coap_protocol_linked_list_duplication_info_store(struct coap_s *h
     stored_duplication_info_ptr->coap = handle;
 
     stored_duplication_info_ptr->param = param;
-    /* * * * Storing Duplication info to Linked list * * * */
+    /* * * * Storing Duplication info to Linked list and to its hash bucket * * * */
 
     ns_list_add_to_end(&handle->linked_list_duplication_msgs, stored_duplication_info_ptr);
+
+    coap_duplication_info_s **bucket_pptr = &handle->hash_duplication_msgs[sn_coap_protocol_hash(addr_ptr->addr_ptr, addr_ptr->addr_len,
+                                                                                              addr_ptr->port, msg_id)];
+    stored_duplication_info_ptr->hash_next = *bucket_pptr;
+    *bucket_pptr = stored_duplication_info_ptr;
+
     ++handle->count_duplication_msgs;
 }
 
 /**************************************************************************//**
- * \fn static int8_t sn_coap_protocol_linked_list_duplication_info_search(sn_nsdl_addr_s *addr_ptr, uint16_t msg_id)
+ * \fn static coap_duplication_info_s *sn_coap_protocol_linked_list_duplication_info_search(struct coap_s *handle, sn_nsdl_addr_s *addr_ptr, uint16_t msg_id)
  *
- * \brief Searches stored message from Linked list (Address and Message ID as key)
+ * \brief Searches stored message from its hash bucket (Address and Message ID as key)
  *
  * \param *addr_ptr is pointer to Address key to be searched
  * \param msg_id is Message ID key to be searched
  *
- * \return Return value is 0 when message found and -1 if not found
+ * \return Return value is pointer to found Duplication info or NULL if not found
  *****************************************************************************/
 
 static coap_duplication_info_s* sn_coap_protocol_linked_list_duplication_info_search(struct coap_s *handle,
         sn_nsdl_addr_s *addr_ptr, uint16_t msg_id)
 {
-    /* Loop all nodes in Linked list for searching Message ID */
-    ns_list_foreach(coap_duplication_info_s, stored_duplication_info_ptr, &handle->linked_list_duplication_msgs) {
-        /* If message's Message ID is same than is searched */
-        if (stored_duplication_info_ptr->msg_id == msg_id) {
-            /* If message's Source address is same than is searched */
-            if (0 == memcmp(addr_ptr->addr_ptr, stored_duplication_info_ptr->address->addr_ptr, addr_ptr->addr_len)) {
-                /* If message's Source address port is same than is searched */
-                if (stored_duplication_info_ptr->address->port == addr_ptr->port) {
-                    /* * * Correct Duplication info found * * * */
-                    return stored_duplication_info_ptr;
-                }
-            }
+    coap_duplication_info_s *stored_duplication_info_ptr = handle->hash_duplication_msgs[sn_coap_protocol_hash(addr_ptr->addr_ptr, addr_ptr->addr_len,
+                                                                                                               addr_ptr->port, msg_id)];
+
+    /* Loop stored Duplication infos with the same hash */
+    for (; stored_duplication_info_ptr != NULL; stored_duplication_info_ptr = stored_duplication_info_ptr->hash_next) {
+        sn_nsdl_addr_s *stored_addr_ptr = stored_duplication_info_ptr->address;
+
+        /* If message's Message ID, Source address and port are same than is searched */
+        if (stored_duplication_info_ptr->msg_id == msg_id &&
+                stored_addr_ptr->port == addr_ptr->port &&
+                stored_addr_ptr->addr_len == addr_ptr->addr_len &&
+                0 == memcmp(addr_ptr->addr_ptr, stored_addr_ptr->addr_ptr, addr_ptr->addr_len)) {
+            /* * * Correct Duplication info found * * * */
+            return stored_duplication_info_ptr;
         }
     }
     return NULL;
 }
 
 /**************************************************************************//**
- * \fn static void sn_coap_protocol_linked_list_duplication_info_remove(struct coap_s *handle, uint8_t *addr_ptr, uint16_t port, uint16_t msg_id)
- *
- * \brief Removes stored Duplication info from Linked list
+ * \fn static void sn_coap_protocol_linked_list_duplication_info_remove(struct coap_s *handle, coap_duplication_info_s *removed_duplication_info_ptr)
  *
- * \param *addr_ptr is pointer to Address key to be removed
+ * \brief Removes stored Duplication info from Linked list and its hash bucket and frees it
  *
- * \param port is Port key to be removed
- *
- * \param msg_id is Message ID key to be removed
+ * \param *removed_duplication_info_ptr is Duplication info to be removed
  *****************************************************************************/
 
-static void sn_coap_protocol_linked_list_duplication_info_remove(struct coap_s *handle, uint8_t *addr_ptr, uint16_t port, uint16_t msg_id)
+static void sn_coap_protocol_linked_list_duplication_info_remove(struct coap_s *handle, coap_duplication_info_s *removed_duplication_info_ptr)
 {
-    /* Loop all stored duplication messages in Linked list */
-    ns_list_foreach(coap_duplication_info_s, removed_duplication_info_ptr, &handle->linked_list_duplication_msgs) {
-        /* If message's Address is same than is searched */
-        if (handle == removed_duplication_info_ptr->coap && 0 == memcmp(addr_ptr,
-                                                                        removed_duplication_info_ptr->address->addr_ptr,
-                                                                        removed_duplication_info_ptr->address->addr_len)) {
-            /* If message's Address prt is same than is searched */
-            if (removed_duplication_info_ptr->address->port == port) {
-                /* If Message ID is same than is searched */
-                if (removed_duplication_info_ptr->msg_id == msg_id) {
-                    /* * * * Correct Duplication info found, remove it from Linked list * * * */
-                    ns_list_remove(&handle->linked_list_duplication_msgs, removed_duplication_info_ptr);
-                    --handle->count_duplication_msgs;
-
-                    /* Free memory of stored Duplication info */
-                    handle->sn_coap_protocol_free(removed_duplication_info_ptr->address->addr_ptr);
-                    removed_duplication_info_ptr->address->addr_ptr = 0;
-                    handle->sn_coap_protocol_free(removed_duplication_info_ptr->address);
-                    removed_duplication_info_ptr->address = 0;
-                    handle->sn_coap_protocol_free(removed_duplication_info_ptr->packet_ptr);
-                    removed_duplication_info_ptr->packet_ptr = 0;
-                    handle->sn_coap_protocol_free(removed_duplication_info_ptr);
-                    removed_duplication_info_ptr = 0;
-                    return;
-                }
-            }
-        }
+    sn_nsdl_addr_s *addr_ptr = removed_duplication_info_ptr->address;
+    coap_duplication_info_s **link_pptr = &handle->hash_duplication_msgs[sn_coap_protocol_hash(addr_ptr->addr_ptr, addr_ptr->addr_len,
+                                                                                            addr_ptr->port, removed_duplication_info_ptr->msg_id)];
+
+    while (*link_pptr != NULL && *link_pptr != removed_duplication_info_ptr) {
+        link_pptr = &(*link_pptr)->hash_next;
+    }
+    if (*link_pptr != NULL) {
+        *link_pptr = removed_duplication_info_ptr->hash_next;
     }
+
+    ns_list_remove(&handle->linked_list_duplication_msgs, removed_duplication_info_ptr);
+    --handle->count_duplication_msgs;
+
+    /* Free memory of stored Duplication info */
+    handle->sn_coap_protocol_free(removed_duplication_info_ptr->address->addr_ptr);
+    removed_duplication_info_ptr->address->addr_ptr = 0;
+    handle->sn_coap_protocol_free(removed_duplication_info_ptr->address);
+    removed_duplication_info_ptr->address = 0;
+    handle->sn_coap_protocol_free(removed_duplication_info_ptr->packet_ptr);
+    removed_duplication_info_ptr->packet_ptr = 0;
+    handle->sn_coap_protocol_free(removed_duplication_info_ptr);
+    removed_duplication_info_ptr = 0;
 }
 
 /**************************************************************************//**
@@ -1164,23 +1200,13 @@ static void sn_coap_protocol_linked_list_duplication_info_remove(struct coap_s *
 
 static void sn_coap_protocol_linked_list_duplication_info_remove_old_ones(struct coap_s *handle)
 {
-    /* Loop all stored duplication messages in Linked list */
-    ns_list_foreach_safe(coap_duplication_info_s, removed_duplication_info_ptr, &handle->linked_list_duplication_msgs) {
-        if ((handle->system_time - removed_duplication_info_ptr->timestamp)  > SN_COAP_DUPLICATION_MAX_TIME_MSGS_STORED) {
-            /* * * * Old Duplication info found, remove it from Linked list * * * */
-            ns_list_remove(&handle->linked_list_duplication_msgs, removed_duplication_info_ptr);
-            --handle->count_duplication_msgs;
-
-            /* Free memory of stored Duplication info */
-            handle->sn_coap_protocol_free(removed_duplication_info_ptr->address->addr_ptr);
-            removed_duplication_info_ptr->address->addr_ptr = 0;
-            handle->sn_coap_protocol_free(removed_duplication_info_ptr->address);
-            removed_duplication_info_ptr->address = 0;
-            handle->sn_coap_protocol_free(removed_duplication_info_ptr->packet_ptr);
-            removed_duplication_info_ptr->packet_ptr = 0;
-            handle->sn_coap_protocol_free(removed_duplication_info_ptr);
-            removed_duplication_info_ptr = 0;
-        }
+    coap_duplication_info_s *removed_duplication_info_ptr;
+
+    /* Infos are stored in timestamp order, so the old ones are at the start of Linked list */
+    while ((removed_duplication_info_ptr = ns_list_get_first(&handle->linked_list_duplication_msgs)) != NULL &&
+            (handle->system_time - removed_duplication_info_ptr->timestamp) > SN_COAP_DUPLICATION_MAX_TIME_MSGS_STORED) {
+        /* * * * Old Duplication info found, remove it from Linked list * * * */
+        sn_coap_protocol_linked_list_duplication_info_remove(handle, removed_duplication_info_ptr);
     }
 }
 
@@ -1420,30 +1446,28 @@ static uint32_t sn_coap_protocol_linked_list_blockwise_payloads_get_len(struct c
 
 static void sn_coap_protocol_linked_list_blockwise_remove_old_data(struct coap_s *handle)
 {
-    /* Loop all stored Blockwise messages in Linked list */
-    ns_list_foreach_safe(coap_blockwise_msg_s, removed_blocwise_msg_ptr, &handle->linked_list_blockwise_sent_msgs) {
-        if ((handle->system_time - removed_blocwise_msg_ptr->timestamp)  > SN_COAP_BLOCKWISE_MAX_TIME_DATA_STORED) {
-            //TODO: Check do we need to check handle == removed_blocwise_msg_ptr->coap here?
-
-            /* * * * Old Blockise message found, remove it from Linked list * * * */
-            if( removed_blocwise_msg_ptr->coap_msg_ptr ){
-                if(removed_blocwise_msg_ptr->coap_msg_ptr->payload_ptr){
-                    handle->sn_coap_protocol_free(removed_blocwise_msg_ptr->coap_msg_ptr->payload_ptr);
-                    removed_blocwise_msg_ptr->coap_msg_ptr->payload_ptr = 0;
-                }
-                sn_coap_parser_release_allocated_coap_msg_mem(handle, removed_blocwise_msg_ptr->coap_msg_ptr);
-                removed_blocwise_msg_ptr->coap_msg_ptr = 0;
+    coap_blockwise_msg_s *removed_blocwise_msg_ptr;
+    coap_blockwise_payload_s *removed_blocwise_payload_ptr;
+
+    /* Messages and payloads are stored in timestamp order, so the old ones are at the start of Linked lists */
+    while ((removed_blocwise_msg_ptr = ns_list_get_first(&handle->linked_list_blockwise_sent_msgs)) != NULL &&
+            (handle->system_time - removed_blocwise_msg_ptr->timestamp) > SN_COAP_BLOCKWISE_MAX_TIME_DATA_STORED) {
+        /* * * * Old Blockise message found, remove it from Linked list * * * */
+        if( removed_blocwise_msg_ptr->coap_msg_ptr ){
+            if(removed_blocwise_msg_ptr->coap_msg_ptr->payload_ptr){
+                handle->sn_coap_protocol_free(removed_blocwise_msg_ptr->coap_msg_ptr->payload_ptr);
+                removed_blocwise_msg_ptr->coap_msg_ptr->payload_ptr = 0;
             }
-            sn_coap_protocol_linked_list_blockwise_msg_remove(handle, removed_blocwise_msg_ptr);
+            sn_coap_parser_release_allocated_coap_msg_mem(handle, removed_blocwise_msg_ptr->coap_msg_ptr);
+            removed_blocwise_msg_ptr->coap_msg_ptr = 0;
         }
+        sn_coap_protocol_linked_list_blockwise_msg_remove(handle, removed_blocwise_msg_ptr);
     }
 
-    /* Loop all stored Blockwise payloads in Linked list */
-    ns_list_foreach_safe(coap_blockwise_payload_s, removed_blocwise_payload_ptr, &handle->linked_list_blockwise_received_payloads) {
-        if ((handle->system_time - removed_blocwise_payload_ptr->timestamp)  > SN_COAP_BLOCKWISE_MAX_TIME_DATA_STORED) {
-            /* * * * Old Blockise payload found, remove it from Linked list * * * */
-            sn_coap_protocol_linked_list_blockwise_payload_remove(handle, removed_blocwise_payload_ptr);
-        }
+    while ((removed_blocwise_payload_ptr = ns_list_get_first(&handle->linked_list_blockwise_received_payloads)) != NULL &&
+            (handle->system_time - removed_blocwise_payload_ptr->timestamp) > SN_COAP_BLOCKWISE_MAX_TIME_DATA_STORED) {
+        /* * * * Old Blockise payload found, remove it from Linked list * * * */
+        sn_coap_protocol_linked_list_blockwise_payload_remove(handle, removed_blocwise_payload_ptr);
     }
 }
 
@@ -1520,26 +1544,6 @@ static void sn_coap_protocol_release_allocated_send_msg_mem(struct coap_s *handl
     }
 }
 
-/**************************************************************************//**
- * \fn static uint16_t sn_coap_count_linked_list_size(const coap_send_msg_list_t *linked_list_ptr)
- *
- * \brief Counts total message size of all messages in linked list
- *
- * \param const coap_send_msg_list_t *linked_list_ptr pointer to linked list
- *****************************************************************************/
-static uint16_t sn_coap_count_linked_list_size(const coap_send_msg_list_t *linked_list_ptr)
-{
-    uint16_t total_size = 0;
-
-    ns_list_foreach(coap_send_msg_s, stored_msg_ptr, linked_list_ptr) {
-        if (stored_msg_ptr->send_msg_ptr) {
-            total_size += stored_msg_ptr->send_msg_ptr->packet_len;
-        }
-    }
-
-    return total_size;
-}
-
 #endif
 
 #if SN_COAP_MAX_BLOCKWISE_PAYLOAD_SIZE
@@ -31,15 +31,29 @@ typedef struct {
     ns_list_link_t link;
 } hole_t;
 
+typedef NS_LIST_HEAD(hole_t, link) hole_list_t;
+
 typedef int ns_mem_word_size_t; // internal signed heap block size type
 
+#ifdef NS_DYN_MEM_SIZE_CLASSES
+// Holes are kept in one list per size class, each power of two range of
+// sizes in words is split in two classes. Heaps below 64KiB have holes
+// of less than 2^14 words, which need 27 classes.
+#define NS_MEM_SIZE_CLASSES 27
+#endif
+
 /* struct for book keeping variables */
 struct ns_mem_book {
     ns_mem_word_size_t     *heap_main;
     ns_mem_word_size_t     *heap_main_end;
     mem_stat_t *mem_stat_info_ptr;
     void (*heap_failure_callback)(heap_fail_t);
-    NS_LIST_HEAD(hole_t, link) holes_list;
+#ifdef NS_DYN_MEM_SIZE_CLASSES
+    hole_list_t holes_list[NS_MEM_SIZE_CLASSES];
+    uint32_t holes_map; // bit set for each class with holes
+#else
+    hole_list_t holes_list;
+#endif
     ns_mem_heap_size_t heap_size;
 };
 
@@ -65,6 +79,74 @@ static void heap_failure(ns_mem_book_t *book, heap_fail_t reason)
     }
 }
 
+#ifdef NS_DYN_MEM_SIZE_CLASSES
+static uint8_t ns_mem_size_class(ns_mem_word_size_t size)
+{
+    uint8_t log2 = 0;
+    while (size >> (log2 + 1)) {
+        log2++;
+    }
+    if (log2 == 0) {
+        return 0;
+    }
+    // Upper or lower half of the power of two range
+    return 2 * log2 - 1 + ((size >> (log2 - 1)) & 1);
+}
+
+// Each class is kept in address order, like the single list, so that
+// temporary allocations are taken from the bottom of the heap and long period
+// ones from the top.
+static void ns_mem_hole_add(ns_mem_book_t *book, ns_mem_word_size_t *block_start, hole_t *before)
+{
+    (void)before;
+    uint8_t size_class = ns_mem_size_class(-*block_start);
+    hole_t *hole = hole_from_block_start(block_start);
+
+    ns_list_foreach(hole_t, ptr, &book->holes_list[size_class]) {
+        if (ptr > hole) {
+            ns_list_add_before(&book->holes_list[size_class], ptr, hole);
+            book->holes_map |= (uint32_t)1 << size_class;
+            return;
+        }
+    }
+    ns_list_add_to_end(&book->holes_list[size_class], hole);
+    book->holes_map |= (uint32_t)1 << size_class;
+}
+
+static hole_t *ns_mem_hole_remove(ns_mem_book_t *book, ns_mem_word_size_t *block_start)
+{
+    uint8_t size_class = ns_mem_size_class(-*block_start);
+
+    ns_list_remove(&book->holes_list[size_class], hole_from_block_start(block_start));
+    if (ns_list_is_empty(&book->holes_list[size_class])) {
+        book->holes_map &= ~((uint32_t)1 << size_class);
+    }
+    return NULL;
+}
+#else
+// Holes are kept in address order, "before" is the hole following the new
+// one or NULL if it is the last
+static void ns_mem_hole_add(ns_mem_book_t *book, ns_mem_word_size_t *block_start, hole_t *before)
+{
+    if (before) {
+        ns_list_add_before(&book->holes_list, before, hole_from_block_start(block_start));
+    } else {
+        ns_list_add_to_end(&book->holes_list, hole_from_block_start(block_start));
+    }
+}
+
+// Returns the hole that followed the removed one, to add its replacement
+// in the same position
+static hole_t *ns_mem_hole_remove(ns_mem_book_t *book, ns_mem_word_size_t *block_start)
+{
+    hole_t *hole = hole_from_block_start(block_start);
+    hole_t *next = ns_list_get_next(&book->holes_list, hole);
+
+    ns_list_remove(&book->holes_list, hole);
+    return next;
+}
+#endif
+
 #endif
 
 void ns_dyn_mem_init(void *heap, ns_mem_heap_size_t h_size,
@@ -115,8 +197,15 @@ ns_mem_book_t *ns_mem_init(void *heap, ns_mem_heap_size_t h_size,
     *ptr = -(temp_int);
     book->heap_main_end = ptr;
 
+#ifdef NS_DYN_MEM_SIZE_CLASSES
+    for (int i = 0; i < NS_MEM_SIZE_CLASSES; i++) {
+        ns_list_init(&book->holes_list[i]);
+    }
+    book->holes_map = 0;
+#else
     ns_list_init(&book->holes_list);
-    ns_list_add_to_start(&book->holes_list, hole_from_block_start(book->heap_main));
+#endif
+    ns_mem_hole_add(book, book->heap_main, NULL);
 
     book->mem_stat_info_ptr = info_ptr;
     //RESET Memory by Hea Len
@@ -191,6 +280,82 @@ static int8_t ns_mem_block_validate(ns_mem_word_size_t *block_start, int directi
     }
     return ret_val;
 }
+
+// Checks a hole found in the holes list
+static bool ns_mem_hole_validate(ns_mem_book_t *book, ns_mem_word_size_t *block_start, int direction)
+{
+    if (ns_mem_block_validate(block_start, direction) != 0 || *block_start >= 0) {
+        //Validation failed, or this supposed hole has positive (allocated) size
+        heap_failure(book, NS_DYN_MEM_HEAP_SECTOR_CORRUPTED);
+        return false;
+    }
+    return true;
+}
+
+// Finds the first hole of at least data_size words in a list, stopping at
+// "limit" if not NULL, returns NULL if there is none
+// For direction, use 1 for direction up and -1 for down
+static ns_mem_word_size_t *ns_mem_hole_first_fit(ns_mem_book_t *book, hole_list_t *holes_list, ns_mem_word_size_t data_size, int direction, hole_t *limit)
+{
+    // ns_list_foreach, either forwards or backwards, result to ptr
+    for (hole_t *cur_hole = direction > 0 ? ns_list_get_first(holes_list)
+                                          : ns_list_get_last(holes_list);
+         cur_hole;
+         cur_hole = direction > 0 ? ns_list_get_next(holes_list, cur_hole)
+                                  : ns_list_get_previous(holes_list, cur_hole)
+        ) {
+        if (limit && (direction > 0 ? cur_hole > limit : cur_hole < limit)) {
+            break;
+        }
+        ns_mem_word_size_t *p = block_start_from_hole(cur_hole);
+        if (!ns_mem_hole_validate(book, p, direction)) {
+            break;
+        }
+        if (-*p >= data_size) {
+            // Found a big enough block
+            return p;
+        }
+    }
+
+    return NULL;
+}
+
+// Finds the first hole of at least data_size words, from the bottom of the
+// heap for direction up and from the top for down, NULL if there is none
+// For direction, use 1 for direction up and -1 for down
+static ns_mem_word_size_t *ns_mem_hole_find(ns_mem_book_t *book, ns_mem_word_size_t data_size, int direction)
+{
+#ifdef NS_DYN_MEM_SIZE_CLASSES
+    // Any hole in the classes above the one of the requested size is big
+    // enough, as the classes are in address order the first of them is at
+    // the start or the end of one of these classes
+    uint8_t size_class = ns_mem_size_class(data_size);
+    hole_t *first = NULL;
+    uint32_t map = book->holes_map >> (size_class + 1);
+    for (uint8_t i = size_class + 1; map; i++, map >>= 1) {
+        if (map & 1) {
+            hole_t *hole = direction > 0 ? ns_list_get_first(&book->holes_list[i])
+                                         : ns_list_get_last(&book->holes_list[i]);
+            if (!first || (direction > 0 ? hole < first : hole > first)) {
+                first = hole;
+            }
+        }
+    }
+
+    // Unless there is a big enough hole before it in the class of the
+    // requested size
+    ns_mem_word_size_t *p = ns_mem_hole_first_fit(book, &book->holes_list[size_class], data_size, direction, first);
+    if (!p && first) {
+        p = block_start_from_hole(first);
+        if (!ns_mem_hole_validate(book, p, direction)) {
+            p = NULL;
+        }
+    }
+    return p;
+#else
+    return ns_mem_hole_first_fit(book, &book->holes_list, data_size, direction, NULL);
+#endif
+}
 #endif
 
 // For direction, use 1 for direction up and -1 for down
@@ -212,60 +377,34 @@ static void *ns_mem_internal_alloc(ns_mem_book_t *book, const ns_mem_block_size_
         goto done;
     }
 
-    // ns_list_foreach, either forwards or backwards, result to ptr
-    for (hole_t *cur_hole = direction > 0 ? ns_list_get_first(&book->holes_list)
-                                          : ns_list_get_last(&book->holes_list);
-         cur_hole;
-         cur_hole = direction > 0 ? ns_list_get_next(&book->holes_list, cur_hole)
-                                  : ns_list_get_previous(&book->holes_list, cur_hole)
-        ) {
-        ns_mem_word_size_t *p = block_start_from_hole(cur_hole);
-        if (ns_mem_block_validate(p, direction) != 0 || *p >= 0) {
-            //Validation failed, or this supposed hole has positive (allocated) size
-            heap_failure(book, NS_DYN_MEM_HEAP_SECTOR_CORRUPTED);
-            break;
-        }
-        if (-*p >= data_size) {
-            // Found a big enough block
-            block_ptr = p;
-            break;
-        }
-    }
-
+    block_ptr = ns_mem_hole_find(book, data_size, direction);
     if (!block_ptr) {
         goto done;
     }
 
     ns_mem_word_size_t block_data_size = -*block_ptr;
+    // Would like to just replace the hole descriptor with the new one, but
+    // they could overlap, so ns_list_replace might fail
+    hole_t *before = ns_mem_hole_remove(book, block_ptr);
     if (block_data_size >= (data_size + 2 + HOLE_T_SIZE)) {
         ns_mem_word_size_t hole_size = block_data_size - data_size - 2;
         ns_mem_word_size_t *hole_ptr;
         //There is enough room for a new hole so create it first
         if ( direction > 0 ) {
-            hole_ptr = block_ptr + 1 + data_size + 1;
             // Hole will be left at end of area.
-            // Would like to just replace this block_ptr with new descriptor, but
-            // they could overlap, so ns_list_replace might fail
-            //ns_list_replace(&holes_list, block_ptr, hole_from_block_start(hole_ptr));
-            hole_t *before = ns_list_get_previous(&book->holes_list, hole_from_block_start(block_ptr));
-            ns_list_remove(&book->holes_list, hole_from_block_start(block_ptr));
-            if (before) {
-                ns_list_add_after(&book->holes_list, before, hole_from_block_start(hole_ptr));
-            } else {
-                ns_list_add_to_start(&book->holes_list, hole_from_block_start(hole_ptr));
-            }
+            hole_ptr = block_ptr + 1 + data_size + 1;
         } else {
+            // Hole remains at start of area.
             hole_ptr = block_ptr;
-            // Hole remains at start of area - keep existing descriptor in place.
             block_ptr += 1 + hole_size + 1;
         }
 
         hole_ptr[0] = -hole_size;
         hole_ptr[1 + hole_size] = -hole_size;
+        ns_mem_hole_add(book, hole_ptr, before);
     } else {
         // Not enough room for a left-over hole, so use the whole block
         data_size = block_data_size;
-        ns_list_remove(&book->holes_list, hole_from_block_start(block_ptr));
     }
     block_ptr[0] = data_size;
     block_ptr[1 + data_size] = data_size;
@@ -362,43 +501,35 @@ static void ns_mem_free_and_merge_with_adjacent_blocks(ns_mem_book_t *book, ns_m
         }
     }
 
-    hole_t *to_add = hole_from_block_start(start);
+    // The merged hole replaces the adjacent holes, described by a
+    // descriptor at its bottom. The removal of the holes notes our position
+    // for insertion below, the upper one last as it comes later.
+    // (Can't use ns_list_replace, because of danger of overlap)
     hole_t *before = NULL;
+    if (existing_start) {
+        before = ns_mem_hole_remove(book, start);
+    }
     if (existing_end) {
-        // Extending hole described by "existing_end" downwards.
-        // Will replace with descriptor at bottom of merged block.
-        // (Can't use ns_list_replace, because of danger of overlap)
-        // Optimisation - note our position for insertion below.
-        before = ns_list_get_next(&book->holes_list, existing_end);
-        ns_list_remove(&book->holes_list, existing_end);
+        before = ns_mem_hole_remove(book, block_start_from_hole(existing_end));
     }
-    if (existing_start) {
-        // Extending hole described by "existing_start" upwards.
-        // No need to modify that descriptor - it remains at the bottom
-        // of the merged block to describe it.
-    } else {
-        // Didn't find adjacent descriptors, but may still
-        // be merging with small blocks without descriptors.
-        if ( merged_data_size >= HOLE_T_SIZE ) {
-            // Locate hole position in list, if we don't already know
-            // from merging with the block above.
-            if (!existing_end) {
-                ns_list_foreach(hole_t, ptr, &book->holes_list) {
-                    if (ptr > to_add) {
-                        before = ptr;
-                        break;
-                    }
-                }
-            }
-            if (before) {
-                ns_list_add_before(&book->holes_list, before, to_add);
-            } else {
-                ns_list_add_to_end(&book->holes_list, to_add);
+#ifndef NS_DYN_MEM_SIZE_CLASSES
+    if (!existing_start && !existing_end) {
+        // Didn't find adjacent descriptors, but may still be merging with
+        // small blocks without descriptors, locate hole position in list.
+        hole_t *to_add = hole_from_block_start(start);
+        ns_list_foreach(hole_t, ptr, &book->holes_list) {
+            if (ptr > to_add) {
+                before = ptr;
+                break;
             }
-
         }
     }
+#endif
     *start = -merged_data_size;
+    if (merged_data_size >= HOLE_T_SIZE) {
+        ns_mem_hole_add(book, start, before);
+    }
+    // Written last as it may lie in a corrupted hole descriptor
     *end = -merged_data_size;
 }
 #endif
@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2017 ARM Limited. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ * Licensed under the Apache License, Version 2.0 (the License); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "CppUTest/TestHarness.h"
+#include "nsdynmemLIB.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "error_callback.h"
+
+/*
+ * Replays an alloc/free trace on a heap and reports the time taken by the
+ * heap operations and the fragmentation left.
+ *
+ * A recorded trace can be given in the NSDYNMEM_TRACE environment variable,
+ * as a file with one operation per line:
+ *   a <id> <size>   long period allocation, ns_mem_alloc()
+ *   t <id> <size>   temporary allocation, ns_mem_temporary_alloc()
+ *   f <id>          free of the allocation <id>
+ * Otherwise a trace modelled on a Thread border router is generated: long
+ * lived table entries, short lived packet buffers and small control blocks.
+ */
+
+#ifndef TRACE_HEAP_SIZE
+#define TRACE_HEAP_SIZE 32000
+#endif
+#define TRACE_IDS       4096
+#define TRACE_OPS       200000
+
+typedef struct {
+    char op;
+    uint16_t id;
+    uint16_t size;
+} trace_op_t;
+
+static trace_op_t *trace;
+static int trace_len;
+
+static void trace_add(char op, uint16_t id, uint16_t size)
+{
+    trace[trace_len].op = op;
+    trace[trace_len].id = id;
+    trace[trace_len].size = size;
+    trace_len++;
+}
+
+static bool trace_load(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return false;
+    }
+
+    char op;
+    unsigned id, size;
+    while (trace_len < TRACE_OPS && fscanf(f, " %c %u", &op, &id) == 2) {
+        size = 0;
+        if (op != 'f' && fscanf(f, "%u", &size) != 1) {
+            break;
+        }
+        trace_add(op, id % TRACE_IDS, size);
+    }
+    fclose(f);
+    return true;
+}
+
+static void trace_generate(void)
+{
+    static uint16_t live[TRACE_IDS];
+    static uint32_t expiry[TRACE_IDS];
+    static uint16_t free_ids[TRACE_IDS];
+    uint16_t live_count = 0;
+    uint32_t seed = 1;
+
+    for (uint16_t i = 0; i < TRACE_IDS; i++) {
+        free_ids[i] = i;
+    }
+
+    for (uint32_t time = 0; trace_len < TRACE_OPS - TRACE_IDS; time++) {
+        seed = seed * 1103515245 + 12345;
+        uint32_t r = seed >> 8;
+
+        // Free what has expired
+        for (uint16_t i = 0; i < live_count; ) {
+            if (expiry[i] == time) {
+                trace_add('f', live[i], 0);
+                free_ids[TRACE_IDS - live_count] = live[i];
+                live_count--;
+                live[i] = live[live_count];
+                expiry[i] = expiry[live_count];
+            } else {
+                i++;
+            }
+        }
+
+        if (live_count == TRACE_IDS) {
+            continue;
+        }
+
+        uint16_t id = free_ids[TRACE_IDS - 1 - live_count];
+        uint32_t lifetime;
+        if (r % 64 == 0) {
+            // Routing and neighbour table entries
+            trace_add('a', id, 24 + (r >> 6) % 176);
+            lifetime = 1000 + (r >> 14) % 4000;
+        } else if (r % 64 < 24) {
+            // Packet buffers
+            trace_add('t', id, 40 + (r >> 6) % 1240);
+            lifetime = 1 + (r >> 14) % 16;
+        } else {
+            // Small control blocks, timers and events
+            trace_add((r >> 6) & 1 ? 'a' : 't', id, 8 + (r >> 7) % 56);
+            lifetime = 1 + (r >> 14) % 1000;
+        }
+        live[live_count] = id;
+        expiry[live_count] = time + lifetime;
+        live_count++;
+    }
+
+    // Free whatever is left at the end of the trace
+    for (uint16_t i = 0; i < live_count; i++) {
+        trace_add('f', live[i], 0);
+    }
+}
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// Largest block that can be allocated, in percent of the free memory
+static uint32_t largest_free_block(ns_mem_book_t *book, mem_stat_t *info)
+{
+    uint32_t free_bytes = info->heap_sector_size - info->heap_sector_allocated_bytes;
+    uint32_t fail_cnt = info->heap_alloc_fail_cnt;
+    uint32_t low = 0;
+    uint32_t high = free_bytes - 2 * sizeof(int);
+    while (low < high) {
+        uint32_t mid = (low + high + 1) / 2;
+        void *p = ns_mem_alloc(book, mid);
+        if (p) {
+            ns_mem_free(book, p);
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    // Only count the failures of the trace
+    info->heap_alloc_fail_cnt = fail_cnt;
+    return low * 100 / free_bytes;
+}
+
+// Replays the trace, returning the lowest largest free block seen if sampled
+static uint32_t trace_replay(ns_mem_book_t *book, mem_stat_t *info, bool sample)
+{
+    static void *p[TRACE_IDS];
+    memset(p, 0, sizeof(p));
+    uint32_t largest_min = 100;
+
+    for (int i = 0; i < trace_len; i++) {
+        trace_op_t *op = &trace[i];
+        // Allocations for an id in use free it first
+        ns_mem_free(book, p[op->id]);
+        p[op->id] = NULL;
+        if (op->op == 'a') {
+            p[op->id] = ns_mem_alloc(book, op->size);
+        } else if (op->op == 't') {
+            p[op->id] = ns_mem_temporary_alloc(book, op->size);
+        }
+
+        if (sample && i % 1000 == 0) {
+            uint32_t largest = largest_free_block(book, info);
+            if (largest < largest_min) {
+                largest_min = largest;
+            }
+        }
+    }
+    return largest_min;
+}
+
+TEST_GROUP(dynmem_trace)
+{
+    void setup() {
+        reset_heap_error();
+        trace = (trace_op_t *)malloc(TRACE_OPS * sizeof(trace_op_t));
+        trace_len = 0;
+    }
+
+    void teardown() {
+        free(trace);
+    }
+};
+
+TEST(dynmem_trace, replay)
+{
+    const char *path = getenv("NSDYNMEM_TRACE");
+    if (!path || !trace_load(path)) {
+        trace_generate();
+    }
+
+    mem_stat_t info;
+    uint8_t *heap = (uint8_t*)malloc(TRACE_HEAP_SIZE);
+    CHECK(NULL != heap);
+
+    ns_mem_book_t *book = ns_mem_init(heap, TRACE_HEAP_SIZE, &heap_fail_callback, &info);
+    double start = now_us();
+    trace_replay(book, &info, false);
+    double elapsed = now_us() - start;
+    CHECK(!heap_have_failed());
+    CHECK(info.heap_sector_alloc_cnt == 0);
+    CHECK(info.heap_sector_allocated_bytes == 0);
+
+    book = ns_mem_init(heap, TRACE_HEAP_SIZE, &heap_fail_callback, &info);
+    uint32_t largest_min = trace_replay(book, &info, true);
+    CHECK(!heap_have_failed());
+
+    printf("\n%d operations on a %d bytes heap: %.3f us per operation, %lu failed allocations, "
+           "largest free block down to %lu%% of free memory\n",
+           trace_len, TRACE_HEAP_SIZE, elapsed / trace_len,
+           (unsigned long)info.heap_alloc_fail_cnt, (unsigned long)largest_min);
+
+    free(heap);
+}
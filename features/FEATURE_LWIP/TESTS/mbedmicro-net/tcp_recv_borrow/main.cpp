@@ -0,0 +1,224 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#if !FEATURE_LWIP
+    #error [NOT_SUPPORTED] LWIP not supported for this target
+#endif
+#if DEVICE_EMAC
+    #error [NOT_SUPPORTED] Not supported for WiFi targets
+#endif
+
+#include "mbed.h"
+#include "EthernetInterface.h"
+#include "TCPSocket.h"
+#include "greentea-client/test_env.h"
+#include "unity/unity.h"
+#include "utest.h"
+
+using namespace utest::v1;
+
+
+#ifndef MBED_CFG_TCP_RECV_BORROW_SIZE
+#define MBED_CFG_TCP_RECV_BORROW_SIZE 0x10000
+#endif
+
+#ifndef MBED_CFG_TCP_RECV_BORROW_CHUNK
+#define MBED_CFG_TCP_RECV_BORROW_CHUNK 1024
+#endif
+
+#ifndef MBED_CFG_TCP_RECV_BORROW_SEGMENTS
+#define MBED_CFG_TCP_RECV_BORROW_SEGMENTS 4
+#endif
+
+
+namespace {
+    uint8_t tx_buffer[MBED_CFG_TCP_RECV_BORROW_CHUNK];
+    uint8_t rx_buffer[MBED_CFG_TCP_RECV_BORROW_CHUNK];
+
+    EthernetInterface eth;
+    SocketAddress tcp_addr;
+}
+
+void test_tcp_connect()
+{
+    TEST_ASSERT_EQUAL(0, eth.connect());
+    printf("MBED: TCPClient IP address is '%s'\n", eth.get_ip_address());
+    printf("MBED: TCPClient waiting for server IP and port...\n");
+
+    greentea_send_kv("target_ip", eth.get_ip_address());
+
+    char recv_key[] = "host_port";
+    char ipbuf[60] = {0};
+    char portbuf[16] = {0};
+    unsigned int port = 0;
+
+    greentea_send_kv("host_ip", " ");
+    greentea_parse_kv(recv_key, ipbuf, sizeof(recv_key), sizeof(ipbuf));
+
+    greentea_send_kv("host_port", " ");
+    greentea_parse_kv(recv_key, portbuf, sizeof(recv_key), sizeof(ipbuf));
+    sscanf(portbuf, "%u", &port);
+
+    printf("MBED: Server IP address received: %s:%d \n", ipbuf, port);
+    tcp_addr.set_ip_address(ipbuf);
+    tcp_addr.set_port(port);
+}
+
+// Bytes of the stream, a pattern which does not line up with the chunks
+static uint8_t pattern(size_t offset)
+{
+    return (offset * 7 + offset / 251) & 0xff;
+}
+
+static bool check(const uint8_t *data, size_t size, size_t *offset)
+{
+    for (size_t i = 0; i < size; i++) {
+        if (data[i] != pattern(*offset + i)) {
+            return false;
+        }
+    }
+    *offset += size;
+    return true;
+}
+
+// Streams the data through the echo server, and returns the time taken
+static int stream(bool borrow)
+{
+    TCPSocket sock;
+    TEST_ASSERT_EQUAL(0, sock.open(&eth));
+    TEST_ASSERT_EQUAL(0, sock.connect(tcp_addr));
+    sock.set_blocking(false);
+
+    nsapi_iovec_t iov[MBED_CFG_TCP_RECV_BORROW_SEGMENTS];
+    size_t tx_count = 0;
+    size_t rx_count = 0;
+    Timer timer;
+    timer.start();
+
+    while (rx_count < MBED_CFG_TCP_RECV_BORROW_SIZE) {
+        if (tx_count < MBED_CFG_TCP_RECV_BORROW_SIZE) {
+            size_t size = MBED_CFG_TCP_RECV_BORROW_SIZE - tx_count;
+            if (size > sizeof(tx_buffer)) {
+                size = sizeof(tx_buffer);
+            }
+            for (size_t i = 0; i < size; i++) {
+                tx_buffer[i] = pattern(tx_count + i);
+            }
+
+            int sent = sock.send(tx_buffer, size);
+            TEST_ASSERT(sent > 0 || sent == NSAPI_ERROR_WOULD_BLOCK);
+            if (sent > 0) {
+                tx_count += sent;
+            }
+        }
+
+        while (rx_count < tx_count) {
+            int recv;
+            if (borrow) {
+                nsapi_recv_view_t view = {iov, MBED_CFG_TCP_RECV_BORROW_SEGMENTS, NULL};
+                recv = sock.recv_borrow(&view);
+                if (recv >= 0) {
+                    TEST_ASSERT(view.iovcnt <= MBED_CFG_TCP_RECV_BORROW_SEGMENTS);
+                    for (unsigned i = 0; i < view.iovcnt; i++) {
+                        TEST_ASSERT(check((const uint8_t *)iov[i].iov_base, iov[i].iov_len, &rx_count));
+                    }
+                    sock.recv_release(&view);
+                }
+            } else {
+                recv = sock.recv(rx_buffer, sizeof(rx_buffer));
+                if (recv >= 0) {
+                    TEST_ASSERT(check(rx_buffer, recv, &rx_count));
+                }
+            }
+
+            TEST_ASSERT(recv > 0 || recv == NSAPI_ERROR_WOULD_BLOCK);
+            if (recv == NSAPI_ERROR_WOULD_BLOCK) {
+                break;
+            }
+        }
+    }
+
+    timer.stop();
+    TEST_ASSERT_EQUAL(0, sock.close());
+    return timer.read_ms();
+}
+
+void test_tcp_recv_borrow()
+{
+    int copy_ms = stream(false);
+    int borrow_ms = stream(true);
+
+    printf("MBED: echoed %d bytes\r\n", MBED_CFG_TCP_RECV_BORROW_SIZE);
+    printf("MBED: recv          %6d ms\r\n", copy_ms);
+    printf("MBED: recv_borrow   %6d ms\r\n", borrow_ms);
+}
+
+// Data left by recv is lent next, and a borrow can be followed by recv
+void test_tcp_recv_borrow_mixed()
+{
+    TCPSocket sock;
+    TEST_ASSERT_EQUAL(0, sock.open(&eth));
+    TEST_ASSERT_EQUAL(0, sock.connect(tcp_addr));
+
+    for (size_t i = 0; i < sizeof(tx_buffer); i++) {
+        tx_buffer[i] = pattern(i);
+    }
+    TEST_ASSERT_EQUAL(sizeof(tx_buffer), sock.send(tx_buffer, sizeof(tx_buffer)));
+
+    nsapi_iovec_t iov[1];
+    size_t rx_count = 0;
+    bool borrow = false;
+    while (rx_count < sizeof(tx_buffer)) {
+        int recv;
+        if (borrow) {
+            nsapi_recv_view_t view = {iov, 1, NULL};
+            recv = sock.recv_borrow(&view);
+            TEST_ASSERT(recv > 0);
+            TEST_ASSERT_EQUAL(1, view.iovcnt);
+            TEST_ASSERT(check((const uint8_t *)iov[0].iov_base, iov[0].iov_len, &rx_count));
+            sock.recv_release(&view);
+            TEST_ASSERT_EQUAL(0, view.iovcnt);
+        } else {
+            recv = sock.recv(rx_buffer, 100);
+            TEST_ASSERT(recv > 0);
+            TEST_ASSERT(check(rx_buffer, recv, &rx_count));
+        }
+        borrow = !borrow;
+    }
+
+    TEST_ASSERT_EQUAL(0, sock.close());
+    eth.disconnect();
+}
+
+
+// Test setup
+utest::v1::status_t test_setup(const size_t number_of_cases)
+{
+    GREENTEA_SETUP(120, "tcp_echo");
+    return verbose_test_setup_handler(number_of_cases);
+}
+
+Case cases[] = {
+    Case("TCP connect", test_tcp_connect),
+    Case("TCP recv_borrow against recv", test_tcp_recv_borrow),
+    Case("TCP recv_borrow mixed with recv", test_tcp_recv_borrow_mixed),
+};
+
+Specification specification(test_setup, cases);
+
+int main()
+{
+    return !Harness::run(specification);
+}
@@ -0,0 +1,224 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#if !FEATURE_LWIP
+    #error [NOT_SUPPORTED] LWIP not supported for this target
+#endif
+#if DEVICE_EMAC
+    #error [NOT_SUPPORTED] Not supported for WiFi targets
+#endif
+
+#include "mbed.h"
+#include "EthernetInterface.h"
+#include "UDPSocket.h"
+#include "greentea-client/test_env.h"
+#include "unity/unity.h"
+#include "utest.h"
+
+using namespace utest::v1;
+
+
+#ifndef MBED_CFG_UDP_BATCH_TIMEOUT
+#define MBED_CFG_UDP_BATCH_TIMEOUT 500
+#endif
+
+#ifndef MBED_CFG_UDP_BATCH_SIZE
+#define MBED_CFG_UDP_BATCH_SIZE 8
+#endif
+
+#ifndef MBED_CFG_UDP_BATCH_PAYLOAD_SIZE
+#define MBED_CFG_UDP_BATCH_PAYLOAD_SIZE 64
+#endif
+
+#ifndef MBED_CFG_UDP_BATCH_BENCHMARK_COUNT
+#define MBED_CFG_UDP_BATCH_BENCHMARK_COUNT 1024
+#endif
+
+
+namespace {
+    char tx_buffer[MBED_CFG_UDP_BATCH_SIZE][MBED_CFG_UDP_BATCH_PAYLOAD_SIZE];
+    char rx_buffer[MBED_CFG_UDP_BATCH_SIZE][MBED_CFG_UDP_BATCH_PAYLOAD_SIZE];
+    nsapi_datagram_t tx_dgrams[MBED_CFG_UDP_BATCH_SIZE];
+    nsapi_datagram_t rx_dgrams[MBED_CFG_UDP_BATCH_SIZE];
+    const int ECHO_LOOPS = 16;
+    char uuid[GREENTEA_UUID_LENGTH] = {0};
+
+    EthernetInterface eth;
+    SocketAddress udp_addr;
+}
+
+void fill_buffer(char *buffer, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        buffer[i] = (rand() % 10) + '0';
+    }
+}
+
+void test_udp_connect() {
+    int err = eth.connect();
+    TEST_ASSERT_EQUAL(0, err);
+
+    printf("UDP client IP Address is %s\n", eth.get_ip_address());
+
+    greentea_send_kv("target_ip", eth.get_ip_address());
+
+    char recv_key[] = "host_port";
+    char ipbuf[60] = {0};
+    char portbuf[16] = {0};
+    unsigned int port = 0;
+
+    greentea_send_kv("host_ip", " ");
+    greentea_parse_kv(recv_key, ipbuf, sizeof(recv_key), sizeof(ipbuf));
+
+    greentea_send_kv("host_port", " ");
+    greentea_parse_kv(recv_key, portbuf, sizeof(recv_key), sizeof(ipbuf));
+    sscanf(portbuf, "%u", &port);
+
+    printf("MBED: UDP Server IP address received: %s:%d \n", ipbuf, port);
+    udp_addr = SocketAddress(ipbuf, port);
+
+    for (int i = 0; i < MBED_CFG_UDP_BATCH_SIZE; i++) {
+        tx_dgrams[i].addr = udp_addr.get_addr();
+        tx_dgrams[i].port = udp_addr.get_port();
+        tx_dgrams[i].data = tx_buffer[i];
+        tx_dgrams[i].size = sizeof(tx_buffer[i]);
+    }
+}
+
+// Finds the datagram sent with the same contents, echoes may be reordered
+static bool was_sent(const nsapi_datagram_t *dgram, bool *seen) {
+    SocketAddress source(dgram->addr, dgram->port);
+    if (source != udp_addr || dgram->len != sizeof(tx_buffer[0])) {
+        return false;
+    }
+
+    for (int i = 0; i < MBED_CFG_UDP_BATCH_SIZE; i++) {
+        if (!seen[i] && memcmp(dgram->data, tx_buffer[i], sizeof(tx_buffer[i])) == 0) {
+            seen[i] = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+void test_udp_batch_echo() {
+    UDPSocket sock;
+    sock.open(&eth);
+    sock.set_timeout(MBED_CFG_UDP_BATCH_TIMEOUT);
+
+    for (int i = 0; i < MBED_CFG_UDP_BATCH_SIZE; i++) {
+        rx_dgrams[i].data = rx_buffer[i];
+        rx_dgrams[i].size = sizeof(rx_buffer[i]);
+    }
+
+    int success = 0;
+    for (unsigned int i = 0; success < ECHO_LOOPS && i < 4*ECHO_LOOPS; i++) {
+        for (int j = 0; j < MBED_CFG_UDP_BATCH_SIZE; j++) {
+            memcpy(tx_buffer[j], uuid, 8);
+            fill_buffer(tx_buffer[j] + 8, sizeof(tx_buffer[j]) - 8);
+        }
+
+        int ret = sock.sendto_batch(tx_dgrams, MBED_CFG_UDP_BATCH_SIZE);
+        if (ret != MBED_CFG_UDP_BATCH_SIZE) {
+            printf("[%02u] Network error %d\n", i, ret);
+            continue;
+        }
+
+        bool seen[MBED_CFG_UDP_BATCH_SIZE] = {false};
+        int received = 0;
+        while (received < MBED_CFG_UDP_BATCH_SIZE) {
+            ret = sock.recvfrom_batch(rx_dgrams, MBED_CFG_UDP_BATCH_SIZE - received);
+            if (ret <= 0) {
+                break;
+            }
+
+            for (int j = 0; j < ret; j++) {
+                if (was_sent(&rx_dgrams[j], seen)) {
+                    received += 1;
+                }
+            }
+        }
+
+        if (received == MBED_CFG_UDP_BATCH_SIZE) {
+            success += 1;
+            continue;
+        }
+
+        printf("[%02u] recv error %d, %d of %d datagrams\n", i, ret, received, MBED_CFG_UDP_BATCH_SIZE);
+
+        // failed, clean out any remaining bad packets
+        sock.set_timeout(0);
+        while (sock.recvfrom(NULL, NULL, 0) != NSAPI_ERROR_WOULD_BLOCK);
+        sock.set_timeout(MBED_CFG_UDP_BATCH_TIMEOUT);
+    }
+
+    sock.close();
+    TEST_ASSERT_EQUAL(ECHO_LOOPS, success);
+}
+
+// Sends the same datagrams one call each, then in batches, the echoes
+// are not read
+void test_udp_batch_throughput() {
+    UDPSocket sock;
+    sock.open(&eth);
+
+    Timer timer;
+    timer.start();
+    int sent = 0;
+    for (int i = 0; i < MBED_CFG_UDP_BATCH_BENCHMARK_COUNT; i++) {
+        const nsapi_datagram_t *dgram = &tx_dgrams[i % MBED_CFG_UDP_BATCH_SIZE];
+        if (sock.sendto(udp_addr, dgram->data, dgram->size) == (int)dgram->size) {
+            sent += 1;
+        }
+    }
+    int sendto_us = timer.read_us();
+    printf("sendto: %d datagrams of %u bytes in %d us, %d datagrams/s\n",
+            sent, sizeof(tx_buffer[0]), sendto_us, (int)(sent * 1000000LL / sendto_us));
+    TEST_ASSERT_EQUAL(MBED_CFG_UDP_BATCH_BENCHMARK_COUNT, sent);
+
+    timer.reset();
+    sent = 0;
+    for (int i = 0; i < MBED_CFG_UDP_BATCH_BENCHMARK_COUNT; i += MBED_CFG_UDP_BATCH_SIZE) {
+        int ret = sock.sendto_batch(tx_dgrams, MBED_CFG_UDP_BATCH_SIZE);
+        if (ret > 0) {
+            sent += ret;
+        }
+    }
+    int batch_us = timer.read_us();
+    printf("sendto_batch of %d: %d datagrams of %u bytes in %d us, %d datagrams/s\n",
+            MBED_CFG_UDP_BATCH_SIZE, sent, sizeof(tx_buffer[0]), batch_us, (int)(sent * 1000000LL / batch_us));
+    TEST_ASSERT_EQUAL(MBED_CFG_UDP_BATCH_BENCHMARK_COUNT, sent);
+
+    sock.close();
+    eth.disconnect();
+}
+
+
+// Test setup
+utest::v1::status_t test_setup(const size_t number_of_cases) {
+    GREENTEA_SETUP_UUID(120, "udp_echo", uuid, GREENTEA_UUID_LENGTH);
+    return verbose_test_setup_handler(number_of_cases);
+}
+
+Case cases[] = {
+    Case("UDP connect", test_udp_connect),
+    Case("UDP batch echo", test_udp_batch_echo),
+    Case("UDP batch throughput", test_udp_batch_throughput),
+};
+
+Specification specification(test_setup, cases);
+
+int main() {
+    return !Harness::run(specification);
+}
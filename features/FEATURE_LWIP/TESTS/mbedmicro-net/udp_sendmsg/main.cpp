@@ -0,0 +1,206 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#if !FEATURE_LWIP
+    #error [NOT_SUPPORTED] LWIP not supported for this target
+#endif
+#if DEVICE_EMAC
+    #error [NOT_SUPPORTED] Not supported for WiFi targets
+#endif
+
+#include "mbed.h"
+#include "EthernetInterface.h"
+#include "UDPSocket.h"
+#include "greentea-client/test_env.h"
+#include "unity/unity.h"
+#include "utest.h"
+
+using namespace utest::v1;
+
+
+#ifndef MBED_CFG_UDP_SENDMSG_TIMEOUT
+#define MBED_CFG_UDP_SENDMSG_TIMEOUT 500
+#endif
+
+#ifndef MBED_CFG_UDP_SENDMSG_PAYLOAD_SIZE
+#define MBED_CFG_UDP_SENDMSG_PAYLOAD_SIZE 512
+#endif
+
+#ifndef MBED_CFG_UDP_SENDMSG_BENCHMARK_COUNT
+#define MBED_CFG_UDP_SENDMSG_BENCHMARK_COUNT 1000
+#endif
+
+
+// Messages are made of a header, a payload and a MAC, as a secured
+// CoAP or DTLS record would be
+namespace {
+    char header[13];
+    char payload[MBED_CFG_UDP_SENDMSG_PAYLOAD_SIZE];
+    char mac[16];
+    char rx_header[sizeof(header)];
+    char rx_payload[sizeof(payload)];
+    char rx_mac[sizeof(mac)];
+    char staging[sizeof(header) + sizeof(payload) + sizeof(mac)];
+    const int ECHO_LOOPS = 16;
+    char uuid[GREENTEA_UUID_LENGTH] = {0};
+
+    EthernetInterface eth;
+    SocketAddress udp_addr;
+}
+
+void fill_buffer(char *buffer, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        buffer[i] = (rand() % 10) + '0';
+    }
+}
+
+void test_udp_connect() {
+    int err = eth.connect();
+    TEST_ASSERT_EQUAL(0, err);
+
+    printf("UDP client IP Address is %s\n", eth.get_ip_address());
+
+    greentea_send_kv("target_ip", eth.get_ip_address());
+
+    char recv_key[] = "host_port";
+    char ipbuf[60] = {0};
+    char portbuf[16] = {0};
+    unsigned int port = 0;
+
+    greentea_send_kv("host_ip", " ");
+    greentea_parse_kv(recv_key, ipbuf, sizeof(recv_key), sizeof(ipbuf));
+
+    greentea_send_kv("host_port", " ");
+    greentea_parse_kv(recv_key, portbuf, sizeof(recv_key), sizeof(ipbuf));
+    sscanf(portbuf, "%u", &port);
+
+    printf("MBED: UDP Server IP address received: %s:%d \n", ipbuf, port);
+    udp_addr = SocketAddress(ipbuf, port);
+}
+
+void test_udp_sendmsg_echo() {
+    UDPSocket sock;
+    sock.open(&eth);
+    sock.set_timeout(MBED_CFG_UDP_SENDMSG_TIMEOUT);
+
+    nsapi_iovec_t tx_iov[] = {
+        {header, sizeof(header)},
+        {payload, sizeof(payload)},
+        {mac, sizeof(mac)},
+    };
+
+    nsapi_iovec_t rx_iov[] = {
+        {rx_header, sizeof(rx_header)},
+        {rx_payload, sizeof(rx_payload)},
+        {rx_mac, sizeof(rx_mac)},
+    };
+
+    int success = 0;
+    for (unsigned int i = 0; success < ECHO_LOOPS && i < 4*ECHO_LOOPS; i++) {
+        memcpy(header, uuid, sizeof(header));
+        fill_buffer(payload, sizeof(payload));
+        fill_buffer(mac, sizeof(mac));
+
+        int ret = sock.sendmsg(udp_addr, tx_iov, 3);
+        if (ret != (int)sizeof(staging)) {
+            printf("[%02u] Network error %d\n", i, ret);
+            continue;
+        }
+
+        SocketAddress temp_addr;
+        ret = sock.recvmsg(&temp_addr, rx_iov, 3);
+        if (temp_addr == udp_addr &&
+            ret == (int)sizeof(staging) &&
+            memcmp(rx_header, header, sizeof(header)) == 0 &&
+            memcmp(rx_payload, payload, sizeof(payload)) == 0 &&
+            memcmp(rx_mac, mac, sizeof(mac)) == 0) {
+            success += 1;
+            continue;
+        }
+
+        printf("[%02u] recv error %d\n", i, ret);
+
+        // failed, clean out any remaining bad packets
+        sock.set_timeout(0);
+        while (sock.recvfrom(NULL, NULL, 0) != NSAPI_ERROR_WOULD_BLOCK);
+        sock.set_timeout(MBED_CFG_UDP_SENDMSG_TIMEOUT);
+    }
+
+    sock.close();
+    TEST_ASSERT_EQUAL(ECHO_LOOPS, success);
+}
+
+// Sends the same messages gathered in a staging buffer, then as three
+// segments, the echoes are not read
+void test_udp_sendmsg_throughput() {
+    UDPSocket sock;
+    sock.open(&eth);
+
+    nsapi_iovec_t tx_iov[] = {
+        {header, sizeof(header)},
+        {payload, sizeof(payload)},
+        {mac, sizeof(mac)},
+    };
+
+    Timer timer;
+    timer.start();
+    int sent = 0;
+    for (int i = 0; i < MBED_CFG_UDP_SENDMSG_BENCHMARK_COUNT; i++) {
+        memcpy(staging, header, sizeof(header));
+        memcpy(staging + sizeof(header), payload, sizeof(payload));
+        memcpy(staging + sizeof(header) + sizeof(payload), mac, sizeof(mac));
+        if (sock.sendto(udp_addr, staging, sizeof(staging)) == (int)sizeof(staging)) {
+            sent += 1;
+        }
+    }
+    int staged_us = timer.read_us();
+    printf("sendto with staging: %d datagrams of %u bytes in %d us, %d datagrams/s\n",
+            sent, sizeof(staging), staged_us, (int)(sent * 1000000LL / staged_us));
+    TEST_ASSERT_EQUAL(MBED_CFG_UDP_SENDMSG_BENCHMARK_COUNT, sent);
+
+    timer.reset();
+    sent = 0;
+    for (int i = 0; i < MBED_CFG_UDP_SENDMSG_BENCHMARK_COUNT; i++) {
+        if (sock.sendmsg(udp_addr, tx_iov, 3) == (int)sizeof(staging)) {
+            sent += 1;
+        }
+    }
+    int sendmsg_us = timer.read_us();
+    printf("sendmsg with 3 segments: %d datagrams of %u bytes in %d us, %d datagrams/s\n",
+            sent, sizeof(staging), sendmsg_us, (int)(sent * 1000000LL / sendmsg_us));
+    TEST_ASSERT_EQUAL(MBED_CFG_UDP_SENDMSG_BENCHMARK_COUNT, sent);
+
+    sock.close();
+    eth.disconnect();
+}
+
+
+// Test setup
+utest::v1::status_t test_setup(const size_t number_of_cases) {
+    GREENTEA_SETUP_UUID(120, "udp_echo", uuid, GREENTEA_UUID_LENGTH);
+    return verbose_test_setup_handler(number_of_cases);
+}
+
+Case cases[] = {
+    Case("UDP connect", test_udp_connect),
+    Case("UDP sendmsg echo", test_udp_sendmsg_echo),
+    Case("UDP sendmsg throughput", test_udp_sendmsg_throughput),
+};
+
+Specification specification(test_setup, cases);
+
+int main() {
+    return !Harness::run(specification);
+}
@@ -0,0 +1,281 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#if !FEATURE_LWIP
+    #error [NOT_SUPPORTED] LWIP not supported for this target
+#endif
+#if DEVICE_EMAC
+    #error [NOT_SUPPORTED] Not supported for WiFi targets
+#endif
+
+#include "mbed.h"
+#include "EthernetInterface.h"
+#include "UDPSocket.h"
+#include "greentea-client/test_env.h"
+#include "unity/unity.h"
+#include "utest.h"
+
+using namespace utest::v1;
+
+
+#ifndef MBED_CFG_UDP_SIGIO_TIMEOUT
+#define MBED_CFG_UDP_SIGIO_TIMEOUT 500
+#endif
+
+#ifndef MBED_CFG_UDP_SIGIO_SOCKETS
+#define MBED_CFG_UDP_SIGIO_SOCKETS 3
+#endif
+
+#ifndef MBED_CFG_UDP_SIGIO_BURST
+#define MBED_CFG_UDP_SIGIO_BURST 8
+#endif
+
+#ifndef MBED_CFG_UDP_SIGIO_PAYLOAD_SIZE
+#define MBED_CFG_UDP_SIGIO_PAYLOAD_SIZE 64
+#endif
+
+#ifndef MBED_CFG_UDP_SIGIO_BENCHMARK_COUNT
+#define MBED_CFG_UDP_SIGIO_BENCHMARK_COUNT 256
+#endif
+
+
+// Counts the events of the stack, before UDPSocket filters them
+class SigioSocket : public UDPSocket {
+public:
+    SigioSocket() : events(0), wakeup(0) {}
+
+    volatile int events;
+    Semaphore wakeup;
+
+protected:
+    virtual void event() {
+        events += 1;
+        wakeup.release();
+        UDPSocket::event();
+    }
+};
+
+namespace {
+    char tx_buffer[MBED_CFG_UDP_SIGIO_BURST][MBED_CFG_UDP_SIGIO_PAYLOAD_SIZE];
+    char rx_buffer[MBED_CFG_UDP_SIGIO_BURST][MBED_CFG_UDP_SIGIO_PAYLOAD_SIZE];
+    nsapi_datagram_t tx_dgrams[MBED_CFG_UDP_SIGIO_BURST];
+    nsapi_datagram_t rx_dgrams[MBED_CFG_UDP_SIGIO_BURST];
+    const int WAKEUP_LOOPS = 16;
+    const int BENCHMARK_SOCKETS[] = {4, 32, 128};
+    char uuid[GREENTEA_UUID_LENGTH] = {0};
+
+    EthernetInterface eth;
+    SocketAddress udp_addr;
+}
+
+void fill_buffer(char *buffer, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        buffer[i] = (rand() % 10) + '0';
+    }
+}
+
+void test_udp_connect() {
+    int err = eth.connect();
+    TEST_ASSERT_EQUAL(0, err);
+
+    printf("UDP client IP Address is %s\n", eth.get_ip_address());
+
+    greentea_send_kv("target_ip", eth.get_ip_address());
+
+    char recv_key[] = "host_port";
+    char ipbuf[60] = {0};
+    char portbuf[16] = {0};
+    unsigned int port = 0;
+
+    greentea_send_kv("host_ip", " ");
+    greentea_parse_kv(recv_key, ipbuf, sizeof(recv_key), sizeof(ipbuf));
+
+    greentea_send_kv("host_port", " ");
+    greentea_parse_kv(recv_key, portbuf, sizeof(recv_key), sizeof(ipbuf));
+    sscanf(portbuf, "%u", &port);
+
+    printf("MBED: UDP Server IP address received: %s:%d \n", ipbuf, port);
+    udp_addr = SocketAddress(ipbuf, port);
+
+    for (int i = 0; i < MBED_CFG_UDP_SIGIO_BURST; i++) {
+        memcpy(tx_buffer[i], uuid, 8);
+        fill_buffer(tx_buffer[i] + 8, sizeof(tx_buffer[i]) - 8);
+        tx_dgrams[i].addr = udp_addr.get_addr();
+        tx_dgrams[i].port = udp_addr.get_port();
+        tx_dgrams[i].data = tx_buffer[i];
+        tx_dgrams[i].size = sizeof(tx_buffer[i]);
+        rx_dgrams[i].data = rx_buffer[i];
+        rx_dgrams[i].size = sizeof(rx_buffer[i]);
+    }
+}
+
+// Reads what is queued without waiting, returns the number of datagrams
+static int drain(SigioSocket *sock) {
+    int received = 0;
+    while (sock->recvfrom(NULL, rx_buffer[0], sizeof(rx_buffer[0])) >= 0) {
+        received += 1;
+    }
+    return received;
+}
+
+// The echoes of a burst notify each socket once, until it is read again
+void test_udp_sigio_burst() {
+    SigioSocket sock[MBED_CFG_UDP_SIGIO_SOCKETS];
+
+    for (int i = 0; i < MBED_CFG_UDP_SIGIO_SOCKETS; i++) {
+        TEST_ASSERT_EQUAL(0, sock[i].open(&eth));
+        sock[i].set_blocking(false);
+        sock[i].events = 0;
+    }
+
+    // The whole burst is sent by one call, so every echo arrives after it
+    for (int i = 0; i < MBED_CFG_UDP_SIGIO_SOCKETS; i++) {
+        TEST_ASSERT_EQUAL(MBED_CFG_UDP_SIGIO_BURST, sock[i].sendto_batch(tx_dgrams, MBED_CFG_UDP_SIGIO_BURST));
+    }
+    wait_ms(MBED_CFG_UDP_SIGIO_TIMEOUT);
+
+    for (int i = 0; i < MBED_CFG_UDP_SIGIO_SOCKETS; i++) {
+        printf("socket %d: %d sigio for a burst of %d\n", i, sock[i].events, MBED_CFG_UDP_SIGIO_BURST);
+        TEST_ASSERT_EQUAL(1, sock[i].events);
+
+        // Reading what is already queued notifies nothing more
+        int received = drain(&sock[i]);
+        TEST_ASSERT_TRUE(received > 0);
+        TEST_ASSERT_EQUAL(1, sock[i].events);
+    }
+
+    // A packet after the read notifies again
+    for (int i = 0; i < MBED_CFG_UDP_SIGIO_SOCKETS; i++) {
+        TEST_ASSERT_EQUAL(MBED_CFG_UDP_SIGIO_BURST, sock[i].sendto_batch(tx_dgrams, MBED_CFG_UDP_SIGIO_BURST));
+    }
+    wait_ms(MBED_CFG_UDP_SIGIO_TIMEOUT);
+
+    for (int i = 0; i < MBED_CFG_UDP_SIGIO_SOCKETS; i++) {
+        TEST_ASSERT_EQUAL(2, sock[i].events);
+        drain(&sock[i]);
+        sock[i].close();
+    }
+}
+
+// A packet arriving once the socket is read empty always wakes it up
+void test_udp_sigio_rearm() {
+    SigioSocket sock;
+    TEST_ASSERT_EQUAL(0, sock.open(&eth));
+    sock.set_blocking(false);
+
+    int success = 0;
+    for (int i = 0; success < WAKEUP_LOOPS && i < 4*WAKEUP_LOOPS; i++) {
+        drain(&sock);
+        while (sock.wakeup.wait(0) > 0);
+
+        int ret = sock.sendto(udp_addr, tx_buffer[0], sizeof(tx_buffer[0]));
+        if (ret != (int)sizeof(tx_buffer[0])) {
+            printf("[%02d] Network error %d\n", i, ret);
+            continue;
+        }
+
+        if (sock.wakeup.wait(MBED_CFG_UDP_SIGIO_TIMEOUT) > 0) {
+            TEST_ASSERT_TRUE(drain(&sock) > 0);
+            success += 1;
+            continue;
+        }
+
+        // No wakeup is only fine if the echo was lost
+        TEST_ASSERT_EQUAL(0, drain(&sock));
+        printf("[%02d] echo lost\n", i);
+    }
+
+    sock.close();
+    TEST_ASSERT_EQUAL(WAKEUP_LOOPS, success);
+}
+
+// Echoes bursts through the last socket opened, with more sockets open
+// around it. More than lwip.socket-max and lwip.udp-socket-max sockets
+// are skipped, raise them in the application configuration to run all.
+void test_udp_sigio_benchmark() {
+    for (unsigned n = 0; n < sizeof(BENCHMARK_SOCKETS) / sizeof(BENCHMARK_SOCKETS[0]); n++) {
+        int count = BENCHMARK_SOCKETS[n];
+        SigioSocket **sock = new SigioSocket*[count];
+        int opened = 0;
+        while (opened < count) {
+            sock[opened] = new SigioSocket;
+            if (sock[opened]->open(&eth) != 0) {
+                delete sock[opened];
+                break;
+            }
+            opened += 1;
+        }
+
+        if (opened == count) {
+            SigioSocket *last = sock[count - 1];
+            last->set_timeout(MBED_CFG_UDP_SIGIO_TIMEOUT);
+            last->events = 0;
+
+            Timer timer;
+            timer.start();
+            int received = 0;
+            for (int i = 0; i < MBED_CFG_UDP_SIGIO_BENCHMARK_COUNT; i += MBED_CFG_UDP_SIGIO_BURST) {
+                int ret = last->sendto_batch(tx_dgrams, MBED_CFG_UDP_SIGIO_BURST);
+                TEST_ASSERT_EQUAL(MBED_CFG_UDP_SIGIO_BURST, ret);
+
+                int burst = 0;
+                while (burst < MBED_CFG_UDP_SIGIO_BURST) {
+                    ret = last->recvfrom_batch(rx_dgrams, MBED_CFG_UDP_SIGIO_BURST - burst);
+                    if (ret <= 0) {
+                        break;
+                    }
+                    burst += ret;
+                }
+                received += burst;
+            }
+            int echo_us = timer.read_us();
+
+            printf("%3d sockets: %d of %d datagrams echoed in %d us, %d us/datagram, %d sigio\n",
+                    count, received, MBED_CFG_UDP_SIGIO_BENCHMARK_COUNT, echo_us,
+                    received ? echo_us / received : 0, last->events);
+            TEST_ASSERT_TRUE(received > 0);
+        } else {
+            printf("%3d sockets: skipped, %d can be opened\n", count, opened);
+        }
+
+        for (int i = 0; i < opened; i++) {
+            sock[i]->close();
+            delete sock[i];
+        }
+        delete[] sock;
+    }
+
+    eth.disconnect();
+}
+
+
+// Test setup
+utest::v1::status_t test_setup(const size_t number_of_cases) {
+    GREENTEA_SETUP_UUID(120, "udp_echo", uuid, GREENTEA_UUID_LENGTH);
+    return verbose_test_setup_handler(number_of_cases);
+}
+
+Case cases[] = {
+    Case("UDP connect", test_udp_connect),
+    Case("UDP sigio for a burst", test_udp_sigio_burst),
+    Case("UDP sigio after rearm", test_udp_sigio_rearm),
+    Case("UDP sigio benchmark", test_udp_sigio_benchmark),
+};
+
+Specification specification(test_setup, cases);
+
+int main() {
+    return !Harness::run(specification);
+}
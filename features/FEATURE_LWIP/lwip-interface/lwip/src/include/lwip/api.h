@@ -268,6 +268,10 @@ struct netconn {
 #endif /* LWIP_TCP */
   /** A callback function that is informed about events for this netconn */
   netconn_callback callback;
+#if LWIP_NETCONN_CALLBACK_ARG
+  /** user pointer for the callback, not used by lwIP */
+  void *callback_arg;
+#endif /* LWIP_NETCONN_CALLBACK_ARG */
 };
 
 /** Register an Network connection event */
@@ -1701,6 +1701,14 @@
 #define LWIP_NETCONN_SEM_PER_THREAD     0
 #endif
 
+/** LWIP_NETCONN_CALLBACK_ARG==1: Add a user pointer to each netconn
+ * (conn->callback_arg, NULL when allocated) so that the netconn callback
+ * can find its owner without searching.
+ */
+#if !defined LWIP_NETCONN_CALLBACK_ARG || defined __DOXYGEN__
+#define LWIP_NETCONN_CALLBACK_ARG       0
+#endif
+
 /** LWIP_NETCONN_FULLDUPLEX==1: Enable code that allows reading from one thread,
  * writing from a 2nd thread and closing from a 3rd thread at the same time.
  * ATTENTION: This is currently really alpha! Some requirements:
@@ -29,6 +29,7 @@
 #include "lwip/netif.h"
 #include "lwip/dhcp.h"
 #include "lwip/tcpip.h"
+#include "lwip/priv/tcpip_priv.h"
 #include "lwip/tcp.h"
 #include "lwip/ip.h"
 #include "lwip/mld6.h"
@@ -46,7 +47,7 @@ static nsapi_error_t mbed_lwip_err_remap(err_t err);
     #define MBED_NETIF_INIT_FN eth_arch_enetif_init
 #endif
 
-/* Static arena of sockets */
+/* Static arena of sockets, the netconn of each socket points back to it */
 static struct lwip_socket {
     bool in_use;
 
@@ -56,8 +57,15 @@ static struct lwip_socket {
 
     void (*cb)(void *);
     void *data;
+    bool notified;
+
+    struct lwip_socket *next;
 } lwip_arena[MEMP_NUM_NETCONN];
 
+/* Sockets returned to the arena, and the number of sockets ever handed out */
+static struct lwip_socket *lwip_arena_free = 0;
+static int lwip_arena_used = 0;
+
 static bool lwip_inited = false;
 static bool lwip_connected = false;
 static bool netif_inited = false;
@@ -67,45 +75,62 @@ static struct lwip_socket *mbed_lwip_arena_alloc(void)
 {
     sys_prot_t prot = sys_arch_protect();
 
-    for (int i = 0; i < MEMP_NUM_NETCONN; i++) {
-        if (!lwip_arena[i].in_use) {
-            struct lwip_socket *s = &lwip_arena[i];
-            memset(s, 0, sizeof *s);
-            s->in_use = true;
-            sys_arch_unprotect(prot);
-            return s;
-        }
+    struct lwip_socket *s = lwip_arena_free;
+    if (s) {
+        lwip_arena_free = s->next;
+    } else if (lwip_arena_used < MEMP_NUM_NETCONN) {
+        s = &lwip_arena[lwip_arena_used++];
+    }
+
+    if (s) {
+        memset(s, 0, sizeof *s);
+        s->in_use = true;
     }
 
     sys_arch_unprotect(prot);
-    return 0;
+    return s;
 }
 
 static void mbed_lwip_arena_dealloc(struct lwip_socket *s)
 {
+    sys_prot_t prot = sys_arch_protect();
+
     s->in_use = false;
+    s->next = lwip_arena_free;
+    lwip_arena_free = s;
+
+    sys_arch_unprotect(prot);
 }
 
 static void mbed_lwip_socket_callback(struct netconn *nc, enum netconn_evt eh, u16_t len)
 {
-    // Filter send minus events
-    if (eh == NETCONN_EVT_SENDMINUS && nc->state == NETCONN_WRITE) {
+    // Filter send minus events, and receive minus events which only
+    // follow reads by the socket itself
+    if ((eh == NETCONN_EVT_SENDMINUS && nc->state == NETCONN_WRITE)
+        || eh == NETCONN_EVT_RCVMINUS) {
         return;
     }
 
     sys_prot_t prot = sys_arch_protect();
 
-    for (int i = 0; i < MEMP_NUM_NETCONN; i++) {
-        if (lwip_arena[i].in_use
-            && lwip_arena[i].conn == nc
-            && lwip_arena[i].cb) {
-            lwip_arena[i].cb(lwip_arena[i].data);
-        }
+    // Notify once until the socket is next used, so a burst of packets
+    // costs a single callback
+    struct lwip_socket *s = (struct lwip_socket *)nc->callback_arg;
+    if (s && s->in_use && s->cb && !s->notified) {
+        s->notified = true;
+        s->cb(s->data);
     }
 
     sys_arch_unprotect(prot);
 }
 
+/* Called by each operation before it looks at the netconn, so that any
+ * later event notifies the socket again */
+static void mbed_lwip_socket_rearm(struct lwip_socket *s)
+{
+    s->notified = false;
+}
+
 
 /* TCP/IP and Network Interface Initialisation */
 static struct netif lwip_netif;
@@ -913,6 +938,8 @@ static nsapi_error_t mbed_lwip_socket_open(nsapi_stack_t *stack, nsapi_socket_t
         return NSAPI_ERROR_NO_SOCKET;
     }
 
+    s->conn->callback_arg = s;
+
     netconn_set_recvtimeout(s->conn, 1);
     *(struct lwip_socket **)handle = s;
     return 0;
@@ -966,6 +993,7 @@ static nsapi_error_t mbed_lwip_socket_connect(nsapi_stack_t *stack, nsapi_socket
         return NSAPI_ERROR_PARAMETER;
     }
 
+    mbed_lwip_socket_rearm(s);
     netconn_set_nonblocking(s->conn, false);
     err_t err = netconn_connect(s->conn, &ip_addr, port);
     netconn_set_nonblocking(s->conn, true);
@@ -981,12 +1009,16 @@ static nsapi_error_t mbed_lwip_socket_accept(nsapi_stack_t *stack, nsapi_socket_
         return NSAPI_ERROR_NO_SOCKET;
     }
 
+    mbed_lwip_socket_rearm(s);
     err_t err = netconn_accept(s->conn, &ns->conn);
     if (err != ERR_OK) {
         mbed_lwip_arena_dealloc(ns);
         return mbed_lwip_err_remap(err);
     }
 
+    // Earlier events are dropped, the socket is not attached yet
+    ns->conn->callback_arg = ns;
+
     netconn_set_recvtimeout(ns->conn, 1);
     *(struct lwip_socket **)handle = ns;
 
@@ -1004,6 +1036,7 @@ static nsapi_size_or_error_t mbed_lwip_socket_send(nsapi_stack_t *stack, nsapi_s
     struct lwip_socket *s = (struct lwip_socket *)handle;
     size_t bytes_written = 0;
 
+    mbed_lwip_socket_rearm(s);
     err_t err = netconn_write_partly(s->conn, data, size, NETCONN_COPY, &bytes_written);
     if (err != ERR_OK) {
         return mbed_lwip_err_remap(err);
@@ -1016,6 +1049,7 @@ static nsapi_size_or_error_t mbed_lwip_socket_recv(nsapi_stack_t *stack, nsapi_s
 {
     struct lwip_socket *s = (struct lwip_socket *)handle;
 
+    mbed_lwip_socket_rearm(s);
     if (!s->buf) {
         err_t err = netconn_recv(s->conn, &s->buf);
         s->offset = 0;
@@ -1045,6 +1079,7 @@ static nsapi_size_or_error_t mbed_lwip_socket_sendto(nsapi_stack_t *stack, nsapi
         return NSAPI_ERROR_PARAMETER;
     }
 
+    mbed_lwip_socket_rearm(s);
     struct netbuf *buf = netbuf_new();
     err_t err = netbuf_ref(buf, data, (u16_t)size);
     if (err != ERR_OK) {
@@ -1066,6 +1101,7 @@ static nsapi_size_or_error_t mbed_lwip_socket_recvfrom(nsapi_stack_t *stack, nsa
     struct lwip_socket *s = (struct lwip_socket *)handle;
     struct netbuf *buf;
 
+    mbed_lwip_socket_rearm(s);
     err_t err = netconn_recv(s->conn, &buf);
     if (err != ERR_OK) {
         return mbed_lwip_err_remap(err);
@@ -1080,6 +1116,353 @@ static nsapi_size_or_error_t mbed_lwip_socket_recvfrom(nsapi_stack_t *stack, nsa
     return recv;
 }
 
+static nsapi_size_or_error_t mbed_lwip_socket_sendmsg(nsapi_stack_t *stack, nsapi_socket_t handle, const nsapi_addr_t *addr, uint16_t port, const nsapi_iovec_t *iov, unsigned iovcnt)
+{
+    struct lwip_socket *s = (struct lwip_socket *)handle;
+
+    mbed_lwip_socket_rearm(s);
+    if (NETCONNTYPE_GROUP(netconn_type(s->conn)) == NETCONN_TCP) {
+        // TCP keeps the data until it is acknowledged, so it is copied to the
+        // segments, but without gathering it first
+        nsapi_size_t sent = 0;
+        for (unsigned i = 0; i < iovcnt; i++) {
+            size_t bytes_written = 0;
+            u8_t flags = NETCONN_COPY | (i + 1 < iovcnt ? NETCONN_MORE : 0);
+            err_t err = netconn_write_partly(s->conn, iov[i].iov_base, iov[i].iov_len, flags, &bytes_written);
+            if (err != ERR_OK) {
+                if (sent) {
+                    break;
+                }
+                return mbed_lwip_err_remap(err);
+            }
+
+            sent += bytes_written;
+            if (bytes_written < iov[i].iov_len) {
+                break;
+            }
+        }
+
+        return sent;
+    }
+
+    ip_addr_t ip_addr;
+    if (addr && !convert_mbed_addr_to_lwip(&ip_addr, addr)) {
+        return NSAPI_ERROR_PARAMETER;
+    }
+
+    // Chain the buffers by reference, the headers are added in front of them
+    struct pbuf *p = NULL;
+    nsapi_size_t size = 0;
+    for (unsigned i = 0; i < iovcnt; i++) {
+        if (!iov[i].iov_len) {
+            continue;
+        }
+
+        size += iov[i].iov_len;
+        struct pbuf *q = size <= 0xffff ? pbuf_alloc(PBUF_TRANSPORT, (u16_t)iov[i].iov_len, PBUF_REF) : NULL;
+        if (!q) {
+            if (p) {
+                pbuf_free(p);
+            }
+            return size <= 0xffff ? NSAPI_ERROR_NO_MEMORY : NSAPI_ERROR_PARAMETER;
+        }
+
+        q->payload = iov[i].iov_base;
+        if (p) {
+            pbuf_cat(p, q);
+        } else {
+            p = q;
+        }
+    }
+
+    if (!p) {
+        p = pbuf_alloc(PBUF_TRANSPORT, 0, PBUF_REF);
+    }
+
+    struct netbuf *buf = netbuf_new();
+    if (!buf || !p) {
+        if (p) {
+            pbuf_free(p);
+        }
+        netbuf_delete(buf);
+        return NSAPI_ERROR_NO_MEMORY;
+    }
+
+    buf->p = buf->ptr = p;
+
+    err_t err;
+    if (addr) {
+        err = netconn_sendto(s->conn, buf, &ip_addr, port);
+    } else {
+        err = netconn_send(s->conn, buf);
+    }
+    netbuf_delete(buf);
+    if (err != ERR_OK) {
+        return mbed_lwip_err_remap(err);
+    }
+
+    return size;
+}
+
+static nsapi_size_or_error_t mbed_lwip_socket_recvmsg(nsapi_stack_t *stack, nsapi_socket_t handle, nsapi_addr_t *addr, uint16_t *port, const nsapi_iovec_t *iov, unsigned iovcnt)
+{
+    struct lwip_socket *s = (struct lwip_socket *)handle;
+
+    mbed_lwip_socket_rearm(s);
+    if (NETCONNTYPE_GROUP(netconn_type(s->conn)) == NETCONN_TCP) {
+        // Fill the buffers in turn, until no more data is pending
+        nsapi_size_t received = 0;
+        for (unsigned i = 0; i < iovcnt; i++) {
+            nsapi_size_or_error_t recv = mbed_lwip_socket_recv(stack, handle, iov[i].iov_base, iov[i].iov_len);
+            if (recv < 0) {
+                if (received) {
+                    break;
+                }
+                return recv;
+            }
+
+            received += recv;
+            if ((nsapi_size_t)recv < iov[i].iov_len || !s->buf) {
+                break;
+            }
+        }
+
+        return received;
+    }
+
+    struct netbuf *buf;
+    err_t err = netconn_recv(s->conn, &buf);
+    if (err != ERR_OK) {
+        return mbed_lwip_err_remap(err);
+    }
+
+    if (addr) {
+        convert_lwip_addr_to_mbed(addr, netbuf_fromaddr(buf));
+        *port = netbuf_fromport(buf);
+    }
+
+    // Scatter the packet, what does not fit is dropped
+    u16_t offset = 0;
+    for (unsigned i = 0; i < iovcnt && offset < netbuf_len(buf); i++) {
+        offset += netbuf_copy_partial(buf, iov[i].iov_base, (u16_t)iov[i].iov_len, offset);
+    }
+    netbuf_delete(buf);
+
+    return offset;
+}
+
+static nsapi_size_or_error_t mbed_lwip_socket_recv_borrow(nsapi_stack_t *stack, nsapi_socket_t handle, nsapi_addr_t *addr, uint16_t *port, nsapi_recv_view_t *view)
+{
+    struct lwip_socket *s = (struct lwip_socket *)handle;
+    bool tcp = NETCONNTYPE_GROUP(netconn_type(s->conn)) == NETCONN_TCP;
+    struct netbuf *buf;
+    u16_t offset = 0;
+
+    if (!view->iovcnt) {
+        return NSAPI_ERROR_PARAMETER;
+    }
+
+    mbed_lwip_socket_rearm(s);
+    if (tcp && s->buf) {
+        // Take over what is left by recv
+        buf = s->buf;
+        offset = s->offset;
+    } else {
+        err_t err = netconn_recv(s->conn, &buf);
+        if (err != ERR_OK) {
+            if (err == ERR_CLSD) {
+                view->iovcnt = 0;
+                view->handle = 0;
+            }
+            return mbed_lwip_err_remap(err);
+        }
+    }
+
+    // Skip the pbufs already received
+    struct pbuf *q = buf->p;
+    while (q && offset >= q->len) {
+        offset -= q->len;
+        q = q->next;
+    }
+
+    // Point the segments at the pbufs, the rest of a TCP netbuf stays with
+    // the socket and the rest of a packet is discarded on release
+    struct pbuf *last = 0;
+    nsapi_size_t size = 0;
+    unsigned count = 0;
+    for (; q && count < view->iovcnt; q = q->next) {
+        if (q->len > offset) {
+            view->iov[count].iov_base = (u8_t *)q->payload + offset;
+            view->iov[count].iov_len = q->len - offset;
+            size += q->len - offset;
+            count++;
+        }
+        offset = 0;
+        last = q;
+    }
+
+    if (tcp && q && q->tot_len) {
+        struct netbuf *rest = netbuf_new();
+        if (!rest) {
+            if (s->buf != buf) {
+                s->buf = buf;
+                s->offset = 0;
+            }
+            return NSAPI_ERROR_NO_MEMORY;
+        }
+
+        for (struct pbuf *r = buf->p; r != q; r = r->next) {
+            r->tot_len -= q->tot_len;
+        }
+        last->next = 0;
+
+        rest->p = rest->ptr = q;
+        s->buf = rest;
+        s->offset = 0;
+    } else if (tcp) {
+        s->buf = 0;
+    }
+
+    if (addr) {
+        convert_lwip_addr_to_mbed(addr, netbuf_fromaddr(buf));
+        *port = netbuf_fromport(buf);
+    }
+
+    view->iovcnt = count;
+    view->handle = buf;
+    return size;
+}
+
+static void mbed_lwip_socket_recv_release(nsapi_stack_t *stack, nsapi_socket_t handle, nsapi_recv_view_t *view)
+{
+    netbuf_delete((struct netbuf *)view->handle);
+    view->handle = 0;
+    view->iovcnt = 0;
+}
+
+/* Batch of datagrams sent by the tcpip thread */
+struct mbed_lwip_batch {
+    struct tcpip_api_call_data call;
+    struct netconn *conn;
+    const nsapi_datagram_t *dgrams;
+    unsigned count;
+    unsigned sent;
+};
+
+static err_t mbed_lwip_socket_sendto_batch_call(struct tcpip_api_call_data *call)
+{
+    struct mbed_lwip_batch *batch = (struct mbed_lwip_batch *)call;
+    struct netconn *conn = batch->conn;
+
+    if (ERR_IS_FATAL(conn->last_err)) {
+        return conn->last_err;
+    }
+
+    if (!conn->pcb.udp) {
+        return ERR_CONN;
+    }
+
+    for (; batch->sent < batch->count; batch->sent++) {
+        const nsapi_datagram_t *dgram = &batch->dgrams[batch->sent];
+        ip_addr_t ip_addr;
+        if (!convert_mbed_addr_to_lwip(&ip_addr, &dgram->addr) || dgram->size > 0xffff) {
+            return ERR_VAL;
+        }
+
+        // The payload is referenced, the caller waits for the whole batch
+        struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, (u16_t)dgram->size, PBUF_REF);
+        if (!p) {
+            return ERR_MEM;
+        }
+
+        p->payload = dgram->data;
+        err_t err = udp_sendto(conn->pcb.udp, p, &ip_addr, dgram->port);
+        pbuf_free(p);
+        if (err != ERR_OK) {
+            return err;
+        }
+    }
+
+    return ERR_OK;
+}
+
+static nsapi_size_or_error_t mbed_lwip_socket_sendto_batch(nsapi_stack_t *stack, nsapi_socket_t handle, const nsapi_datagram_t *dgrams, unsigned count)
+{
+    struct lwip_socket *s = (struct lwip_socket *)handle;
+
+    if (NETCONNTYPE_GROUP(netconn_type(s->conn)) != NETCONN_UDP) {
+        return NSAPI_ERROR_UNSUPPORTED;
+    }
+
+    // One message to the tcpip thread for the whole batch, instead of
+    // one netconn_sendto each
+    struct mbed_lwip_batch batch;
+    batch.conn = s->conn;
+    batch.dgrams = dgrams;
+    batch.count = count;
+    batch.sent = 0;
+
+    mbed_lwip_socket_rearm(s);
+    err_t err = tcpip_api_call(mbed_lwip_socket_sendto_batch_call, &batch.call);
+    if (err != ERR_OK && !batch.sent) {
+        return mbed_lwip_err_remap(err);
+    }
+
+    return batch.sent;
+}
+
+/* Takes a packet already queued on a UDP netconn, like netconn_recv
+ * but without waiting for the receive timeout */
+static struct netbuf *mbed_lwip_socket_recv_queued(struct netconn *conn)
+{
+    void *buf;
+    if (ERR_IS_FATAL(conn->last_err)
+        || sys_arch_mbox_tryfetch(&conn->recvmbox, &buf) == SYS_MBOX_EMPTY) {
+        return 0;
+    }
+
+#if LWIP_SO_RCVBUF
+    SYS_ARCH_DEC(conn->recv_avail, netbuf_len((struct netbuf *)buf));
+#endif
+    API_EVENT(conn, NETCONN_EVT_RCVMINUS, netbuf_len((struct netbuf *)buf));
+    return (struct netbuf *)buf;
+}
+
+static nsapi_size_or_error_t mbed_lwip_socket_recvfrom_batch(nsapi_stack_t *stack, nsapi_socket_t handle, nsapi_datagram_t *dgrams, unsigned count)
+{
+    struct lwip_socket *s = (struct lwip_socket *)handle;
+    unsigned received = 0;
+
+    if (NETCONNTYPE_GROUP(netconn_type(s->conn)) != NETCONN_UDP) {
+        return NSAPI_ERROR_UNSUPPORTED;
+    }
+
+    mbed_lwip_socket_rearm(s);
+    while (received < count) {
+        struct netbuf *buf;
+        if (!received) {
+            // Wait for the first packet as recvfrom does
+            err_t err = netconn_recv(s->conn, &buf);
+            if (err != ERR_OK) {
+                return mbed_lwip_err_remap(err);
+            }
+        } else {
+            buf = mbed_lwip_socket_recv_queued(s->conn);
+            if (!buf) {
+                break;
+            }
+        }
+
+        nsapi_datagram_t *dgram = &dgrams[received++];
+        convert_lwip_addr_to_mbed(&dgram->addr, netbuf_fromaddr(buf));
+        dgram->port = netbuf_fromport(buf);
+        dgram->len = netbuf_copy(buf, dgram->data, dgram->size > 0xffff ? 0xffff : (u16_t)dgram->size);
+        netbuf_delete(buf);
+    }
+
+    return received;
+}
+
 static nsapi_error_t mbed_lwip_setsockopt(nsapi_stack_t *stack, nsapi_socket_t handle, int level, int optname, const void *optval, unsigned optlen)
 {
     struct lwip_socket *s = (struct lwip_socket *)handle;
@@ -1134,6 +1517,7 @@ static void mbed_lwip_socket_attach(nsapi_stack_t *stack, nsapi_socket_t handle,
 
     s->cb = callback;
     s->data = data;
+    mbed_lwip_socket_rearm(s);
 }
 
 /* LWIP network stack */
@@ -1150,6 +1534,12 @@ const nsapi_stack_api_t lwip_stack_api = {
     .socket_recv        = mbed_lwip_socket_recv,
     .socket_sendto      = mbed_lwip_socket_sendto,
     .socket_recvfrom    = mbed_lwip_socket_recvfrom,
+    .socket_sendmsg     = mbed_lwip_socket_sendmsg,
+    .socket_recvmsg     = mbed_lwip_socket_recvmsg,
+    .socket_recv_borrow = mbed_lwip_socket_recv_borrow,
+    .socket_recv_release = mbed_lwip_socket_recv_release,
+    .socket_sendto_batch = mbed_lwip_socket_sendto_batch,
+    .socket_recvfrom_batch = mbed_lwip_socket_recvfrom_batch,
     .setsockopt         = mbed_lwip_setsockopt,
     .socket_attach      = mbed_lwip_socket_attach,
 };
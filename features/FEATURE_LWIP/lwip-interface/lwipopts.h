@@ -197,6 +197,9 @@
 #define LWIP_DNS                    1
 #define LWIP_SOCKET                 0
 
+// Socket events find their socket through the netconn
+#define LWIP_NETCONN_CALLBACK_ARG   1
+
 #define SO_REUSE                    1
 
 // Support Multicast
@@ -19,6 +19,8 @@
 #include "utest.h"
 
 #include "HeapBlockDevice.h"
+#include "ProfilingBlockDevice.h"
+#include "CachingBlockDevice.h"
 #include "FATFileSystem.h"
 #include <stdlib.h>
 #include "mbed_retarget.h"
@@ -145,6 +147,194 @@ void test_read_dir() {
     TEST_ASSERT_EQUAL(0, err);
 }
 
+// Test for reading a file at random offsets
+void test_random_seek() {
+    FATFileSystem fs("fat");
+
+    int err = fs.mount(&bd);
+    TEST_ASSERT_EQUAL(0, err);
+
+    // Fast seek is only supported if enabled in the configuration
+    err = fs.set_fast_seek(true);
+    TEST_ASSERT(err == 0 || err == -ENOSYS);
+
+    const int file_size = 64*BLOCK_SIZE;
+    uint32_t buffer[BLOCK_SIZE/4];
+
+    File file;
+    err = file.open(&fs, "test_random_seek", O_WRONLY | O_CREAT);
+    TEST_ASSERT_EQUAL(0, err);
+
+    // Each word holds its own offset
+    for (int offset = 0; offset < file_size; offset += BLOCK_SIZE) {
+        for (int i = 0; i < BLOCK_SIZE/4; i++) {
+            buffer[i] = offset + 4*i;
+        }
+
+        ssize_t size = file.write(buffer, BLOCK_SIZE);
+        TEST_ASSERT_EQUAL(BLOCK_SIZE, size);
+    }
+
+    err = file.close();
+    TEST_ASSERT_EQUAL(0, err);
+
+    err = file.open(&fs, "test_random_seek", O_RDONLY);
+    TEST_ASSERT_EQUAL(0, err);
+
+    srand(1);
+    for (int i = 0; i < 256; i++) {
+        off_t offset = 4*(rand() % ((file_size - BLOCK_SIZE)/4));
+
+        off_t res = file.seek(offset, SEEK_SET);
+        TEST_ASSERT_EQUAL(offset, res);
+
+        ssize_t size = file.read(buffer, BLOCK_SIZE);
+        TEST_ASSERT_EQUAL(BLOCK_SIZE, size);
+        TEST_ASSERT_EQUAL(offset, buffer[0]);
+        TEST_ASSERT_EQUAL(offset + BLOCK_SIZE - 4, buffer[BLOCK_SIZE/4 - 1]);
+    }
+
+    err = file.close();
+    TEST_ASSERT_EQUAL(0, err);
+
+    err = fs.remove("test_random_seek");
+    TEST_ASSERT_EQUAL(0, err);
+
+    err = fs.unmount();
+    TEST_ASSERT_EQUAL(0, err);
+}
+
+// Stream a file through the sector buffer or directly, returning the time
+// taken in us
+static int stream_file(FATFileSystem *fs, int direct, bool write) {
+    const int file_size = 32*BLOCK_SIZE;
+    const int chunk_size = 8*BLOCK_SIZE;
+    static uint32_t buffer[chunk_size/4];
+
+    File file;
+    int err = file.open(fs, "test_direct_io", (write ? O_WRONLY | O_CREAT | O_TRUNC : O_RDONLY) | direct);
+    TEST_ASSERT_EQUAL(0, err);
+
+    Timer timer;
+    timer.start();
+    for (int offset = 0; offset < file_size; offset += chunk_size) {
+        if (write) {
+            for (int i = 0; i < chunk_size/4; i++) {
+                buffer[i] = offset + 4*i;
+            }
+
+            ssize_t size = file.write(buffer, chunk_size);
+            TEST_ASSERT_EQUAL(chunk_size, size);
+        } else {
+            ssize_t size = file.read(buffer, chunk_size);
+            TEST_ASSERT_EQUAL(chunk_size, size);
+            TEST_ASSERT_EQUAL(offset, buffer[0]);
+            TEST_ASSERT_EQUAL(offset + chunk_size - 4, buffer[chunk_size/4 - 1]);
+        }
+    }
+
+    err = file.close();
+    timer.stop();
+    TEST_ASSERT_EQUAL(0, err);
+
+    return timer.read_us();
+}
+
+// Test for the direct transfers of whole sectors
+void test_direct_io() {
+    ProfilingBlockDevice profiler(&bd);
+    FATFileSystem fs("fat");
+
+    int err = fs.mount(&profiler);
+    TEST_ASSERT_EQUAL(0, err);
+
+    for (int direct = 0; direct <= O_DIRECT; direct += O_DIRECT) {
+        profiler.reset();
+        int write_us = stream_file(&fs, direct, true);
+        int read_us = stream_file(&fs, direct, false);
+        printf("%s: write %d us, read %d us, %llu bytes read, %llu bytes programmed\n",
+                direct ? "direct" : "buffered", write_us, read_us,
+                profiler.get_read_count(), profiler.get_program_count());
+    }
+
+    err = fs.remove("test_direct_io");
+    TEST_ASSERT_EQUAL(0, err);
+
+    err = fs.unmount();
+    TEST_ASSERT_EQUAL(0, err);
+}
+
+// Walk directories, returning the number of reads of the block device
+static bd_size_t walk_dirs(BlockDevice *top, ProfilingBlockDevice *profiler) {
+    FATFileSystem fs("fat");
+
+    int err = fs.mount(top);
+    TEST_ASSERT_EQUAL(0, err);
+
+    profiler->reset();
+
+    for (int i = 0; i < 3; i++) {
+        Dir dir;
+        err = dir.open(&fs, "test_walk_dirs");
+        TEST_ASSERT_EQUAL(0, err);
+
+        struct dirent *de;
+        while ((de = readdir(&dir))) {
+            if (de->d_type == DT_REG) {
+                char path[NAME_MAX];
+                snprintf(path, NAME_MAX, "test_walk_dirs/%s", de->d_name);
+
+                struct stat st;
+                err = fs.stat(path, &st);
+                TEST_ASSERT_EQUAL(0, err);
+            }
+        }
+
+        err = dir.close();
+        TEST_ASSERT_EQUAL(0, err);
+    }
+
+    bd_size_t reads = profiler->get_read_count();
+
+    err = fs.unmount();
+    TEST_ASSERT_EQUAL(0, err);
+
+    return reads;
+}
+
+// Test for the reads saved by a cache on directory operations
+void test_cached_dirs() {
+    ProfilingBlockDevice profiler(&bd);
+    CachingBlockDevice cache(&profiler, 8);
+
+    FATFileSystem fs("fat");
+
+    int err = fs.mount(&cache);
+    TEST_ASSERT_EQUAL(0, err);
+
+    err = fs.mkdir("test_walk_dirs", S_IRWXU | S_IRWXG | S_IRWXO);
+    TEST_ASSERT_EQUAL(0, err);
+
+    for (int i = 0; i < 32; i++) {
+        char path[NAME_MAX];
+        snprintf(path, NAME_MAX, "test_walk_dirs/test_file_%d", i);
+
+        File file;
+        err = file.open(&fs, path, O_WRONLY | O_CREAT);
+        TEST_ASSERT_EQUAL(0, err);
+        err = file.close();
+        TEST_ASSERT_EQUAL(0, err);
+    }
+
+    err = fs.unmount();
+    TEST_ASSERT_EQUAL(0, err);
+
+    bd_size_t uncached = walk_dirs(&profiler, &profiler);
+    bd_size_t cached = walk_dirs(&cache, &profiler);
+    printf("device reads: %llu bytes uncached, %llu bytes cached\n", uncached, cached);
+    TEST_ASSERT(cached < uncached);
+}
+
 
 // Test setup
 utest::v1::status_t test_setup(const size_t number_of_cases) {
@@ -157,6 +347,9 @@ Case cases[] = {
     Case("Testing read write < block", test_read_write<BLOCK_SIZE/2>),
     Case("Testing read write > block", test_read_write<2*BLOCK_SIZE>),
     Case("Testing dir iteration", test_read_dir),
+    Case("Testing dir iteration through a cache", test_cached_dirs),
+    Case("Testing random seeks", test_random_seek),
+    Case("Testing direct io", test_direct_io),
 };
 
 Specification specification(test_setup, cases);
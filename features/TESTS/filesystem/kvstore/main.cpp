@@ -0,0 +1,587 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "mbed.h"
+#include "greentea-client/test_env.h"
+#include "unity.h"
+#include "utest.h"
+
+#include "HeapBlockDevice.h"
+#include "SlicingBlockDevice.h"
+#include "KVStore.h"
+#include <stdlib.h>
+#include <errno.h>
+
+using namespace utest::v1;
+
+// Test block device
+#define BLOCK_SIZE 512
+#define BLOCK_COUNT 16
+#define PROGRAM_SIZE 4
+#define BENCH_COUNT 1000
+
+
+// Block device counting erases, and cutting the power on a given program,
+// which is left half done
+class TestBlockDevice : public BlockDevice
+{
+public:
+    TestBlockDevice(BlockDevice *bd)
+        : _bd(bd), _countdown(0), _dead(false)
+    {
+        memset(erases, 0, sizeof(erases));
+    }
+
+    void cut_power_at(int program) {
+        _countdown = program;
+        _dead = false;
+    }
+
+    bool dead() const {
+        return _dead;
+    }
+
+    virtual int init() { return _bd->init(); }
+    virtual int deinit() { return _bd->deinit(); }
+
+    virtual int read(void *buffer, bd_addr_t addr, bd_size_t size) {
+        return _bd->read(buffer, addr, size);
+    }
+
+    virtual int program(const void *buffer, bd_addr_t addr, bd_size_t size) {
+        if (_dead) {
+            return BD_ERROR_DEVICE_ERROR;
+        }
+
+        if (_countdown && --_countdown == 0) {
+            _dead = true;
+            bd_size_t half = (size / 2) - (size / 2) % get_program_size();
+            if (half) {
+                _bd->program(buffer, addr, half);
+            }
+            return BD_ERROR_DEVICE_ERROR;
+        }
+
+        return _bd->program(buffer, addr, size);
+    }
+
+    virtual int erase(bd_addr_t addr, bd_size_t size) {
+        if (_dead) {
+            return BD_ERROR_DEVICE_ERROR;
+        }
+
+        for (bd_addr_t a = addr; a < addr + size; a += get_erase_size()) {
+            erases[a / get_erase_size()] += 1;
+        }
+        return _bd->erase(addr, size);
+    }
+
+    virtual bd_size_t get_read_size() const { return _bd->get_read_size(); }
+    virtual bd_size_t get_program_size() const { return _bd->get_program_size(); }
+    virtual bd_size_t get_erase_size() const { return _bd->get_erase_size(); }
+    virtual bd_size_t size() const { return _bd->size(); }
+
+private:
+    BlockDevice *_bd;
+    int _countdown;
+    bool _dead;
+
+public:
+    uint32_t erases[BLOCK_COUNT];
+};
+
+static int key_count;
+static int count_key(const char *key, size_t size)
+{
+    key_count += 1;
+    return 0;
+}
+
+
+// Simple test of setting, getting and removing keys
+void test_set_get_remove() {
+    HeapBlockDevice bd(BLOCK_COUNT*BLOCK_SIZE, 1, PROGRAM_SIZE, BLOCK_SIZE);
+    int err = KVStore::format(&bd);
+    TEST_ASSERT_EQUAL(0, err);
+
+    KVStore kv;
+    err = kv.mount(&bd);
+    TEST_ASSERT_EQUAL(0, err);
+
+    err = kv.set("alpha", "hello", 5);
+    TEST_ASSERT_EQUAL(0, err);
+    err = kv.set("beta", "world!", 6);
+    TEST_ASSERT_EQUAL(0, err);
+    err = kv.set("alpha", "hi", 2);
+    TEST_ASSERT_EQUAL(0, err);
+
+    char buffer[16];
+    size_t size;
+    err = kv.get("alpha", buffer, sizeof(buffer), &size);
+    TEST_ASSERT_EQUAL(0, err);
+    TEST_ASSERT_EQUAL(2, size);
+    TEST_ASSERT_EQUAL(0, memcmp(buffer, "hi", 2));
+
+    // Values are truncated to the buffer
+    err = kv.get("beta", buffer, 3, &size);
+    TEST_ASSERT_EQUAL(0, err);
+    TEST_ASSERT_EQUAL(6, size);
+    TEST_ASSERT_EQUAL(0, memcmp(buffer, "wor", 3));
+
+    err = kv.get("gamma", buffer, sizeof(buffer), &size);
+    TEST_ASSERT_EQUAL(-ENOENT, err);
+
+    key_count = 0;
+    err = kv.iterate(NULL, count_key);
+    TEST_ASSERT_EQUAL(0, err);
+    TEST_ASSERT_EQUAL(2, key_count);
+
+    key_count = 0;
+    err = kv.iterate("al", count_key);
+    TEST_ASSERT_EQUAL(0, err);
+    TEST_ASSERT_EQUAL(1, key_count);
+
+    err = kv.remove("alpha");
+    TEST_ASSERT_EQUAL(0, err);
+    err = kv.remove("alpha");
+    TEST_ASSERT_EQUAL(-ENOENT, err);
+    err = kv.get("alpha", buffer, sizeof(buffer), &size);
+    TEST_ASSERT_EQUAL(-ENOENT, err);
+
+    err = kv.unmount();
+    TEST_ASSERT_EQUAL(0, err);
+
+    // Keys and removals survive a remount
+    err = kv.mount(&bd);
+    TEST_ASSERT_EQUAL(0, err);
+
+    err = kv.get("alpha", buffer, sizeof(buffer), &size);
+    TEST_ASSERT_EQUAL(-ENOENT, err);
+    err = kv.get("beta", buffer, sizeof(buffer), &size);
+    TEST_ASSERT_EQUAL(0, err);
+    TEST_ASSERT_EQUAL(6, size);
+    TEST_ASSERT_EQUAL(0, memcmp(buffer, "world!", 6));
+
+    err = kv.unmount();
+    TEST_ASSERT_EQUAL(0, err);
+
+    // Formatting removes all keys
+    err = KVStore::format(&bd);
+    TEST_ASSERT_EQUAL(0, err);
+    err = kv.mount(&bd);
+    TEST_ASSERT_EQUAL(0, err);
+    err = kv.get("beta", buffer, sizeof(buffer), &size);
+    TEST_ASSERT_EQUAL(-ENOENT, err);
+    err = kv.unmount();
+    TEST_ASSERT_EQUAL(0, err);
+}
+
+// Test stores on slices of a block device
+void test_slicing() {
+    HeapBlockDevice bd(BLOCK_COUNT*BLOCK_SIZE, 1, PROGRAM_SIZE, BLOCK_SIZE);
+    SlicingBlockDevice slice1(&bd, 0, (BLOCK_COUNT/2)*BLOCK_SIZE);
+    SlicingBlockDevice slice2(&bd, (BLOCK_COUNT/2)*BLOCK_SIZE);
+
+    int err = KVStore::format(&slice1);
+    TEST_ASSERT_EQUAL(0, err);
+    err = KVStore::format(&slice2);
+    TEST_ASSERT_EQUAL(0, err);
+
+    KVStore kv1;
+    err = kv1.mount(&slice1);
+    TEST_ASSERT_EQUAL(0, err);
+    KVStore kv2;
+    err = kv2.mount(&slice2);
+    TEST_ASSERT_EQUAL(0, err);
+
+    for (int i = 0; i < 200; i++) {
+        err = kv1.set("key", &i, sizeof(i));
+        TEST_ASSERT_EQUAL(0, err);
+        int j = -i;
+        err = kv2.set("key", &j, sizeof(j));
+        TEST_ASSERT_EQUAL(0, err);
+    }
+
+    err = kv1.unmount();
+    TEST_ASSERT_EQUAL(0, err);
+    err = kv2.unmount();
+    TEST_ASSERT_EQUAL(0, err);
+
+    err = kv1.mount(&slice1);
+    TEST_ASSERT_EQUAL(0, err);
+    err = kv2.mount(&slice2);
+    TEST_ASSERT_EQUAL(0, err);
+
+    int value;
+    err = kv1.get("key", &value, sizeof(value));
+    TEST_ASSERT_EQUAL(0, err);
+    TEST_ASSERT_EQUAL(199, value);
+    err = kv2.get("key", &value, sizeof(value));
+    TEST_ASSERT_EQUAL(0, err);
+    TEST_ASSERT_EQUAL(-199, value);
+
+    err = kv1.unmount();
+    TEST_ASSERT_EQUAL(0, err);
+    err = kv2.unmount();
+    TEST_ASSERT_EQUAL(0, err);
+}
+
+// Test that space is reclaimed and wear is spread over the blocks,
+// when a few static keys are mixed with a hot one
+void test_wear_leveling() {
+    HeapBlockDevice heap(BLOCK_COUNT*BLOCK_SIZE, 1, PROGRAM_SIZE, BLOCK_SIZE);
+    TestBlockDevice bd(&heap);
+    int err = KVStore::format(&bd);
+    TEST_ASSERT_EQUAL(0, err);
+    memset(bd.erases, 0, sizeof(bd.erases));
+
+    KVStore kv;
+    err = kv.mount(&bd);
+    TEST_ASSERT_EQUAL(0, err);
+
+    uint8_t buffer[64];
+    for (int i = 0; i < 32; i++) {
+        char key[16];
+        sprintf(key, "static%d", i);
+        memset(buffer, i, sizeof(buffer));
+        err = kv.set(key, buffer, sizeof(buffer));
+        TEST_ASSERT_EQUAL(0, err);
+    }
+
+    for (int i = 0; i < 5000; i++) {
+        err = kv.set("hot", &i, sizeof(i));
+        TEST_ASSERT_EQUAL(0, err);
+    }
+
+    uint32_t min = 0xffffffff;
+    uint32_t max = 0;
+    for (int b = 0; b < BLOCK_COUNT; b++) {
+        min = bd.erases[b] < min ? bd.erases[b] : min;
+        max = bd.erases[b] > max ? bd.erases[b] : max;
+    }
+    printf("erases per block: min %lu, max %lu\n",
+            (unsigned long)min, (unsigned long)max);
+    TEST_ASSERT(min > 0);
+    TEST_ASSERT(max - min <= 1);
+
+    err = kv.unmount();
+    TEST_ASSERT_EQUAL(0, err);
+
+    // Static keys survive being moved around
+    err = kv.mount(&bd);
+    TEST_ASSERT_EQUAL(0, err);
+    for (int i = 0; i < 32; i++) {
+        char key[16];
+        sprintf(key, "static%d", i);
+        err = kv.get(key, buffer, sizeof(buffer));
+        TEST_ASSERT_EQUAL(0, err);
+        TEST_ASSERT_EQUAL(i, buffer[0]);
+        TEST_ASSERT_EQUAL(i, buffer[sizeof(buffer)-1]);
+    }
+
+    int value;
+    err = kv.get("hot", &value, sizeof(value));
+    TEST_ASSERT_EQUAL(0, err);
+    TEST_ASSERT_EQUAL(4999, value);
+
+    // Filling the store fails cleanly
+    for (int i = 0; ; i++) {
+        char key[16];
+        sprintf(key, "fill%d", i);
+        err = kv.set(key, buffer, sizeof(buffer));
+        if (err) {
+            break;
+        }
+    }
+    TEST_ASSERT_EQUAL(-ENOSPC, err);
+    err = kv.get("hot", &value, sizeof(value));
+    TEST_ASSERT_EQUAL(0, err);
+    TEST_ASSERT_EQUAL(4999, value);
+
+    err = kv.unmount();
+    TEST_ASSERT_EQUAL(0, err);
+}
+
+// Test that a full store reports no free space, and that keys can still
+// be removed from it
+void test_full() {
+    // Records are aligned to the program size, each one used here takes
+    // a single program unit so that they fill the blocks exactly
+    const bd_size_t program_size = 32;
+    HeapBlockDevice bd(BLOCK_COUNT*BLOCK_SIZE, 1, program_size, BLOCK_SIZE);
+    int err = KVStore::format(&bd);
+    TEST_ASSERT_EQUAL(0, err);
+
+    KVStore kv;
+    err = kv.mount(&bd);
+    TEST_ASSERT_EQUAL(0, err);
+    bd_size_t empty = kv.free_size();
+
+    uint8_t buffer[10] = {0};
+    int count;
+    for (count = 0; ; count++) {
+        char key[16];
+        sprintf(key, "key%d", count);
+        err = kv.set(key, buffer, sizeof(buffer));
+        if (err) {
+            break;
+        }
+    }
+    TEST_ASSERT_EQUAL(-ENOSPC, err);
+    TEST_ASSERT(count > 0);
+    TEST_ASSERT(kv.free_size() < program_size);
+
+    for (int i = 0; i < count; i++) {
+        char key[16];
+        sprintf(key, "key%d", i);
+        err = kv.remove(key);
+        TEST_ASSERT_EQUAL(0, err);
+    }
+    TEST_ASSERT_EQUAL(empty, kv.free_size());
+
+    err = kv.unmount();
+    TEST_ASSERT_EQUAL(0, err);
+
+    // The removals are kept, and the space can be used again
+    err = kv.mount(&bd);
+    TEST_ASSERT_EQUAL(0, err);
+    key_count = 0;
+    err = kv.iterate(NULL, count_key);
+    TEST_ASSERT_EQUAL(0, err);
+    TEST_ASSERT_EQUAL(0, key_count);
+
+    for (int i = 0; i < count; i++) {
+        char key[16];
+        sprintf(key, "key%d", i);
+        err = kv.set(key, buffer, sizeof(buffer));
+        TEST_ASSERT_EQUAL(0, err);
+    }
+
+    err = kv.unmount();
+    TEST_ASSERT_EQUAL(0, err);
+}
+
+// Test that transactions are applied all at once
+void test_transactions() {
+    HeapBlockDevice bd(BLOCK_COUNT*BLOCK_SIZE, 1, PROGRAM_SIZE, BLOCK_SIZE);
+    int err = KVStore::format(&bd);
+    TEST_ASSERT_EQUAL(0, err);
+
+    KVStore kv;
+    err = kv.mount(&bd);
+    TEST_ASSERT_EQUAL(0, err);
+
+    int a = 1, b = 1, c = 1;
+    err = kv.set("a", &a, sizeof(a));
+    TEST_ASSERT_EQUAL(0, err);
+    err = kv.set("c", &c, sizeof(c));
+    TEST_ASSERT_EQUAL(0, err);
+
+    err = kv.begin();
+    TEST_ASSERT_EQUAL(0, err);
+    a = 2;
+    err = kv.set("a", &a, sizeof(a));
+    TEST_ASSERT_EQUAL(0, err);
+    b = 2;
+    err = kv.set("b", &b, sizeof(b));
+    TEST_ASSERT_EQUAL(0, err);
+    err = kv.remove("c");
+    TEST_ASSERT_EQUAL(0, err);
+    err = kv.remove("c");
+    TEST_ASSERT_EQUAL(-ENOENT, err);
+
+    // Nothing is visible before the commit
+    int value;
+    err = kv.get("a", &value, sizeof(value));
+    TEST_ASSERT_EQUAL(0, err);
+    TEST_ASSERT_EQUAL(1, value);
+    err = kv.get("b", &value, sizeof(value));
+    TEST_ASSERT_EQUAL(-ENOENT, err);
+
+    err = kv.commit();
+    TEST_ASSERT_EQUAL(0, err);
+
+    err = kv.get("a", &value, sizeof(value));
+    TEST_ASSERT_EQUAL(0, err);
+    TEST_ASSERT_EQUAL(2, value);
+    err = kv.get("b", &value, sizeof(value));
+    TEST_ASSERT_EQUAL(0, err);
+    TEST_ASSERT_EQUAL(2, value);
+    err = kv.get("c", &value, sizeof(value));
+    TEST_ASSERT_EQUAL(-ENOENT, err);
+
+    // Aborted transactions are dropped
+    err = kv.begin();
+    TEST_ASSERT_EQUAL(0, err);
+    a = 3;
+    err = kv.set("a", &a, sizeof(a));
+    TEST_ASSERT_EQUAL(0, err);
+    err = kv.abort();
+    TEST_ASSERT_EQUAL(0, err);
+
+    err = kv.unmount();
+    TEST_ASSERT_EQUAL(0, err);
+    err = kv.mount(&bd);
+    TEST_ASSERT_EQUAL(0, err);
+
+    err = kv.get("a", &value, sizeof(value));
+    TEST_ASSERT_EQUAL(0, err);
+    TEST_ASSERT_EQUAL(2, value);
+    err = kv.get("b", &value, sizeof(value));
+    TEST_ASSERT_EQUAL(0, err);
+    TEST_ASSERT_EQUAL(2, value);
+    err = kv.get("c", &value, sizeof(value));
+    TEST_ASSERT_EQUAL(-ENOENT, err);
+
+    err = kv.unmount();
+    TEST_ASSERT_EQUAL(0, err);
+}
+
+// Test that cutting the power at any program leaves each key with its old or
+// new value, and transactions applied entirely or not at all
+void test_power_cuts() {
+    HeapBlockDevice heap(BLOCK_COUNT*BLOCK_SIZE, 1, PROGRAM_SIZE, BLOCK_SIZE);
+    TestBlockDevice bd(&heap);
+    int err = KVStore::format(&bd);
+    TEST_ASSERT_EQUAL(0, err);
+
+    // Bounds of the counters, an update cut short may or may not be there
+    uint32_t lo[3] = {0, 0, 0};
+    uint32_t hi[3] = {0, 0, 0};
+    int cuts = 0;
+    for (int round = 0; round < 500; round++) {
+        KVStore kv;
+        err = kv.mount(&bd);
+        TEST_ASSERT_EQUAL(0, err);
+
+        // c0 and c1 are set on their own, t0 and t1 in a transaction
+        static const char *keys[] = {"c0", "c1", "t0", "t1"};
+        uint32_t values[4];
+        for (int i = 0; i < 4; i++) {
+            err = kv.get(keys[i], &values[i], sizeof(values[i]));
+            if (err == -ENOENT) {
+                values[i] = 0;
+            } else {
+                TEST_ASSERT_EQUAL(0, err);
+            }
+        }
+
+        for (int i = 0; i < 3; i++) {
+            TEST_ASSERT(values[i] >= lo[i] && values[i] <= hi[i]);
+        }
+        TEST_ASSERT_EQUAL(values[2], values[3]);
+
+        // Filler keeps space being reclaimed
+        uint8_t filler[40];
+        memset(filler, round, sizeof(filler));
+        bd.cut_power_at(1 + (rand() % 32));
+
+        for (int i = 0; i < 3; i++) {
+            lo[i] = values[i];
+            hi[i] = values[i] + 1;
+        }
+
+        err = 0;
+        for (int i = 0; i < 2 && !err; i++) {
+            uint32_t value = values[i] + 1;
+            err = kv.set(keys[i], &value, sizeof(value));
+            if (!err) {
+                lo[i] = value;
+                err = kv.set("filler", filler, sizeof(filler));
+            }
+        }
+
+        if (!err) {
+            uint32_t value = values[2] + 1;
+            err = kv.begin();
+            TEST_ASSERT_EQUAL(0, err);
+            err = kv.set(keys[2], &value, sizeof(value));
+            TEST_ASSERT_EQUAL(0, err);
+            err = kv.set(keys[3], &value, sizeof(value));
+            TEST_ASSERT_EQUAL(0, err);
+            err = kv.commit();
+            if (!err) {
+                lo[2] = value;
+            }
+        }
+
+        if (err) {
+            TEST_ASSERT(bd.dead());
+            cuts += 1;
+        }
+    }
+
+    printf("power cuts: %d\n", cuts);
+    TEST_ASSERT(cuts > 0);
+}
+
+// Measure updates per second and time to mount a full log
+void test_benchmark() {
+    HeapBlockDevice bd(BLOCK_COUNT*BLOCK_SIZE, 1, PROGRAM_SIZE, BLOCK_SIZE);
+    int err = KVStore::format(&bd);
+    TEST_ASSERT_EQUAL(0, err);
+
+    KVStore kv;
+    err = kv.mount(&bd);
+    TEST_ASSERT_EQUAL(0, err);
+
+    Timer timer;
+    timer.start();
+    for (int i = 0; i < BENCH_COUNT; i++) {
+        char key[16];
+        sprintf(key, "key%d", i % 64);
+        err = kv.set(key, &i, sizeof(i));
+        TEST_ASSERT_EQUAL(0, err);
+    }
+    timer.stop();
+    printf("set: %d in %dus, %d per second\n", BENCH_COUNT, timer.read_us(),
+            (int)(BENCH_COUNT / timer.read()));
+
+    err = kv.unmount();
+    TEST_ASSERT_EQUAL(0, err);
+
+    timer.reset();
+    timer.start();
+    err = kv.mount(&bd);
+    timer.stop();
+    TEST_ASSERT_EQUAL(0, err);
+    printf("mount: %dus\n", timer.read_us());
+
+    err = kv.unmount();
+    TEST_ASSERT_EQUAL(0, err);
+}
+
+
+// Test setup
+utest::v1::status_t test_setup(const size_t number_of_cases) {
+    GREENTEA_SETUP(60, "default_auto");
+    return verbose_test_setup_handler(number_of_cases);
+}
+
+Case cases[] = {
+    Case("Testing set, get and remove", test_set_get_remove),
+    Case("Testing stores on slices", test_slicing),
+    Case("Testing wear leveling", test_wear_leveling),
+    Case("Testing a full store", test_full),
+    Case("Testing transactions", test_transactions),
+    Case("Testing power cuts", test_power_cuts),
+    Case("Testing benchmark", test_benchmark),
+};
+
+Specification specification(test_setup, cases);
+
+int main() {
+    return !Harness::run(specification);
+}
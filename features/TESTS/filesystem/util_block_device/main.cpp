@@ -22,6 +22,7 @@
 #include "SlicingBlockDevice.h"
 #include "ChainingBlockDevice.h"
 #include "ProfilingBlockDevice.h"
+#include "CachingBlockDevice.h"
 #include <stdlib.h>
 
 using namespace utest::v1;
@@ -238,6 +239,146 @@ void test_profiling() {
     TEST_ASSERT_EQUAL(BLOCK_SIZE, erase_count);
 }
 
+// Simple test which read/writes blocks through a cache
+void test_caching() {
+    HeapBlockDevice bd(BLOCK_COUNT*BLOCK_SIZE, BLOCK_SIZE);
+    uint8_t *write_block = new uint8_t[BLOCK_SIZE];
+    uint8_t *read_block = new uint8_t[BLOCK_SIZE];
+
+    // Test with a cache of two blocks, profiling the accesses to the device
+    ProfilingBlockDevice profiler(&bd);
+    CachingBlockDevice cache(&profiler, 2);
+
+    int err = cache.init();
+    TEST_ASSERT_EQUAL(0, err);
+
+    TEST_ASSERT_EQUAL(BLOCK_SIZE, cache.get_erase_size());
+    TEST_ASSERT_EQUAL(BLOCK_COUNT*BLOCK_SIZE, cache.size());
+
+    // Fill with random sequence
+    srand(1);
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+        write_block[i] = 0xff & rand();
+    }
+
+    // Write the same block several times, and read it
+    for (int i = 0; i < 4; i++) {
+        err = cache.erase(0, BLOCK_SIZE);
+        TEST_ASSERT_EQUAL(0, err);
+
+        err = cache.program(write_block, 0, BLOCK_SIZE);
+        TEST_ASSERT_EQUAL(0, err);
+    }
+
+    err = cache.read(read_block, 0, BLOCK_SIZE);
+    TEST_ASSERT_EQUAL(0, err);
+
+    // Check that the data was unmodified and the device not accessed
+    srand(1);
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+        TEST_ASSERT_EQUAL(0xff & rand(), read_block[i]);
+    }
+
+    TEST_ASSERT_EQUAL(0, profiler.get_read_count());
+    TEST_ASSERT_EQUAL(0, profiler.get_program_count());
+    TEST_ASSERT_EQUAL(0, profiler.get_erase_count());
+
+    // Sync writes the block back once
+    err = cache.sync();
+    TEST_ASSERT_EQUAL(0, err);
+
+    TEST_ASSERT_EQUAL(BLOCK_SIZE, profiler.get_program_count());
+    TEST_ASSERT_EQUAL(BLOCK_SIZE, profiler.get_erase_count());
+
+    // Check with original block device
+    err = bd.read(read_block, 0, BLOCK_SIZE);
+    TEST_ASSERT_EQUAL(0, err);
+
+    srand(1);
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+        TEST_ASSERT_EQUAL(0xff & rand(), read_block[i]);
+    }
+
+    // Read other blocks, evicting the first one from the cache
+    cache.reset_counts();
+    for (int i = 0; i < 3; i++) {
+        err = cache.read(read_block, BLOCK_SIZE, BLOCK_SIZE);
+        TEST_ASSERT_EQUAL(0, err);
+
+        err = cache.read(read_block, 2*BLOCK_SIZE, BLOCK_SIZE);
+        TEST_ASSERT_EQUAL(0, err);
+    }
+
+    err = cache.read(read_block, 0, BLOCK_SIZE);
+    TEST_ASSERT_EQUAL(0, err);
+
+    TEST_ASSERT_EQUAL(4, cache.get_hit_count());
+    TEST_ASSERT_EQUAL(3, cache.get_miss_count());
+    TEST_ASSERT_EQUAL(3*BLOCK_SIZE, profiler.get_read_count());
+
+    delete[] write_block;
+    delete[] read_block;
+    err = cache.deinit();
+    TEST_ASSERT_EQUAL(0, err);
+}
+
+
+// Test that only the modified program units are written back
+void test_caching_partial() {
+    HeapBlockDevice bd(BLOCK_COUNT*BLOCK_SIZE, 1, BLOCK_SIZE/8, BLOCK_SIZE);
+    uint8_t *write_block = new uint8_t[BLOCK_SIZE/8];
+    uint8_t *read_block = new uint8_t[BLOCK_SIZE/8];
+
+    ProfilingBlockDevice profiler(&bd);
+    CachingBlockDevice cache(&profiler, 2);
+
+    int err = cache.init();
+    TEST_ASSERT_EQUAL(0, err);
+
+    srand(1);
+    for (int i = 0; i < BLOCK_SIZE/8; i++) {
+        write_block[i] = 0xff & rand();
+    }
+
+    // Erase and program a single unit, the erase is written back with it
+    err = cache.erase(0, BLOCK_SIZE);
+    TEST_ASSERT_EQUAL(0, err);
+
+    err = cache.program(write_block, BLOCK_SIZE/8, BLOCK_SIZE/8);
+    TEST_ASSERT_EQUAL(0, err);
+
+    err = cache.sync();
+    TEST_ASSERT_EQUAL(0, err);
+
+    TEST_ASSERT_EQUAL(BLOCK_SIZE/8, profiler.get_program_count());
+    TEST_ASSERT_EQUAL(BLOCK_SIZE, profiler.get_erase_count());
+
+    // Program another unit of the erased block, without erasing it again
+    profiler.reset();
+    err = cache.program(write_block, 3*BLOCK_SIZE/8, BLOCK_SIZE/8);
+    TEST_ASSERT_EQUAL(0, err);
+
+    err = cache.sync();
+    TEST_ASSERT_EQUAL(0, err);
+
+    TEST_ASSERT_EQUAL(BLOCK_SIZE/8, profiler.get_program_count());
+    TEST_ASSERT_EQUAL(0, profiler.get_erase_count());
+
+    // Check with original block device
+    err = bd.read(read_block, 3*BLOCK_SIZE/8, BLOCK_SIZE/8);
+    TEST_ASSERT_EQUAL(0, err);
+
+    srand(1);
+    for (int i = 0; i < BLOCK_SIZE/8; i++) {
+        TEST_ASSERT_EQUAL(0xff & rand(), read_block[i]);
+    }
+
+    delete[] write_block;
+    delete[] read_block;
+    err = cache.deinit();
+    TEST_ASSERT_EQUAL(0, err);
+}
+
 
 // Test setup
 utest::v1::status_t test_setup(const size_t number_of_cases) {
@@ -249,6 +390,8 @@ Case cases[] = {
     Case("Testing slicing of a block device", test_slicing),
     Case("Testing chaining of block devices", test_chaining),
     Case("Testing profiling of block devices", test_profiling),
+    Case("Testing caching of block devices", test_caching),
+    Case("Testing partial programs through a cache", test_caching_partial),
 };
 
 Specification specification(test_setup, cases);
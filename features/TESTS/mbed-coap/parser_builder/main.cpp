@@ -0,0 +1,423 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "mbed.h"
+#include "greentea-client/test_env.h"
+#include "unity.h"
+#include "utest.h"
+
+#include "mbed-coap/sn_coap_protocol.h"
+#include "mbed-coap/sn_coap_header.h"
+#include <stdlib.h>
+
+#ifndef FEATURE_COMMON_PAL
+#error [NOT_SUPPORTED] test requires the COMMON_PAL feature
+#endif
+
+using namespace utest::v1;
+
+#define MESSAGES            3
+#define BUFFER_SIZE         256
+#define BLOCK_SIZE          1024
+#define ITERATIONS          2000
+
+static struct coap_s *coap;
+static uint32_t alloc_cnt;
+static uint8_t token[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+static uint8_t payload[64];
+
+static void *coap_malloc(uint16_t size)
+{
+    alloc_cnt++;
+    return malloc(size);
+}
+
+static void coap_free(void *ptr)
+{
+    free(ptr);
+}
+
+static uint8_t coap_tx(uint8_t *packet, uint16_t len, sn_nsdl_addr_s *addr, void *param)
+{
+    return 1;
+}
+
+static int8_t coap_rx(sn_coap_hdr_s *header, sn_nsdl_addr_s *addr, void *param)
+{
+    return 0;
+}
+
+static void init_options(sn_coap_options_list_s *options)
+{
+    memset(options, 0, sizeof(*options));
+    options->max_age = 60;
+    options->accept = COAP_CT_NONE;
+    options->uri_port = -1;
+    options->observe = -1;
+    options->block1 = -1;
+    options->block2 = -1;
+}
+
+/* A registration update, a blockwise response and a request through a proxy */
+static void init_message(int n, sn_coap_hdr_s *header, sn_coap_options_list_s *options)
+{
+    sn_coap_parser_init_message(header);
+    init_options(options);
+    header->options_list_ptr = options;
+
+    switch (n) {
+        case 0:
+            header->msg_type = COAP_MSG_TYPE_CONFIRMABLE;
+            header->msg_code = COAP_MSG_CODE_REQUEST_GET;
+            header->msg_id = 0x1234;
+            header->token_ptr = token;
+            header->token_len = 4;
+            header->uri_path_ptr = (uint8_t *)"rd/ep1/obj";
+            header->uri_path_len = 10;
+            options->uri_query_ptr = (uint8_t *)"ep=node&lt=3600";
+            options->uri_query_len = 15;
+            options->accept = COAP_CT_LINK_FORMAT;
+            options->observe = 0;
+            break;
+        case 1:
+            header->msg_type = COAP_MSG_TYPE_ACKNOWLEDGEMENT;
+            header->msg_code = COAP_MSG_CODE_RESPONSE_CONTENT;
+            header->msg_id = 7;
+            header->token_ptr = token;
+            header->token_len = 8;
+            header->content_format = COAP_CT_OCTET_STREAM;
+            header->payload_ptr = payload;
+            header->payload_len = sizeof(payload);
+            options->etag_ptr = (uint8_t *)"\x01\x02\x03\x04";
+            options->etag_len = 4;
+            options->block2 = 0x12;
+            break;
+        default:
+            header->msg_type = COAP_MSG_TYPE_NON_CONFIRMABLE;
+            header->msg_code = COAP_MSG_CODE_REQUEST_POST;
+            header->msg_id = 0xfffe;
+            header->uri_path_ptr = (uint8_t *)"a/very/long/path/segment-longer-than-12/x";
+            header->uri_path_len = strlen((char *)header->uri_path_ptr);
+            header->content_format = COAP_CT_TEXT_PLAIN;
+            header->payload_ptr = payload;
+            header->payload_len = 20;
+            options->uri_host_ptr = (uint8_t *)"example.com";
+            options->uri_host_len = 11;
+            options->uri_port = 5683;
+            options->location_path_ptr = (uint8_t *)"loc/1";
+            options->location_path_len = 5;
+            options->location_query_ptr = (uint8_t *)"q=1";
+            options->location_query_len = 3;
+            options->proxy_uri_ptr = (uint8_t *)"coap://proxy.example.com/resource";
+            options->proxy_uri_len = 33;
+            options->max_age = 3600;
+            break;
+    }
+}
+
+static void assert_same_value(const uint8_t *expected, uint16_t expected_len, const uint8_t *actual, uint16_t actual_len)
+{
+    TEST_ASSERT_EQUAL(expected_len, actual_len);
+    if (expected_len) {
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, actual, expected_len);
+    }
+}
+
+static void assert_same_message(sn_coap_hdr_s *expected, sn_coap_hdr_s *actual)
+{
+    TEST_ASSERT_EQUAL(expected->coap_status, actual->coap_status);
+    TEST_ASSERT_EQUAL(expected->msg_type, actual->msg_type);
+    TEST_ASSERT_EQUAL(expected->msg_code, actual->msg_code);
+    TEST_ASSERT_EQUAL(expected->msg_id, actual->msg_id);
+    TEST_ASSERT_EQUAL(expected->content_format, actual->content_format);
+    assert_same_value(expected->token_ptr, expected->token_len, actual->token_ptr, actual->token_len);
+    assert_same_value(expected->uri_path_ptr, expected->uri_path_len, actual->uri_path_ptr, actual->uri_path_len);
+    assert_same_value(expected->payload_ptr, expected->payload_len, actual->payload_ptr, actual->payload_len);
+
+    sn_coap_options_list_s *x = expected->options_list_ptr;
+    sn_coap_options_list_s *y = actual->options_list_ptr;
+    TEST_ASSERT_NOT_NULL(x);
+    TEST_ASSERT_NOT_NULL(y);
+    assert_same_value(x->etag_ptr, x->etag_len, y->etag_ptr, y->etag_len);
+    assert_same_value(x->proxy_uri_ptr, x->proxy_uri_len, y->proxy_uri_ptr, y->proxy_uri_len);
+    assert_same_value(x->uri_host_ptr, x->uri_host_len, y->uri_host_ptr, y->uri_host_len);
+    assert_same_value(x->location_path_ptr, x->location_path_len, y->location_path_ptr, y->location_path_len);
+    assert_same_value(x->location_query_ptr, x->location_query_len, y->location_query_ptr, y->location_query_len);
+    assert_same_value(x->uri_query_ptr, x->uri_query_len, y->uri_query_ptr, y->uri_query_len);
+    TEST_ASSERT_EQUAL(x->accept, y->accept);
+    TEST_ASSERT_EQUAL(x->max_age, y->max_age);
+    TEST_ASSERT_EQUAL(x->uri_port, y->uri_port);
+    TEST_ASSERT_EQUAL(x->observe, y->observe);
+    TEST_ASSERT_EQUAL(x->block1, y->block1);
+    TEST_ASSERT_EQUAL(x->block2, y->block2);
+    TEST_ASSERT_EQUAL(x->use_size1, y->use_size1);
+    TEST_ASSERT_EQUAL(x->use_size2, y->use_size2);
+    TEST_ASSERT_EQUAL(x->size1, y->size1);
+    TEST_ASSERT_EQUAL(x->size2, y->size2);
+}
+
+/* Both parsers give the same message, and it builds back to the same datagram */
+void test_zero_copy_parser()
+{
+    for (int n = 0; n < MESSAGES; n++) {
+        sn_coap_hdr_s header;
+        sn_coap_options_list_s options;
+        uint8_t packet[BUFFER_SIZE];
+        uint8_t zero_copy_packet[BUFFER_SIZE];
+        uint8_t built[BUFFER_SIZE];
+        coap_version_e version;
+
+        init_message(n, &header, &options);
+        int16_t len = sn_coap_builder_2(packet, &header, BLOCK_SIZE);
+        TEST_ASSERT_TRUE(len > 0);
+
+        sn_coap_hdr_s *copied = sn_coap_parser(coap, len, packet, &version);
+        TEST_ASSERT_NOT_NULL(copied);
+        TEST_ASSERT_EQUAL(COAP_STATUS_OK, copied->coap_status);
+
+        sn_coap_hdr_s parsed;
+        sn_coap_options_list_s parsed_options;
+        memcpy(zero_copy_packet, packet, len);
+        TEST_ASSERT_EQUAL_PTR(&parsed, sn_coap_parser_zero_copy(len, zero_copy_packet, &parsed, &parsed_options, &version));
+        TEST_ASSERT_EQUAL(COAP_VERSION_1, version);
+        TEST_ASSERT_EQUAL_PTR(&parsed_options, parsed.options_list_ptr);
+        assert_same_message(copied, &parsed);
+        sn_coap_parser_release_allocated_coap_msg_mem(coap, copied);
+
+        // Values are left in the datagram
+        if (parsed.payload_len) {
+            TEST_ASSERT_TRUE(parsed.payload_ptr > zero_copy_packet && parsed.payload_ptr < zero_copy_packet + len);
+        }
+
+        TEST_ASSERT_EQUAL(len, sn_coap_builder_3(built, sizeof(built), &parsed));
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(packet, built, len);
+
+        // Without an options structure only the messages without such options parse
+        memcpy(zero_copy_packet, packet, len);
+        sn_coap_parser_zero_copy(len, zero_copy_packet, &parsed, NULL, &version);
+        TEST_ASSERT_EQUAL(COAP_STATUS_PARSER_ERROR_IN_HEADER, parsed.coap_status);
+    }
+}
+
+static sn_coap_status_e parse_copied(uint16_t len, uint8_t *packet)
+{
+    coap_version_e version;
+    sn_coap_hdr_s *header = sn_coap_parser(coap, len, packet, &version);
+    TEST_ASSERT_NOT_NULL(header);
+    sn_coap_status_e status = header->coap_status;
+    sn_coap_parser_release_allocated_coap_msg_mem(coap, header);
+    return status;
+}
+
+static sn_coap_status_e parse_zero_copy(uint16_t len, uint8_t *packet)
+{
+    coap_version_e version;
+    sn_coap_hdr_s header;
+    sn_coap_options_list_s options;
+    TEST_ASSERT_EQUAL_PTR(&header, sn_coap_parser_zero_copy(len, packet, &header, &options, &version));
+    return header.coap_status;
+}
+
+/* Datagrams whose token or options run past their end are rejected by both parsers */
+void test_truncated_datagrams()
+{
+    static const struct {
+        uint8_t len;
+        uint8_t data[8];
+    } truncated[] = {
+        // Token of 4 bytes, 2 present
+        {6, {0x44, 0x01, 0x12, 0x34, 0xaa, 0xbb}},
+        // Uri-Path of 10 bytes, 3 present
+        {8, {0x40, 0x01, 0x12, 0x34, 0xba, 'r', 'd', '/'}},
+        // Option length extension missing
+        {5, {0x40, 0x01, 0x12, 0x34, 0xbd}},
+        // 2 byte option delta extension, 1 present
+        {6, {0x40, 0x01, 0x12, 0x34, 0xe0, 0x01}},
+        // Option value ends at the datagram end, one byte short
+        {7, {0x40, 0x01, 0x12, 0x34, 0x63, 0x01, 0x02}},
+    };
+
+    for (size_t i = 0; i < sizeof(truncated) / sizeof(truncated[0]); i++) {
+        uint8_t packet[8];
+        memcpy(packet, truncated[i].data, truncated[i].len);
+        TEST_ASSERT_EQUAL(COAP_STATUS_PARSER_ERROR_IN_HEADER, parse_copied(truncated[i].len, packet));
+        memcpy(packet, truncated[i].data, truncated[i].len);
+        TEST_ASSERT_EQUAL(COAP_STATUS_PARSER_ERROR_IN_HEADER, parse_zero_copy(truncated[i].len, packet));
+    }
+
+    // Cut anywhere, the parsers agree, and accept it only at an option boundary
+    for (int n = 0; n < MESSAGES; n++) {
+        sn_coap_hdr_s header;
+        sn_coap_options_list_s options;
+        uint8_t packet[BUFFER_SIZE];
+        uint8_t cut[BUFFER_SIZE];
+
+        init_message(n, &header, &options);
+        header.payload_ptr = NULL;
+        header.payload_len = 0;
+        int16_t len = sn_coap_builder_2(packet, &header, BLOCK_SIZE);
+        TEST_ASSERT_TRUE(len > 0);
+
+        for (int cut_len = 4; cut_len < len; cut_len++) {
+            memcpy(cut, packet, cut_len);
+            sn_coap_status_e status = parse_copied(cut_len, cut);
+            memcpy(cut, packet, cut_len);
+            TEST_ASSERT_EQUAL(status, parse_zero_copy(cut_len, cut));
+            if (cut_len < 4 + header.token_len) {
+                TEST_ASSERT_EQUAL(COAP_STATUS_PARSER_ERROR_IN_HEADER, status);
+            }
+        }
+    }
+}
+
+/* ETag is built with its own length when Size1 and Size2 are set too */
+void test_etag_with_sizes()
+{
+    sn_coap_hdr_s header;
+    sn_coap_options_list_s options;
+    uint8_t packet[BUFFER_SIZE];
+    coap_version_e version;
+
+    sn_coap_parser_init_message(&header);
+    init_options(&options);
+    header.options_list_ptr = &options;
+    header.msg_type = COAP_MSG_TYPE_ACKNOWLEDGEMENT;
+    header.msg_code = COAP_MSG_CODE_RESPONSE_CONTENT;
+    header.msg_id = 1;
+    options.etag_ptr = (uint8_t *)"\xde\xad\xbe\xef";
+    options.etag_len = 4;
+    options.use_size1 = 1;
+    options.size1 = 70000;
+    options.use_size2 = 1;
+    options.size2 = 1024;
+
+    // Header 4, ETag 1 + 4, Size2 2 + 2, Size1 2 + 3
+    const int16_t expected_len = 4 + 5 + 4 + 5;
+    TEST_ASSERT_EQUAL(expected_len, sn_coap_builder_calc_needed_packet_data_size_2(&header, BLOCK_SIZE));
+    TEST_ASSERT_EQUAL(expected_len, sn_coap_builder_2(packet, &header, BLOCK_SIZE));
+    TEST_ASSERT_EQUAL(expected_len, sn_coap_builder_3(packet, sizeof(packet), &header));
+
+    sn_coap_hdr_s parsed;
+    sn_coap_options_list_s parsed_options;
+    sn_coap_parser_zero_copy(expected_len, packet, &parsed, &parsed_options, &version);
+    TEST_ASSERT_EQUAL(COAP_STATUS_OK, parsed.coap_status);
+    assert_same_value(options.etag_ptr, options.etag_len, parsed_options.etag_ptr, parsed_options.etag_len);
+    TEST_ASSERT_TRUE(parsed_options.use_size1);
+    TEST_ASSERT_EQUAL_UINT32(70000, parsed_options.size1);
+    TEST_ASSERT_TRUE(parsed_options.use_size2);
+    TEST_ASSERT_EQUAL_UINT32(1024, parsed_options.size2);
+}
+
+/* A destination one byte too small fails without being written past its end */
+void test_builder_buffer_too_small()
+{
+    for (int n = 0; n < MESSAGES; n++) {
+        sn_coap_hdr_s header;
+        sn_coap_options_list_s options;
+        uint8_t packet[BUFFER_SIZE];
+
+        init_message(n, &header, &options);
+        int16_t len = sn_coap_builder_calc_needed_packet_data_size_2(&header, BLOCK_SIZE);
+        TEST_ASSERT_TRUE(len > 0 && len < BUFFER_SIZE);
+
+        memset(packet, 0xa5, sizeof(packet));
+        TEST_ASSERT_EQUAL(-3, sn_coap_builder_3(packet, len - 1, &header));
+        for (int i = len - 1; i < BUFFER_SIZE; i++) {
+            TEST_ASSERT_EQUAL_HEX8(0xa5, packet[i]);
+        }
+
+        TEST_ASSERT_EQUAL(len, sn_coap_builder_3(packet, len, &header));
+        TEST_ASSERT_EQUAL_HEX8(0xa5, packet[len]);
+    }
+}
+
+/* Parse a request and build a response with its token and options, as a client answering a read */
+void test_parse_build_benchmark()
+{
+    for (int n = 0; n < MESSAGES; n++) {
+        sn_coap_hdr_s header;
+        sn_coap_options_list_s options;
+        uint8_t request[BUFFER_SIZE];
+        uint8_t packet[BUFFER_SIZE];
+        uint8_t response[BUFFER_SIZE];
+        coap_version_e version;
+        Timer timer;
+
+        init_message(n, &header, &options);
+        int16_t len = sn_coap_builder_2(request, &header, BLOCK_SIZE);
+        TEST_ASSERT_TRUE(len > 0);
+
+        alloc_cnt = 0;
+        timer.start();
+        for (int i = 0; i < ITERATIONS; i++) {
+            memcpy(packet, request, len);
+            sn_coap_hdr_s *parsed = sn_coap_parser(coap, len, packet, &version);
+            parsed->msg_type = COAP_MSG_TYPE_ACKNOWLEDGEMENT;
+            parsed->msg_code = COAP_MSG_CODE_RESPONSE_CONTENT;
+            uint16_t size = sn_coap_builder_calc_needed_packet_data_size_2(parsed, BLOCK_SIZE);
+            uint8_t *built = (uint8_t *)coap_malloc(size);
+            TEST_ASSERT_TRUE(sn_coap_builder_2(built, parsed, BLOCK_SIZE) > 0);
+            coap_free(built);
+            sn_coap_parser_release_allocated_coap_msg_mem(coap, parsed);
+        }
+        int copying_us = timer.read_us();
+        uint32_t copying_allocs = alloc_cnt;
+
+        alloc_cnt = 0;
+        timer.reset();
+        for (int i = 0; i < ITERATIONS; i++) {
+            sn_coap_hdr_s parsed;
+            sn_coap_options_list_s parsed_options;
+            memcpy(packet, request, len);
+            sn_coap_parser_zero_copy(len, packet, &parsed, &parsed_options, &version);
+            parsed.msg_type = COAP_MSG_TYPE_ACKNOWLEDGEMENT;
+            parsed.msg_code = COAP_MSG_CODE_RESPONSE_CONTENT;
+            TEST_ASSERT_TRUE(sn_coap_builder_3(response, sizeof(response), &parsed) > 0);
+        }
+        int zero_copy_us = timer.read_us();
+        uint32_t zero_copy_allocs = alloc_cnt;
+        TEST_ASSERT_EQUAL_UINT32(0, zero_copy_allocs);
+
+        printf("message %d, %d bytes:\r\n", n, len);
+        printf("  copying     %8.3f us/msg %6.2f allocs/msg\r\n", (float)copying_us / ITERATIONS, (float)copying_allocs / ITERATIONS);
+        printf("  zero-copy   %8.3f us/msg %6.2f allocs/msg\r\n", (float)zero_copy_us / ITERATIONS, (float)zero_copy_allocs / ITERATIONS);
+    }
+}
+
+utest::v1::status_t test_setup(const size_t number_of_cases)
+{
+    GREENTEA_SETUP(60, "default_auto");
+    for (unsigned i = 0; i < sizeof(payload); i++) {
+        payload[i] = i;
+    }
+    coap = sn_coap_protocol_init(coap_malloc, coap_free, coap_tx, coap_rx);
+    TEST_ASSERT_NOT_NULL(coap);
+    return verbose_test_setup_handler(number_of_cases);
+}
+
+Case cases[] = {
+    Case("Zero-copy parser matches the copying parser", test_zero_copy_parser),
+    Case("Truncated datagrams are rejected", test_truncated_datagrams),
+    Case("ETag with Size1 and Size2", test_etag_with_sizes),
+    Case("Builder with a too small buffer", test_builder_buffer_too_small),
+    Case("Parse and build benchmark", test_parse_build_benchmark)
+};
+
+Specification specification(test_setup, cases);
+
+int main()
+{
+    return !Harness::run(specification);
+}
@@ -0,0 +1,287 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "mbed.h"
+#include "greentea-client/test_env.h"
+#include "unity.h"
+#include "utest.h"
+
+#include "mbed-coap/sn_coap_protocol.h"
+#include "mbed-coap/sn_coap_header.h"
+#include <stdlib.h>
+
+#ifndef FEATURE_COMMON_PAL
+#error [NOT_SUPPORTED] test requires the COMMON_PAL feature
+#endif
+
+using namespace utest::v1;
+
+#define PEERS               1000
+#define ROUNDS              5
+#define OUTSTANDING         200
+#define EXEC_CALLS          1000
+
+static uint8_t peer_addr[PEERS][16];
+static sn_nsdl_addr_s peer[PEERS];
+
+static uint32_t tx_cnt;
+static uint32_t failed_cnt;
+
+static void *coap_malloc(uint16_t size)
+{
+    return malloc(size);
+}
+
+static void coap_free(void *ptr)
+{
+    free(ptr);
+}
+
+static uint8_t coap_tx(uint8_t *packet, uint16_t len, sn_nsdl_addr_s *addr, void *param)
+{
+    tx_cnt++;
+    return 1;
+}
+
+static int8_t coap_rx(sn_coap_hdr_s *header, sn_nsdl_addr_s *addr, void *param)
+{
+    if (header->coap_status == COAP_STATUS_BUILDER_MESSAGE_SENDING_FAILED) {
+        failed_cnt++;
+    }
+    return 0;
+}
+
+/* IPv6 peers which differ in the last bytes and the port, as behind a border router */
+static void init_peers()
+{
+    for (int i = 0; i < PEERS; i++) {
+        peer_addr[i][0] = 0xfd;
+        peer_addr[i][14] = i >> 8;
+        peer_addr[i][15] = i;
+        peer[i].addr_len = 16;
+        peer[i].addr_ptr = peer_addr[i];
+        peer[i].port = 5683 + (i % 3);
+        peer[i].type = SN_NSDL_ADDRESS_TYPE_IPV6;
+    }
+}
+
+static struct coap_s *init_coap(uint8_t *duplicates, uint8_t *resendings)
+{
+    struct coap_s *coap = sn_coap_protocol_init(coap_malloc, coap_free, coap_tx, coap_rx);
+    TEST_ASSERT_NOT_NULL(coap);
+
+    // Use the largest buffers allowed by the configuration
+    *duplicates = 255;
+    while (*duplicates && sn_coap_protocol_set_duplicate_buffer_size(coap, *duplicates) != 0) {
+        (*duplicates)--;
+    }
+    *resendings = 255;
+    while (*resendings && sn_coap_protocol_set_retransmission_buffer(coap, *resendings, 0) != 0) {
+        (*resendings)--;
+    }
+    TEST_ASSERT_EQUAL(0, sn_coap_protocol_set_retransmission_parameters(coap, 2, 1));
+
+    tx_cnt = 0;
+    failed_cnt = 0;
+    sn_coap_protocol_exec(coap, 1);
+    return coap;
+}
+
+static uint16_t build_packet(uint8_t *packet, sn_coap_msg_type_e type, sn_coap_msg_code_e code, uint16_t msg_id)
+{
+    sn_coap_hdr_s header;
+    memset(&header, 0, sizeof(header));
+    header.msg_type = type;
+    header.msg_code = code;
+    header.msg_id = msg_id;
+    return sn_coap_builder(packet, &header);
+}
+
+static sn_coap_status_e receive_message(struct coap_s *coap, int i, sn_coap_msg_type_e type, sn_coap_msg_code_e code, uint16_t msg_id)
+{
+    uint8_t packet[16];
+    uint16_t len = build_packet(packet, type, code, msg_id);
+    sn_coap_hdr_s *header = sn_coap_protocol_parse(coap, &peer[i], len, packet, NULL);
+    TEST_ASSERT_NOT_NULL(header);
+
+    sn_coap_status_e status = header->coap_status;
+    if (status == COAP_STATUS_OK && type == COAP_MSG_TYPE_CONFIRMABLE) {
+        sn_coap_hdr_s *response = sn_coap_build_response(coap, header, COAP_MSG_CODE_RESPONSE_CONTENT);
+        TEST_ASSERT_NOT_NULL(response);
+        TEST_ASSERT_TRUE(sn_coap_protocol_build(coap, &peer[i], packet, response, NULL) > 0);
+        sn_coap_parser_release_allocated_coap_msg_mem(coap, response);
+    }
+    sn_coap_parser_release_allocated_coap_msg_mem(coap, header);
+    return status;
+}
+
+static uint16_t send_notification(struct coap_s *coap, int i)
+{
+    uint8_t packet[16];
+    sn_coap_hdr_s header;
+    memset(&header, 0, sizeof(header));
+    header.msg_type = COAP_MSG_TYPE_CONFIRMABLE;
+    header.msg_code = COAP_MSG_CODE_RESPONSE_CONTENT;
+    TEST_ASSERT_TRUE(sn_coap_protocol_build(coap, &peer[i], packet, &header, NULL) > 0);
+    return header.msg_id;
+}
+
+/* The last requests of each peer are detected as duplicates and answered again */
+void test_duplicates()
+{
+    uint8_t duplicates;
+    uint8_t resendings;
+    struct coap_s *coap = init_coap(&duplicates, &resendings);
+    if (duplicates == 0) {
+        sn_coap_protocol_destroy(coap);
+        TEST_IGNORE_MESSAGE("duplicate detection is not enabled");
+    }
+
+    for (int i = 0; i < PEERS; i++) {
+        TEST_ASSERT_EQUAL(COAP_STATUS_OK, receive_message(coap, i, COAP_MSG_TYPE_CONFIRMABLE, COAP_MSG_CODE_REQUEST_GET, 100 + i));
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, tx_cnt);
+
+    for (int i = PEERS - duplicates; i < PEERS; i++) {
+        // Same Message ID from another peer is not a duplicate
+        TEST_ASSERT_EQUAL(COAP_STATUS_PARSER_DUPLICATED_MSG, receive_message(coap, i, COAP_MSG_TYPE_CONFIRMABLE, COAP_MSG_CODE_REQUEST_GET, 100 + i));
+        TEST_ASSERT_EQUAL(COAP_STATUS_OK, receive_message(coap, (i + 1) % PEERS, COAP_MSG_TYPE_NON_CONFIRMABLE, COAP_MSG_CODE_REQUEST_GET, 100 + i));
+    }
+    TEST_ASSERT_EQUAL_UINT32(duplicates, tx_cnt);
+
+    // Stored messages expire
+    TEST_ASSERT_EQUAL(COAP_STATUS_OK, receive_message(coap, 0, COAP_MSG_TYPE_NON_CONFIRMABLE, COAP_MSG_CODE_REQUEST_GET, 1));
+    TEST_ASSERT_EQUAL(COAP_STATUS_PARSER_DUPLICATED_MSG, receive_message(coap, 0, COAP_MSG_TYPE_NON_CONFIRMABLE, COAP_MSG_CODE_REQUEST_GET, 1));
+    sn_coap_protocol_exec(coap, 100);
+    TEST_ASSERT_EQUAL(COAP_STATUS_OK, receive_message(coap, 0, COAP_MSG_TYPE_NON_CONFIRMABLE, COAP_MSG_CODE_REQUEST_GET, 1));
+
+    sn_coap_protocol_destroy(coap);
+}
+
+/* Acknowledged messages are removed in any order, the others are resent and then fail */
+void test_retransmissions()
+{
+    uint8_t duplicates;
+    uint8_t resendings;
+    struct coap_s *coap = init_coap(&duplicates, &resendings);
+    TEST_ASSERT_TRUE(resendings > 0);
+
+    uint16_t *msg_ids = new uint16_t[resendings];
+    for (int i = 0; i < resendings; i++) {
+        msg_ids[i] = send_notification(coap, i * 7 % PEERS);
+    }
+
+    // Acknowledge every other one from the end, and once from the wrong peer
+    int acked = 0;
+    for (int i = resendings - 1; i >= 0; i -= 2) {
+        receive_message(coap, (i * 7 + 1) % PEERS, COAP_MSG_TYPE_ACKNOWLEDGEMENT, COAP_MSG_CODE_EMPTY, msg_ids[i]);
+        receive_message(coap, i * 7 % PEERS, COAP_MSG_TYPE_ACKNOWLEDGEMENT, COAP_MSG_CODE_EMPTY, msg_ids[i]);
+        acked++;
+    }
+    int left = resendings - acked;
+
+    // Resent after 1 and then 2 to 3 seconds
+    sn_coap_protocol_exec(coap, 2);
+    TEST_ASSERT_EQUAL_UINT32(left, tx_cnt);
+    sn_coap_protocol_exec(coap, 10);
+    TEST_ASSERT_EQUAL_UINT32(2 * left, tx_cnt);
+    sn_coap_protocol_exec(coap, 30);
+    TEST_ASSERT_EQUAL_UINT32(2 * left, tx_cnt);
+    TEST_ASSERT_EQUAL_UINT32(left, failed_cnt);
+
+    for (int i = 0; i < resendings; i++) {
+        TEST_ASSERT_EQUAL(-2, sn_coap_protocol_delete_retransmission(coap, msg_ids[i]));
+    }
+
+    delete[] msg_ids;
+    sn_coap_protocol_destroy(coap);
+}
+
+/* Requests from all peers, and notifications acknowledged in random order */
+void test_lookup_benchmark()
+{
+    uint8_t duplicates;
+    uint8_t resendings;
+    struct coap_s *coap = init_coap(&duplicates, &resendings);
+    Timer timer;
+    uint16_t msg_id = 1;
+
+    timer.start();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < PEERS; i++) {
+            receive_message(coap, i, COAP_MSG_TYPE_CONFIRMABLE, COAP_MSG_CODE_REQUEST_GET, msg_id++);
+        }
+    }
+    int request_us = timer.read_us();
+
+    int outstanding = resendings < OUTSTANDING ? resendings : OUTSTANDING;
+    uint16_t *msg_ids = new uint16_t[outstanding];
+    int *peers = new int[outstanding];
+    int total = ROUNDS * PEERS;
+
+    timer.reset();
+    for (int n = 0; n < total + outstanding; n++) {
+        int slot = n < outstanding || n >= total ? n % outstanding : rand() % outstanding;
+        if (n >= outstanding) {
+            receive_message(coap, peers[slot], COAP_MSG_TYPE_ACKNOWLEDGEMENT, COAP_MSG_CODE_EMPTY, msg_ids[slot]);
+        }
+        if (n < total) {
+            peers[slot] = n % PEERS;
+            msg_ids[slot] = send_notification(coap, peers[slot]);
+        }
+    }
+    int notification_us = timer.read_us();
+
+    for (int i = 0; i < outstanding; i++) {
+        TEST_ASSERT_EQUAL(-2, sn_coap_protocol_delete_retransmission(coap, msg_ids[i]));
+    }
+    for (int i = 0; i < resendings; i++) {
+        send_notification(coap, i);
+    }
+    timer.reset();
+    for (int i = 0; i < EXEC_CALLS; i++) {
+        sn_coap_protocol_exec(coap, 1);
+    }
+    int exec_us = timer.read_us();
+
+    printf("%d peers, %d duplication infos, %d resending messages:\r\n", PEERS, duplicates, resendings);
+    printf("  request and response      %8d us (%.3f us/msg)\r\n", request_us, (float)request_us / total);
+    printf("  notification and ack      %8d us (%.3f us/msg)\r\n", notification_us, (float)notification_us / total);
+    printf("  exec, nothing to resend   %8d us (%.3f us/call)\r\n", exec_us, (float)exec_us / EXEC_CALLS);
+
+    delete[] msg_ids;
+    delete[] peers;
+    sn_coap_protocol_destroy(coap);
+}
+
+utest::v1::status_t test_setup(const size_t number_of_cases)
+{
+    GREENTEA_SETUP(60, "default_auto");
+    init_peers();
+    return verbose_test_setup_handler(number_of_cases);
+}
+
+Case cases[] = {
+    Case("Duplicate detection with many peers", test_duplicates),
+    Case("Retransmissions with many peers", test_retransmissions),
+    Case("Lookup with many peers", test_lookup_benchmark)
+};
+
+Specification specification(test_setup, cases);
+
+int main()
+{
+    return !Harness::run(specification);
+}
@@ -42,7 +42,7 @@ public:
      *  @param fs       Filesystem as target for the file
      *  @param path     The name of the file to open
      *  @param flags    The flags to open the file in, one of O_RDONLY, O_WRONLY, O_RDWR,
-     *                  bitwise or'd with one of O_CREAT, O_TRUNC, O_APPEND
+     *                  bitwise or'd with one of O_CREAT, O_TRUNC, O_APPEND, O_DIRECT
      */
     File(FileSystem *fs, const char *path, int flags = O_RDONLY);
 
@@ -57,7 +57,7 @@ public:
      *  @param fs       Filesystem as target for the file
      *  @param path     The name of the file to open
      *  @param flags    The flags to open the file in, one of O_RDONLY, O_WRONLY, O_RDWR,
-     *                  bitwise or'd with one of O_CREAT, O_TRUNC, O_APPEND
+     *                  bitwise or'd with one of O_CREAT, O_TRUNC, O_APPEND, O_DIRECT
      *  @return         0 on success, negative error code on failure
      */
     virtual int open(FileSystem *fs, const char *path, int flags=O_RDONLY);
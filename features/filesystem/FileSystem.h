@@ -118,7 +118,7 @@ protected:
      *  @param file     Destination for the handle to a newly created file
      *  @param path     The name of the file to open
      *  @param flags    The flags to open the file in, one of O_RDONLY, O_WRONLY, O_RDWR,
-     *                  bitwise or'd with one of O_CREAT, O_TRUNC, O_APPEND
+     *                  bitwise or'd with one of O_CREAT, O_TRUNC, O_APPEND, O_DIRECT
      *  @return         0 on success, negative error code on failure
      */
     virtual int file_open(fs_file_t *file, const char *path, int flags) = 0;
@@ -59,6 +59,18 @@ public:
      */
     virtual int deinit() = 0;
 
+    /** Ensure data on storage is in sync with the driver
+     *
+     *  Block devices may buffer programs and erases, sync writes any pending
+     *  operation to the underlying storage.
+     *
+     *  @return         0 on success or a negative error code on failure
+     */
+    virtual int sync()
+    {
+        return 0;
+    }
+
     /** Read blocks from a block device
      *
      *  If a failure occurs, it is not possible to determine how many bytes succeeded
@@ -135,6 +147,20 @@ public:
         return get_program_size();
     }
 
+    /** Get the value of storage when erased
+     *
+     *  If get_erase_value() returns a non-negative byte value, the underlying
+     *  storage is set to that value when erased, and storage containing
+     *  that value can be programmed without another erase.
+     *
+     *  @return         The value of storage when erased, or -1 if you can't
+     *                  rely on the value of erased storage
+     */
+    virtual int get_erase_value() const
+    {
+        return -1;
+    }
+
     /** Get the total size of the underlying device
      *
      *  @return         Size of the underlying device in bytes
@@ -0,0 +1,422 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CachingBlockDevice.h"
+
+
+CachingBlockDevice::CachingBlockDevice(BlockDevice *bd, bd_size_t count)
+    : _bd(bd)
+    , _blocks(0), _count(count), _block_size(0), _program_size(0)
+    , _erase_value(-1)
+    , _clock(0)
+    , _hit_count(0), _miss_count(0)
+{
+    MBED_ASSERT(_count > 0);
+}
+
+CachingBlockDevice::~CachingBlockDevice()
+{
+    if (_blocks) {
+        for (size_t i = 0; i < _count; i++) {
+            free(_blocks[i].buffer);
+            free(_blocks[i].programmed);
+        }
+
+        delete[] _blocks;
+        _blocks = 0;
+    }
+}
+
+int CachingBlockDevice::init()
+{
+    int err = _bd->init();
+    if (err) {
+        return err;
+    }
+
+    if (!_blocks) {
+        _block_size = _bd->get_erase_size();
+        _program_size = _bd->get_program_size();
+        _blocks = new cache_block[_count];
+        for (size_t i = 0; i < _count; i++) {
+            _blocks[i].buffer = 0;
+            _blocks[i].programmed = 0;
+            _blocks[i].used = 0;
+        }
+    }
+
+    MBED_ASSERT(_block_size == _bd->get_erase_size());
+    MBED_ASSERT(_program_size == _bd->get_program_size());
+    _erase_value = _bd->get_erase_value();
+
+    bd_size_t units = _block_size / _program_size;
+    for (size_t i = 0; i < _count; i++) {
+        if (!_blocks[i].buffer) {
+            _blocks[i].buffer = (uint8_t*)malloc(_block_size);
+            if (!_blocks[i].buffer) {
+                return BD_ERROR_DEVICE_ERROR;
+            }
+        }
+
+        if (!_blocks[i].programmed) {
+            _blocks[i].programmed = (uint8_t*)malloc((units + 7) / 8);
+            if (!_blocks[i].programmed) {
+                return BD_ERROR_DEVICE_ERROR;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int CachingBlockDevice::deinit()
+{
+    int err = sync();
+    if (err) {
+        return err;
+    }
+
+    // Memory is kept until the destructor so a reinitialization can't fail
+    // on allocation, the content is dropped
+    for (size_t i = 0; i < _count; i++) {
+        _blocks[i].used = 0;
+    }
+
+    return _bd->deinit();
+}
+
+int CachingBlockDevice::sync()
+{
+    MBED_ASSERT(_blocks != NULL);
+    for (size_t i = 0; i < _count; i++) {
+        int err = flush(&_blocks[i]);
+        if (err) {
+            return err;
+        }
+    }
+
+    return _bd->sync();
+}
+
+int CachingBlockDevice::read(void *b, bd_addr_t addr, bd_size_t size)
+{
+    MBED_ASSERT(_blocks != NULL);
+    MBED_ASSERT(is_valid_read(addr, size));
+    uint8_t *buffer = static_cast<uint8_t*>(b);
+
+    // Only reads within a block are added to the cache
+    bool single = addr / _block_size == (addr + size - 1) / _block_size;
+
+    while (size > 0) {
+        bd_addr_t off = addr % _block_size;
+        bd_size_t chunk = _block_size - off < size ? _block_size - off : size;
+
+        cache_block *block = find(addr - off);
+        if (block) {
+            _hit_count += 1;
+            touch(block);
+            memcpy(buffer, &block->buffer[off], chunk);
+        } else if (single) {
+            _miss_count += 1;
+            int err = allocate(addr - off, &block);
+            if (err) {
+                return err;
+            }
+
+            err = _bd->read(block->buffer, addr - off, _block_size);
+            if (err) {
+                block->used = 0;
+                return err;
+            }
+
+            memcpy(buffer, &block->buffer[off], chunk);
+        } else {
+            // Read all the following blocks not cached at once
+            _miss_count += 1;
+            while (chunk < size && !find(addr + chunk)) {
+                _miss_count += 1;
+                chunk += _block_size < size - chunk ? _block_size : size - chunk;
+            }
+
+            int err = _bd->read(buffer, addr, chunk);
+            if (err) {
+                return err;
+            }
+        }
+
+        buffer += chunk;
+        addr += chunk;
+        size -= chunk;
+    }
+
+    return 0;
+}
+
+int CachingBlockDevice::program(const void *b, bd_addr_t addr, bd_size_t size)
+{
+    MBED_ASSERT(_blocks != NULL);
+    MBED_ASSERT(is_valid_program(addr, size));
+    const uint8_t *buffer = static_cast<const uint8_t*>(b);
+
+    // Only programs within a block are added to the cache
+    bool single = addr / _block_size == (addr + size - 1) / _block_size;
+
+    while (size > 0) {
+        bd_addr_t off = addr % _block_size;
+        bd_size_t chunk = _block_size - off < size ? _block_size - off : size;
+
+        cache_block *block = find(addr - off);
+        if (!block && single) {
+            int err = allocate(addr - off, &block);
+            if (err) {
+                return err;
+            }
+
+            // The whole block is written back, fetch what is not programmed
+            if (chunk < _block_size) {
+                err = _bd->read(block->buffer, addr - off, _block_size);
+                if (err) {
+                    block->used = 0;
+                    return err;
+                }
+            }
+        }
+
+        if (block) {
+            touch(block);
+            memcpy(&block->buffer[off], buffer, chunk);
+            mark(block, off, chunk);
+        } else {
+            // Program all the following blocks not cached at once, they
+            // have been erased on the underlying device
+            while (chunk < size && !find(addr + chunk)) {
+                chunk += _block_size < size - chunk ? _block_size : size - chunk;
+            }
+
+            int err = _bd->program(buffer, addr, chunk);
+            if (err) {
+                return err;
+            }
+        }
+
+        buffer += chunk;
+        addr += chunk;
+        size -= chunk;
+    }
+
+    return 0;
+}
+
+int CachingBlockDevice::erase(bd_addr_t addr, bd_size_t size)
+{
+    MBED_ASSERT(_blocks != NULL);
+    MBED_ASSERT(is_valid_erase(addr, size));
+
+    // Erases which fit in the cache are deferred to the write back, so the
+    // usual erase then program sequence costs a single erase
+    if (size / _block_size <= _count) {
+        for (bd_size_t i = 0; i < size; i += _block_size) {
+            cache_block *block = find(addr + i);
+            if (!block) {
+                int err = allocate(addr + i, &block);
+                if (err) {
+                    return err;
+                }
+            }
+
+            // Pending programs are overwritten by the erase, what is read
+            // back until the block is programmed is the erase value
+            touch(block);
+            if (_erase_value >= 0) {
+                memset(block->buffer, _erase_value, _block_size);
+            }
+            memset(block->programmed, 0, (_block_size / _program_size + 7) / 8);
+            block->dirty = true;
+            block->erased = true;
+        }
+
+        return 0;
+    }
+
+    drop(addr, size);
+    return _bd->erase(addr, size);
+}
+
+int CachingBlockDevice::trim(bd_addr_t addr, bd_size_t size)
+{
+    MBED_ASSERT(_blocks != NULL);
+    MBED_ASSERT(is_valid_erase(addr, size));
+
+    drop(addr, size);
+    return _bd->trim(addr, size);
+}
+
+bd_size_t CachingBlockDevice::get_read_size() const
+{
+    return _bd->get_read_size();
+}
+
+bd_size_t CachingBlockDevice::get_program_size() const
+{
+    return _bd->get_program_size();
+}
+
+bd_size_t CachingBlockDevice::get_erase_size() const
+{
+    return _bd->get_erase_size();
+}
+
+int CachingBlockDevice::get_erase_value() const
+{
+    return _bd->get_erase_value();
+}
+
+bd_size_t CachingBlockDevice::size() const
+{
+    return _bd->size();
+}
+
+void CachingBlockDevice::reset_counts()
+{
+    _hit_count = 0;
+    _miss_count = 0;
+}
+
+bd_size_t CachingBlockDevice::get_hit_count() const
+{
+    return _hit_count;
+}
+
+bd_size_t CachingBlockDevice::get_miss_count() const
+{
+    return _miss_count;
+}
+
+CachingBlockDevice::cache_block *CachingBlockDevice::find(bd_addr_t addr)
+{
+    for (size_t i = 0; i < _count; i++) {
+        if (_blocks[i].used && _blocks[i].addr == addr) {
+            return &_blocks[i];
+        }
+    }
+
+    return 0;
+}
+
+int CachingBlockDevice::allocate(bd_addr_t addr, cache_block **block)
+{
+    // Reuse a free block or evict the least recently used one
+    cache_block *lru = &_blocks[0];
+    for (size_t i = 0; i < _count && lru->used; i++) {
+        if (_blocks[i].used < lru->used) {
+            lru = &_blocks[i];
+        }
+    }
+
+    int err = flush(lru);
+    if (err) {
+        return err;
+    }
+
+    lru->addr = addr;
+    lru->dirty = false;
+    lru->erased = false;
+    memset(lru->programmed, 0, (_block_size / _program_size + 7) / 8);
+    touch(lru);
+
+    *block = lru;
+    return 0;
+}
+
+int CachingBlockDevice::flush(cache_block *block)
+{
+    if (!block->used || !block->dirty) {
+        return 0;
+    }
+
+    if (block->erased) {
+        int err = _bd->erase(block->addr, _block_size);
+        if (err) {
+            return err;
+        }
+    }
+
+    // Program each run of modified program units at once
+    bd_size_t units = _block_size / _program_size;
+    bool programmed = false;
+    for (bd_size_t i = 0; i < units;) {
+        if (!(block->programmed[i / 8] & (1 << (i % 8)))) {
+            i += 1;
+            continue;
+        }
+
+        bd_size_t n = 1;
+        while (i + n < units && (block->programmed[(i + n) / 8] & (1 << ((i + n) % 8)))) {
+            n += 1;
+        }
+
+        int err = _bd->program(&block->buffer[i * _program_size],
+                block->addr + i * _program_size, n * _program_size);
+        if (err) {
+            return err;
+        }
+
+        programmed = true;
+        i += n;
+    }
+
+    if (block->erased && !programmed && _erase_value < 0) {
+        // The content of an erased block is left to the underlying device
+        block->used = 0;
+    }
+
+    memset(block->programmed, 0, (units + 7) / 8);
+    block->dirty = false;
+    block->erased = false;
+    return 0;
+}
+
+void CachingBlockDevice::mark(cache_block *block, bd_addr_t off, bd_size_t size)
+{
+    for (bd_size_t i = off / _program_size; i < (off + size) / _program_size; i++) {
+        block->programmed[i / 8] |= 1 << (i % 8);
+    }
+
+    block->dirty = true;
+}
+
+void CachingBlockDevice::drop(bd_addr_t addr, bd_size_t size)
+{
+    for (size_t i = 0; i < _count; i++) {
+        if (_blocks[i].used && _blocks[i].addr >= addr && _blocks[i].addr < addr + size) {
+            _blocks[i].used = 0;
+        }
+    }
+}
+
+void CachingBlockDevice::touch(cache_block *block)
+{
+    _clock += 1;
+    if (!_clock) {
+        // Restart the LRU order on wrap around, keeping blocks in use
+        for (size_t i = 0; i < _count; i++) {
+            _blocks[i].used = _blocks[i].used ? 1 : 0;
+        }
+        _clock = 2;
+    }
+
+    block->used = _clock;
+}
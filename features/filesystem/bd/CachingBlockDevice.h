@@ -0,0 +1,220 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 ARM Limited
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef MBED_CACHING_BLOCK_DEVICE_H
+#define MBED_CACHING_BLOCK_DEVICE_H
+
+#include "BlockDevice.h"
+#include "mbed.h"
+
+
+/** Block device for caching the blocks of another block device
+ *
+ *  The cache holds a number of erase blocks of the underlying block device,
+ *  replaced in least recently used order:
+ *  - Reads and programs within a single block go through the cache, so
+ *    filesystem metadata which is accessed again and again stays in RAM.
+ *    Larger operations are assumed to be streaming file data and only use
+ *    the blocks already cached.
+ *  - Programmed and erased blocks are written back when they are evicted or
+ *    on sync(), so repeated updates of a block cost a single erase and
+ *    program of the underlying block device. Only the program units
+ *    modified are programmed, and the block is erased only if it was
+ *    erased through the cache.
+ *
+ *  Pending data is lost if the device is not synced or deinitialized.
+ *
+ *  @code
+ *  #include "mbed.h"
+ *  #include "HeapBlockDevice.h"
+ *  #include "CachingBlockDevice.h"
+ *
+ *  // Create a block device with 64 blocks of size 512
+ *  HeapBlockDevice mem(64*512, 512);
+ *
+ *  // Cache up to 8 of its blocks
+ *  CachingBlockDevice cache(&mem, 8);
+ *
+ *  // do block device work....
+ *
+ *  // Write back the blocks modified
+ *  cache.sync();
+ *
+ *  printf("hit count: %lld\n", cache.get_hit_count());
+ *  printf("miss count: %lld\n", cache.get_miss_count());
+ * @endcode
+ */
+class CachingBlockDevice : public BlockDevice
+{
+public:
+    /** Lifetime of the memory block device
+     *
+     *  @param bd       Block device to back the CachingBlockDevice
+     *  @param count    Number of blocks of the underlying device to cache,
+     *                  each one uses the erase size of the device in RAM
+     */
+    CachingBlockDevice(BlockDevice *bd, bd_size_t count = 4);
+
+    /** Lifetime of a block device
+     */
+    virtual ~CachingBlockDevice();
+
+    /** Initialize a block device
+     *
+     *  @return         0 on success or a negative error code on failure
+     */
+    virtual int init();
+
+    /** Deinitialize a block device
+     *
+     *  Writes back the blocks modified.
+     *
+     *  @return         0 on success or a negative error code on failure
+     */
+    virtual int deinit();
+
+    /** Ensure data on storage is in sync with the driver
+     *
+     *  Writes back the blocks modified, then syncs the underlying device.
+     *
+     *  @return         0 on success or a negative error code on failure
+     */
+    virtual int sync();
+
+    /** Read blocks from a block device
+     *
+     *  @param buffer   Buffer to read blocks into
+     *  @param addr     Address of block to begin reading from
+     *  @param size     Size to read in bytes, must be a multiple of read block size
+     *  @return         0 on success, negative error code on failure
+     */
+    virtual int read(void *buffer, bd_addr_t addr, bd_size_t size);
+
+    /** Program blocks to a block device
+     *
+     *  The blocks must have been erased prior to being programmed
+     *
+     *  @param buffer   Buffer of data to write to blocks
+     *  @param addr     Address of block to begin writing to
+     *  @param size     Size to write in bytes, must be a multiple of program block size
+     *  @return         0 on success, negative error code on failure
+     */
+    virtual int program(const void *buffer, bd_addr_t addr, bd_size_t size);
+
+    /** Erase blocks on a block device
+     *
+     *  The state of an erased block is undefined until it has been programmed
+     *
+     *  @param addr     Address of block to begin erasing
+     *  @param size     Size to erase in bytes, must be a multiple of erase block size
+     *  @return         0 on success, negative error code on failure
+     */
+    virtual int erase(bd_addr_t addr, bd_size_t size);
+
+    /** Mark blocks as no longer in use
+     *
+     *  The cached blocks in the range are dropped without being written back.
+     *
+     *  @param addr     Address of block to mark as unused
+     *  @param size     Size to mark as unused in bytes, must be a multiple of erase block size
+     *  @return         0 on success, negative error code on failure
+     */
+    virtual int trim(bd_addr_t addr, bd_size_t size);
+
+    /** Get the size of a readable block
+     *
+     *  @return         Size of a readable block in bytes
+     */
+    virtual bd_size_t get_read_size() const;
+
+    /** Get the size of a programable block
+     *
+     *  @return         Size of a programable block in bytes
+     *  @note Must be a multiple of the read size
+     */
+    virtual bd_size_t get_program_size() const;
+
+    /** Get the size of a eraseable block
+     *
+     *  @return         Size of a eraseable block in bytes
+     *  @note Must be a multiple of the program size
+     */
+    virtual bd_size_t get_erase_size() const;
+
+    /** Get the value of storage when erased
+     *
+     *  @return         The value of the underlying device when erased, or -1
+     *                  if it is not defined
+     */
+    virtual int get_erase_value() const;
+
+    /** Get the total size of the underlying device
+     *
+     *  @return         Size of the underlying device in bytes
+     */
+    virtual bd_size_t size() const;
+
+    /** Reset the hit and miss counts to zero
+     */
+    void reset_counts();
+
+    /** Get number of blocks read from the cache
+     *
+     *  @return The number of blocks read without accessing the underlying device
+     */
+    bd_size_t get_hit_count() const;
+
+    /** Get number of blocks read from the underlying device
+     *
+     *  @return The number of blocks read from the underlying device
+     */
+    bd_size_t get_miss_count() const;
+
+private:
+    struct cache_block {
+        bd_addr_t addr;
+        uint8_t *buffer;
+        uint8_t *programmed;    // Bitmap of the program units to write back
+        uint32_t used;          // Last use for the LRU order, 0 if not in use
+        bool dirty;             // Must be written back
+        bool erased;            // Must be erased on the underlying device
+    };
+
+    cache_block *find(bd_addr_t addr);
+    int allocate(bd_addr_t addr, cache_block **block);
+    int flush(cache_block *block);
+    void mark(cache_block *block, bd_addr_t off, bd_size_t size);
+    void drop(bd_addr_t addr, bd_size_t size);
+    void touch(cache_block *block);
+
+    BlockDevice *_bd;
+    cache_block *_blocks;
+    bd_size_t _count;
+    bd_size_t _block_size;
+    bd_size_t _program_size;
+    int _erase_value;
+    uint32_t _clock;
+    bd_size_t _hit_count;
+    bd_size_t _miss_count;
+};
+
+
+#endif
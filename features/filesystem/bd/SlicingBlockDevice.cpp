@@ -75,6 +75,11 @@ int SlicingBlockDevice::deinit()
     return _bd->deinit();
 }
 
+int SlicingBlockDevice::sync()
+{
+    return _bd->sync();
+}
+
 int SlicingBlockDevice::read(void *b, bd_addr_t addr, bd_size_t size)
 {
     MBED_ASSERT(is_valid_read(addr, size));
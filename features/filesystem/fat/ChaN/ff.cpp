@@ -1072,6 +1072,48 @@ DWORD clmt_clust (	/* <2:Error, >=2:Cluster number */
 
 
 
+/*-----------------------------------------------------------------------*/
+/* Direct I/O - Extend a transfer over the following contiguous clusters */
+/*-----------------------------------------------------------------------*/
+
+static
+UINT clust_span (	/* Number of sectors to transfer */
+	FIL* fp,		/* Pointer to the file object */
+	UINT cc,		/* Number of sectors left in the current cluster */
+	UINT nsect,		/* Number of sectors requested */
+	int stretch		/* Allocate clusters at the end of the chain (write) */
+)
+{
+	DWORD clst, ncl;
+
+
+	clst = fp->clust;
+	while (cc < nsect) {
+#if _USE_FASTSEEK
+		if (fp->cltbl) {
+			ncl = clmt_clust(fp, fp->fptr + (DWORD)cc * SS(fp->fs));	/* Get cluster# from the CLMT */
+		} else
+#endif
+		{
+#if !_FS_READONLY
+			if (stretch)
+				ncl = create_chain(fp->fs, clst);	/* Follow or stretch cluster chain on the FAT */
+			else
+#endif
+				ncl = get_fat(fp->fs, clst);		/* Follow cluster chain on the FAT */
+		}
+		if (ncl != clst + 1) break;		/* Fragmented or an error, the next round deals with it */
+		clst = ncl;
+		cc += fp->fs->csize;
+	}
+	fp->clust = clst;					/* Last cluster in the transfer */
+
+	return cc < nsect ? cc : nsect;
+}
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Directory handling - Set directory index                              */
 /*-----------------------------------------------------------------------*/
@@ -2649,8 +2691,12 @@ FRESULT f_read (
 			sect += csect;
 			cc = btr / SS(fp->fs);				/* When remaining bytes >= sector size, */
 			if (cc) {							/* Read maximum contiguous sectors directly */
-				if (csect + cc > fp->fs->csize)	/* Clip at cluster boundary */
-					cc = fp->fs->csize - csect;
+				if (csect + cc > fp->fs->csize) {	/* Clip at cluster boundary */
+					if (fp->flag & FA__DIRECT)	/* or at the end of the contiguous clusters */
+						cc = clust_span(fp, fp->fs->csize - csect, cc, 0);
+					else
+						cc = fp->fs->csize - csect;
+				}
 				if (disk_read(fp->fs->drv, rbuff, sect, cc) != RES_OK)
 					ABORT(fp->fs, FR_DISK_ERR);
 #if !_FS_READONLY && _FS_MINIMIZE <= 2			/* Replace one of the read sectors with cached data if it contains a dirty sector */
@@ -2771,8 +2817,16 @@ FRESULT f_write (
 			sect += csect;
 			cc = btw / SS(fp->fs);			/* When remaining bytes >= sector size, */
 			if (cc) {						/* Write maximum contiguous sectors directly */
-				if (csect + cc > fp->fs->csize)	/* Clip at cluster boundary */
-					cc = fp->fs->csize - csect;
+				if (csect + cc > fp->fs->csize) {	/* Clip at cluster boundary */
+					if (fp->flag & FA__DIRECT) {	/* or at the end of the contiguous clusters */
+						cc = clust_span(fp, fp->fs->csize - csect, cc, 1);
+#if FLUSH_ON_NEW_CLUSTER
+						need_sync = true;
+#endif
+					} else {
+						cc = fp->fs->csize - csect;
+					}
+				}
 				if (disk_write(fp->fs->drv, wbuff, sect, cc) != RES_OK)
 					ABORT(fp->fs, FR_DISK_ERR);
 #if _FS_MINIMIZE <= 2
@@ -312,6 +312,7 @@ int ff_del_syncobj (_SYNC_t sobj);				/* Delete a sync object */
 #define FA__WRITTEN			0x20
 #define FA__DIRTY			0x40
 #endif
+#define FA__DIRECT			0x80
 
 
 /* FAT sub type (FATFS.fs_type) */
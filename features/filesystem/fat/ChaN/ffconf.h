@@ -45,7 +45,11 @@
 /* This option switches f_mkfs() function. (0:Disable or 1:Enable) */
 
 
+#if MBED_CONF_FILESYSTEM_FAT_FAST_SEEK
+#define	_USE_FASTSEEK	1
+#else
 #define	_USE_FASTSEEK	0
+#endif
 /* This option switches fast seek feature. (0:Disable or 1:Enable) */
 
 
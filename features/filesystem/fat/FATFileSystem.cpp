@@ -127,6 +127,36 @@ static Deferred<const char*> fat_path_prefix(int id, const char *path)
     return Deferred<const char*>(buffer, dodelete);
 }
 
+#if _USE_FASTSEEK
+// Builds the cluster link map used by fast seek, the file is left in normal
+// seek mode if there is not enough memory
+static void fat_link_map(FIL *fh)
+{
+    // Start with room for a few fragments, FatFs reports the size needed
+    DWORD size = 2 + 2*4;
+
+    while (true) {
+        fh->cltbl = (DWORD*)malloc(size * sizeof(DWORD));
+        if (!fh->cltbl) {
+            return;
+        }
+
+        fh->cltbl[0] = size;
+        FRESULT res = f_lseek(fh, CREATE_LINKMAP);
+        if (res == FR_OK) {
+            return;
+        }
+
+        size = fh->cltbl[0];
+        free(fh->cltbl);
+        fh->cltbl = NULL;
+        if (res != FR_NOT_ENOUGH_CORE) {
+            return;
+        }
+    }
+}
+#endif
+
 
 ////// Disk operations //////
 
@@ -225,7 +255,8 @@ DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
             if (_ffs[pdrv] == NULL) {
                 return RES_NOTRDY;
             } else {
-                return RES_OK;
+                int err = _ffs[pdrv]->sync();
+                return err ? RES_ERROR : RES_OK;
             }
         case GET_SECTOR_COUNT:
             if (_ffs[pdrv] == NULL) {
@@ -263,7 +294,7 @@ DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
 
 // Filesystem implementation (See FATFilySystem.h)
 FATFileSystem::FATFileSystem(const char *name, BlockDevice *bd)
-        : FileSystem(name), _id(-1) {
+        : FileSystem(name), _id(-1), _fast_seek(_USE_FASTSEEK) {
     if (bd) {
         mount(bd);
     }
@@ -314,9 +345,13 @@ int FATFileSystem::unmount()
     }
 
     FRESULT res = f_mount(NULL, _fsid, 0);
+    int err = _ffs[_id]->sync();
     _ffs[_id] = NULL;
     _id = -1;
     unlock();
+    if (res == FR_OK && err) {
+        res = FR_DISK_ERR;
+    }
     return fat_error_remap(res);
 }
 
@@ -442,6 +477,17 @@ int FATFileSystem::stat(const char *path, struct stat *st) {
     return 0;
 }
 
+int FATFileSystem::set_fast_seek(bool enable) {
+#if _USE_FASTSEEK
+    lock();
+    _fast_seek = enable;
+    unlock();
+    return 0;
+#else
+    return -ENOSYS;
+#endif
+}
+
 void FATFileSystem::lock() {
     _ffs_mutex->lock();
 }
@@ -485,6 +531,10 @@ int FATFileSystem::file_open(fs_file_t *file, const char *path, int flags) {
         return fat_error_remap(res);
     }
 
+    if (flags & O_DIRECT) {
+        fh->flag |= FA__DIRECT;
+    }
+
     if (flags & O_APPEND) {
         f_lseek(fh, fh->fsize);
     }
@@ -501,6 +551,9 @@ int FATFileSystem::file_close(fs_file_t file) {
     FRESULT res = f_close(fh);
     unlock();
 
+#if _USE_FASTSEEK
+    free(fh->cltbl);
+#endif
     delete fh;
     return fat_error_remap(res);
 }
@@ -554,6 +607,12 @@ off_t FATFileSystem::file_seek(fs_file_t file, off_t offset, int whence) {
     FIL *fh = static_cast<FIL*>(file);
 
     lock();
+#if _USE_FASTSEEK
+    if (_fast_seek && !fh->cltbl && !(fh->flag & FA_WRITE)) {
+        fat_link_map(fh);
+    }
+#endif
+
     if (whence == SEEK_END) {
         offset += fh->fsize;
     } else if(whence==SEEK_CUR) {
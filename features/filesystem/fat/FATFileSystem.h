@@ -139,14 +139,31 @@ public:
      */
     virtual int mkdir(const char *path, mode_t mode);
 
+    /** Enable or disable fast seek on files opened read-only
+     *
+     *  With fast seek, a map of the clusters of a file is built on its first
+     *  seek, so seeking does not walk the FAT chain from the start of the
+     *  file. The map uses 8 bytes for each fragment of the file and is freed
+     *  when the file is closed. Enabled by default if supported.
+     *
+     *  @param enable   True to enable fast seek, false to disable it
+     *  @return         0 on success, -ENOSYS if the filesystem.fat-fast-seek
+     *                  configuration option is not set
+     */
+    int set_fast_seek(bool enable);
+
 protected:
     /** Open a file on the filesystem
      *
      *  @param file     Destination for the handle to a newly created file
      *  @param path     The name of the file to open
      *  @param flags    The flags to open the file in, one of O_RDONLY, O_WRONLY, O_RDWR,
-     *                  bitwise or'd with one of O_CREAT, O_TRUNC, O_APPEND
+     *                  bitwise or'd with one of O_CREAT, O_TRUNC, O_APPEND, O_DIRECT
      *  @return         0 on success, negative error code on failure
+     *
+     *  @note With O_DIRECT, whole sectors read or written in one call are
+     *  transferred across contiguous clusters in a single block device
+     *  request, other data still goes through the sector buffer.
      */
     virtual int file_open(fs_file_t *file, const char *path, int flags);
 
@@ -256,6 +273,7 @@ private:
     FATFS _fs; // Work area (file system object) for logical drive
     char _fsid[sizeof("0:")];
     int _id;
+    bool _fast_seek;
 
 protected:
     virtual void lock();
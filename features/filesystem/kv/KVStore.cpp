@@ -0,0 +1,1262 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 ARM Limited
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mbed.h"
+#include <errno.h>
+
+#include "KVStore.h"
+
+#ifndef MBED_CONF_FILESYSTEM_KVSTORE_MAX_KEY_SIZE
+#define MBED_CONF_FILESYSTEM_KVSTORE_MAX_KEY_SIZE 64
+#endif
+
+
+////// On-disk format //////
+//
+// Each block starts with a block_header, followed by records aligned to the
+// program size. A block is in the log if its header checks out and its
+// sequence is not older than the tail of the log, which is given by the
+// header of the newest block and the GC_DONE records appended to it. Blocks
+// out of the log are free, whatever their content, so a block does not need
+// to be erased until it is reused.
+//
+// The CRC of a record is seeded with the sequence of its block, so records
+// left over from a previous use of the block never check out.
+
+#define KVSTORE_MAGIC           0x3153564b      // "KVS1"
+#define KVSTORE_RECORD_DELETE   0x0001          // Key removed
+#define KVSTORE_RECORD_TXN      0x0002          // Part of a transaction
+#define KVSTORE_RECORD_TXN_MORE 0x0004          // More records of the transaction follow
+#define KVSTORE_RECORD_GC_DONE  0x0008          // Block with the sequence in the value is out of the log
+#define KVSTORE_BLOCK_SEALED    ((bd_size_t)-1)
+#define KVSTORE_NO_BLOCK        ((size_t)-1)
+#define KVSTORE_NO_ADDR         ((bd_addr_t)-1)
+
+struct block_header {
+    uint32_t magic;
+    uint32_t block_size;
+    uint32_t seq;
+    uint32_t tail_seq;          // Oldest block in the log when this one was started
+    uint32_t erase_count;
+    uint32_t crc;
+};
+
+struct record_header {
+    uint32_t crc;               // Of the rest of the record, seeded with the block sequence
+    uint16_t flags;
+    uint16_t key_size;
+    uint32_t value_size;
+};
+
+static uint32_t kv_crc32(uint32_t crc, const void *buffer, size_t size)
+{
+    static const uint32_t table[16] = {
+        0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+        0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+        0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+        0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+    };
+
+    const uint8_t *data = (const uint8_t *)buffer;
+    for (size_t i = 0; i < size; i++) {
+        crc = (crc >> 4) ^ table[(crc ^ (data[i] >> 0)) & 0xf];
+        crc = (crc >> 4) ^ table[(crc ^ (data[i] >> 4)) & 0xf];
+    }
+
+    return crc;
+}
+
+static uint32_t kv_crc_seed(uint32_t seq)
+{
+    return kv_crc32(0xffffffff, &seq, sizeof(seq));
+}
+
+static uint32_t kv_hash(const char *key, size_t key_size)
+{
+    uint32_t hash = 0x811c9dc5;
+    for (size_t i = 0; i < key_size; i++) {
+        hash = (hash ^ (uint8_t)key[i]) * 0x01000193;
+    }
+
+    return hash;
+}
+
+static bd_size_t kv_align(bd_size_t size, bd_size_t align)
+{
+    return ((size + align - 1) / align) * align;
+}
+
+static int kv_block_geometry(BlockDevice *bd, bd_size_t *block_size)
+{
+    bd_size_t erase_size = bd->get_erase_size();
+    if (*block_size == 0) {
+        *block_size = erase_size;
+    }
+
+    if (*block_size % erase_size != 0 || *block_size % bd->get_program_size() != 0
+            || *block_size % bd->get_read_size() != 0 || *block_size > 0xffffffff
+            || bd->size() > 0xffffffff || bd->size() / *block_size < 2) {
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+
+////// Lifetime //////
+
+KVStore::KVStore(BlockDevice *bd, bd_size_t block_size)
+    : _bd(NULL), _block_size(block_size), _read_size(0), _program_size(0)
+    , _blocks(NULL), _block_count(0), _head(KVSTORE_NO_BLOCK), _head_end(0)
+    , _seq(0), _live(0)
+    , _entries(NULL), _entry_count(0), _entry_capacity(0)
+    , _read_buffer(NULL), _read_addr(0), _program_buffer(NULL)
+    , _program_addr(0), _program_fill(0)
+    , _txn(false), _txn_ops(NULL), _txn_size(0)
+{
+    if (bd) {
+        mount(bd);
+    }
+}
+
+KVStore::~KVStore()
+{
+    // nop if unmounted
+    unmount();
+}
+
+int KVStore::format(BlockDevice *bd, bd_size_t block_size)
+{
+    int err = bd->init();
+    if (err) {
+        return err;
+    }
+
+    err = kv_block_geometry(bd, &block_size);
+    if (err) {
+        bd->deinit();
+        return err;
+    }
+
+    // The erased state of a block device is undefined, so overwrite the
+    // headers to make sure no block is in the log
+    bd_size_t header_size = kv_align(sizeof(block_header), bd->get_program_size());
+    uint8_t *header = new uint8_t[header_size];
+    memset(header, 0, header_size);
+
+    bd_size_t block_count = bd->size() / block_size;
+    for (bd_size_t b = 0; b < block_count && !err; b++) {
+        err = bd->erase(b * block_size, block_size);
+        if (!err) {
+            err = bd->program(header, b * block_size, header_size);
+        }
+    }
+
+    delete[] header;
+    int deinit_err = bd->deinit();
+    return err ? err : deinit_err;
+}
+
+int KVStore::mount(BlockDevice *bd)
+{
+    lock();
+    if (_bd) {
+        unlock();
+        return -EINVAL;
+    }
+
+    int err = bd->init();
+    if (err) {
+        unlock();
+        return err;
+    }
+
+    bd_size_t block_size = _block_size;
+    err = kv_block_geometry(bd, &block_size);
+    if (err) {
+        bd->deinit();
+        unlock();
+        return err;
+    }
+
+    _bd = bd;
+    _block_size = block_size;
+    _read_size = bd->get_read_size();
+    _program_size = bd->get_program_size();
+    _block_count = bd->size() / block_size;
+    _blocks = new block[_block_count];
+    _read_buffer = new uint8_t[_read_size];
+    _program_buffer = new uint8_t[_program_size];
+    _read_addr = KVSTORE_NO_ADDR;
+    _head = KVSTORE_NO_BLOCK;
+    _seq = 0;
+    _live = 0;
+
+    {
+        // Read the block headers, the newest block gives the tail of the log
+        size_t newest = KVSTORE_NO_BLOCK;
+        uint32_t max_erase_count = 0;
+        uint32_t tail = 0;
+        for (size_t b = 0; b < _block_count; b++) {
+            block_header header;
+            err = _read(b * _block_size, &header, sizeof(header));
+            if (err) {
+                goto fail;
+            }
+
+            _blocks[b].used = KVSTORE_BLOCK_SEALED;
+            if (header.magic != KVSTORE_MAGIC || header.block_size != _block_size
+                    || header.seq == 0
+                    || header.crc != kv_crc32(0xffffffff, &header, offsetof(block_header, crc))) {
+                _blocks[b].seq = 0;
+                _blocks[b].erase_count = (uint32_t)-1;
+                continue;
+            }
+
+            _blocks[b].seq = header.seq;
+            _blocks[b].erase_count = header.erase_count;
+            if (header.erase_count > max_erase_count) {
+                max_erase_count = header.erase_count;
+            }
+            if (newest == KVSTORE_NO_BLOCK || header.seq > _blocks[newest].seq) {
+                newest = b;
+                tail = header.tail_seq;
+            }
+        }
+
+        // Blocks of unknown wear are assumed to be the most worn
+        for (size_t b = 0; b < _block_count; b++) {
+            if (_blocks[b].erase_count == (uint32_t)-1) {
+                _blocks[b].erase_count = max_erase_count;
+            }
+        }
+
+        if (newest != KVSTORE_NO_BLOCK) {
+            _seq = _blocks[newest].seq;
+
+            uint32_t gc_seq = 0;
+            err = _replay_block(newest, false, &gc_seq);
+            if (err) {
+                goto fail;
+            }
+            if (gc_seq && gc_seq + 1 > tail) {
+                tail = gc_seq + 1;
+            }
+
+            for (size_t b = 0; b < _block_count; b++) {
+                if (_blocks[b].seq && _blocks[b].seq < tail) {
+                    _blocks[b].seq = 0;
+                }
+            }
+
+            // No free block means a power failure while reclaiming space,
+            // before the oldest block was out of the log, so the newest
+            // block only holds copies of its records
+            if (_free_count() == 0) {
+                _blocks[newest].seq = 0;
+            }
+        }
+
+        // Replay the log from the oldest block
+        uint32_t replayed = 0;
+        while (true) {
+            size_t next = KVSTORE_NO_BLOCK;
+            for (size_t b = 0; b < _block_count; b++) {
+                if (_blocks[b].seq > replayed
+                        && (next == KVSTORE_NO_BLOCK || _blocks[b].seq < _blocks[next].seq)) {
+                    next = b;
+                }
+            }
+
+            if (next == KVSTORE_NO_BLOCK) {
+                break;
+            }
+
+            err = _replay_block(next, true, NULL);
+            if (err) {
+                goto fail;
+            }
+            replayed = _blocks[next].seq;
+        }
+    }
+
+    unlock();
+    return 0;
+
+fail:
+    delete[] _blocks;
+    delete[] _read_buffer;
+    delete[] _program_buffer;
+    free(_entries);
+    _blocks = NULL;
+    _read_buffer = NULL;
+    _program_buffer = NULL;
+    _entries = NULL;
+    _entry_count = 0;
+    _entry_capacity = 0;
+    _bd = NULL;
+    bd->deinit();
+    unlock();
+    return err;
+}
+
+int KVStore::unmount()
+{
+    lock();
+    if (!_bd) {
+        unlock();
+        return -EINVAL;
+    }
+
+    _txn_clear();
+    _txn = false;
+
+    delete[] _blocks;
+    delete[] _read_buffer;
+    delete[] _program_buffer;
+    free(_entries);
+    _blocks = NULL;
+    _read_buffer = NULL;
+    _program_buffer = NULL;
+    _entries = NULL;
+    _entry_count = 0;
+    _entry_capacity = 0;
+
+    int err = _bd->deinit();
+    _bd = NULL;
+    unlock();
+    return err;
+}
+
+
+////// Key operations //////
+
+int KVStore::set(const char *key, const void *buffer, size_t size)
+{
+    size_t key_size = strlen(key);
+    if (key_size == 0 || key_size > MBED_CONF_FILESYSTEM_KVSTORE_MAX_KEY_SIZE
+            || size > 0xffffffff) {
+        return -EINVAL;
+    }
+
+    lock();
+    if (!_bd) {
+        unlock();
+        return -EINVAL;
+    }
+
+    if (_txn) {
+        int err = _txn_add(0, key, buffer, size);
+        unlock();
+        return err;
+    }
+
+    int err = _reserve(_record_size(key_size, size), false);
+    if (err) {
+        unlock();
+        return err;
+    }
+
+    bd_addr_t addr;
+    err = _write_record(0, key, key_size, buffer, size, &addr);
+    if (err) {
+        unlock();
+        return err;
+    }
+
+    err = _insert(key, key_size, addr, size);
+    unlock();
+    return err;
+}
+
+int KVStore::get(const char *key, void *buffer, size_t size, size_t *actual_size)
+{
+    size_t key_size = strlen(key);
+    lock();
+    if (!_bd) {
+        unlock();
+        return -EINVAL;
+    }
+
+    size_t index;
+    int err = _find(key, key_size, kv_hash(key, key_size), &index);
+    if (err) {
+        unlock();
+        return err;
+    }
+
+    const entry *e = &_entries[index];
+    if (actual_size) {
+        *actual_size = e->value_size;
+    }
+    if (size > e->value_size) {
+        size = e->value_size;
+    }
+
+    err = _read(e->addr + sizeof(record_header) + e->key_size, buffer, size);
+    unlock();
+    return err;
+}
+
+int KVStore::remove(const char *key)
+{
+    size_t key_size = strlen(key);
+    lock();
+    if (!_bd) {
+        unlock();
+        return -EINVAL;
+    }
+
+    if (_txn) {
+        // Check the key against the transaction, then the store
+        txn_op *last = NULL;
+        for (txn_op *op = _txn_ops; op; op = op->next) {
+            if (op->key_size == key_size && memcmp(op + 1, key, key_size) == 0) {
+                last = op;
+            }
+        }
+
+        size_t index;
+        int err = last
+                ? ((last->flags & KVSTORE_RECORD_DELETE) ? -ENOENT : 0)
+                : _find(key, key_size, kv_hash(key, key_size), &index);
+        if (!err) {
+            err = _txn_add(KVSTORE_RECORD_DELETE, key, NULL, 0);
+        }
+        unlock();
+        return err;
+    }
+
+    size_t index;
+    int err = _find(key, key_size, kv_hash(key, key_size), &index);
+    if (err) {
+        unlock();
+        return err;
+    }
+
+    err = _reserve(_record_size(key_size, 0), true);
+    if (err) {
+        unlock();
+        return err;
+    }
+
+    bd_addr_t addr;
+    err = _write_record(KVSTORE_RECORD_DELETE, key, key_size, NULL, 0, &addr);
+    if (err) {
+        unlock();
+        return err;
+    }
+
+    // Space may have been reclaimed, moving the entry
+    err = _find(key, key_size, kv_hash(key, key_size), &index);
+    if (!err) {
+        _erase_entry(index);
+    }
+    unlock();
+    return 0;
+}
+
+int KVStore::iterate(const char *prefix, Callback<int(const char *key, size_t size)> func)
+{
+    size_t prefix_size = prefix ? strlen(prefix) : 0;
+    lock();
+    if (!_bd) {
+        unlock();
+        return -EINVAL;
+    }
+
+    char key[MBED_CONF_FILESYSTEM_KVSTORE_MAX_KEY_SIZE + 1];
+    for (size_t i = 0; i < _entry_count; i++) {
+        const entry *e = &_entries[i];
+        if (e->key_size < prefix_size) {
+            continue;
+        }
+
+        int err = _read(e->addr + sizeof(record_header), key, e->key_size);
+        if (err) {
+            unlock();
+            return err;
+        }
+        key[e->key_size] = '\0';
+
+        if (prefix_size && memcmp(key, prefix, prefix_size) != 0) {
+            continue;
+        }
+
+        err = func(key, e->value_size);
+        if (err) {
+            unlock();
+            return err;
+        }
+    }
+
+    unlock();
+    return 0;
+}
+
+
+////// Transactions //////
+
+int KVStore::begin()
+{
+    lock();
+    if (!_bd || _txn) {
+        unlock();
+        return -EINVAL;
+    }
+
+    _txn = true;
+    _txn_size = 0;
+    unlock();
+    return 0;
+}
+
+int KVStore::commit()
+{
+    lock();
+    if (!_bd || !_txn) {
+        unlock();
+        return -EINVAL;
+    }
+
+    int err = 0;
+    if (_txn_ops) {
+        err = _reserve(_txn_size, false);
+    }
+
+    // The records are only applied to the index once they are all written
+    bd_addr_t start = KVSTORE_NO_ADDR;
+    for (txn_op *op = _txn_ops; op && !err; op = op->next) {
+        uint16_t flags = op->flags | KVSTORE_RECORD_TXN;
+        if (op->next) {
+            flags |= KVSTORE_RECORD_TXN_MORE;
+        }
+
+        const char *key = (const char *)(op + 1);
+        bd_addr_t addr;
+        err = _write_record(flags, key, op->key_size, key + op->key_size,
+                op->value_size, &addr);
+        if (start == KVSTORE_NO_ADDR) {
+            start = addr;
+        }
+    }
+
+    // The records are contiguous in the head block
+    for (txn_op *op = _txn_ops; op && !err; op = op->next) {
+        const char *key = (const char *)(op + 1);
+        if (op->flags & KVSTORE_RECORD_DELETE) {
+            size_t index;
+            if (_find(key, op->key_size, kv_hash(key, op->key_size), &index) == 0) {
+                _erase_entry(index);
+            }
+        } else {
+            err = _insert(key, op->key_size, start, op->value_size);
+        }
+        start += _record_size(op->key_size, op->value_size);
+    }
+
+    _txn_clear();
+    _txn = false;
+    unlock();
+    return err;
+}
+
+int KVStore::abort()
+{
+    lock();
+    if (!_bd || !_txn) {
+        unlock();
+        return -EINVAL;
+    }
+
+    _txn_clear();
+    _txn = false;
+    unlock();
+    return 0;
+}
+
+int KVStore::_txn_add(uint16_t flags, const char *key, const void *buffer, size_t size)
+{
+    size_t key_size = strlen(key);
+    bd_size_t record_size = _record_size(key_size, size);
+    bd_size_t capacity = _block_size - kv_align(sizeof(block_header), _program_size)
+            - _record_size(0, sizeof(uint32_t));
+    if (_txn_size + record_size > capacity) {
+        return -ENOSPC;
+    }
+
+    txn_op *op = (txn_op *)malloc(sizeof(txn_op) + key_size + size);
+    if (!op) {
+        return -ENOMEM;
+    }
+
+    op->next = NULL;
+    op->flags = flags;
+    op->key_size = key_size;
+    op->value_size = size;
+    memcpy(op + 1, key, key_size);
+    if (size) {
+        memcpy((uint8_t *)(op + 1) + key_size, buffer, size);
+    }
+
+    txn_op **tail = &_txn_ops;
+    while (*tail) {
+        tail = &(*tail)->next;
+    }
+    *tail = op;
+    _txn_size += record_size;
+    return 0;
+}
+
+void KVStore::_txn_clear()
+{
+    while (_txn_ops) {
+        txn_op *next = _txn_ops->next;
+        free(_txn_ops);
+        _txn_ops = next;
+    }
+    _txn_size = 0;
+}
+
+
+////// Space management //////
+
+int KVStore::gc()
+{
+    lock();
+    if (!_bd || _txn) {
+        unlock();
+        return -EINVAL;
+    }
+
+    int err = _gc();
+    unlock();
+    return err;
+}
+
+bd_size_t KVStore::free_size()
+{
+    lock();
+    if (!_bd) {
+        unlock();
+        return 0;
+    }
+
+    bd_size_t capacity = _capacity();
+    bd_size_t size = _live < capacity ? capacity - _live : 0;
+    unlock();
+    return size;
+}
+
+void KVStore::lock()
+{
+    _mutex.lock();
+}
+
+void KVStore::unlock()
+{
+    _mutex.unlock();
+}
+
+bd_size_t KVStore::_record_size(size_t key_size, size_t value_size) const
+{
+    return kv_align(sizeof(record_header) + key_size + value_size, _program_size);
+}
+
+bd_size_t KVStore::_capacity() const
+{
+    // Every block but the one kept free holds the same amount of records,
+    // less the room kept for a delete record so that a full store can
+    // still have keys removed
+    bd_size_t capacity = (_block_count - 1) * (_block_size
+            - kv_align(sizeof(block_header), _program_size)
+            - _record_size(0, sizeof(uint32_t)));
+    bd_size_t headroom = _record_size(MBED_CONF_FILESYSTEM_KVSTORE_MAX_KEY_SIZE, 0);
+    return capacity > headroom ? capacity - headroom : 0;
+}
+
+uint32_t KVStore::_tail_seq() const
+{
+    uint32_t tail = 0;
+    for (size_t b = 0; b < _block_count; b++) {
+        if (_blocks[b].seq && (!tail || _blocks[b].seq < tail)) {
+            tail = _blocks[b].seq;
+        }
+    }
+
+    return tail;
+}
+
+size_t KVStore::_free_count() const
+{
+    size_t count = 0;
+    for (size_t b = 0; b < _block_count; b++) {
+        if (!_blocks[b].seq) {
+            count += 1;
+        }
+    }
+
+    return count;
+}
+
+int KVStore::_reserve(bd_size_t size, bool remove)
+{
+    bd_size_t block_capacity = _block_size - kv_align(sizeof(block_header), _program_size)
+            - _record_size(0, sizeof(uint32_t));
+
+    // A delete record may use the room kept for it, it frees more than that
+    bd_size_t capacity = _capacity();
+    if (remove) {
+        capacity += _record_size(MBED_CONF_FILESYSTEM_KVSTORE_MAX_KEY_SIZE, 0);
+    }
+
+    if (size > block_capacity || _live + size > capacity) {
+        return -ENOSPC;
+    }
+
+    for (size_t i = 0; i <= _block_count; i++) {
+        if (_head != KVSTORE_NO_BLOCK && _blocks[_head].used + size <= _head_end) {
+            return 0;
+        }
+
+        // The last free block is kept for reclaiming space
+        int err = _free_count() > 1 ? _start_block() : _gc();
+        if (err) {
+            return err;
+        }
+    }
+
+    return -ENOSPC;
+}
+
+int KVStore::_erase_block(size_t b)
+{
+    _read_addr = KVSTORE_NO_ADDR;
+    int err = _bd->erase(b * _block_size, _block_size);
+    if (err) {
+        return err;
+    }
+
+    _blocks[b].erase_count += 1;
+    return 0;
+}
+
+int KVStore::_start_block()
+{
+    // Start the free block erased the least
+    size_t b = KVSTORE_NO_BLOCK;
+    for (size_t i = 0; i < _block_count; i++) {
+        if (!_blocks[i].seq
+                && (b == KVSTORE_NO_BLOCK || _blocks[i].erase_count < _blocks[b].erase_count)) {
+            b = i;
+        }
+    }
+
+    if (b == KVSTORE_NO_BLOCK) {
+        return -ENOSPC;
+    }
+
+    int err = _erase_block(b);
+    if (err) {
+        return err;
+    }
+
+    block_header header;
+    header.magic = KVSTORE_MAGIC;
+    header.block_size = _block_size;
+    header.seq = _seq + 1;
+    header.tail_seq = _tail_seq();
+    if (!header.tail_seq) {
+        header.tail_seq = header.seq;
+    }
+    header.erase_count = _blocks[b].erase_count;
+    header.crc = kv_crc32(0xffffffff, &header, offsetof(block_header, crc));
+
+    err = _program_start(b * _block_size);
+    if (!err) {
+        err = _program_data(&header, sizeof(header));
+    }
+    if (!err) {
+        err = _program_end();
+    }
+    if (err) {
+        return err;
+    }
+
+    _seq = header.seq;
+    _blocks[b].seq = header.seq;
+    _blocks[b].used = kv_align(sizeof(block_header), _program_size);
+    if (_head != KVSTORE_NO_BLOCK) {
+        _blocks[_head].used = KVSTORE_BLOCK_SEALED;
+    }
+    _head = b;
+
+    // Leave room for the record closing a reclaim
+    _head_end = _block_size - _record_size(0, sizeof(uint32_t));
+    return 0;
+}
+
+int KVStore::_gc()
+{
+    // Blocks are reclaimed oldest first, so records the copied ones
+    // superseded are gone as well, and tombstones can be dropped
+    size_t victim = KVSTORE_NO_BLOCK;
+    for (size_t b = 0; b < _block_count; b++) {
+        if (_blocks[b].seq
+                && (victim == KVSTORE_NO_BLOCK || _blocks[b].seq < _blocks[victim].seq)) {
+            victim = b;
+        }
+    }
+
+    if (victim == KVSTORE_NO_BLOCK) {
+        return -ENOSPC;
+    }
+
+    int err = _start_block();
+    if (err) {
+        return err;
+    }
+
+    bd_addr_t start = victim * _block_size;
+    for (size_t i = 0; i < _entry_count; i++) {
+        if (_entries[i].addr >= start && _entries[i].addr < start + _block_size) {
+            err = _copy_record(&_entries[i]);
+            if (err) {
+                return err;
+            }
+        }
+    }
+
+    // Take the block out of the log, it is erased when reused
+    uint32_t seq = _blocks[victim].seq;
+    bd_addr_t addr;
+    err = _write_record(KVSTORE_RECORD_GC_DONE, NULL, 0, &seq, sizeof(seq), &addr);
+    if (err) {
+        return err;
+    }
+
+    // The record used the room left for it, the block holds as many records
+    // as any other
+    _head_end = _block_size;
+    _blocks[victim].seq = 0;
+    return 0;
+}
+
+
+////// Records //////
+
+int KVStore::_write_record(uint16_t flags, const char *key, size_t key_size,
+        const void *buffer, size_t size, bd_addr_t *addr)
+{
+    MBED_ASSERT(_blocks[_head].used + _record_size(key_size, size) <= _block_size);
+
+    record_header header;
+    header.flags = flags;
+    header.key_size = key_size;
+    header.value_size = size;
+    header.crc = kv_crc_seed(_blocks[_head].seq);
+    header.crc = kv_crc32(header.crc, &header.flags, sizeof(header) - sizeof(header.crc));
+    header.crc = kv_crc32(header.crc, key, key_size);
+    header.crc = kv_crc32(header.crc, buffer, size);
+
+    *addr = _head * _block_size + _blocks[_head].used;
+    int err = _program_start(*addr);
+    if (!err) {
+        err = _program_data(&header, sizeof(header));
+    }
+    if (!err) {
+        err = _program_data(key, key_size);
+    }
+    if (!err) {
+        err = _program_data(buffer, size);
+    }
+    if (!err) {
+        err = _program_end();
+    }
+    if (err) {
+        // The end of the block is unknown, don't append to it
+        _blocks[_head].used = KVSTORE_BLOCK_SEALED;
+        _head = KVSTORE_NO_BLOCK;
+        return err;
+    }
+
+    _blocks[_head].used += _record_size(key_size, size);
+    return 0;
+}
+
+int KVStore::_copy_record(entry *e)
+{
+    // Copies drop the transaction flags, they stand on their own
+    record_header header;
+    header.flags = 0;
+    header.key_size = e->key_size;
+    header.value_size = e->value_size;
+
+    uint8_t chunk[32];
+    bd_size_t size = e->key_size + e->value_size;
+    header.crc = kv_crc_seed(_blocks[_head].seq);
+    header.crc = kv_crc32(header.crc, &header.flags, sizeof(header) - sizeof(header.crc));
+    for (bd_size_t off = 0; off < size; off += sizeof(chunk)) {
+        bd_size_t n = size - off < sizeof(chunk) ? size - off : sizeof(chunk);
+        int err = _read(e->addr + sizeof(header) + off, chunk, n);
+        if (err) {
+            return err;
+        }
+        header.crc = kv_crc32(header.crc, chunk, n);
+    }
+
+    bd_addr_t addr = _head * _block_size + _blocks[_head].used;
+    int err = _program_start(addr);
+    if (!err) {
+        err = _program_data(&header, sizeof(header));
+    }
+    for (bd_size_t off = 0; off < size && !err; off += sizeof(chunk)) {
+        bd_size_t n = size - off < sizeof(chunk) ? size - off : sizeof(chunk);
+        err = _read(e->addr + sizeof(header) + off, chunk, n);
+        if (!err) {
+            err = _program_data(chunk, n);
+        }
+    }
+    if (!err) {
+        err = _program_end();
+    }
+    if (err) {
+        _blocks[_head].used = KVSTORE_BLOCK_SEALED;
+        _head = KVSTORE_NO_BLOCK;
+        return err;
+    }
+
+    _blocks[_head].used += _record_size(e->key_size, e->value_size);
+    e->addr = addr;
+    return 0;
+}
+
+int KVStore::_check_record(bd_addr_t addr, bd_addr_t end, uint32_t seq,
+        uint16_t *flags, uint16_t *key_size, uint32_t *value_size)
+{
+    record_header header;
+    if (addr + sizeof(header) > end) {
+        return -EILSEQ;
+    }
+
+    int err = _read(addr, &header, sizeof(header));
+    if (err) {
+        return err;
+    }
+
+    if (header.key_size > MBED_CONF_FILESYSTEM_KVSTORE_MAX_KEY_SIZE
+            || header.value_size > end - addr
+            || addr + _record_size(header.key_size, header.value_size) > end) {
+        return -EILSEQ;
+    }
+
+    uint8_t chunk[32];
+    bd_size_t size = header.key_size + header.value_size;
+    uint32_t crc = kv_crc_seed(seq);
+    crc = kv_crc32(crc, &header.flags, sizeof(header) - sizeof(header.crc));
+    for (bd_size_t off = 0; off < size; off += sizeof(chunk)) {
+        bd_size_t n = size - off < sizeof(chunk) ? size - off : sizeof(chunk);
+        err = _read(addr + sizeof(header) + off, chunk, n);
+        if (err) {
+            return err;
+        }
+        crc = kv_crc32(crc, chunk, n);
+    }
+
+    if (crc != header.crc) {
+        return -EILSEQ;
+    }
+
+    *flags = header.flags;
+    *key_size = header.key_size;
+    *value_size = header.value_size;
+    return 0;
+}
+
+int KVStore::_replay_block(size_t b, bool apply, uint32_t *gc_seq)
+{
+    bd_addr_t addr = b * _block_size + kv_align(sizeof(block_header), _program_size);
+    bd_addr_t end = (b + 1) * _block_size;
+    bd_addr_t txn = KVSTORE_NO_ADDR;
+
+    while (true) {
+        uint16_t flags;
+        uint16_t key_size;
+        uint32_t value_size;
+        int err = _check_record(addr, end, _blocks[b].seq, &flags, &key_size, &value_size);
+        if (err == -EILSEQ) {
+            // An incomplete transaction at the end is dropped
+            return 0;
+        } else if (err) {
+            return err;
+        }
+
+        if (flags & KVSTORE_RECORD_GC_DONE) {
+            txn = KVSTORE_NO_ADDR;
+            if (gc_seq && value_size == sizeof(uint32_t)) {
+                err = _read(addr + sizeof(record_header), gc_seq, sizeof(uint32_t));
+                if (err) {
+                    return err;
+                }
+            }
+        } else if (flags & KVSTORE_RECORD_TXN_MORE) {
+            if (txn == KVSTORE_NO_ADDR) {
+                txn = addr;
+            }
+        } else if (flags & KVSTORE_RECORD_TXN) {
+            // Last record of a transaction, apply all of it
+            bd_addr_t txn_addr = (txn == KVSTORE_NO_ADDR) ? addr : txn;
+            while (apply && txn_addr < addr) {
+                record_header header;
+                err = _read(txn_addr, &header, sizeof(header));
+                if (!err) {
+                    err = _apply(txn_addr, header.flags, header.key_size, header.value_size);
+                }
+                if (err) {
+                    return err;
+                }
+                txn_addr += _record_size(header.key_size, header.value_size);
+            }
+            if (apply) {
+                err = _apply(addr, flags, key_size, value_size);
+                if (err) {
+                    return err;
+                }
+            }
+            txn = KVSTORE_NO_ADDR;
+        } else {
+            // Records of an unfinished transaction are dropped
+            txn = KVSTORE_NO_ADDR;
+            if (apply) {
+                err = _apply(addr, flags, key_size, value_size);
+                if (err) {
+                    return err;
+                }
+            }
+        }
+
+        addr += _record_size(key_size, value_size);
+    }
+}
+
+int KVStore::_apply(bd_addr_t addr, uint16_t flags, uint16_t key_size, uint32_t value_size)
+{
+    char key[MBED_CONF_FILESYSTEM_KVSTORE_MAX_KEY_SIZE];
+    int err = _read(addr + sizeof(record_header), key, key_size);
+    if (err) {
+        return err;
+    }
+
+    if (flags & KVSTORE_RECORD_DELETE) {
+        size_t index;
+        if (_find(key, key_size, kv_hash(key, key_size), &index) == 0) {
+            _erase_entry(index);
+        }
+        return 0;
+    }
+
+    return _insert(key, key_size, addr, value_size);
+}
+
+
+////// Index //////
+
+int KVStore::_find(const char *key, size_t key_size, uint32_t hash, size_t *index)
+{
+    // Entries are sorted by hash, keys are compared on a match
+    size_t lo = 0;
+    size_t hi = _entry_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (_entries[mid].hash < hash) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    *index = lo;
+    char stored[MBED_CONF_FILESYSTEM_KVSTORE_MAX_KEY_SIZE];
+    for (size_t i = lo; i < _entry_count && _entries[i].hash == hash; i++) {
+        if (_entries[i].key_size != key_size) {
+            continue;
+        }
+
+        int err = _read(_entries[i].addr + sizeof(record_header), stored, key_size);
+        if (err) {
+            return err;
+        }
+
+        if (memcmp(stored, key, key_size) == 0) {
+            *index = i;
+            return 0;
+        }
+    }
+
+    return -ENOENT;
+}
+
+int KVStore::_insert(const char *key, size_t key_size, bd_addr_t addr, uint32_t value_size)
+{
+    uint32_t hash = kv_hash(key, key_size);
+    size_t index;
+    int err = _find(key, key_size, hash, &index);
+    if (err == 0) {
+        _live -= _record_size(key_size, _entries[index].value_size);
+        _live += _record_size(key_size, value_size);
+        _entries[index].addr = addr;
+        _entries[index].value_size = value_size;
+        return 0;
+    } else if (err != -ENOENT) {
+        return err;
+    }
+
+    if (_entry_count == _entry_capacity) {
+        size_t capacity = _entry_capacity ? 2 * _entry_capacity : 8;
+        entry *entries = (entry *)realloc(_entries, capacity * sizeof(entry));
+        if (!entries) {
+            return -ENOMEM;
+        }
+        _entries = entries;
+        _entry_capacity = capacity;
+    }
+
+    memmove(&_entries[index + 1], &_entries[index],
+            (_entry_count - index) * sizeof(entry));
+    _entries[index].hash = hash;
+    _entries[index].addr = addr;
+    _entries[index].value_size = value_size;
+    _entries[index].key_size = key_size;
+    _entry_count += 1;
+    _live += _record_size(key_size, value_size);
+    return 0;
+}
+
+void KVStore::_erase_entry(size_t index)
+{
+    _live -= _record_size(_entries[index].key_size, _entries[index].value_size);
+    memmove(&_entries[index], &_entries[index + 1],
+            (_entry_count - index - 1) * sizeof(entry));
+    _entry_count -= 1;
+}
+
+
+////// Block device access //////
+
+int KVStore::_read(bd_addr_t addr, void *buffer, bd_size_t size)
+{
+    uint8_t *data = (uint8_t *)buffer;
+    while (size > 0) {
+        // Aligned runs are read directly, the rest through the cache
+        if (addr % _read_size == 0 && size >= _read_size) {
+            bd_size_t n = size - size % _read_size;
+            int err = _bd->read(data, addr, n);
+            if (err) {
+                return err;
+            }
+            addr += n;
+            data += n;
+            size -= n;
+            continue;
+        }
+
+        bd_addr_t aligned = addr - addr % _read_size;
+        if (aligned != _read_addr) {
+            int err = _bd->read(_read_buffer, aligned, _read_size);
+            if (err) {
+                _read_addr = KVSTORE_NO_ADDR;
+                return err;
+            }
+            _read_addr = aligned;
+        }
+
+        bd_size_t off = addr - aligned;
+        bd_size_t n = _read_size - off < size ? _read_size - off : size;
+        memcpy(data, &_read_buffer[off], n);
+        addr += n;
+        data += n;
+        size -= n;
+    }
+
+    return 0;
+}
+
+int KVStore::_program_start(bd_addr_t addr)
+{
+    MBED_ASSERT(addr % _program_size == 0);
+    _program_addr = addr;
+    _program_fill = 0;
+    _read_addr = KVSTORE_NO_ADDR;
+    return 0;
+}
+
+int KVStore::_program_data(const void *buffer, bd_size_t size)
+{
+    const uint8_t *data = (const uint8_t *)buffer;
+    while (size > 0) {
+        if (_program_fill == 0 && size >= _program_size) {
+            bd_size_t n = size - size % _program_size;
+            int err = _bd->program(data, _program_addr, n);
+            if (err) {
+                return err;
+            }
+            _program_addr += n;
+            data += n;
+            size -= n;
+            continue;
+        }
+
+        bd_size_t n = _program_size - _program_fill < size
+                ? _program_size - _program_fill : size;
+        memcpy(&_program_buffer[_program_fill], data, n);
+        _program_fill += n;
+        data += n;
+        size -= n;
+
+        if (_program_fill == _program_size) {
+            int err = _bd->program(_program_buffer, _program_addr, _program_size);
+            if (err) {
+                return err;
+            }
+            _program_addr += _program_size;
+            _program_fill = 0;
+        }
+    }
+
+    return 0;
+}
+
+int KVStore::_program_end()
+{
+    if (_program_fill == 0) {
+        return 0;
+    }
+
+    memset(&_program_buffer[_program_fill], 0, _program_size - _program_fill);
+    int err = _bd->program(_program_buffer, _program_addr, _program_size);
+    if (err) {
+        return err;
+    }
+
+    _program_addr += _program_size;
+    _program_fill = 0;
+    return 0;
+}
@@ -0,0 +1,296 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 ARM Limited
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef MBED_KVSTORE_H
+#define MBED_KVSTORE_H
+
+#include "BlockDevice.h"
+#include "PlatformMutex.h"
+#include "Callback.h"
+#include <stddef.h>
+
+using namespace mbed;
+
+
+/** Power-fail safe key/value store on a block device
+ *
+ *  Values are appended to a log of CRC protected records, so a set() costs
+ *  a single program of the size of the record and an interrupted set()
+ *  leaves the previous value in place. An index of the keys is kept in RAM,
+ *  so a get() costs a single read of the key and value.
+ *
+ *  The log is made of blocks of the erase size of the device:
+ *  - Records are appended to the newest block, and a new block is started
+ *    when it is full. The block started is the free block erased the least.
+ *  - Space is reclaimed from the oldest block, by copying the records still
+ *    in use to a new block before freeing it. Blocks are therefore reused
+ *    in turn, which levels their wear whatever the update pattern. One block
+ *    is always kept free for this.
+ *  - When mounted, the log is replayed from the oldest block to build the
+ *    index. Records which do not check out end the replay of their block,
+ *    and the newest block is not appended to, as its end may be partially
+ *    programmed.
+ *
+ *  set() and remove() calls between begin() and commit() are applied
+ *  atomically: they are held in RAM and written in a single block on commit,
+ *  and are all dropped when replaying the log if the last one is missing.
+ *
+ *  @code
+ *  #include "mbed.h"
+ *  #include "HeapBlockDevice.h"
+ *  #include "KVStore.h"
+ *
+ *  HeapBlockDevice bd(16*4096, 1, 1, 4096);
+ *  KVStore kv;
+ *
+ *  int main() {
+ *      if (kv.mount(&bd)) {
+ *          KVStore::format(&bd);
+ *          kv.mount(&bd);
+ *      }
+ *
+ *      uint32_t boot_count = 0;
+ *      kv.get("boot_count", &boot_count, sizeof(boot_count));
+ *      boot_count += 1;
+ *      kv.set("boot_count", &boot_count, sizeof(boot_count));
+ *
+ *      // Update a pair of keys atomically
+ *      kv.begin();
+ *      kv.set("wifi_ssid", "mbed", 4);
+ *      kv.set("wifi_password", "secret", 6);
+ *      kv.commit();
+ *
+ *      kv.unmount();
+ *  }
+ *  @endcode
+ */
+class KVStore
+{
+public:
+    /** Lifetime of a KVStore
+     *
+     *  @param bd           BlockDevice to mount, may be passed instead to mount call
+     *  @param block_size   Size of the blocks of the log in bytes, must be a
+     *                      multiple of the erase size of the device. If zero,
+     *                      the erase size of the device is used. Defaults to zero.
+     */
+    KVStore(BlockDevice *bd = NULL, bd_size_t block_size = 0);
+    virtual ~KVStore();
+
+    /** Formats a block device for a KVStore, removing all keys
+     *
+     *  The KVStore should not be mounted on the block device when this
+     *  function is called. A block device which is blank or holds other data
+     *  mounts as an empty KVStore without being formatted.
+     *
+     *  @param bd           BlockDevice to format
+     *  @param block_size   Size of the blocks of the log, see KVStore()
+     *  @return             0 on success, negative error code on failure
+     */
+    static int format(BlockDevice *bd, bd_size_t block_size = 0);
+
+    /** Mounts a KVStore to a block device
+     *
+     *  Replays the log to build the index of the keys, discarding anything
+     *  left incomplete by a power failure.
+     *
+     *  @param bd       BlockDevice to mount to
+     *  @return         0 on success, negative error code on failure
+     */
+    int mount(BlockDevice *bd);
+
+    /** Unmounts a KVStore from the underlying block device
+     *
+     *  A transaction in progress is aborted.
+     *
+     *  @return         0 on success, negative error code on failure
+     */
+    int unmount();
+
+    /** Set the value of a key
+     *
+     *  @param key      Null terminated key, up to
+     *                  MBED_CONF_FILESYSTEM_KVSTORE_MAX_KEY_SIZE characters
+     *  @param buffer   Value of the key
+     *  @param size     Size of the value in bytes, the record of the key
+     *                  and value must fit in a block
+     *  @return         0 on success, -ENOSPC if the store is full, or
+     *                  another negative error code on failure
+     */
+    int set(const char *key, const void *buffer, size_t size);
+
+    /** Get the value of a key
+     *
+     *  Values set in a transaction are not visible until it is committed.
+     *
+     *  @param key          Null terminated key
+     *  @param buffer       Buffer to read the value into
+     *  @param size         Size of the buffer in bytes, the value is
+     *                      truncated if it does not fit
+     *  @param actual_size  Size of the value in bytes, may be NULL
+     *  @return             0 on success, -ENOENT if the key is not set, or
+     *                      another negative error code on failure
+     */
+    int get(const char *key, void *buffer, size_t size, size_t *actual_size = NULL);
+
+    /** Remove a key
+     *
+     *  @param key      Null terminated key
+     *  @return         0 on success, -ENOENT if the key is not set, or
+     *                  another negative error code on failure
+     */
+    int remove(const char *key);
+
+    /** Call a function for each key
+     *
+     *  The keys are visited in no particular order. The function must not
+     *  modify the store.
+     *
+     *  @param prefix   Only visit the keys starting with this prefix, may be NULL
+     *  @param func     Function called with each key and the size of its
+     *                  value, iteration stops if it returns non-zero
+     *  @return         0 on success, the value returned by func if non-zero,
+     *                  or a negative error code on failure
+     */
+    int iterate(const char *prefix, Callback<int(const char *key, size_t size)> func);
+
+    /** Start a transaction
+     *
+     *  The following set() and remove() calls, from any thread, are held
+     *  in RAM until commit() writes them atomically, or abort() drops them.
+     *  They return -ENOSPC if the transaction no longer fits in a block.
+     *
+     *  @return         0 on success, negative error code on failure
+     */
+    int begin();
+
+    /** Write the set() and remove() calls of the transaction atomically
+     *
+     *  @return         0 on success, negative error code on failure in which
+     *                  case none of the transaction is applied
+     */
+    int commit();
+
+    /** Drop the set() and remove() calls of the transaction
+     *
+     *  @return         0 on success, negative error code on failure
+     */
+    int abort();
+
+    /** Reclaim the space of the oldest block now
+     *
+     *  Space is reclaimed as needed by set() and remove(), this allows it to
+     *  be done ahead of time, e.g. when idle.
+     *
+     *  @return         0 on success, -ENOSPC if there is nothing to reclaim,
+     *                  or another negative error code on failure
+     */
+    int gc();
+
+    /** Get the number of bytes which can be written before the store is full
+     *
+     *  Records are aligned to the program size and do not span blocks, so
+     *  records which do not fill the blocks exactly leave some of it unused.
+     *
+     *  @return         Number of bytes of records which can be written
+     */
+    bd_size_t free_size();
+
+protected:
+    virtual void lock();
+    virtual void unlock();
+
+private:
+    struct entry {
+        uint32_t hash;
+        uint32_t addr;          // Address of the record
+        uint32_t value_size;
+        uint16_t key_size;
+    };
+
+    struct block {
+        uint32_t seq;           // Order in the log, 0 if free
+        uint32_t erase_count;
+        bd_size_t used;         // Bytes programmed, the whole block once sealed
+    };
+
+    struct txn_op {
+        txn_op *next;
+        uint16_t flags;
+        uint16_t key_size;
+        uint32_t value_size;
+        // followed by the key and the value
+    };
+
+    int _read(bd_addr_t addr, void *buffer, bd_size_t size);
+    int _program_start(bd_addr_t addr);
+    int _program_data(const void *buffer, bd_size_t size);
+    int _program_end();
+    int _write_record(uint16_t flags, const char *key, size_t key_size,
+            const void *buffer, size_t size, bd_addr_t *addr);
+    int _copy_record(entry *e);
+    int _check_record(bd_addr_t addr, bd_addr_t end, uint32_t seq, uint16_t *flags,
+            uint16_t *key_size, uint32_t *value_size);
+    int _replay_block(size_t b, bool apply, uint32_t *gc_seq);
+    int _apply(bd_addr_t addr, uint16_t flags, uint16_t key_size, uint32_t value_size);
+    int _find(const char *key, size_t key_size, uint32_t hash, size_t *index);
+    int _insert(const char *key, size_t key_size, bd_addr_t addr, uint32_t value_size);
+    void _erase_entry(size_t index);
+    int _reserve(bd_size_t size, bool remove);
+    int _start_block();
+    int _gc();
+    int _erase_block(size_t b);
+    uint32_t _tail_seq() const;
+    size_t _free_count() const;
+    bd_size_t _record_size(size_t key_size, size_t value_size) const;
+    bd_size_t _capacity() const;
+    int _txn_add(uint16_t flags, const char *key, const void *buffer, size_t size);
+    void _txn_clear();
+
+    PlatformMutex _mutex;
+    BlockDevice *_bd;
+    bd_size_t _block_size;
+    bd_size_t _read_size;
+    bd_size_t _program_size;
+    block *_blocks;
+    size_t _block_count;
+    size_t _head;               // Block records are appended to
+    bd_size_t _head_end;        // End of the space for records in the head block
+    uint32_t _seq;              // Sequence of the newest block
+    bd_size_t _live;            // Bytes of records in use
+
+    entry *_entries;
+    size_t _entry_count;
+    size_t _entry_capacity;
+
+    uint8_t *_read_buffer;
+    bd_addr_t _read_addr;
+    uint8_t *_program_buffer;
+    bd_addr_t _program_addr;
+    bd_size_t _program_fill;
+
+    bool _txn;
+    txn_op *_txn_ops;
+    bd_size_t _txn_size;
+};
+
+
+#endif
@@ -34,6 +34,9 @@
 #include "bd/SlicingBlockDevice.h"
 #include "bd/HeapBlockDevice.h"
 
+// Key/value store
+#include "kv/KVStore.h"
+
 
 /** @}*/
 #endif
@@ -1202,6 +1202,25 @@
  */
 #define MBEDTLS_SSL_MAX_FRAGMENT_LENGTH
 
+/**
+ * \def MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH
+ *
+ * Size the I/O buffers of TLS connections on demand, instead of allocating
+ * two buffers of MBEDTLS_SSL_MAX_CONTENT_LEN bytes for each of them.
+ *
+ * The buffers start at MBEDTLS_SSL_MIN_CONTENT_LEN bytes. The input buffer
+ * grows when a larger record arrives, and the output buffer grows to its
+ * full size for the handshake. Both are shrunk back once the handshake is
+ * over, to the negotiated max_fragment_length if it is smaller, and
+ * application data is then written in records fitting the output buffer.
+ * DTLS connections always use buffers of the full size.
+ *
+ * Requires: !MBEDTLS_ZLIB_SUPPORT
+ *
+ * Uncomment this macro to size the I/O buffers on demand
+ */
+//#define MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH
+
 /**
  * \def MBEDTLS_SSL_PROTO_SSL3
  *
@@ -2665,6 +2684,7 @@
 
 /* SSL options */
 //#define MBEDTLS_SSL_MAX_CONTENT_LEN             16384 /**< Maxium fragment length in bytes, determines the size of each of the two internal I/O buffers */
+//#define MBEDTLS_SSL_MIN_CONTENT_LEN              1024 /**< Size of the I/O buffers outside of the handshake with MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH */
 //#define MBEDTLS_SSL_DEFAULT_TICKET_LIFETIME     86400 /**< Lifetime of session tickets (if enabled) */
 //#define MBEDTLS_PSK_MAX_LEN               32 /**< Max size of TLS pre-shared keys, in bytes (default 256 bits) */
 //#define MBEDTLS_SSL_COOKIE_TIMEOUT        60 /**< Default expiration delay of DTLS cookies, in seconds if HAVE_TIME, or in number of cookies issued */
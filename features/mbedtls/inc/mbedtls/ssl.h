@@ -222,6 +222,18 @@
 #define MBEDTLS_SSL_MAX_CONTENT_LEN         16384   /**< Size of the input / output buffer */
 #endif
 
+/*
+ * Fragment length the I/O buffers start at and are shrunk back to after
+ * the handshake, with MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH.
+ */
+#if !defined(MBEDTLS_SSL_MIN_CONTENT_LEN)
+#define MBEDTLS_SSL_MIN_CONTENT_LEN         1024
+#endif
+
+#if MBEDTLS_SSL_MIN_CONTENT_LEN > MBEDTLS_SSL_MAX_CONTENT_LEN
+#error "MBEDTLS_SSL_MIN_CONTENT_LEN larger than MBEDTLS_SSL_MAX_CONTENT_LEN"
+#endif
+
 /* \} name SECTION: Module settings */
 
 /*
@@ -832,6 +844,9 @@ struct mbedtls_ssl_context
     int in_msgtype;             /*!< record header: message type      */
     size_t in_msglen;           /*!< record header: message length    */
     size_t in_left;             /*!< amount of data read so far       */
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+    size_t in_buf_len;          /*!< length of the input buffer       */
+#endif
 #if defined(MBEDTLS_SSL_PROTO_DTLS)
     uint16_t in_epoch;          /*!< DTLS epoch for incoming records  */
     size_t next_record_offset;  /*!< offset of the next record in datagram
@@ -862,6 +877,9 @@ struct mbedtls_ssl_context
     int out_msgtype;            /*!< record header: message type      */
     size_t out_msglen;          /*!< record header: message length    */
     size_t out_left;            /*!< amount of data not yet written   */
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+    size_t out_buf_len;         /*!< length of the output buffer      */
+#endif
 
 #if defined(MBEDTLS_ZLIB_SUPPORT)
     unsigned char *compress_buf;        /*!<  zlib data buffer        */
@@ -978,6 +978,9 @@ static int ssl_parse_client_hello_v2( mbedtls_ssl_context *ssl )
         return( ret );
     }
 
+    /* The input buffer may have been moved to fit the message */
+    buf = ssl->in_hdr;
+
     ssl->handshake->update_checksum( ssl, buf + 2, n );
 
     buf = ssl->in_msg;
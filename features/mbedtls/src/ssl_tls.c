@@ -155,6 +155,148 @@ static unsigned int mfl_code_to_length[MBEDTLS_SSL_MAX_FRAG_LEN_INVALID] =
 };
 #endif /* MBEDTLS_SSL_MAX_FRAGMENT_LENGTH */
 
+/* Current length of the I/O buffers */
+static inline size_t ssl_get_in_buf_len( const mbedtls_ssl_context *ssl )
+{
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+    return( ssl->in_buf_len );
+#else
+    ((void) ssl);
+    return( MBEDTLS_SSL_BUFFER_LEN );
+#endif
+}
+
+static inline size_t ssl_get_out_buf_len( const mbedtls_ssl_context *ssl )
+{
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+    return( ssl->out_buf_len );
+#else
+    ((void) ssl);
+    return( MBEDTLS_SSL_BUFFER_LEN );
+#endif
+}
+
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+static void ssl_rebase( unsigned char **p, const unsigned char *old_buf,
+                        unsigned char *new_buf )
+{
+    if( *p != NULL )
+        *p = new_buf + ( *p - old_buf );
+}
+
+/*
+ * Move a record buffer to one of len bytes, keeping its first used bytes.
+ * Only the stream transport resizes its buffers, as a whole datagram has
+ * to fit in the input buffer when it is read.
+ */
+static int ssl_realloc_buf( const mbedtls_ssl_context *ssl,
+                            unsigned char **buf, size_t *buf_len,
+                            size_t len, size_t used )
+{
+    unsigned char *new_buf;
+
+#if defined(MBEDTLS_SSL_PROTO_DTLS)
+    if( ssl->conf->transport == MBEDTLS_SSL_TRANSPORT_DATAGRAM )
+        return( 0 );
+#else
+    ((void) ssl);
+#endif
+
+    /* Shrinking is skipped while the data does not fit */
+    if( len == *buf_len || used > len )
+        return( 0 );
+
+    if( ( new_buf = mbedtls_calloc( 1, len ) ) == NULL )
+    {
+        MBEDTLS_SSL_DEBUG_MSG( 1, ( "alloc(%d bytes) failed", len ) );
+        return( MBEDTLS_ERR_SSL_ALLOC_FAILED );
+    }
+
+    MBEDTLS_SSL_DEBUG_MSG( 3, ( "record buffer resized: %d -> %d bytes",
+                                *buf_len, len ) );
+
+    memcpy( new_buf, *buf, used );
+    mbedtls_zeroize( *buf, *buf_len );
+    mbedtls_free( *buf );
+    *buf = new_buf;
+    *buf_len = len;
+    return( 0 );
+}
+
+/*
+ * Resize the input buffer, keeping the record being read and the
+ * content not consumed yet
+ */
+static int ssl_resize_in_buf( mbedtls_ssl_context *ssl, size_t len )
+{
+    int ret;
+    unsigned char *old_buf = ssl->in_buf;
+    /* The record counter is kept in front of the header */
+    size_t used = ssl->in_hdr - ssl->in_buf;
+
+    /* Either a record is being read, or its content is being consumed */
+    if( ssl->in_left != 0 )
+        used += ssl->in_left;
+    else if( ssl->in_msglen != 0 )
+        used = ( ssl->in_offt != NULL ? ssl->in_offt : ssl->in_msg )
+               + ssl->in_msglen - ssl->in_buf;
+
+    if( ( ret = ssl_realloc_buf( ssl, &ssl->in_buf, &ssl->in_buf_len,
+                                 len, used ) ) != 0 )
+        return( ret );
+
+    ssl_rebase( &ssl->in_ctr,  old_buf, ssl->in_buf );
+    ssl_rebase( &ssl->in_hdr,  old_buf, ssl->in_buf );
+    ssl_rebase( &ssl->in_len,  old_buf, ssl->in_buf );
+    ssl_rebase( &ssl->in_iv,   old_buf, ssl->in_buf );
+    ssl_rebase( &ssl->in_msg,  old_buf, ssl->in_buf );
+    ssl_rebase( &ssl->in_offt, old_buf, ssl->in_buf );
+    return( 0 );
+}
+
+/*
+ * Resize the output buffer, keeping the record not fully written yet
+ */
+static int ssl_resize_out_buf( mbedtls_ssl_context *ssl, size_t len )
+{
+    int ret;
+    unsigned char *old_buf = ssl->out_buf;
+    size_t used = ssl->out_hdr - ssl->out_buf;
+
+    if( ssl->out_left != 0 )
+        used += mbedtls_ssl_hdr_len( ssl ) + ssl->out_msglen;
+
+    if( ( ret = ssl_realloc_buf( ssl, &ssl->out_buf, &ssl->out_buf_len,
+                                 len, used ) ) != 0 )
+        return( ret );
+
+    ssl_rebase( &ssl->out_ctr, old_buf, ssl->out_buf );
+    ssl_rebase( &ssl->out_hdr, old_buf, ssl->out_buf );
+    ssl_rebase( &ssl->out_len, old_buf, ssl->out_buf );
+    ssl_rebase( &ssl->out_iv,  old_buf, ssl->out_buf );
+    ssl_rebase( &ssl->out_msg, old_buf, ssl->out_buf );
+    return( 0 );
+}
+
+/*
+ * Buffer length for records outside of the handshake: a negotiated
+ * max_fragment_length can only make it smaller
+ */
+static size_t ssl_min_buf_len( const mbedtls_ssl_context *ssl )
+{
+    size_t len = MBEDTLS_SSL_MIN_CONTENT_LEN;
+
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+    if( mbedtls_ssl_get_max_frag_len( ssl ) < len )
+        len = mbedtls_ssl_get_max_frag_len( ssl );
+#else
+    ((void) ssl);
+#endif
+
+    return( len + MBEDTLS_SSL_BUFFER_OVERHEAD );
+}
+#endif /* MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH */
+
 #if defined(MBEDTLS_SSL_CLI_C)
 static int ssl_session_copy( mbedtls_ssl_session *dst, const mbedtls_ssl_session *src )
 {
@@ -2220,6 +2362,15 @@ int mbedtls_ssl_fetch_input( mbedtls_ssl_context *ssl, size_t nb_want )
         return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
     }
 
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+    if( nb_want > ssl->in_buf_len - (size_t)( ssl->in_hdr - ssl->in_buf ) &&
+        ( ret = ssl_resize_in_buf( ssl,
+                    ( ssl->in_hdr - ssl->in_buf ) + nb_want ) ) != 0 )
+    {
+        return( ret );
+    }
+#endif
+
 #if defined(MBEDTLS_SSL_PROTO_DTLS)
     if( ssl->conf->transport == MBEDTLS_SSL_TRANSPORT_DATAGRAM )
     {
@@ -3519,6 +3670,24 @@ static int ssl_parse_record_header( mbedtls_ssl_context *ssl )
         return( MBEDTLS_ERR_SSL_INVALID_RECORD );
     }
 
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH) && \
+    defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+    /* Once negotiated, the max_fragment_length also bounds what we buffer */
+    if( ssl->state == MBEDTLS_SSL_HANDSHAKE_OVER &&
+        ssl->session_in != NULL &&
+        ssl->session_in->mfl_code != MBEDTLS_SSL_MAX_FRAG_LEN_NONE &&
+        ssl->in_msglen > mfl_code_to_length[ssl->session_in->mfl_code]
+                         + MBEDTLS_SSL_BUFFER_OVERHEAD
+                         - (size_t)( ssl->in_msg - ssl->in_buf ) )
+    {
+        MBEDTLS_SSL_DEBUG_MSG( 1, ( "record larger than the negotiated "
+                                    "maximum fragment length" ) );
+        mbedtls_ssl_send_alert_message( ssl, MBEDTLS_SSL_ALERT_LEVEL_FATAL,
+                                        MBEDTLS_SSL_ALERT_MSG_RECORD_OVERFLOW );
+        return( MBEDTLS_ERR_SSL_INVALID_RECORD );
+    }
+#endif
+
     /* Check length against bounds of the current transform and version */
     if( ssl->transform_in == NULL )
     {
@@ -5221,6 +5390,12 @@ void mbedtls_ssl_handshake_wrapup( mbedtls_ssl_context *ssl )
 #endif
         ssl_handshake_wrapup_free_hs_transform( ssl );
 
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+    /* Shrinking is best effort, the buffers are kept on failure */
+    (void) ssl_resize_in_buf( ssl, ssl_min_buf_len( ssl ) );
+    (void) ssl_resize_out_buf( ssl, ssl_min_buf_len( ssl ) );
+#endif
+
     ssl->state++;
 
     MBEDTLS_SSL_DEBUG_MSG( 3, ( "<= handshake wrapup" ) );
@@ -5606,10 +5781,17 @@ int mbedtls_ssl_setup( mbedtls_ssl_context *ssl,
                        const mbedtls_ssl_config *conf )
 {
     int ret;
-    const size_t len = MBEDTLS_SSL_BUFFER_LEN;
+    size_t len = MBEDTLS_SSL_BUFFER_LEN;
 
     ssl->conf = conf;
 
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+#if defined(MBEDTLS_SSL_PROTO_DTLS)
+    if( conf->transport == MBEDTLS_SSL_TRANSPORT_STREAM )
+#endif
+        len = MBEDTLS_SSL_MIN_CONTENT_LEN + MBEDTLS_SSL_BUFFER_OVERHEAD;
+#endif
+
     /*
      * Prepare base structures
      */
@@ -5622,6 +5804,11 @@ int mbedtls_ssl_setup( mbedtls_ssl_context *ssl,
         return( MBEDTLS_ERR_SSL_ALLOC_FAILED );
     }
 
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+    ssl->in_buf_len = len;
+    ssl->out_buf_len = len;
+#endif
+
 #if defined(MBEDTLS_SSL_PROTO_DTLS)
     if( conf->transport == MBEDTLS_SSL_TRANSPORT_DATAGRAM )
     {
@@ -5717,9 +5904,17 @@ static int ssl_session_reset_int( mbedtls_ssl_context *ssl, int partial )
     ssl->transform_in = NULL;
     ssl->transform_out = NULL;
 
-    memset( ssl->out_buf, 0, MBEDTLS_SSL_BUFFER_LEN );
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+    /* Nothing is kept with the stream transport, so this cannot fail */
+    (void) ssl_resize_in_buf( ssl, MBEDTLS_SSL_MIN_CONTENT_LEN +
+                                   MBEDTLS_SSL_BUFFER_OVERHEAD );
+    (void) ssl_resize_out_buf( ssl, MBEDTLS_SSL_MIN_CONTENT_LEN +
+                                    MBEDTLS_SSL_BUFFER_OVERHEAD );
+#endif
+
+    memset( ssl->out_buf, 0, ssl_get_out_buf_len( ssl ) );
     if( partial == 0 )
-        memset( ssl->in_buf, 0, MBEDTLS_SSL_BUFFER_LEN );
+        memset( ssl->in_buf, 0, ssl_get_in_buf_len( ssl ) );
 
 #if defined(MBEDTLS_SSL_HW_RECORD_ACCEL)
     if( mbedtls_ssl_hw_record_reset != NULL )
@@ -6532,6 +6727,13 @@ int mbedtls_ssl_handshake_step( mbedtls_ssl_context *ssl )
     if( ssl == NULL || ssl->conf == NULL )
         return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
 
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+    /* Handshake messages are written whole, up to the maximum length */
+    if( ( ret = ssl_resize_out_buf( ssl, MBEDTLS_SSL_BUFFER_LEN ) ) != 0 )
+        return( ret );
+    ret = MBEDTLS_ERR_SSL_FEATURE_UNAVAILABLE;
+#endif
+
 #if defined(MBEDTLS_SSL_CLI_C)
     if( ssl->conf->endpoint == MBEDTLS_SSL_IS_CLIENT )
         ret = mbedtls_ssl_handshake_client_step( ssl );
@@ -7071,6 +7273,12 @@ static int ssl_write_real( mbedtls_ssl_context *ssl,
     }
 #endif /* MBEDTLS_SSL_MAX_FRAGMENT_LENGTH */
 
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+    /* Records are written in place, as large as the buffer allows */
+    if( len > ssl->out_buf_len - MBEDTLS_SSL_BUFFER_OVERHEAD )
+        len = ssl->out_buf_len - MBEDTLS_SSL_BUFFER_OVERHEAD;
+#endif
+
     if( ssl->out_left != 0 )
     {
         if( ( ret = mbedtls_ssl_flush_output( ssl ) ) != 0 )
@@ -7345,13 +7553,13 @@ void mbedtls_ssl_free( mbedtls_ssl_context *ssl )
 
     if( ssl->out_buf != NULL )
     {
-        mbedtls_zeroize( ssl->out_buf, MBEDTLS_SSL_BUFFER_LEN );
+        mbedtls_zeroize( ssl->out_buf, ssl_get_out_buf_len( ssl ) );
         mbedtls_free( ssl->out_buf );
     }
 
     if( ssl->in_buf != NULL )
     {
-        mbedtls_zeroize( ssl->in_buf, MBEDTLS_SSL_BUFFER_LEN );
+        mbedtls_zeroize( ssl->in_buf, ssl_get_in_buf_len( ssl ) );
         mbedtls_free( ssl->in_buf );
     }
 
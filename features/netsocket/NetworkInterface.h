@@ -19,10 +19,18 @@
 
 #include "netsocket/nsapi_types.h"
 #include "netsocket/SocketAddress.h"
+#include "Callback.h"
 
 // Predeclared class
 class NetworkStack;
 
+/** Hostname translation callback
+ *
+ *  Called with the result of gethostbyname_async(), the address is only
+ *  valid for the duration of the call and NULL on failure.
+ */
+typedef mbed::Callback<void (nsapi_error_t result, SocketAddress *address)> hostbyname_cb_t;
+
 
 /** NetworkInterface class
  *
@@ -119,6 +127,24 @@ public:
     virtual nsapi_error_t gethostbyname(const char *host,
             SocketAddress *address, nsapi_version_t version = NSAPI_UNSPEC);
 
+    /** Translates a hostname to an IP address without blocking
+     *
+     *  The hostname may be either a domain name or an IP address. If the
+     *  hostname is an IP address or its address is cached, the callback is
+     *  called before returning. Otherwise the query runs from the shared
+     *  event queue and the callback is called from there.
+     *
+     *  @param host     Hostname to resolve
+     *  @param callback Callback called with the result
+     *  @param version  IP version of address to resolve, NSAPI_UNSPEC indicates
+     *                  version is chosen by the stack (defaults to NSAPI_UNSPEC)
+     *  @return         0 if the callback has been called,
+     *                  NSAPI_ERROR_IN_PROGRESS if the callback will be called later,
+     *                  negative error code on failure, the callback is not called
+     */
+    virtual nsapi_error_t gethostbyname_async(const char *host,
+            hostbyname_cb_t callback, nsapi_version_t version = NSAPI_UNSPEC);
+
     /** Add a domain name server to list of servers to query
      *
      *  @param address  Destination for the host address
@@ -20,8 +20,26 @@
 #include "stddef.h"
 #include <new>
 
+#ifndef MBED_CONF_NSAPI_RECV_COPY_SIZE
+#define MBED_CONF_NSAPI_RECV_COPY_SIZE 1500
+#endif
+
 
 // Default NetworkStack operations
+nsapi_version_t NetworkStack::dns_version(nsapi_version_t version)
+{
+    // if the version is unspecified, try to guess the version from the
+    // ip address of the underlying stack
+    if (version == NSAPI_UNSPEC) {
+        SocketAddress testaddress;
+        if (testaddress.set_ip_address(this->get_ip_address())) {
+            version = testaddress.get_ip_version();
+        }
+    }
+
+    return version;
+}
+
 nsapi_error_t NetworkStack::gethostbyname(const char *name, SocketAddress *address, nsapi_version_t version)
 {
     // check for simple ip addresses
@@ -33,16 +51,23 @@ nsapi_error_t NetworkStack::gethostbyname(const char *name, SocketAddress *addre
         return NSAPI_ERROR_OK;
     }
 
-    // if the version is unspecified, try to guess the version from the
-    // ip address of the underlying stack
-    if (version == NSAPI_UNSPEC) {
-        SocketAddress testaddress;
-        if (testaddress.set_ip_address(this->get_ip_address())) {
-            version = testaddress.get_ip_version();
+    return nsapi_dns_query(this, name, address, dns_version(version));
+}
+
+nsapi_error_t NetworkStack::gethostbyname_async(const char *name, hostbyname_cb_t callback, nsapi_version_t version)
+{
+    // check for simple ip addresses
+    SocketAddress address;
+    if (address.set_ip_address(name)) {
+        if (version != NSAPI_UNSPEC && address.get_ip_version() != version) {
+            return NSAPI_ERROR_DNS_FAILURE;
         }
+
+        callback(NSAPI_ERROR_OK, &address);
+        return NSAPI_ERROR_OK;
     }
 
-    return nsapi_dns_query(this, name, address, version);
+    return nsapi_dns_query_async(this, name, callback, dns_version(version));
 }
 
 nsapi_error_t NetworkStack::add_dns_server(const SocketAddress &address)
@@ -50,6 +75,160 @@ nsapi_error_t NetworkStack::add_dns_server(const SocketAddress &address)
     return nsapi_dns_add_server(address);
 }
 
+nsapi_size_or_error_t NetworkStack::socket_sendmsg(nsapi_socket_t handle, const SocketAddress *address,
+        const nsapi_iovec_t *iov, unsigned iovcnt)
+{
+    const void *data = iovcnt ? iov[0].iov_base : NULL;
+    nsapi_size_t size = iovcnt ? iov[0].iov_len : 0;
+    uint8_t *buffer = NULL;
+
+    // gather the buffers unless there is only one
+    if (iovcnt > 1) {
+        for (unsigned i = 1; i < iovcnt; i++) {
+            size += iov[i].iov_len;
+        }
+
+        buffer = (uint8_t *)malloc(size);
+        if (!buffer) {
+            return NSAPI_ERROR_NO_MEMORY;
+        }
+
+        nsapi_size_t offset = 0;
+        for (unsigned i = 0; i < iovcnt; i++) {
+            memcpy(buffer + offset, iov[i].iov_base, iov[i].iov_len);
+            offset += iov[i].iov_len;
+        }
+        data = buffer;
+    }
+
+    nsapi_size_or_error_t ret;
+    if (address) {
+        ret = socket_sendto(handle, *address, data, size);
+    } else {
+        ret = socket_send(handle, data, size);
+    }
+
+    free(buffer);
+    return ret;
+}
+
+nsapi_size_or_error_t NetworkStack::socket_recvmsg(nsapi_socket_t handle, SocketAddress *address,
+        const nsapi_iovec_t *iov, unsigned iovcnt)
+{
+    void *data = iovcnt ? iov[0].iov_base : NULL;
+    nsapi_size_t size = iovcnt ? iov[0].iov_len : 0;
+    uint8_t *buffer = NULL;
+
+    // receive in place unless there are several buffers
+    if (iovcnt > 1) {
+        for (unsigned i = 1; i < iovcnt; i++) {
+            size += iov[i].iov_len;
+        }
+
+        buffer = (uint8_t *)malloc(size);
+        if (!buffer) {
+            return NSAPI_ERROR_NO_MEMORY;
+        }
+        data = buffer;
+    }
+
+    nsapi_size_or_error_t ret;
+    if (address) {
+        ret = socket_recvfrom(handle, address, data, size);
+    } else {
+        ret = socket_recv(handle, data, size);
+    }
+
+    // scatter what was received
+    if (buffer) {
+        nsapi_size_t offset = 0;
+        for (unsigned i = 0; ret > 0 && offset < (nsapi_size_t)ret; i++) {
+            nsapi_size_t len = (nsapi_size_t)ret - offset;
+            if (len > iov[i].iov_len) {
+                len = iov[i].iov_len;
+            }
+
+            memcpy(iov[i].iov_base, buffer + offset, len);
+            offset += len;
+        }
+
+        free(buffer);
+    }
+
+    return ret;
+}
+
+nsapi_size_or_error_t NetworkStack::socket_recv_borrow(nsapi_socket_t handle, SocketAddress *address,
+        nsapi_recv_view_t *view)
+{
+    if (!view->iovcnt) {
+        return NSAPI_ERROR_PARAMETER;
+    }
+
+    // lend a copy, the buffer is freed on release
+    uint8_t *buffer = (uint8_t *)malloc(MBED_CONF_NSAPI_RECV_COPY_SIZE);
+    if (!buffer) {
+        return NSAPI_ERROR_NO_MEMORY;
+    }
+
+    nsapi_size_or_error_t ret;
+    if (address) {
+        ret = socket_recvfrom(handle, address, buffer, MBED_CONF_NSAPI_RECV_COPY_SIZE);
+    } else {
+        ret = socket_recv(handle, buffer, MBED_CONF_NSAPI_RECV_COPY_SIZE);
+    }
+
+    if (ret < 0) {
+        free(buffer);
+        return ret;
+    }
+
+    view->iov[0].iov_base = buffer;
+    view->iov[0].iov_len = ret;
+    view->iovcnt = 1;
+    view->handle = buffer;
+    return ret;
+}
+
+void NetworkStack::socket_recv_release(nsapi_socket_t handle, nsapi_recv_view_t *view)
+{
+    free(view->handle);
+    view->handle = NULL;
+    view->iovcnt = 0;
+}
+
+nsapi_size_or_error_t NetworkStack::socket_sendto_batch(nsapi_socket_t handle,
+        const nsapi_datagram_t *dgrams, unsigned count)
+{
+    for (unsigned i = 0; i < count; i++) {
+        SocketAddress address(dgrams[i].addr, dgrams[i].port);
+        nsapi_size_or_error_t ret = socket_sendto(handle, address, dgrams[i].data, dgrams[i].size);
+        if (ret < 0) {
+            return i ? (nsapi_size_or_error_t)i : ret;
+        }
+    }
+
+    return count;
+}
+
+nsapi_size_or_error_t NetworkStack::socket_recvfrom_batch(nsapi_socket_t handle,
+        nsapi_datagram_t *dgrams, unsigned count)
+{
+    for (unsigned i = 0; i < count; i++) {
+        SocketAddress address;
+        nsapi_size_or_error_t ret = socket_recvfrom(handle, &address, dgrams[i].data, dgrams[i].size);
+        if (ret < 0) {
+            return i ? (nsapi_size_or_error_t)i : ret;
+        }
+
+        dgrams[i].addr = address.get_addr();
+        dgrams[i].port = address.get_port();
+        dgrams[i].len = ret;
+    }
+
+    return count;
+}
+
 nsapi_error_t NetworkStack::setstackopt(int level, int optname, const void *optval, unsigned optlen)
 {
     return NSAPI_ERROR_UNSUPPORTED;
@@ -111,6 +290,23 @@ public:
         return err;
     }
 
+    virtual nsapi_error_t gethostbyname_async(const char *name, hostbyname_cb_t callback, nsapi_version_t version)
+    {
+        if (!_stack_api()->gethostbyname) {
+            return NetworkStack::gethostbyname_async(name, callback, version);
+        }
+
+        // stack-specific resolution is blocking, the answer is given right away
+        SocketAddress address;
+        nsapi_error_t err = gethostbyname(name, &address, version);
+        if (err) {
+            return err;
+        }
+
+        callback(NSAPI_ERROR_OK, &address);
+        return NSAPI_ERROR_OK;
+    }
+
     virtual nsapi_error_t add_dns_server(const SocketAddress &address)
     {
         if (!_stack_api()->add_dns_server) {
@@ -249,6 +445,90 @@ protected:
         return err;
     }
 
+    virtual nsapi_size_or_error_t socket_sendmsg(nsapi_socket_t socket, const SocketAddress *address, const nsapi_iovec_t *iov, unsigned iovcnt)
+    {
+        if (!_stack_api()->socket_sendmsg) {
+            return NetworkStack::socket_sendmsg(socket, address, iov, iovcnt);
+        }
+
+        if (address) {
+            nsapi_addr_t addr = address->get_addr();
+            return _stack_api()->socket_sendmsg(_stack(), socket, &addr, address->get_port(), iov, iovcnt);
+        }
+
+        return _stack_api()->socket_sendmsg(_stack(), socket, NULL, 0, iov, iovcnt);
+    }
+
+    virtual nsapi_size_or_error_t socket_recvmsg(nsapi_socket_t socket, SocketAddress *address, const nsapi_iovec_t *iov, unsigned iovcnt)
+    {
+        if (!_stack_api()->socket_recvmsg) {
+            return NetworkStack::socket_recvmsg(socket, address, iov, iovcnt);
+        }
+
+        if (!address) {
+            return _stack_api()->socket_recvmsg(_stack(), socket, NULL, NULL, iov, iovcnt);
+        }
+
+        nsapi_addr_t addr = {NSAPI_IPv4, 0};
+        uint16_t port = 0;
+
+        nsapi_size_or_error_t err = _stack_api()->socket_recvmsg(_stack(), socket, &addr, &port, iov, iovcnt);
+
+        address->set_addr(addr);
+        address->set_port(port);
+
+        return err;
+    }
+
+    virtual nsapi_size_or_error_t socket_recv_borrow(nsapi_socket_t socket, SocketAddress *address, nsapi_recv_view_t *view)
+    {
+        if (!_stack_api()->socket_recv_borrow || !_stack_api()->socket_recv_release) {
+            return NetworkStack::socket_recv_borrow(socket, address, view);
+        }
+
+        if (!address) {
+            return _stack_api()->socket_recv_borrow(_stack(), socket, NULL, NULL, view);
+        }
+
+        nsapi_addr_t addr = {NSAPI_IPv4, 0};
+        uint16_t port = 0;
+
+        nsapi_size_or_error_t err = _stack_api()->socket_recv_borrow(_stack(), socket, &addr, &port, view);
+
+        address->set_addr(addr);
+        address->set_port(port);
+
+        return err;
+    }
+
+    virtual void socket_recv_release(nsapi_socket_t socket, nsapi_recv_view_t *view)
+    {
+        if (!_stack_api()->socket_recv_borrow || !_stack_api()->socket_recv_release) {
+            NetworkStack::socket_recv_release(socket, view);
+            return;
+        }
+
+        _stack_api()->socket_recv_release(_stack(), socket, view);
+    }
+
+    virtual nsapi_size_or_error_t socket_sendto_batch(nsapi_socket_t socket, const nsapi_datagram_t *dgrams, unsigned count)
+    {
+        if (!_stack_api()->socket_sendto_batch) {
+            return NetworkStack::socket_sendto_batch(socket, dgrams, count);
+        }
+
+        return _stack_api()->socket_sendto_batch(_stack(), socket, dgrams, count);
+    }
+
+    virtual nsapi_size_or_error_t socket_recvfrom_batch(nsapi_socket_t socket, nsapi_datagram_t *dgrams, unsigned count)
+    {
+        if (!_stack_api()->socket_recvfrom_batch) {
+            return NetworkStack::socket_recvfrom_batch(socket, dgrams, count);
+        }
+
+        return _stack_api()->socket_recvfrom_batch(_stack(), socket, dgrams, count);
+    }
+
     virtual void socket_attach(nsapi_socket_t socket, void (*callback)(void *), void *data)
     {
         if (!_stack_api()->socket_attach) {
@@ -60,6 +60,24 @@ public:
     virtual nsapi_error_t gethostbyname(const char *host,
             SocketAddress *address, nsapi_version_t version = NSAPI_UNSPEC);
 
+    /** Translates a hostname to an IP address without blocking
+     *
+     *  The hostname may be either a domain name or an IP address. If the
+     *  hostname is an IP address or its address is cached, the callback is
+     *  called before returning. Otherwise the query runs from the shared
+     *  event queue and the callback is called from there.
+     *
+     *  @param host     Hostname to resolve
+     *  @param callback Callback called with the result
+     *  @param version  IP version of address to resolve, NSAPI_UNSPEC indicates
+     *                  version is chosen by the stack (defaults to NSAPI_UNSPEC)
+     *  @return         0 if the callback has been called,
+     *                  NSAPI_ERROR_IN_PROGRESS if the callback will be called later,
+     *                  negative error code on failure, the callback is not called
+     */
+    virtual nsapi_error_t gethostbyname_async(const char *host,
+            hostbyname_cb_t callback, nsapi_version_t version = NSAPI_UNSPEC);
+
     /** Add a domain name server to list of servers to query
      *
      *  @param address  Destination for the host address
@@ -253,6 +271,130 @@ protected:
     virtual nsapi_size_or_error_t socket_recvfrom(nsapi_socket_t handle, SocketAddress *address,
             void *buffer, nsapi_size_t size) = 0;
 
+    /** Send a message made of several buffers over a socket
+     *
+     *  Sends the buffers as if they were a single buffer, over a connected
+     *  TCP socket if address is NULL, or as a packet to the specified
+     *  address over a UDP socket. Returns the number of bytes sent from the
+     *  buffers.
+     *
+     *  This call is non-blocking. If sending would block,
+     *  NSAPI_ERROR_WOULD_BLOCK is returned immediately.
+     *
+     *  By default the buffers are copied to a contiguous buffer passed to
+     *  socket_send or socket_sendto, stacks able to send the buffers in
+     *  place should override this.
+     *
+     *  @param handle   Socket handle
+     *  @param address  The SocketAddress of the remote host, or NULL for TCP
+     *  @param iov      Buffers of data to send to the host
+     *  @param iovcnt   Number of buffers
+     *  @return         Number of sent bytes on success, negative error
+     *                  code on failure
+     */
+    virtual nsapi_size_or_error_t socket_sendmsg(nsapi_socket_t handle, const SocketAddress *address,
+            const nsapi_iovec_t *iov, unsigned iovcnt);
+
+    /** Receive data over a socket into several buffers
+     *
+     *  Receives data over a connected TCP socket if address is NULL, or a
+     *  packet over a UDP socket storing its source address in address.
+     *  The buffers are filled in order. Returns the number of bytes
+     *  received.
+     *
+     *  This call is non-blocking. If receiving would block,
+     *  NSAPI_ERROR_WOULD_BLOCK is returned immediately.
+     *
+     *  By default the data is received in a contiguous buffer with
+     *  socket_recv or socket_recvfrom and copied to the buffers.
+     *
+     *  @param handle   Socket handle
+     *  @param address  Destination for the source address, or NULL for TCP
+     *  @param iov      Destination buffers for data received from the host
+     *  @param iovcnt   Number of buffers
+     *  @return         Number of received bytes on success, negative error
+     *                  code on failure
+     */
+    virtual nsapi_size_or_error_t socket_recvmsg(nsapi_socket_t handle, SocketAddress *address,
+            const nsapi_iovec_t *iov, unsigned iovcnt);
+
+    /** Receive data over a socket without copying it
+     *
+     *  Receives data over a connected TCP socket if address is NULL, or a
+     *  packet over a UDP socket storing its source address in address, and
+     *  lends it as read-only segments of the receive buffers of the stack.
+     *  Segments of a packet that do not fit in the view are discarded, TCP
+     *  data that does not fit is left for the next receive. Returns the
+     *  number of bytes in the view, which has to be released with
+     *  socket_recv_release.
+     *
+     *  This call is non-blocking. If receiving would block,
+     *  NSAPI_ERROR_WOULD_BLOCK is returned immediately.
+     *
+     *  By default the data is copied to a buffer of
+     *  MBED_CONF_NSAPI_RECV_COPY_SIZE bytes with socket_recv or
+     *  socket_recvfrom, stacks able to lend their buffers should override
+     *  this together with socket_recv_release.
+     *
+     *  @param handle   Socket handle
+     *  @param address  Destination for the source address, or NULL for TCP
+     *  @param view     Segments to fill with the data received
+     *  @return         Number of received bytes on success, negative error
+     *                  code on failure
+     */
+    virtual nsapi_size_or_error_t socket_recv_borrow(nsapi_socket_t handle, SocketAddress *address,
+            nsapi_recv_view_t *view);
+
+    /** Release data lent by socket_recv_borrow
+     *
+     *  Gives the buffers of the view back to the stack, after which the
+     *  segments are no longer valid.
+     *
+     *  @param handle   Socket handle
+     *  @param view     View filled by socket_recv_borrow
+     */
+    virtual void socket_recv_release(nsapi_socket_t handle, nsapi_recv_view_t *view);
+
+    /** Send several packets over a UDP socket
+     *
+     *  Sends the datagrams in order, each to its own address. Returns the
+     *  number of datagrams sent, which is less than count if one could not
+     *  be sent after others were.
+     *
+     *  This call is non-blocking. If sending would block,
+     *  NSAPI_ERROR_WOULD_BLOCK is returned immediately.
+     *
+     *  By default each datagram is sent with socket_sendto, stacks able
+     *  to send the batch at once should override this.
+     *
+     *  @param handle   Socket handle
+     *  @param dgrams   Datagrams to send
+     *  @param count    Number of datagrams
+     *  @return         Number of sent datagrams on success, negative error
+     *                  code on failure
+     */
+    virtual nsapi_size_or_error_t socket_sendto_batch(nsapi_socket_t handle,
+            const nsapi_datagram_t *dgrams, unsigned count);
+
+    /** Receive several packets over a UDP socket
+     *
+     *  Fills the datagrams in order with the packets already received, up
+     *  to count. Returns the number of datagrams filled.
+     *
+     *  This call is non-blocking. If no packet has been received,
+     *  NSAPI_ERROR_WOULD_BLOCK is returned immediately.
+     *
+     *  By default each datagram is received with socket_recvfrom.
+     *
+     *  @param handle   Socket handle
+     *  @param dgrams   Datagrams to fill with the packets received
+     *  @param count    Number of datagrams
+     *  @return         Number of received datagrams on success, negative
+     *                  error code on failure
+     */
+    virtual nsapi_size_or_error_t socket_recvfrom_batch(nsapi_socket_t handle,
+            nsapi_datagram_t *dgrams, unsigned count);
+
     /** Register a callback on state change of the socket
      *
      *  The specified callback will be called on state changes such as when
@@ -299,6 +441,12 @@ protected:
      */
     virtual nsapi_error_t getsockopt(nsapi_socket_t handle, int level,
             int optname, void *optval, unsigned *optlen);
+
+private:
+    /** Version of the addresses to resolve, guessed from the stack's
+     *  own address if unspecified
+     */
+    nsapi_version_t dns_version(nsapi_version_t version);
 };
 
 
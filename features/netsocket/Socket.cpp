@@ -16,11 +16,23 @@
 
 #include "Socket.h"
 #include "mbed.h"
+#include "platform/mbed_critical.h"
 
 Socket::Socket()
     : _stack(0)
     , _socket(0)
     , _timeout(osWaitForever)
+    , _queue(0)
+    , _process_pending(false)
+    , _process_id(0)
+    , _send_data(0)
+    , _send_size(0)
+    , _sent(0)
+    , _send_addr()
+    , _send_port(0)
+    , _recv_data(0)
+    , _recv_size(0)
+    , _recv_address(0)
 {
 }
 
@@ -66,6 +78,10 @@ nsapi_error_t Socket::close()
     // on this socket
     event();
 
+    // Asynchronous operations are dropped, the socket may be destroyed
+    // before the queue runs
+    async_cancel();
+
     _lock.unlock();
     return ret;
 }
@@ -99,6 +115,17 @@ nsapi_error_t Socket::bind(const SocketAddress &address)
     return ret;
 }
 
+void Socket::recv_release(nsapi_recv_view_t *view)
+{
+    _lock.lock();
+
+    if (_stack) {
+        _stack->socket_recv_release(_socket, view);
+    }
+
+    _lock.unlock();
+}
+
 void Socket::set_blocking(bool blocking)
 {
     // Socket::set_timeout is thread safe
@@ -160,3 +187,138 @@ void Socket::attach(Callback<void()> callback)
 {
     sigio(callback);
 }
+
+void Socket::set_event_queue(events::EventQueue *queue)
+{
+    _lock.lock();
+    async_cancel();
+    core_util_critical_section_enter();
+    _queue = queue;
+    core_util_critical_section_exit();
+    _lock.unlock();
+}
+
+bool Socket::cancel_send()
+{
+    _lock.lock();
+    bool cancelled = _send_done;
+    _send_done = Callback<void(nsapi_size_or_error_t)>();
+    _lock.unlock();
+    return cancelled;
+}
+
+bool Socket::cancel_recv()
+{
+    _lock.lock();
+    bool cancelled = _recv_done;
+    _recv_done = Callback<void(nsapi_size_or_error_t)>();
+    _lock.unlock();
+    return cancelled;
+}
+
+nsapi_size_or_error_t Socket::async_send()
+{
+    return NSAPI_ERROR_UNSUPPORTED;
+}
+
+nsapi_size_or_error_t Socket::async_recv()
+{
+    return NSAPI_ERROR_UNSUPPORTED;
+}
+
+// Called with the lock held, the caller fills in the operation
+// if NSAPI_ERROR_IN_PROGRESS is returned
+nsapi_error_t Socket::async_start(Callback<void(nsapi_size_or_error_t)> *op,
+        Callback<void(nsapi_size_or_error_t)> done)
+{
+    if (!_socket) {
+        return NSAPI_ERROR_NO_SOCKET;
+    }
+
+    if (!_queue) {
+        return NSAPI_ERROR_UNSUPPORTED;
+    }
+
+    if (*op) {
+        return NSAPI_ERROR_ALREADY;
+    }
+
+    // Attempted from the queue, so the callback is never called
+    // before this returns
+    nsapi_error_t err = async_event();
+    if (err) {
+        return err;
+    }
+
+    *op = done;
+    return NSAPI_ERROR_IN_PROGRESS;
+}
+
+// Also called from event() in the context of the stack, without the lock,
+// so the queue is posted to at most once in a critical section
+nsapi_error_t Socket::async_event()
+{
+    nsapi_error_t err = NSAPI_ERROR_OK;
+    core_util_critical_section_enter();
+    if (_queue && !_process_pending) {
+        _process_id = _queue->call(this, &Socket::process);
+        if (_process_id) {
+            _process_pending = true;
+        } else {
+            err = NSAPI_ERROR_NO_MEMORY;
+        }
+    }
+    core_util_critical_section_exit();
+    return err;
+}
+
+void Socket::async_cancel()
+{
+    core_util_critical_section_enter();
+    if (_process_pending) {
+        _queue->cancel(_process_id);
+        _process_pending = false;
+    }
+    core_util_critical_section_exit();
+    _send_done = Callback<void(nsapi_size_or_error_t)>();
+    _recv_done = Callback<void(nsapi_size_or_error_t)>();
+}
+
+void Socket::process()
+{
+    _lock.lock();
+    core_util_critical_section_enter();
+    _process_pending = false;
+    core_util_critical_section_exit();
+
+    // One operation completes per call, as its callback may close or
+    // destroy the socket. The other one is looked at in a new call.
+    Callback<void(nsapi_size_or_error_t)> done;
+    nsapi_size_or_error_t ret = NSAPI_ERROR_WOULD_BLOCK;
+    if (_send_done) {
+        ret = _socket ? async_send() : NSAPI_ERROR_NO_SOCKET;
+        if (ret != NSAPI_ERROR_WOULD_BLOCK) {
+            done = _send_done;
+            _send_done = Callback<void(nsapi_size_or_error_t)>();
+        }
+    }
+
+    if (!done && _recv_done) {
+        ret = _socket ? async_recv() : NSAPI_ERROR_NO_SOCKET;
+        if (ret != NSAPI_ERROR_WOULD_BLOCK) {
+            done = _recv_done;
+            _recv_done = Callback<void(nsapi_size_or_error_t)>();
+        }
+    }
+
+    // If the queue is full, the next event of the stack posts it again
+    if (done && (_send_done || _recv_done)) {
+        async_event();
+    }
+
+    _lock.unlock();
+
+    if (done) {
+        done(ret);
+    }
+}
@@ -23,6 +23,7 @@
 #include "netsocket/SocketAddress.h"
 #include "netsocket/NetworkStack.h"
 #include "rtos/Mutex.h"
+#include "events/EventQueue.h"
 #include "Callback.h"
 #include "mbed_toolchain.h"
 
@@ -154,6 +155,52 @@ public:
      */    
     nsapi_error_t getsockopt(int level, int optname, void *optval, unsigned *optlen);
 
+    /** Release data lent by a borrowing receive
+     *
+     *  Gives the buffers of a view filled by TCPSocket::recv_borrow or
+     *  UDPSocket::recvfrom_borrow back to the stack. Every view returned
+     *  has to be released before the socket is closed.
+     *
+     *  @param view     View filled by a borrowing receive
+     */
+    void recv_release(nsapi_recv_view_t *view);
+
+    /** Run asynchronous operations on an event queue
+     *
+     *  Enables the asynchronous operations, such as TCPSocket::send_async
+     *  or UDPSocket::recvfrom_async. The events of the stack post the
+     *  processing of the operations in progress on the queue, which also
+     *  calls their callbacks, so no thread waits on the socket.
+     *
+     *  Asynchronous operations, their cancellation and close have to be
+     *  called in the context of the event queue, e.g. from a callback or
+     *  an event. They should not be mixed with blocking calls.
+     *  An operation fails to start with NSAPI_ERROR_NO_MEMORY if the queue
+     *  is full.
+     *
+     *  @param queue    Event queue to run the operations on, NULL to
+     *                  cancel the operations in progress
+     */
+    void set_event_queue(events::EventQueue *queue);
+
+    /** Cancel the asynchronous connect or send in progress
+     *
+     *  Its callback is not called, and its buffer can be reused once this
+     *  returns. Data already handed to the stack is still sent.
+     *
+     *  @return         True if an operation was cancelled
+     */
+    bool cancel_send();
+
+    /** Cancel the asynchronous receive in progress
+     *
+     *  Its callback is not called, and its buffer can be reused once this
+     *  returns. Data not received yet stays with the stack.
+     *
+     *  @return         True if an operation was cancelled
+     */
+    bool cancel_recv();
+
     /** Register a callback on state change of the socket
      *
      *  The specified callback will be called on state changes such as when
@@ -204,12 +251,36 @@ protected:
     virtual nsapi_protocol_t get_proto() = 0;
     virtual void event() = 0;
 
+    // Asynchronous operations, attempted on the event queue until they
+    // return something else than NSAPI_ERROR_WOULD_BLOCK
+    virtual nsapi_size_or_error_t async_send();
+    virtual nsapi_size_or_error_t async_recv();
+    nsapi_error_t async_start(mbed::Callback<void(nsapi_size_or_error_t)> *op,
+            mbed::Callback<void(nsapi_size_or_error_t)> done);
+    nsapi_error_t async_event();
+    void async_cancel();
+    void process();
+
     NetworkStack *_stack;
     nsapi_socket_t _socket;
     uint32_t _timeout;
     mbed::Callback<void()> _event;
     mbed::Callback<void()> _callback;
     rtos::Mutex _lock;
+
+    events::EventQueue *_queue;
+    volatile bool _process_pending;
+    int _process_id;
+    mbed::Callback<void(nsapi_size_or_error_t)> _send_done;
+    mbed::Callback<void(nsapi_size_or_error_t)> _recv_done;
+    const void *_send_data;
+    nsapi_size_t _send_size;
+    nsapi_size_t _sent;
+    nsapi_addr_t _send_addr;
+    uint16_t _send_port;
+    void *_recv_data;
+    nsapi_size_t _recv_size;
+    SocketAddress *_recv_address;
 };
 
 
@@ -23,7 +23,8 @@
 
 TCPSocket::TCPSocket()
     : _pending(0), _event_flag(),
-      _read_in_progress(false), _write_in_progress(false)
+      _read_in_progress(false), _write_in_progress(false),
+      _connecting(false), _connect_in_progress(false)
 {
 }
 
@@ -188,6 +189,135 @@ nsapi_size_or_error_t TCPSocket::recv(void *data, nsapi_size_t size)
     return ret;
 }
 
+nsapi_size_or_error_t TCPSocket::sendmsg(const nsapi_iovec_t *iov, unsigned iovcnt)
+{
+    _lock.lock();
+    nsapi_size_or_error_t ret;
+
+    // If this assert is hit then there are two threads
+    // performing a send at the same time which is undefined
+    // behavior
+    MBED_ASSERT(!_write_in_progress);
+    _write_in_progress = true;
+
+    while (true) {
+        if (!_socket) {
+            ret = NSAPI_ERROR_NO_SOCKET;
+            break;
+        }
+
+        _pending = 0;
+        ret = _stack->socket_sendmsg(_socket, NULL, iov, iovcnt);
+        if ((_timeout == 0) || (ret != NSAPI_ERROR_WOULD_BLOCK)) {
+            break;
+        } else {
+            uint32_t flag;
+
+            // Release lock before blocking so other threads
+            // accessing this object aren't blocked
+            _lock.unlock();
+            flag = _event_flag.wait_any(WRITE_FLAG, _timeout);
+            _lock.lock();
+
+            if (flag & osFlagsError) {
+                // Timeout break
+                ret = NSAPI_ERROR_WOULD_BLOCK;
+                break;
+            }
+        }
+    }
+
+    _write_in_progress = false;
+    _lock.unlock();
+    return ret;
+}
+
+nsapi_size_or_error_t TCPSocket::recvmsg(const nsapi_iovec_t *iov, unsigned iovcnt)
+{
+    _lock.lock();
+    nsapi_size_or_error_t ret;
+
+    // If this assert is hit then there are two threads
+    // performing a recv at the same time which is undefined
+    // behavior
+    MBED_ASSERT(!_read_in_progress);
+    _read_in_progress = true;
+
+    while (true) {
+        if (!_socket) {
+            ret = NSAPI_ERROR_NO_SOCKET;
+            break;
+        }
+
+        _pending = 0;
+        ret = _stack->socket_recvmsg(_socket, NULL, iov, iovcnt);
+        if ((_timeout == 0) || (ret != NSAPI_ERROR_WOULD_BLOCK)) {
+            break;
+        } else {
+            uint32_t flag;
+
+            // Release lock before blocking so other threads
+            // accessing this object aren't blocked
+            _lock.unlock();
+            flag = _event_flag.wait_any(READ_FLAG, _timeout);
+            _lock.lock();
+
+            if (flag & osFlagsError) {
+                // Timeout break
+                ret = NSAPI_ERROR_WOULD_BLOCK;
+                break;
+            }
+        }
+    }
+
+    _read_in_progress = false;
+    _lock.unlock();
+    return ret;
+}
+
+nsapi_size_or_error_t TCPSocket::recv_borrow(nsapi_recv_view_t *view)
+{
+    _lock.lock();
+    nsapi_size_or_error_t ret;
+
+    // If this assert is hit then there are two threads
+    // performing a recv at the same time which is undefined
+    // behavior
+    MBED_ASSERT(!_read_in_progress);
+    _read_in_progress = true;
+
+    while (true) {
+        if (!_socket) {
+            ret = NSAPI_ERROR_NO_SOCKET;
+            break;
+        }
+
+        _pending = 0;
+        ret = _stack->socket_recv_borrow(_socket, NULL, view);
+        if ((_timeout == 0) || (ret != NSAPI_ERROR_WOULD_BLOCK)) {
+            break;
+        } else {
+            uint32_t flag;
+
+            // Release lock before blocking so other threads
+            // accessing this object aren't blocked
+            _lock.unlock();
+            flag = _event_flag.wait_any(READ_FLAG, _timeout);
+            _lock.lock();
+
+            if (flag & osFlagsError) {
+                // Timeout break
+                ret = NSAPI_ERROR_WOULD_BLOCK;
+                break;
+            }
+        }
+    }
+
+    _read_in_progress = false;
+    _lock.unlock();
+    return ret;
+}
+
 void TCPSocket::event()
 {
     _event_flag.set(READ_FLAG|WRITE_FLAG);
@@ -196,4 +326,92 @@ void TCPSocket::event()
     if (_callback && _pending == 1) {
         _callback();
     }
+
+    async_event();
+}
+
+nsapi_error_t TCPSocket::connect_async(const SocketAddress &address,
+        mbed::Callback<void(nsapi_error_t)> done)
+{
+    _lock.lock();
+    nsapi_error_t ret = async_start(&_send_done, done);
+    if (ret == NSAPI_ERROR_IN_PROGRESS) {
+        _send_addr = address.get_addr();
+        _send_port = address.get_port();
+        _connecting = true;
+        _connect_in_progress = false;
+    }
+
+    _lock.unlock();
+    return ret;
+}
+
+nsapi_error_t TCPSocket::send_async(const void *data, nsapi_size_t size,
+        mbed::Callback<void(nsapi_size_or_error_t)> done)
+{
+    _lock.lock();
+    nsapi_error_t ret = async_start(&_send_done, done);
+    if (ret == NSAPI_ERROR_IN_PROGRESS) {
+        _send_data = data;
+        _send_size = size;
+        _sent = 0;
+        _connecting = false;
+    }
+
+    _lock.unlock();
+    return ret;
+}
+
+nsapi_error_t TCPSocket::recv_async(void *data, nsapi_size_t size,
+        mbed::Callback<void(nsapi_size_or_error_t)> done)
+{
+    _lock.lock();
+    nsapi_error_t ret = async_start(&_recv_done, done);
+    if (ret == NSAPI_ERROR_IN_PROGRESS) {
+        _recv_data = data;
+        _recv_size = size;
+    }
+
+    _lock.unlock();
+    return ret;
+}
+
+nsapi_size_or_error_t TCPSocket::async_send()
+{
+    if (_connecting) {
+        _pending = 0;
+        nsapi_error_t ret = _stack->socket_connect(_socket, SocketAddress(_send_addr, _send_port));
+        if (ret == NSAPI_ERROR_IN_PROGRESS || ret == NSAPI_ERROR_ALREADY) {
+            _connect_in_progress = true;
+            return NSAPI_ERROR_WOULD_BLOCK;
+        }
+
+        // As for a blocking connect, "EISCONN" is the end of our connect
+        if (ret == NSAPI_ERROR_IS_CONNECTED && _connect_in_progress) {
+            ret = NSAPI_ERROR_OK;
+        }
+        return ret;
+    }
+
+    // Completes once the stack has taken all of the data
+    while (_sent < _send_size) {
+        _pending = 0;
+        nsapi_size_or_error_t ret = _stack->socket_send(_socket,
+                (const uint8_t *)_send_data + _sent, _send_size - _sent);
+        if (ret == NSAPI_ERROR_WOULD_BLOCK) {
+            return ret;
+        } else if (ret < 0) {
+            return _sent ? _sent : ret;
+        }
+
+        _sent += ret;
+    }
+
+    return _sent;
+}
+
+nsapi_size_or_error_t TCPSocket::async_recv()
+{
+    _pending = 0;
+    return _stack->socket_recv(_socket, _recv_data, _recv_size);
 }
@@ -46,7 +46,8 @@ public:
     template <typename S>
     TCPSocket(S *stack)
         : _pending(0), _event_flag(0),
-          _read_in_progress(false), _write_in_progress(false)
+          _read_in_progress(false), _write_in_progress(false),
+          _connecting(false), _connect_in_progress(false)
     {
         open(stack);
     }
@@ -110,16 +111,109 @@ public:
      */
     nsapi_size_or_error_t recv(void *data, nsapi_size_t size);
 
+    /** Send data from several buffers over a TCP socket
+     *
+     *  Sends the buffers as if they were a single buffer, without gathering
+     *  them first on stacks that support it. Otherwise behaves like send.
+     *
+     *  @param iov      Buffers of data to send to the host
+     *  @param iovcnt   Number of buffers
+     *  @return         Number of sent bytes on success, negative error
+     *                  code on failure
+     */
+    nsapi_size_or_error_t sendmsg(const nsapi_iovec_t *iov, unsigned iovcnt);
+
+    /** Receive data over a TCP socket into several buffers
+     *
+     *  The buffers are filled in order. Otherwise behaves like recv.
+     *
+     *  @param iov      Destination buffers for data received from the host
+     *  @param iovcnt   Number of buffers
+     *  @return         Number of received bytes on success, negative error
+     *                  code on failure
+     */
+    nsapi_size_or_error_t recvmsg(const nsapi_iovec_t *iov, unsigned iovcnt);
+
+    /** Receive data over a TCP socket without copying it
+     *
+     *  Fills the view with read-only segments of the receive buffers of
+     *  the stack, on stacks that support it, or with a copy otherwise.
+     *  Data that does not fit in the segments provided is left for the
+     *  next receive. The view has to be given back with recv_release,
+     *  unless an error is returned. Otherwise behaves like recv.
+     *
+     *  @param view     Segments to fill with the data received
+     *  @return         Number of received bytes on success, negative error
+     *                  code on failure
+     */
+    nsapi_size_or_error_t recv_borrow(nsapi_recv_view_t *view);
+
+    /** Connects TCP socket to a remote host without blocking
+     *
+     *  The connection is made on the event queue set with
+     *  set_event_queue, and the callback is called from the queue once
+     *  it is done. The connect takes the place of a send, see cancel_send.
+     *
+     *  @param address  The SocketAddress of the remote host
+     *  @param done     Called with 0 on success, negative error code
+     *                  on failure
+     *  @return         NSAPI_ERROR_IN_PROGRESS if the callback will be
+     *                  called, negative error code on failure
+     */
+    nsapi_error_t connect_async(const SocketAddress &address,
+            mbed::Callback<void(nsapi_error_t)> done);
+
+    /** Send data over a TCP socket without blocking
+     *
+     *  The callback is called from the event queue set with
+     *  set_event_queue once the whole buffer has been accepted by the
+     *  stack, so a slow peer holds back the next send. The buffer must
+     *  stay valid until then. Only one send can be in progress.
+     *
+     *  @param data     Buffer of data to send to the host
+     *  @param size     Size of the buffer in bytes
+     *  @param done     Called with the number of sent bytes, less than
+     *                  size only if an error stopped the send, or a
+     *                  negative error code on failure
+     *  @return         NSAPI_ERROR_IN_PROGRESS if the callback will be
+     *                  called, negative error code on failure
+     */
+    nsapi_error_t send_async(const void *data, nsapi_size_t size,
+            mbed::Callback<void(nsapi_size_or_error_t)> done);
+
+    /** Receive data over a TCP socket without blocking
+     *
+     *  The callback is called from the event queue set with
+     *  set_event_queue once data is available. Data is only taken from
+     *  the stack while a receive is in progress, so not receiving closes
+     *  the window of the peer. The buffer must stay valid until the
+     *  callback. Only one receive can be in progress.
+     *
+     *  @param data     Destination buffer for data received from the host
+     *  @param size     Size of the buffer in bytes
+     *  @param done     Called with the number of received bytes, 0 if
+     *                  the connection was closed, or a negative error
+     *                  code on failure
+     *  @return         NSAPI_ERROR_IN_PROGRESS if the callback will be
+     *                  called, negative error code on failure
+     */
+    nsapi_error_t recv_async(void *data, nsapi_size_t size,
+            mbed::Callback<void(nsapi_size_or_error_t)> done);
+
 protected:
     friend class TCPServer;
 
     virtual nsapi_protocol_t get_proto();
     virtual void event();
+    virtual nsapi_size_or_error_t async_send();
+    virtual nsapi_size_or_error_t async_recv();
 
     volatile unsigned _pending;
     rtos::EventFlags _event_flag;
     bool _read_in_progress;
     bool _write_in_progress;
+    bool _connecting;
+    bool _connect_in_progress;
 };
 
 
@@ -125,6 +125,195 @@ nsapi_size_or_error_t UDPSocket::recvfrom(SocketAddress *address, void *buffer,
     return ret;
 }
 
+nsapi_size_or_error_t UDPSocket::sendmsg(const SocketAddress &address, const nsapi_iovec_t *iov, unsigned iovcnt)
+{
+    _lock.lock();
+    nsapi_size_or_error_t ret;
+
+    while (true) {
+        if (!_socket) {
+            ret = NSAPI_ERROR_NO_SOCKET;
+            break;
+        }
+
+        _pending = 0;
+        nsapi_size_or_error_t sent = _stack->socket_sendmsg(_socket, &address, iov, iovcnt);
+        if ((0 == _timeout) || (NSAPI_ERROR_WOULD_BLOCK != sent)) {
+            ret = sent;
+            break;
+        } else {
+            uint32_t flag;
+
+            // Release lock before blocking so other threads
+            // accessing this object aren't blocked
+            _lock.unlock();
+            flag = _event_flag.wait_any(WRITE_FLAG, _timeout);
+            _lock.lock();
+
+            if (flag & osFlagsError) {
+                // Timeout break
+                ret = NSAPI_ERROR_WOULD_BLOCK;
+                break;
+            }
+        }
+    }
+
+    _lock.unlock();
+    return ret;
+}
+
+nsapi_size_or_error_t UDPSocket::recvmsg(SocketAddress *address, const nsapi_iovec_t *iov, unsigned iovcnt)
+{
+    _lock.lock();
+    nsapi_size_or_error_t ret;
+    // the stack tells packets from streams by the address
+    SocketAddress source;
+
+    while (true) {
+        if (!_socket) {
+            ret = NSAPI_ERROR_NO_SOCKET;
+            break;
+        }
+
+        _pending = 0;
+        nsapi_size_or_error_t recv = _stack->socket_recvmsg(_socket, address ? address : &source, iov, iovcnt);
+        if ((0 == _timeout) || (NSAPI_ERROR_WOULD_BLOCK != recv)) {
+            ret = recv;
+            break;
+        } else {
+            uint32_t flag;
+
+            // Release lock before blocking so other threads
+            // accessing this object aren't blocked
+            _lock.unlock();
+            flag = _event_flag.wait_any(READ_FLAG, _timeout);
+            _lock.lock();
+
+            if (flag & osFlagsError) {
+                // Timeout break
+                ret = NSAPI_ERROR_WOULD_BLOCK;
+                break;
+            }
+        }
+    }
+
+    _lock.unlock();
+    return ret;
+}
+
+nsapi_size_or_error_t UDPSocket::recvfrom_borrow(SocketAddress *address, nsapi_recv_view_t *view)
+{
+    _lock.lock();
+    nsapi_size_or_error_t ret;
+    // the stack tells packets from streams by the address
+    SocketAddress source;
+
+    while (true) {
+        if (!_socket) {
+            ret = NSAPI_ERROR_NO_SOCKET;
+            break;
+        }
+
+        _pending = 0;
+        nsapi_size_or_error_t recv = _stack->socket_recv_borrow(_socket, address ? address : &source, view);
+        if ((0 == _timeout) || (NSAPI_ERROR_WOULD_BLOCK != recv)) {
+            ret = recv;
+            break;
+        } else {
+            uint32_t flag;
+
+            // Release lock before blocking so other threads
+            // accessing this object aren't blocked
+            _lock.unlock();
+            flag = _event_flag.wait_any(READ_FLAG, _timeout);
+            _lock.lock();
+
+            if (flag & osFlagsError) {
+                // Timeout break
+                ret = NSAPI_ERROR_WOULD_BLOCK;
+                break;
+            }
+        }
+    }
+
+    _lock.unlock();
+    return ret;
+}
+
+nsapi_size_or_error_t UDPSocket::sendto_batch(const nsapi_datagram_t *dgrams, unsigned count)
+{
+    _lock.lock();
+    nsapi_size_or_error_t ret;
+
+    while (true) {
+        if (!_socket) {
+            ret = NSAPI_ERROR_NO_SOCKET;
+            break;
+        }
+
+        _pending = 0;
+        nsapi_size_or_error_t sent = _stack->socket_sendto_batch(_socket, dgrams, count);
+        if ((0 == _timeout) || (NSAPI_ERROR_WOULD_BLOCK != sent)) {
+            ret = sent;
+            break;
+        } else {
+            uint32_t flag;
+
+            // Release lock before blocking so other threads
+            // accessing this object aren't blocked
+            _lock.unlock();
+            flag = _event_flag.wait_any(WRITE_FLAG, _timeout);
+            _lock.lock();
+
+            if (flag & osFlagsError) {
+                // Timeout break
+                ret = NSAPI_ERROR_WOULD_BLOCK;
+                break;
+            }
+        }
+    }
+
+    _lock.unlock();
+    return ret;
+}
+
+nsapi_size_or_error_t UDPSocket::recvfrom_batch(nsapi_datagram_t *dgrams, unsigned count)
+{
+    _lock.lock();
+    nsapi_size_or_error_t ret;
+
+    while (true) {
+        if (!_socket) {
+            ret = NSAPI_ERROR_NO_SOCKET;
+            break;
+        }
+
+        _pending = 0;
+        nsapi_size_or_error_t recv = _stack->socket_recvfrom_batch(_socket, dgrams, count);
+        if ((0 == _timeout) || (NSAPI_ERROR_WOULD_BLOCK != recv)) {
+            ret = recv;
+            break;
+        } else {
+            uint32_t flag;
+
+            // Release lock before blocking so other threads
+            // accessing this object aren't blocked
+            _lock.unlock();
+            flag = _event_flag.wait_any(READ_FLAG, _timeout);
+            _lock.lock();
+
+            if (flag & osFlagsError) {
+                // Timeout break
+                ret = NSAPI_ERROR_WOULD_BLOCK;
+                break;
+            }
+        }
+    }
+
+    _lock.unlock();
+    return ret;
+}
+
 void UDPSocket::event()
 {
     _event_flag.set(READ_FLAG|WRITE_FLAG);
@@ -133,4 +322,54 @@ void UDPSocket::event()
     if (_callback && _pending == 1) {
         _callback();
     }
+
+    async_event();
+}
+
+nsapi_error_t UDPSocket::sendto_async(const SocketAddress &address,
+        const void *data, nsapi_size_t size,
+        mbed::Callback<void(nsapi_size_or_error_t)> done)
+{
+    _lock.lock();
+    nsapi_error_t ret = async_start(&_send_done, done);
+    if (ret == NSAPI_ERROR_IN_PROGRESS) {
+        _send_addr = address.get_addr();
+        _send_port = address.get_port();
+        _send_data = data;
+        _send_size = size;
+    }
+
+    _lock.unlock();
+    return ret;
+}
+
+nsapi_error_t UDPSocket::recvfrom_async(SocketAddress *address,
+        void *data, nsapi_size_t size,
+        mbed::Callback<void(nsapi_size_or_error_t)> done)
+{
+    _lock.lock();
+    nsapi_error_t ret = async_start(&_recv_done, done);
+    if (ret == NSAPI_ERROR_IN_PROGRESS) {
+        _recv_address = address;
+        _recv_data = data;
+        _recv_size = size;
+    }
+
+    _lock.unlock();
+    return ret;
+}
+
+nsapi_size_or_error_t UDPSocket::async_send()
+{
+    _pending = 0;
+    return _stack->socket_sendto(_socket, SocketAddress(_send_addr, _send_port),
+            _send_data, _send_size);
+}
+
+nsapi_size_or_error_t UDPSocket::async_recv()
+{
+    SocketAddress address;
+    _pending = 0;
+    return _stack->socket_recvfrom(_socket, _recv_address ? _recv_address : &address,
+            _recv_data, _recv_size);
 }
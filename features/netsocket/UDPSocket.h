@@ -112,9 +112,119 @@ public:
     nsapi_size_or_error_t recvfrom(SocketAddress *address,
             void *data, nsapi_size_t size);
 
+    /** Send a packet made of several buffers over a UDP socket
+     *
+     *  Sends the buffers as a single packet, without gathering them first
+     *  on stacks that support it. Otherwise behaves like sendto.
+     *
+     *  @param address  The SocketAddress of the remote host
+     *  @param iov      Buffers of data to send to the host
+     *  @param iovcnt   Number of buffers
+     *  @return         Number of sent bytes on success, negative error
+     *                  code on failure
+     */
+    nsapi_size_or_error_t sendmsg(const SocketAddress &address,
+            const nsapi_iovec_t *iov, unsigned iovcnt);
+
+    /** Receive a packet over a UDP socket into several buffers
+     *
+     *  The buffers are filled in order, data of the packet that does not
+     *  fit is discarded. Otherwise behaves like recvfrom.
+     *
+     *  @param address  Destination for the source address or NULL
+     *  @param iov      Destination buffers for data received from the host
+     *  @param iovcnt   Number of buffers
+     *  @return         Number of received bytes on success, negative error
+     *                  code on failure
+     */
+    nsapi_size_or_error_t recvmsg(SocketAddress *address,
+            const nsapi_iovec_t *iov, unsigned iovcnt);
+
+    /** Receive a packet over a UDP socket without copying it
+     *
+     *  Fills the view with read-only segments of the receive buffers of
+     *  the stack, on stacks that support it, or with a copy otherwise.
+     *  Data of the packet that does not fit in the segments provided is
+     *  discarded. The view has to be given back with recv_release, unless
+     *  an error is returned. Otherwise behaves like recvfrom.
+     *
+     *  @param address  Destination for the source address or NULL
+     *  @param view     Segments to fill with the data received
+     *  @return         Number of received bytes on success, negative error
+     *                  code on failure
+     */
+    nsapi_size_or_error_t recvfrom_borrow(SocketAddress *address, nsapi_recv_view_t *view);
+
+    /** Send several packets over a UDP socket
+     *
+     *  Hands the datagrams to the stack in a single call, each with its
+     *  own address. Returns the number of datagrams sent, which is less
+     *  than count if the stack stopped part way. Otherwise behaves like
+     *  sendto.
+     *
+     *  @param dgrams   Datagrams to send
+     *  @param count    Number of datagrams
+     *  @return         Number of sent datagrams on success, negative error
+     *                  code on failure
+     */
+    nsapi_size_or_error_t sendto_batch(const nsapi_datagram_t *dgrams, unsigned count);
+
+    /** Receive several packets over a UDP socket
+     *
+     *  Blocks like recvfrom until a packet is received, then fills the
+     *  datagrams with it and with the packets already waiting, up to
+     *  count. Data of a packet that does not fit in its buffer is
+     *  discarded.
+     *
+     *  @param dgrams   Datagrams to fill with the packets received
+     *  @param count    Number of datagrams
+     *  @return         Number of received datagrams on success, negative
+     *                  error code on failure
+     */
+    nsapi_size_or_error_t recvfrom_batch(nsapi_datagram_t *dgrams, unsigned count);
+
+    /** Send a packet over a UDP socket without blocking
+     *
+     *  The callback is called from the event queue set with
+     *  set_event_queue once the stack has taken the packet. The buffer
+     *  must stay valid until then. Only one send can be in progress.
+     *
+     *  @param address  The SocketAddress of the remote host
+     *  @param data     Buffer of data to send to the host
+     *  @param size     Size of the buffer in bytes
+     *  @param done     Called with the number of sent bytes, or a
+     *                  negative error code on failure
+     *  @return         NSAPI_ERROR_IN_PROGRESS if the callback will be
+     *                  called, negative error code on failure
+     */
+    nsapi_error_t sendto_async(const SocketAddress &address,
+            const void *data, nsapi_size_t size,
+            mbed::Callback<void(nsapi_size_or_error_t)> done);
+
+    /** Receive a packet over a UDP socket without blocking
+     *
+     *  The callback is called from the event queue set with
+     *  set_event_queue once a packet has been received. The address and
+     *  buffer must stay valid until then. Only one receive can be in
+     *  progress.
+     *
+     *  @param address  Destination for the source address or NULL
+     *  @param data     Destination buffer for data received from the host
+     *  @param size     Size of the buffer in bytes
+     *  @param done     Called with the number of received bytes, or a
+     *                  negative error code on failure
+     *  @return         NSAPI_ERROR_IN_PROGRESS if the callback will be
+     *                  called, negative error code on failure
+     */
+    nsapi_error_t recvfrom_async(SocketAddress *address,
+            void *data, nsapi_size_t size,
+            mbed::Callback<void(nsapi_size_or_error_t)> done);
+
 protected:
     virtual nsapi_protocol_t get_proto();
     virtual void event();
+    virtual nsapi_size_or_error_t async_send();
+    virtual nsapi_size_or_error_t async_recv();
 
     volatile unsigned _pending;
     rtos::EventFlags _event_flag;
@@ -16,19 +16,70 @@
  */
 #include "nsapi_dns.h"
 #include "netsocket/UDPSocket.h"
+#include "events/mbed_shared_queues.h"
+#include "platform/SingletonPtr.h"
+#include "platform/PlatformMutex.h"
+#include "hal/us_ticker_api.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <new>
+#include <limits.h>
 
 #define CLASS_IN 1
 
 #define RR_A 1
+#define RR_SOA 6
 #define RR_AAAA 28
 
+#define RCODE_NXDOMAIN 3
+
 // DNS options
 #define DNS_BUFFER_SIZE 512
 #define DNS_TIMEOUT 5000
 #define DNS_SERVERS_SIZE 5
+#define DNS_QUERIES_SIZE 4
+
+#ifndef MBED_CONF_NSAPI_DNS_CACHE_SIZE
+#define MBED_CONF_NSAPI_DNS_CACHE_SIZE 3
+#endif
+
+#ifndef MBED_CONF_NSAPI_DNS_CACHE_ADDRESSES
+#define MBED_CONF_NSAPI_DNS_CACHE_ADDRESSES 2
+#endif
+
+#ifndef MBED_CONF_NSAPI_DNS_CACHE_NEGATIVE_TTL
+#define MBED_CONF_NSAPI_DNS_CACHE_NEGATIVE_TTL 60
+#endif
+
+// Cached answer, count is 0 if the host has no address of this version
+struct dns_cache_t {
+    char *host;
+    nsapi_version_t version;
+    unsigned count;
+    nsapi_addr_t addr[MBED_CONF_NSAPI_DNS_CACHE_ADDRESSES];
+    us_timestamp_t expires;
+    us_timestamp_t accessed;
+};
+
+// Query in progress for nsapi_dns_query_async
+struct dns_query_t {
+    int id;
+    NetworkStack *stack;
+    char *host;
+    nsapi_version_t version;
+    hostbyname_cb_t callback;
+    UDPSocket *socket;
+    int timeout_id;
+    unsigned server;
+};
+
+#if MBED_CONF_NSAPI_DNS_CACHE_SIZE
+static dns_cache_t *dns_cache[MBED_CONF_NSAPI_DNS_CACHE_SIZE];
+#endif
+static dns_query_t *dns_queries[DNS_QUERIES_SIZE];
+static int dns_query_id;
+static SingletonPtr<PlatformMutex> dns_mutex;
 
 nsapi_addr_t dns_servers[DNS_SERVERS_SIZE] = {
     {NSAPI_IPv4, {8, 8, 8, 8}},                             // Google
@@ -112,7 +163,32 @@ static void dns_append_question(uint8_t **p, const char *host, nsapi_version_t v
     dns_append_word(p, CLASS_IN);
 }
 
-static int dns_scan_response(const uint8_t **p, nsapi_addr_t *addr, unsigned addr_count)
+static uint32_t dns_scan_dword(const uint8_t **p)
+{
+    uint32_t a = dns_scan_word(p);
+    uint32_t b = dns_scan_word(p);
+    return (a << 16) | b;
+}
+
+static void dns_skip_name(const uint8_t **p)
+{
+    while (true) {
+        uint8_t len = dns_scan_byte(p);
+        if (len == 0) {
+            break;
+        } else if (len & 0xc0) { // this is link
+            dns_scan_byte(p);
+            break;
+        }
+
+        *p += len;
+    }
+}
+
+// Returns the number of addresses found, 0 if the host has no address of
+// the version asked, or negative if the response can not be used. The time
+// the answer can be cached for is stored in ttl.
+static int dns_scan_response(const uint8_t **p, nsapi_addr_t *addr, unsigned addr_count, uint32_t *ttl)
 {
     // scan header
     uint16_t id    = dns_scan_word(p);
@@ -123,48 +199,31 @@ static int dns_scan_response(const uint8_t **p, nsapi_addr_t *addr, unsigned add
 
     uint16_t qdcount = dns_scan_word(p); // qdcount
     uint16_t ancount = dns_scan_word(p); // ancount
-    dns_scan_word(p);                    // nscount
+    uint16_t nscount = dns_scan_word(p); // nscount
     dns_scan_word(p);                    // arcount
 
     // verify header is response to query
-    if (!(id == 1 && qr && opcode == 0 && rcode == 0)) {
-        return 0;
+    if (!(id == 1 && qr && opcode == 0 && (rcode == 0 || rcode == RCODE_NXDOMAIN))) {
+        return -1;
     }
 
     // skip questions
     for (int i = 0; i < qdcount; i++) {
-        while (true) {
-            uint8_t len = dns_scan_byte(p);
-            if (len == 0) {
-                break;
-            }
-
-            *p += len;
-        }
-
+        dns_skip_name(p);
         dns_scan_word(p); // qtype
         dns_scan_word(p); // qclass
     }
 
     // scan each response
     unsigned count = 0;
+    *ttl = 0;
 
     for (int i = 0; i < ancount && count < addr_count; i++) {
-        while (true) {
-            uint8_t len = dns_scan_byte(p);
-            if (len == 0) {
-                break;
-            } else if (len & 0xc0) { // this is link
-                dns_scan_byte(p);
-                break;
-            }
-
-            *p += len;
-        }
+        dns_skip_name(p);
 
         uint16_t rtype    = dns_scan_word(p); // rtype
         uint16_t rclass   = dns_scan_word(p); // rclass
-        *p += 4;                              // ttl
+        uint32_t rttl     = dns_scan_dword(p); // ttl
         uint16_t rdlength = dns_scan_word(p); // rdlength
 
         if (rtype == RR_A && rclass == CLASS_IN && rdlength == NSAPI_IPv4_BYTES) {
@@ -188,10 +247,164 @@ static int dns_scan_response(const uint8_t **p, nsapi_addr_t *addr, unsigned add
         } else {
             // skip unrecognized records
             *p += rdlength;
+            continue;
+        }
+
+        // the answer is valid as long as all of its addresses are
+        if (count == 1 || rttl < *ttl) {
+            *ttl = rttl;
+        }
+    }
+
+    if (count > 0) {
+        return count;
+    }
+
+    // negative answers can be cached as long as the SOA record of the
+    // authority section, if any
+    for (int i = 0; i < nscount; i++) {
+        dns_skip_name(p);
+
+        uint16_t rtype    = dns_scan_word(p); // rtype
+        dns_scan_word(p);                     // rclass
+        uint32_t rttl     = dns_scan_dword(p); // ttl
+        uint16_t rdlength = dns_scan_word(p); // rdlength
+        *p += rdlength;
+
+        if (rtype == RR_SOA) {
+            *ttl = rttl;
+            break;
         }
     }
 
-    return count;
+    return 0;
+}
+
+
+// DNS cache
+#if MBED_CONF_NSAPI_DNS_CACHE_SIZE
+static us_timestamp_t dns_now()
+{
+    return ticker_read_us(get_us_ticker_data());
+}
+
+static nsapi_version_t dns_cache_version(nsapi_version_t version)
+{
+    // questions are for A records unless IPv6 is asked
+    return version == NSAPI_IPv6 ? NSAPI_IPv6 : NSAPI_IPv4;
+}
+#endif
+
+// Returns the number of addresses cached, 0 for a cached negative answer,
+// or negative if the host is not in the cache
+static int dns_cache_find(const char *host, nsapi_version_t version, nsapi_addr_t *addr, unsigned addr_count)
+{
+    int result = -1;
+
+#if MBED_CONF_NSAPI_DNS_CACHE_SIZE
+    version = dns_cache_version(version);
+    us_timestamp_t now = dns_now();
+
+    dns_mutex->lock();
+    for (int i = 0; i < MBED_CONF_NSAPI_DNS_CACHE_SIZE; i++) {
+        dns_cache_t *entry = dns_cache[i];
+        if (!entry) {
+            continue;
+        }
+
+        if (entry->expires <= now) {
+            free(entry->host);
+            delete entry;
+            dns_cache[i] = NULL;
+            continue;
+        }
+
+        if (entry->version == version && strcmp(entry->host, host) == 0) {
+            entry->accessed = now;
+            result = entry->count < addr_count ? entry->count : addr_count;
+            memcpy(addr, entry->addr, result * sizeof(nsapi_addr_t));
+        }
+    }
+    dns_mutex->unlock();
+#endif
+
+    return result;
+}
+
+static void dns_cache_add(const char *host, nsapi_version_t version, const nsapi_addr_t *addr, unsigned count, uint32_t ttl)
+{
+#if MBED_CONF_NSAPI_DNS_CACHE_SIZE
+    if (count == 0 && ttl > MBED_CONF_NSAPI_DNS_CACHE_NEGATIVE_TTL) {
+        ttl = MBED_CONF_NSAPI_DNS_CACHE_NEGATIVE_TTL;
+    }
+
+    if (ttl == 0) {
+        return;
+    }
+
+    if (count > MBED_CONF_NSAPI_DNS_CACHE_ADDRESSES) {
+        count = MBED_CONF_NSAPI_DNS_CACHE_ADDRESSES;
+    }
+
+    version = dns_cache_version(version);
+    us_timestamp_t now = dns_now();
+
+    dns_mutex->lock();
+
+    // replace the same host wherever it is, otherwise a free entry, an
+    // expired one or the least recently used one
+    int index = -1;
+    int spare = 0;
+    for (int i = 0; i < MBED_CONF_NSAPI_DNS_CACHE_SIZE; i++) {
+        dns_cache_t *entry = dns_cache[i];
+        if (!entry) {
+            if (dns_cache[spare]) {
+                spare = i;
+            }
+            continue;
+        }
+
+        if (entry->version == version && strcmp(entry->host, host) == 0) {
+            index = i;
+            break;
+        }
+
+        if (dns_cache[spare] && (entry->expires <= now
+                || entry->accessed < dns_cache[spare]->accessed)) {
+            spare = i;
+        }
+    }
+
+    if (index < 0) {
+        index = spare;
+    }
+
+    dns_cache_t *entry = dns_cache[index];
+    if (entry) {
+        free(entry->host);
+    } else {
+        entry = new (std::nothrow) dns_cache_t;
+    }
+
+    char *host_copy = entry ? (char *)malloc(strlen(host) + 1) : NULL;
+    if (!host_copy) {
+        delete entry;
+        dns_cache[index] = NULL;
+        dns_mutex->unlock();
+        return;
+    }
+
+    strcpy(host_copy, host);
+    entry->host = host_copy;
+    entry->version = version;
+    entry->count = count;
+    memcpy(entry->addr, addr, count * sizeof(nsapi_addr_t));
+    entry->expires = now + ttl * 1000000ULL;
+    entry->accessed = now;
+    dns_cache[index] = entry;
+
+    dns_mutex->unlock();
+#endif
 }
 
 // core query function
@@ -204,6 +417,12 @@ static nsapi_size_or_error_t nsapi_dns_query_multiple(NetworkStack *stack, const
         return NSAPI_ERROR_PARAMETER;
     }
 
+    // check for a cached answer
+    int cached = dns_cache_find(host, version, addr, addr_count);
+    if (cached >= 0) {
+        return cached > 0 ? cached : NSAPI_ERROR_DNS_FAILURE;
+    }
+
     // create a udp socket
     UDPSocket socket;
     int err = socket.open(stack);
@@ -243,8 +462,14 @@ static nsapi_size_or_error_t nsapi_dns_query_multiple(NetworkStack *stack, const
         }
 
         const uint8_t *response = packet;
-        if (dns_scan_response(&response, addr, addr_count) > 0) {
-            result = NSAPI_ERROR_OK;
+        uint32_t ttl;
+        int count = dns_scan_response(&response, addr, addr_count, &ttl);
+        if (count > 0) {
+            result = count;
+        }
+
+        if (count >= 0) {
+            dns_cache_add(host, version, addr, count, ttl);
         }
 
         /* The DNS response is final, no need to check other servers */
@@ -264,6 +489,239 @@ static nsapi_size_or_error_t nsapi_dns_query_multiple(NetworkStack *stack, const
     return result;
 }
 
+// asynchronous queries, run from the shared event queue
+static dns_query_t *dns_query_get(int id)
+{
+    for (int i = 0; i < DNS_QUERIES_SIZE; i++) {
+        if (dns_queries[i] && dns_queries[i]->id == id) {
+            return dns_queries[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void dns_query_done(dns_query_t *query, nsapi_error_t result, SocketAddress *address)
+{
+    dns_mutex->lock();
+    for (int i = 0; i < DNS_QUERIES_SIZE; i++) {
+        if (dns_queries[i] == query) {
+            dns_queries[i] = NULL;
+        }
+    }
+    dns_mutex->unlock();
+
+    mbed::mbed_event_queue()->cancel(query->timeout_id);
+    if (query->socket) {
+        query->socket->close();
+        delete query->socket;
+    }
+
+    query->callback(result, address);
+
+    free(query->host);
+    delete query;
+}
+
+static void dns_query_timeout(int id);
+
+static void dns_query_send(dns_query_t *query)
+{
+    uint8_t *packet = (uint8_t *)malloc(DNS_BUFFER_SIZE);
+    if (!packet) {
+        dns_query_done(query, NSAPI_ERROR_NO_MEMORY, NULL);
+        return;
+    }
+
+    // send the question to the next server that accepts it
+    nsapi_size_or_error_t err = NSAPI_ERROR_DNS_FAILURE;
+    for (; query->server < DNS_SERVERS_SIZE; query->server++) {
+        uint8_t *question = packet;
+        dns_append_question(&question, query->host, query->version);
+
+        err = query->socket->sendto(SocketAddress(dns_servers[query->server], 53), packet, question - packet);
+        if (err >= 0) {
+            break;
+        }
+    }
+
+    free(packet);
+
+    if (err < 0) {
+        dns_query_done(query, NSAPI_ERROR_DNS_FAILURE, NULL);
+        return;
+    }
+
+    query->timeout_id = mbed::mbed_event_queue()->call_in(DNS_TIMEOUT, dns_query_timeout, query->id);
+    if (!query->timeout_id) {
+        dns_query_done(query, NSAPI_ERROR_NO_MEMORY, NULL);
+    }
+}
+
+static void dns_query_recv(int id)
+{
+    dns_mutex->lock();
+    dns_query_t *query = dns_query_get(id);
+    dns_mutex->unlock();
+
+    if (!query) {
+        return;
+    }
+
+    uint8_t *packet = (uint8_t *)malloc(DNS_BUFFER_SIZE);
+    if (!packet) {
+        dns_query_done(query, NSAPI_ERROR_NO_MEMORY, NULL);
+        return;
+    }
+
+    nsapi_size_or_error_t err = query->socket->recvfrom(NULL, packet, DNS_BUFFER_SIZE);
+    if (err == NSAPI_ERROR_WOULD_BLOCK) {
+        free(packet);
+        return;
+    }
+
+    nsapi_addr_t addr[MBED_CONF_NSAPI_DNS_CACHE_ADDRESSES + 1];
+    int count = -1;
+    uint32_t ttl;
+    if (err >= 0) {
+        const uint8_t *response = packet;
+        count = dns_scan_response(&response, addr, sizeof(addr) / sizeof(addr[0]), &ttl);
+    }
+
+    free(packet);
+
+    if (count >= 0) {
+        dns_cache_add(query->host, query->version, addr, count, ttl);
+    }
+
+    if (count > 0) {
+        SocketAddress address(addr[0]);
+        dns_query_done(query, NSAPI_ERROR_OK, &address);
+    } else {
+        /* The DNS response is final, no need to check other servers */
+        dns_query_done(query, err < 0 ? err : NSAPI_ERROR_DNS_FAILURE, NULL);
+    }
+}
+
+static void dns_query_timeout(int id)
+{
+    dns_mutex->lock();
+    dns_query_t *query = dns_query_get(id);
+    dns_mutex->unlock();
+
+    if (!query) {
+        return;
+    }
+
+    query->server++;
+    dns_query_send(query);
+}
+
+static void dns_query_sigio(void *id)
+{
+    // called from the stack, defer the socket access to the event queue
+    mbed::mbed_event_queue()->call(dns_query_recv, (int)(intptr_t)id);
+}
+
+static void dns_query_start(int id)
+{
+    dns_mutex->lock();
+    dns_query_t *query = dns_query_get(id);
+    dns_mutex->unlock();
+
+    if (!query) {
+        return;
+    }
+
+    query->socket = new (std::nothrow) UDPSocket;
+    if (!query->socket) {
+        dns_query_done(query, NSAPI_ERROR_NO_MEMORY, NULL);
+        return;
+    }
+
+    nsapi_error_t err = query->socket->open(query->stack);
+    if (err) {
+        dns_query_done(query, err, NULL);
+        return;
+    }
+
+    query->socket->set_blocking(false);
+    query->socket->sigio(mbed::callback(dns_query_sigio, (void *)(intptr_t)id));
+    dns_query_send(query);
+}
+
+nsapi_error_t nsapi_dns_query_async(NetworkStack *stack, const char *host,
+        hostbyname_cb_t callback, nsapi_version_t version)
+{
+    // check for valid host name
+    int host_len = host ? strlen(host) : 0;
+    if (host_len > 128 || host_len == 0) {
+        return NSAPI_ERROR_PARAMETER;
+    }
+
+    // check for a cached answer
+    nsapi_addr_t addr;
+    int cached = dns_cache_find(host, version, &addr, 1);
+    if (cached > 0) {
+        SocketAddress address(addr);
+        callback(NSAPI_ERROR_OK, &address);
+        return NSAPI_ERROR_OK;
+    } else if (cached == 0) {
+        return NSAPI_ERROR_DNS_FAILURE;
+    }
+
+    dns_query_t *query = new (std::nothrow) dns_query_t;
+    char *host_copy = (char *)malloc(host_len + 1);
+    if (!query || !host_copy) {
+        delete query;
+        free(host_copy);
+        return NSAPI_ERROR_NO_MEMORY;
+    }
+
+    strcpy(host_copy, host);
+    query->stack = stack;
+    query->host = host_copy;
+    query->version = version;
+    query->callback = callback;
+    query->socket = NULL;
+    query->timeout_id = 0;
+    query->server = 0;
+
+    dns_mutex->lock();
+    int index = -1;
+    for (int i = 0; i < DNS_QUERIES_SIZE; i++) {
+        if (!dns_queries[i]) {
+            index = i;
+            break;
+        }
+    }
+
+    if (index >= 0) {
+        // ids stay positive so they can not be mistaken for errors
+        dns_query_id = dns_query_id < INT_MAX ? dns_query_id + 1 : 1;
+        query->id = dns_query_id;
+        dns_queries[index] = query;
+    }
+    dns_mutex->unlock();
+
+    if (index < 0) {
+        free(host_copy);
+        delete query;
+        return NSAPI_ERROR_NO_MEMORY;
+    }
+
+    if (!mbed::mbed_event_queue()->call(dns_query_start, query->id)) {
+        dns_mutex->lock();
+        dns_queries[index] = NULL;
+        dns_mutex->unlock();
+        free(host_copy);
+        delete query;
+        return NSAPI_ERROR_NO_MEMORY;
+    }
+
+    return NSAPI_ERROR_IN_PROGRESS;
+}
+
 // convenience functions for other forms of queries
 extern "C" nsapi_size_or_error_t nsapi_dns_query_multiple(nsapi_stack_t *stack, const char *host,
         nsapi_addr_t *addr, nsapi_size_t addr_count, nsapi_version_t version)
@@ -148,6 +148,24 @@ nsapi_size_or_error_t nsapi_dns_query_multiple(S *stack, const char *host,
                 host, addr, addr_count, version);
 }
 
+/** Query a domain name server for an IP address of a given hostname without blocking
+ *
+ *  The query runs from the shared event queue, see mbed_event_queue(),
+ *  and the callback is called from there with the result. Cached answers
+ *  are given before returning.
+ *
+ *  @param stack    Network stack as target for DNS query
+ *  @param host     Hostname to resolve
+ *  @param callback Callback called with the result of the query
+ *  @param version  IP version to resolve (defaults to NSAPI_IPv4)
+ *  @return         0 if the answer was cached and the callback has been called,
+ *                  NSAPI_ERROR_IN_PROGRESS if the callback will be called later,
+ *                  negative error code on failure, the callback is not called
+ *                  NSAPI_ERROR_DNS_FAILURE indicates the host could not be found
+ */
+nsapi_error_t nsapi_dns_query_async(NetworkStack *stack, const char *host,
+        hostbyname_cb_t callback, nsapi_version_t version = NSAPI_IPv4);
+
 /** Add a domain name server to list of servers to query
  *
  *  @param addr     Destination for the host address
@@ -155,6 +155,45 @@ typedef struct nsapi_addr {
 typedef void *nsapi_socket_t;
 
 
+/** Buffer of a scatter-gather socket operation
+ *
+ *  An array of buffers is sent as one message, or filled in order with
+ *  the data received.
+ */
+typedef struct nsapi_iovec {
+    void *iov_base;         /*!< Start of the buffer */
+    nsapi_size_t iov_len;   /*!< Size of the buffer in bytes */
+} nsapi_iovec_t;
+
+
+/** Received data lent by a stack
+ *
+ *  A borrowing receive fills the segments with views into the receive
+ *  buffers of the stack, in order. They stay valid until the view is
+ *  released and must not be written to.
+ */
+typedef struct nsapi_recv_view {
+    nsapi_iovec_t *iov;     /*!< Segments, provided by the caller */
+    unsigned iovcnt;        /*!< Number of segments provided, set to the number filled */
+    void *handle;           /*!< Buffers held by the stack until release */
+} nsapi_recv_view_t;
+
+
+/** Datagram of a batch socket operation
+ *
+ *  A batch send takes the address, port, data and size of each datagram.
+ *  A batch receive fills data with up to size bytes, discarding the rest
+ *  of the packet, and sets addr, port and len.
+ */
+typedef struct nsapi_datagram {
+    nsapi_addr_t addr;      /*!< Address of the remote host */
+    uint16_t port;          /*!< Port of the remote host */
+    void *data;             /*!< Data to send, or buffer to receive into */
+    nsapi_size_t size;      /*!< Size of the data or of the buffer in bytes */
+    nsapi_size_t len;       /*!< Number of bytes received */
+} nsapi_datagram_t;
+
+
 /** Enum of socket protocols
  *
  *  The socket protocol specifies a particular protocol to
@@ -554,6 +593,133 @@ typedef struct nsapi_stack_api
      */    
     nsapi_error_t (*getsockopt)(nsapi_stack_t *stack, nsapi_socket_t socket, int level,
             int optname, void *optval, unsigned *optlen);
+
+    /** Send a message made of several buffers over a socket
+     *
+     *  Sends the buffers as if they were a single buffer, over a connected
+     *  TCP socket if addr is NULL, or as a packet to the specified address
+     *  over a UDP socket. Returns the number of bytes sent from the buffers.
+     *
+     *  This call is non-blocking. If sending would block,
+     *  NSAPI_ERROR_WOULD_BLOCK is returned immediately.
+     *
+     *  Optional, stacks without it get the buffers copied to a contiguous
+     *  one for socket_send or socket_sendto.
+     *
+     *  @param stack    Stack handle
+     *  @param socket   Socket handle
+     *  @param addr     The address of the remote host, or NULL for TCP
+     *  @param port     The port of the remote host
+     *  @param iov      Buffers of data to send to the host
+     *  @param iovcnt   Number of buffers
+     *  @return         Number of sent bytes on success, negative error
+     *                  code on failure
+     */
+    nsapi_size_or_error_t (*socket_sendmsg)(nsapi_stack_t *stack, nsapi_socket_t socket,
+            const nsapi_addr_t *addr, uint16_t port, const nsapi_iovec_t *iov, unsigned iovcnt);
+
+    /** Receive data over a socket into several buffers
+     *
+     *  Receives data over a connected TCP socket if addr is NULL, or a
+     *  packet over a UDP socket storing its source address in addr. The
+     *  buffers are filled in order. Returns the number of bytes received.
+     *
+     *  This call is non-blocking. If receiving would block,
+     *  NSAPI_ERROR_WOULD_BLOCK is returned immediately.
+     *
+     *  Optional, stacks without it receive in a contiguous buffer with
+     *  socket_recv or socket_recvfrom, which is copied to the buffers.
+     *
+     *  @param stack    Stack handle
+     *  @param socket   Socket handle
+     *  @param addr     Destination for the address of the remote host, or NULL for TCP
+     *  @param port     Destination for the port of the remote host
+     *  @param iov      Destination buffers for data received from the host
+     *  @param iovcnt   Number of buffers
+     *  @return         Number of received bytes on success, negative error
+     *                  code on failure
+     */
+    nsapi_size_or_error_t (*socket_recvmsg)(nsapi_stack_t *stack, nsapi_socket_t socket,
+            nsapi_addr_t *addr, uint16_t *port, const nsapi_iovec_t *iov, unsigned iovcnt);
+
+    /** Receive data over a socket without copying it
+     *
+     *  Receives data over a connected TCP socket if addr is NULL, or a
+     *  packet over a UDP socket storing its source address in addr, and
+     *  lends it as read-only segments of the receive buffers. Segments of
+     *  a packet that do not fit in the view are discarded, TCP data that
+     *  does not fit is left for the next receive. Returns the number of
+     *  bytes in the view, which is held until socket_recv_release.
+     *
+     *  This call is non-blocking. If receiving would block,
+     *  NSAPI_ERROR_WOULD_BLOCK is returned immediately.
+     *
+     *  Optional, together with socket_recv_release. Stacks without it
+     *  receive a copy in a buffer of MBED_CONF_NSAPI_RECV_COPY_SIZE bytes.
+     *
+     *  @param stack    Stack handle
+     *  @param socket   Socket handle
+     *  @param addr     Destination for the address of the remote host, or NULL for TCP
+     *  @param port     Destination for the port of the remote host
+     *  @param view     Segments to fill with the data received
+     *  @return         Number of received bytes on success, negative error
+     *                  code on failure
+     */
+    nsapi_size_or_error_t (*socket_recv_borrow)(nsapi_stack_t *stack, nsapi_socket_t socket,
+            nsapi_addr_t *addr, uint16_t *port, nsapi_recv_view_t *view);
+
+    /** Release data lent by socket_recv_borrow
+     *
+     *  Gives the buffers of the view back to the stack.
+     *
+     *  @param stack    Stack handle
+     *  @param socket   Socket handle
+     *  @param view     View filled by socket_recv_borrow
+     */
+    void (*socket_recv_release)(nsapi_stack_t *stack, nsapi_socket_t socket,
+            nsapi_recv_view_t *view);
+
+    /** Send several packets over a UDP socket
+     *
+     *  Sends the datagrams in order, each to its own address. Returns the
+     *  number of datagrams sent, which is less than count if one could not
+     *  be sent after others were.
+     *
+     *  This call is non-blocking. If sending would block,
+     *  NSAPI_ERROR_WOULD_BLOCK is returned immediately.
+     *
+     *  Optional, stacks without it send each datagram with socket_sendto.
+     *
+     *  @param stack    Stack handle
+     *  @param socket   Socket handle
+     *  @param dgrams   Datagrams to send
+     *  @param count    Number of datagrams
+     *  @return         Number of sent datagrams on success, negative error
+     *                  code on failure
+     */
+    nsapi_size_or_error_t (*socket_sendto_batch)(nsapi_stack_t *stack, nsapi_socket_t socket,
+            const nsapi_datagram_t *dgrams, unsigned count);
+
+    /** Receive several packets over a UDP socket
+     *
+     *  Fills the datagrams in order with the packets already received, up
+     *  to count. Returns the number of datagrams filled.
+     *
+     *  This call is non-blocking. If no packet has been received,
+     *  NSAPI_ERROR_WOULD_BLOCK is returned immediately.
+     *
+     *  Optional, stacks without it receive each datagram with
+     *  socket_recvfrom.
+     *
+     *  @param stack    Stack handle
+     *  @param socket   Socket handle
+     *  @param dgrams   Datagrams to fill with the packets received
+     *  @param count    Number of datagrams
+     *  @return         Number of received datagrams on success, negative
+     *                  error code on failure
+     */
+    nsapi_size_or_error_t (*socket_recvfrom_batch)(nsapi_stack_t *stack, nsapi_socket_t socket,
+            nsapi_datagram_t *dgrams, unsigned count);
 } nsapi_stack_api_t;
 
 
@@ -0,0 +1,279 @@
+/*
+ * mbed Microcontroller Library
+ * Copyright (c) 2006-2017 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/** @file index.cpp Test cases for the key name index used by Open(), Create()
+ * and Find(), and benchmark of their latency with the number of KVs.
+ *
+ * Please consult the documentation under the test-case functions for
+ * a description of the individual test case.
+ */
+
+#include "mbed.h"
+#include "cfstore_config.h"
+#include "cfstore_test.h"
+#include "cfstore_debug.h"
+#include "Driver_Common.h"
+#include "configuration_store.h"
+#include "utest/utest.h"
+#include "unity/unity.h"
+#include "greentea-client/test_env.h"
+#include "mbed_stats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+using namespace utest::v1;
+
+static char cfstore_index_utest_msg_g[CFSTORE_UTEST_MSG_BUF_SIZE];
+
+/// @cond CFSTORE_DOXYGEN_DISABLE
+#ifdef CFSTORE_DEBUG
+#define CFSTORE_INDEX_GREENTEA_TIMEOUT_S     600
+#else
+#define CFSTORE_INDEX_GREENTEA_TIMEOUT_S     180
+#endif
+#define CFSTORE_INDEX_APPS                   8
+#define CFSTORE_INDEX_VALUE_LEN              8
+#define CFSTORE_INDEX_OPEN_ITERATIONS        1000
+#define CFSTORE_INDEX_FIND_ITERATIONS        10
+
+extern ARM_CFSTORE_DRIVER cfstore_driver;
+/// @endcond
+
+/* KV names are spread over CFSTORE_INDEX_APPS namespaces so that a wildcard
+ * query on one namespace matches 1/CFSTORE_INDEX_APPS of the KVs */
+static void cfstore_index_key_name(char* key_name, int i)
+{
+    snprintf(key_name, CFSTORE_KEY_NAME_MAX_LENGTH+1, "com.arm.mbed.app%d.cred%04d.key", i % CFSTORE_INDEX_APPS, i);
+}
+
+static int32_t cfstore_index_create(int i, ARM_CFSTORE_SIZE len)
+{
+    char key_name[CFSTORE_KEY_NAME_MAX_LENGTH+1];
+    char value[CFSTORE_INDEX_VALUE_LEN] = "value";
+    int32_t ret = ARM_DRIVER_ERROR;
+    ARM_CFSTORE_KEYDESC kdesc;
+    ARM_CFSTORE_HANDLE_INIT(hkey);
+
+    memset(&kdesc, 0, sizeof(kdesc));
+    kdesc.drl = ARM_RETENTION_WHILE_DEVICE_ACTIVE;
+    cfstore_index_key_name(key_name, i);
+    ret = cfstore_driver.Create(key_name, len, &kdesc, hkey);
+    if(ret < ARM_DRIVER_OK){
+        return ret;
+    }
+    cfstore_driver.Write(hkey, value, &len);
+    return cfstore_driver.Close(hkey);
+}
+
+/* count (and optionally delete) the KVs matching a query using the Find() idiom */
+static int32_t cfstore_index_find_count(const char* key_name_query, bool del)
+{
+    int32_t count = 0;
+    ARM_CFSTORE_HANDLE_INIT(next);
+    ARM_CFSTORE_HANDLE_INIT(prev);
+
+    while(cfstore_driver.Find(key_name_query, prev, next) == ARM_DRIVER_OK)
+    {
+        count++;
+        if(del){
+            cfstore_driver.Delete(next);
+        }
+        CFSTORE_HANDLE_SWAP(prev, next);
+    }
+    return count;
+}
+
+static int32_t cfstore_index_open(int i, ARM_CFSTORE_SIZE *len)
+{
+    char key_name[CFSTORE_KEY_NAME_MAX_LENGTH+1];
+    int32_t ret = ARM_DRIVER_ERROR;
+    ARM_CFSTORE_FMODE flags;
+    ARM_CFSTORE_HANDLE_INIT(hkey);
+
+    memset(&flags, 0, sizeof(flags));
+    cfstore_index_key_name(key_name, i);
+    ret = cfstore_driver.Open(key_name, flags, hkey);
+    if(ret < ARM_DRIVER_OK){
+        return ret;
+    }
+    if(len){
+        cfstore_driver.GetValueLen(hkey, len);
+    }
+    return cfstore_driver.Close(hkey);
+}
+
+
+/* report whether built/configured for flash sync or async mode */
+static control_t cfstore_index_test_00(const size_t call_count)
+{
+    int32_t ret = ARM_DRIVER_ERROR;
+
+    (void) call_count;
+    ret = cfstore_test_startup();
+    CFSTORE_TEST_UTEST_MESSAGE(cfstore_index_utest_msg_g, CFSTORE_UTEST_MSG_BUF_SIZE, "%s:Error: failed to perform test startup (ret=%d).\n", __func__, (int) ret);
+    TEST_ASSERT_MESSAGE(ret >= ARM_DRIVER_OK, cfstore_index_utest_msg_g);
+    return CaseNext;
+}
+
+/** @brief  test that Open(), Create() and Find() stay consistent as KVs are
+ *          created, deleted through the Find() idiom, grown and shrunk.
+ *
+ * @return on success returns CaseNext to continue to next test case, otherwise will assert on errors.
+ */
+static control_t cfstore_index_test_01(const size_t call_count)
+{
+    const int32_t num_kvs = 100;
+    int32_t ret = ARM_DRIVER_ERROR;
+    ARM_CFSTORE_SIZE len = 0;
+
+    (void) call_count;
+    ret = cfstore_driver.Initialize(NULL, NULL);
+    CFSTORE_TEST_UTEST_MESSAGE(cfstore_index_utest_msg_g, CFSTORE_UTEST_MSG_BUF_SIZE, "%s:Error: failed to initialize CFSTORE (ret=%d).\n", __func__, (int) ret);
+    TEST_ASSERT_MESSAGE(ret >= ARM_DRIVER_OK, cfstore_index_utest_msg_g);
+
+    for(int i = 0; i < num_kvs; i++){
+        /* create out of name order */
+        ret = cfstore_index_create((i * 37) % num_kvs, CFSTORE_INDEX_VALUE_LEN);
+        CFSTORE_TEST_UTEST_MESSAGE(cfstore_index_utest_msg_g, CFSTORE_UTEST_MSG_BUF_SIZE, "%s:Error: failed to create KV %d (ret=%d).\n", __func__, (int) i, (int) ret);
+        TEST_ASSERT_MESSAGE(ret >= ARM_DRIVER_OK, cfstore_index_utest_msg_g);
+    }
+    TEST_ASSERT_EQUAL(ARM_CFSTORE_DRIVER_ERROR_PREEXISTING_KEY, cfstore_index_create(3, CFSTORE_INDEX_VALUE_LEN));
+    TEST_ASSERT_EQUAL(num_kvs, cfstore_index_find_count("*", false));
+    TEST_ASSERT_EQUAL(num_kvs / CFSTORE_INDEX_APPS + 1, cfstore_index_find_count("com.arm.mbed.app3.*", false));
+    TEST_ASSERT_EQUAL(10, cfstore_index_find_count("*.cred000*", false));
+    TEST_ASSERT_EQUAL(1, cfstore_index_find_count("com.arm.mbed.app1.cred0009.key", false));
+
+    /* delete the KVs of one namespace while finding them */
+    TEST_ASSERT_EQUAL(num_kvs / CFSTORE_INDEX_APPS, cfstore_index_find_count("com.arm.mbed.app5.*", true));
+    TEST_ASSERT_EQUAL(0, cfstore_index_find_count("com.arm.mbed.app5.*", false));
+    TEST_ASSERT_EQUAL(num_kvs - num_kvs / CFSTORE_INDEX_APPS, cfstore_index_find_count("com.arm.mbed.app*", false));
+
+    /* grow and shrink values, which moves the following KVs */
+    TEST_ASSERT_TRUE(cfstore_index_create(2, 64) >= ARM_DRIVER_OK);
+    TEST_ASSERT_TRUE(cfstore_index_create(1, 2) >= ARM_DRIVER_OK);
+
+    for(int i = 0; i < num_kvs; i++){
+        ret = cfstore_index_open(i, &len);
+        if(i % CFSTORE_INDEX_APPS == 5){
+            TEST_ASSERT_EQUAL(ARM_CFSTORE_DRIVER_ERROR_KEY_NOT_FOUND, ret);
+            continue;
+        }
+        CFSTORE_TEST_UTEST_MESSAGE(cfstore_index_utest_msg_g, CFSTORE_UTEST_MSG_BUF_SIZE, "%s:Error: failed to open KV %d (ret=%d).\n", __func__, (int) i, (int) ret);
+        TEST_ASSERT_MESSAGE(ret >= ARM_DRIVER_OK, cfstore_index_utest_msg_g);
+        TEST_ASSERT_EQUAL(i == 2 ? 64 : i == 1 ? 2 : CFSTORE_INDEX_VALUE_LEN, len);
+    }
+
+    cfstore_index_find_count("*", true);
+    TEST_ASSERT_EQUAL(0, cfstore_index_find_count("*", false));
+    ret = cfstore_driver.Uninitialize();
+    TEST_ASSERT_MESSAGE(ret >= ARM_DRIVER_OK, "Uninitialize() failed");
+    return CaseNext;
+}
+
+/** @brief  benchmark Open() and wildcard Find() latency, and the heap used, with
+ *          50, 500 and 5000 KVs. Stops at the first size that does not fit in
+ *          memory.
+ *
+ * @return on success returns CaseNext to continue to next test case, otherwise will assert on errors.
+ */
+static control_t cfstore_index_test_02(const size_t call_count)
+{
+    const int32_t num_kvs[] = { 50, 500, 5000 };
+    int32_t ret = ARM_DRIVER_ERROR;
+    int32_t found = 0;
+    Timer timer;
+    mbed_stats_heap_t stats_start;
+    mbed_stats_heap_t stats_end;
+
+    (void) call_count;
+#ifdef CFSTORE_CONFIG_KEY_INDEX_ENABLED
+    printf("KV key name index enabled\r\n");
+#else
+    printf("KV key name index disabled\r\n");
+#endif
+    for(size_t n = 0; n < sizeof(num_kvs) / sizeof(num_kvs[0]); n++){
+        ret = cfstore_driver.Initialize(NULL, NULL);
+        TEST_ASSERT_MESSAGE(ret >= ARM_DRIVER_OK, "Initialize() failed");
+
+        mbed_stats_heap_get(&stats_start);
+        for(int i = 0; i < num_kvs[n] && ret >= ARM_DRIVER_OK; i++){
+            ret = cfstore_index_create(i, CFSTORE_INDEX_VALUE_LEN);
+        }
+        mbed_stats_heap_get(&stats_end);
+
+        if(ret >= ARM_DRIVER_OK){
+            timer.reset();
+            timer.start();
+            for(int i = 0; i < CFSTORE_INDEX_OPEN_ITERATIONS; i++){
+                ret = cfstore_index_open((i * 31) % num_kvs[n], NULL);
+                TEST_ASSERT_MESSAGE(ret >= ARM_DRIVER_OK, "Open() failed");
+            }
+            timer.stop();
+            float open_us = (float) timer.read_us() / CFSTORE_INDEX_OPEN_ITERATIONS;
+
+            timer.reset();
+            timer.start();
+            for(int i = 0; i < CFSTORE_INDEX_FIND_ITERATIONS; i++){
+                found = cfstore_index_find_count("com.arm.mbed.app3.*", false);
+            }
+            timer.stop();
+            float find_us = (float) timer.read_us() / CFSTORE_INDEX_FIND_ITERATIONS;
+
+            printf("%5d KVs: Open() %8.1f us, Find() of %d KVs %10.1f us, heap %lu bytes\r\n",
+                   (int) num_kvs[n], open_us, (int) found, find_us,
+                   (unsigned long) (stats_end.current_size - stats_start.current_size));
+        } else {
+            printf("%5d KVs: out of memory\r\n", (int) num_kvs[n]);
+        }
+
+        cfstore_index_find_count("*", true);
+        cfstore_driver.Uninitialize();
+        if(ret < ARM_DRIVER_OK){
+            break;
+        }
+    }
+    return CaseNext;
+}
+
+/// @cond CFSTORE_DOXYGEN_DISABLE
+utest::v1::status_t greentea_setup(const size_t number_of_cases)
+{
+    GREENTEA_SETUP(CFSTORE_INDEX_GREENTEA_TIMEOUT_S, "default_auto");
+    return greentea_test_setup_handler(number_of_cases);
+}
+
+Case cases[] = {
+           /*          1         2         3         4         5         6        7  */
+           /* 1234567890123456789012345678901234567890123456789012345678901234567890 */
+        Case("INDEX_test_00", cfstore_index_test_00),
+        Case("INDEX_test_01", cfstore_index_test_01),
+        Case("INDEX_test_02", cfstore_index_test_02),
+};
+
+
+/* Declare your test specification with a custom setup handler */
+Specification specification(greentea_setup, cases);
+
+int main()
+{
+    return !Harness::run(specification);
+}
+/// @endcond
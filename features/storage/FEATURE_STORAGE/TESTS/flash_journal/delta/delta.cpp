@@ -0,0 +1,464 @@
+/*
+ * Copyright (c) 2006-2016, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Tests for the delta records of the sequential flash journal strategy
+ * (FlashJournal_logDelta()). The journal is run on an in-memory storage
+ * driver which counts the octets programmed and erased, so the test can also
+ * report the write amplification and the latency of updating a few octets of
+ * a blob with deltas, against logging and committing the whole blob.
+ */
+
+#ifdef TARGET_LIKE_POSIX
+#define AVOID_GREENTEA
+#endif
+
+#ifndef AVOID_GREENTEA
+#include "greentea-client/test_env.h"
+#endif
+#include "utest/utest.h"
+#include "unity/unity.h"
+
+#include "flash-journal-strategy-sequential/flash_journal_crc.h"
+#include "flash-journal-strategy-sequential/flash_journal_strategy_sequential.h"
+#include "flash-journal-strategy-sequential/flash_journal_private.h"
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#ifdef TARGET_LIKE_POSIX
+#include <time.h>
+#else
+#include "hal/us_ticker_api.h"
+#endif
+
+using namespace utest::v1;
+
+/*
+ * In-memory storage driver, with the semantics of NOR flash: erasing sets
+ * octets to 0xFF and programming can only clear bits.
+ */
+static const uint32_t STUB_PROGRAM_UNIT = 8;
+static const uint32_t STUB_ERASE_UNIT   = 4096;
+static const uint32_t STUB_NUM_SLOTS    = 4;
+static const uint32_t STUB_SIZE         = STUB_ERASE_UNIT * (STUB_NUM_SLOTS + 1); /* header and slots */
+
+static uint8_t stubStorage[STUB_SIZE];
+
+static struct {
+    uint32_t programmed; /* octets programmed */
+    uint32_t erased;     /* octets erased */
+} stubStats;
+
+static const ARM_DRIVER_VERSION stubVersion = {
+    ARM_STORAGE_API_VERSION,
+    ARM_DRIVER_VERSION_MAJOR_MINOR(1,00)
+};
+
+static const ARM_STORAGE_BLOCK stubBlock = {
+    0,                                      /* addr */
+    STUB_SIZE,                              /* size */
+    {
+        1,                                  /* erasable */
+        1,                                  /* programmable */
+        0,                                  /* executable */
+        0,                                  /* protectable */
+        0,                                  /* reserved */
+        STUB_ERASE_UNIT,                    /* erase_unit */
+        0                                   /* protection_unit */
+    }
+};
+
+static ARM_DRIVER_VERSION stubGetVersion(void)
+{
+    return stubVersion;
+}
+
+static ARM_STORAGE_CAPABILITIES stubGetCapabilities(void)
+{
+    ARM_STORAGE_CAPABILITIES caps;
+    memset(&caps, 0, sizeof(caps));
+    caps.erase_all = 1;
+    return caps;
+}
+
+static int32_t stubInitialize(ARM_Storage_Callback_t callback)
+{
+    (void) callback;
+    return 1; /* synchronous completion */
+}
+
+static int32_t stubUninitialize(void)
+{
+    return 1;
+}
+
+static int32_t stubPowerControl(ARM_POWER_STATE state)
+{
+    (void) state;
+    return 1;
+}
+
+static int32_t stubReadData(uint64_t addr, void *data, uint32_t size)
+{
+    if ((addr >= STUB_SIZE) || (size > STUB_SIZE - addr)) {
+        return ARM_DRIVER_ERROR_PARAMETER;
+    }
+    memcpy(data, &stubStorage[addr], size);
+    return size;
+}
+
+static int32_t stubProgramData(uint64_t addr, const void *data, uint32_t size)
+{
+    if ((addr >= STUB_SIZE) || (size > STUB_SIZE - addr) || (addr % STUB_PROGRAM_UNIT) || (size % STUB_PROGRAM_UNIT)) {
+        return ARM_DRIVER_ERROR_PARAMETER;
+    }
+    for (uint32_t i = 0; i < size; i++) {
+        stubStorage[addr + i] &= ((const uint8_t *)data)[i];
+    }
+    stubStats.programmed += size;
+    return size;
+}
+
+static int32_t stubErase(uint64_t addr, uint32_t size)
+{
+    if ((addr >= STUB_SIZE) || (size > STUB_SIZE - addr) || (addr % STUB_ERASE_UNIT) || (size % STUB_ERASE_UNIT)) {
+        return ARM_DRIVER_ERROR_PARAMETER;
+    }
+    memset(&stubStorage[addr], 0xFF, size);
+    stubStats.erased += size;
+    return size;
+}
+
+static int32_t stubEraseAll(void)
+{
+    return stubErase(0, STUB_SIZE);
+}
+
+static ARM_STORAGE_STATUS stubGetStatus(void)
+{
+    ARM_STORAGE_STATUS status;
+    memset(&status, 0, sizeof(status));
+    return status;
+}
+
+static int32_t stubGetInfo(ARM_STORAGE_INFO *info)
+{
+    memset(info, 0, sizeof(ARM_STORAGE_INFO));
+    info->total_storage        = STUB_SIZE;
+    info->program_unit         = STUB_PROGRAM_UNIT;
+    info->optimal_program_unit = STUB_PROGRAM_UNIT;
+    info->program_cycles       = ARM_STORAGE_PROGRAM_CYCLES_INFINITE;
+    info->erased_value         = 1;
+    info->programmability      = ARM_STORAGE_PROGRAMMABILITY_ERASABLE;
+    info->retention_level      = ARM_RETENTION_NVM;
+    return ARM_DRIVER_OK;
+}
+
+static uint32_t stubResolveAddress(uint64_t addr)
+{
+    (void) addr;
+    return ARM_STORAGE_INVALID_ADDRESS;
+}
+
+static int32_t stubGetNextBlock(const ARM_STORAGE_BLOCK *prevP, ARM_STORAGE_BLOCK *nextP)
+{
+    if (prevP == NULL) {
+        if (nextP) {
+            memcpy(nextP, &stubBlock, sizeof(ARM_STORAGE_BLOCK));
+        }
+        return ARM_DRIVER_OK;
+    }
+    if (nextP) {
+        nextP->addr = ARM_STORAGE_INVALID_OFFSET;
+        nextP->size = 0;
+    }
+    return ARM_DRIVER_ERROR;
+}
+
+static int32_t stubGetBlock(uint64_t addr, ARM_STORAGE_BLOCK *blockP)
+{
+    if (addr < STUB_SIZE) {
+        if (blockP) {
+            memcpy(blockP, &stubBlock, sizeof(ARM_STORAGE_BLOCK));
+        }
+        return ARM_DRIVER_OK;
+    }
+    if (blockP) {
+        blockP->addr = ARM_STORAGE_INVALID_OFFSET;
+        blockP->size = 0;
+    }
+    return ARM_DRIVER_ERROR;
+}
+
+static ARM_DRIVER_STORAGE stubDriver = {
+    stubGetVersion,
+    stubGetCapabilities,
+    stubInitialize,
+    stubUninitialize,
+    stubPowerControl,
+    stubReadData,
+    stubProgramData,
+    stubErase,
+    stubEraseAll,
+    stubGetStatus,
+    stubGetInfo,
+    stubResolveAddress,
+    stubGetNextBlock,
+    stubGetBlock
+};
+ARM_DRIVER_STORAGE *drv = &stubDriver;
+
+FlashJournal_t      journal;
+
+static const size_t SIZEOF_BLOB = 1024;
+static uint8_t      expected[SIZEOF_BLOB]; /* the blob as it should read back */
+static uint8_t      buffer[SIZEOF_BLOB];
+
+static uint32_t now_us(void)
+{
+#ifdef TARGET_LIKE_POSIX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    return us_ticker_read();
+#endif
+}
+
+/* log and commit 'expected' as a whole new blob */
+static void logAndCommitBlob(void)
+{
+    int32_t rc = FlashJournal_log(&journal, expected, SIZEOF_BLOB);
+    TEST_ASSERT_EQUAL(SIZEOF_BLOB, rc);
+    rc = FlashJournal_commit(&journal);
+    TEST_ASSERT_EQUAL(1, rc);
+}
+
+/* update a range of 'expected', and log the update as a delta */
+static int32_t updateWithDelta(size_t offset, size_t size, uint8_t pattern)
+{
+    memset(&expected[offset], pattern, size);
+    return FlashJournal_logDelta(&journal, offset, &expected[offset], size);
+}
+
+/* check that the journal reads back 'expected', with a read() and with readFrom()s in odd-sized chunks */
+static void verifyBlob(void)
+{
+    FlashJournal_Info_t info;
+    int32_t rc = FlashJournal_getInfo(&journal, &info);
+    TEST_ASSERT_EQUAL(JOURNAL_STATUS_OK, rc);
+    TEST_ASSERT_EQUAL(SIZEOF_BLOB, info.sizeofJournaledBlob);
+
+    memset(buffer, 0, SIZEOF_BLOB);
+    rc = FlashJournal_read(&journal, buffer, SIZEOF_BLOB);
+    TEST_ASSERT_EQUAL(SIZEOF_BLOB, rc);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, buffer, SIZEOF_BLOB);
+
+    static const size_t CHUNK = 37;
+    memset(buffer, 0, SIZEOF_BLOB);
+    for (size_t offset = 0; offset < SIZEOF_BLOB; offset += CHUNK) {
+        size_t size = (SIZEOF_BLOB - offset < CHUNK) ? (SIZEOF_BLOB - offset) : CHUNK;
+        rc = FlashJournal_readFrom(&journal, offset, buffer + offset, size);
+        TEST_ASSERT_EQUAL(size, rc);
+    }
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, buffer, SIZEOF_BLOB);
+}
+
+void test_formatAndInitialize()
+{
+    memset(stubStorage, 0xFF, sizeof(stubStorage));
+
+    int32_t rc = flashJournalStrategySequential_format(drv, STUB_NUM_SLOTS, NULL);
+    TEST_ASSERT_EQUAL(1, rc);
+    rc = FlashJournal_initialize(&journal, drv, &FLASH_JOURNAL_STRATEGY_SEQUENTIAL, NULL);
+    TEST_ASSERT_EQUAL(1, rc);
+
+    /* there is no blob to apply a delta to */
+    uint8_t data[STUB_PROGRAM_UNIT] = { 0 };
+    rc = FlashJournal_logDelta(&journal, 0, data, sizeof(data));
+    TEST_ASSERT_EQUAL(JOURNAL_STATUS_EMPTY, rc);
+}
+
+void test_logDeltas()
+{
+    for (size_t i = 0; i < SIZEOF_BLOB; i++) {
+        expected[i] = (uint8_t) i;
+    }
+    logAndCommitBlob();
+
+    /* the delta needs to lie within the blob, and to align with the program_unit */
+    uint8_t data[STUB_PROGRAM_UNIT] = { 0 };
+    TEST_ASSERT_EQUAL(JOURNAL_STATUS_PARAMETER, FlashJournal_logDelta(&journal, SIZEOF_BLOB - 1, data, sizeof(data)));
+    TEST_ASSERT_EQUAL(JOURNAL_STATUS_PARAMETER, FlashJournal_logDelta(&journal, 0, data, sizeof(data) - 1));
+
+    TEST_ASSERT_EQUAL(8, updateWithDelta(0, 8, 0xA1));
+    TEST_ASSERT_EQUAL(64, updateWithDelta(100, 64, 0xA2));
+    TEST_ASSERT_EQUAL(16, updateWithDelta(120, 16, 0xA3)); /* overlaps the previous delta */
+    TEST_ASSERT_EQUAL(8, updateWithDelta(SIZEOF_BLOB - 8, 8, 0xA4));
+    TEST_ASSERT_EQUAL(SIZEOF_BLOB, updateWithDelta(0, SIZEOF_BLOB, 0xA5));
+    TEST_ASSERT_EQUAL(8, updateWithDelta(512, 8, 0xA6));
+    verifyBlob();
+}
+
+void test_replayAfterInitialize()
+{
+    int32_t rc = FlashJournal_initialize(&journal, drv, &FLASH_JOURNAL_STRATEGY_SEQUENTIAL, NULL);
+    TEST_ASSERT_EQUAL(1, rc);
+    verifyBlob();
+
+    /* further deltas follow the replayed ones */
+    TEST_ASSERT_EQUAL(24, updateWithDelta(200, 24, 0xB1));
+    rc = FlashJournal_initialize(&journal, drv, &FLASH_JOURNAL_STRATEGY_SEQUENTIAL, NULL);
+    TEST_ASSERT_EQUAL(1, rc);
+    verifyBlob();
+}
+
+void test_tornDelta()
+{
+    SequentialFlashJournal_t *sequentialJournal = (SequentialFlashJournal_t *)&journal;
+
+    /* emulate a loss of power after programming the head of a delta record, but not its data */
+    SequentialFlashJournalDeltaHead_t head;
+    head.magic  = SEQUENTIAL_FLASH_JOURNAL_DELTA_MAGIC;
+    head.offset = 0;
+    head.size   = 64;
+    head.crc32  = 0x12345678;
+    uint64_t headOffset = DELTAS_ADDRESS(sequentialJournal) + sequentialJournal->sizeofDeltas;
+    TEST_ASSERT_EQUAL(sizeof(head), drv->ProgramData(headOffset, &head, sizeof(head)));
+
+    /* the torn record is ignored, and seals the deltas */
+    int32_t rc = FlashJournal_initialize(&journal, drv, &FLASH_JOURNAL_STRATEGY_SEQUENTIAL, NULL);
+    TEST_ASSERT_EQUAL(1, rc);
+    verifyBlob();
+    uint8_t data[STUB_PROGRAM_UNIT] = { 0 };
+    TEST_ASSERT_EQUAL(JOURNAL_STATUS_BOUNDED_CAPACITY, FlashJournal_logDelta(&journal, 0, data, sizeof(data)));
+
+    /* logging the whole blob makes room for deltas again */
+    logAndCommitBlob();
+    TEST_ASSERT_EQUAL(8, updateWithDelta(8, 8, 0xC1));
+    rc = FlashJournal_initialize(&journal, drv, &FLASH_JOURNAL_STRATEGY_SEQUENTIAL, NULL);
+    TEST_ASSERT_EQUAL(1, rc);
+    verifyBlob();
+}
+
+void test_compaction()
+{
+    /* fill up the slot with deltas */
+    unsigned numDeltas = 0;
+    int32_t rc;
+    while ((rc = updateWithDelta((numDeltas * 24) % (SIZEOF_BLOB - 32), 32, (uint8_t) numDeltas)) == 32) {
+        numDeltas++;
+    }
+    TEST_ASSERT_EQUAL(JOURNAL_STATUS_BOUNDED_CAPACITY, rc);
+    TEST_ASSERT(numDeltas > 0);
+
+    /* the update which didn't fit is folded in by logging the whole blob */
+    logAndCommitBlob();
+    verifyBlob();
+    rc = FlashJournal_initialize(&journal, drv, &FLASH_JOURNAL_STRATEGY_SEQUENTIAL, NULL);
+    TEST_ASSERT_EQUAL(1, rc);
+    verifyBlob();
+    TEST_ASSERT_EQUAL(32, updateWithDelta(64, 32, 0xD1));
+    verifyBlob();
+}
+
+/* Update a 4-octet counter in the blob many times, either by logging the
+ * whole blob, or with deltas (logging the whole blob once the deltas have
+ * filled up the slot). */
+void test_metrics()
+{
+    static const unsigned NUM_UPDATES = 500;
+    static const size_t   COUNTER_OFFSET = 256;
+
+    for (unsigned deltas = 0; deltas < 2; deltas++) {
+        memset(&stubStats, 0, sizeof(stubStats));
+        uint32_t elapsed = 0;
+        uint32_t worst = 0;
+        unsigned compactions = 0;
+
+        for (uint32_t counter = 0; counter < NUM_UPDATES; counter++) {
+            memcpy(&expected[COUNTER_OFFSET], &counter, sizeof(counter));
+
+            uint32_t start = now_us();
+            if (!deltas) {
+                logAndCommitBlob();
+            } else {
+                /* deltas need to align with the program_unit */
+                size_t offset = COUNTER_OFFSET - (COUNTER_OFFSET % STUB_PROGRAM_UNIT);
+                int32_t rc = FlashJournal_logDelta(&journal, offset, &expected[offset], STUB_PROGRAM_UNIT);
+                if (rc == JOURNAL_STATUS_BOUNDED_CAPACITY) {
+                    logAndCommitBlob();
+                    compactions++;
+                } else {
+                    TEST_ASSERT_EQUAL(STUB_PROGRAM_UNIT, rc);
+                }
+            }
+            uint32_t latency = now_us() - start;
+
+            elapsed += latency;
+            if (latency > worst) {
+                worst = latency;
+            }
+        }
+        verifyBlob();
+
+        printf("%s: %u updates of %u octets in a %u octet blob: %lu octets programmed and %lu erased per update, "
+               "write amplification %lu, commit latency %lu us average and %lu us worst, %u whole blob logs\r\n",
+               deltas ? "deltas" : "whole blob", NUM_UPDATES, (unsigned) sizeof(uint32_t), (unsigned) SIZEOF_BLOB,
+               (unsigned long) (stubStats.programmed / NUM_UPDATES), (unsigned long) (stubStats.erased / NUM_UPDATES),
+               (unsigned long) (stubStats.programmed / (NUM_UPDATES * sizeof(uint32_t))),
+               (unsigned long) (elapsed / NUM_UPDATES), (unsigned long) worst, deltas ? compactions : NUM_UPDATES);
+    }
+}
+
+#ifndef AVOID_GREENTEA
+// Custom setup handler required for proper Greentea support
+utest::v1::status_t greentea_setup(const size_t number_of_cases)
+{
+    GREENTEA_SETUP(60, "default_auto");
+    // Call the default reporting function
+    return greentea_test_setup_handler(number_of_cases);
+}
+#else
+status_t default_setup(const size_t)
+{
+    return STATUS_CONTINUE;
+}
+#endif
+
+// Specify all your test cases here
+Case cases[] = {
+    Case("format and initialize",                       test_formatAndInitialize),
+    Case("log deltas",                                  test_logDeltas),
+    Case("replay deltas after initialize",              test_replayAfterInitialize),
+    Case("torn delta",                                  test_tornDelta),
+    Case("compaction",                                  test_compaction),
+    Case("metrics",                                     test_metrics),
+};
+
+// Declare your test specification with a custom setup handler
+#ifndef AVOID_GREENTEA
+Specification specification(greentea_setup, cases);
+#else
+Specification specification(default_setup, cases);
+#endif
+
+int main(int argc, char** argv)
+{
+    // Run the test specification
+    Harness::run(specification);
+}
@@ -56,6 +56,24 @@
 #define CFSTORE_CONFIG_BACKEND_FLASH_ENABLED
 #endif
 
+/* CFSTORE_KEY_INDEX
+ *   Keep an in-RAM index of the KV key names so that Open(), Create() and
+ *   Find() do not walk the whole KV area. Set to 0 to save the index RAM.
+ *   The index is not available when cfstore uses a client supplied SRAM slab.
+ */
+#if (!defined CFSTORE_KEY_INDEX || CFSTORE_KEY_INDEX!=0) && !defined CFSTORE_YOTTA_CFG_CFSTORE_SRAM_ADDR
+#define CFSTORE_CONFIG_KEY_INDEX_ENABLED
+#endif
+
+/* CFSTORE_DELTA_FLUSH
+ *   On Flush(), log only the range of the KV area changed since the last
+ *   commit as a flash-journal delta record, rather than the whole area. The
+ *   whole area is still logged when the delta records fill up the journal slot.
+ */
+#if defined CFSTORE_CONFIG_BACKEND_FLASH_ENABLED && (!defined CFSTORE_DELTA_FLUSH || CFSTORE_DELTA_FLUSH!=0)
+#define CFSTORE_CONFIG_DELTA_FLUSH_ENABLED
+#endif
+
 #if defined STORAGE_CONFIG_HARDWARE_MTD_K64F_ASYNC_OPS
 #define CFSTORE_STORAGE_DRIVER_CONFIG_HARDWARE_MTD_ASYNC_OPS STORAGE_CONFIG_HARDWARE_MTD_K64F_ASYNC_OPS
 #endif
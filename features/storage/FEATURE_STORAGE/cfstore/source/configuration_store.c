@@ -166,6 +166,40 @@ typedef struct cfstore_area_hkvt_t
 } cfstore_area_hkvt_t;
 
 
+/* @brief   in-RAM index of the KVs stored in the sram area.
+ *
+ * KVs are referenced by their offset from area_0_head so the index survives
+ * realloc() moving the area. Offsets are stored plus one so that 0 marks an
+ * empty hash slot.
+ *
+ * @param   hash
+ *          open addressing (linear probing) hash table of KV offsets, keyed
+ *          on the key name. Used for exact key name lookups.
+ * @param   hash_size
+ *          number of slots in hash. A power of 2 kept at least twice the
+ *          number of KVs.
+ * @param   sorted
+ *          KV offsets sorted by key name. Used for wildcard Find() queries,
+ *          which only visit the KVs sharing the literal prefix of the query.
+ * @param   sorted_size
+ *          number of entries allocated for sorted.
+ * @param   count
+ *          number of KVs in the index.
+ * @param   valid
+ *          false if the index could not be allocated, in which case lookups
+ *          walk the area until the index is rebuilt on the next initialise.
+ */
+typedef struct cfstore_index_t
+{
+    uint32_t *hash;
+    uint32_t *sorted;
+    uint32_t hash_size;
+    uint32_t sorted_size;
+    uint32_t count;
+    bool valid;
+} cfstore_index_t;
+
+
 /* helper struct */
 typedef struct cfstore_client_notify_data_t
 {
@@ -221,6 +255,7 @@ static const char* cfstore_flash_opcode_str[] =
     "FLASH_JOURNAL_OPCODE_LOG_BLOB",
     "FLASH_JOURNAL_OPCODE_COMMIT",
     "FLASH_JOURNAL_OPCODE_RESET",
+    "FLASH_JOURNAL_OPCODE_LOG_DELTA",
 };
 
 static const char* cfstore_flash_state_str[] =
@@ -378,6 +413,16 @@ static int32_t cfstore_get_key_name_ex(cfstore_area_hkvt_t *hkvt, char* key_name
  *          plus padding so the sram blob size is a multiple of flash
  *          program_unit.
  *          - accessed in app & intr context; hence needs CS protection.
+ *
+ * @param   dirty_start, dirty_end
+ *          range of the area changed since the last commit, as offsets from
+ *          area_0_head. The range is empty when dirty_start > dirty_end.
+ *          Used to log only the changed range on Flush(). Only present when
+ *          CFSTORE_CONFIG_DELTA_FLUSH_ENABLED is defined.
+ *
+ * @param   index
+ *          index of the KV key names, see cfstore_index_t. Only present
+ *          when CFSTORE_CONFIG_KEY_INDEX_ENABLED is defined.
  */
 typedef struct cfstore_ctx_t
 {
@@ -401,12 +446,20 @@ typedef struct cfstore_ctx_t
     uint32_t area_dirty_flag : 1;
     uint32_t f_reserved0 : 30;
 
+#ifdef CFSTORE_CONFIG_KEY_INDEX_ENABLED
+    cfstore_index_t index;
+#endif /* CFSTORE_CONFIG_KEY_INDEX_ENABLED */
+
 #ifdef CFSTORE_CONFIG_BACKEND_FLASH_ENABLED
     /* flash journal related data */
     FlashJournal_t jrnl;
     FlashJournal_Info_t info;
     FlashJournal_OpCode_t cmd_code;
     uint64_t expected_blob_size;
+#ifdef CFSTORE_CONFIG_DELTA_FLUSH_ENABLED
+    uint32_t dirty_start;
+    uint32_t dirty_end;
+#endif /* CFSTORE_CONFIG_DELTA_FLUSH_ENABLED */
 #endif /* CFSTORE_CONFIG_BACKEND_FLASH_ENABLED */
 } cfstore_ctx_t;
 
@@ -1312,6 +1365,372 @@ static int32_t cfstore_get_next_hkvt(cfstore_area_hkvt_t* prev, cfstore_area_hkv
 }
 
 
+/*
+ * KV index
+ */
+
+#ifdef CFSTORE_CONFIG_KEY_INDEX_ENABLED
+
+#define CFSTORE_INDEX_HASH_SIZE_MIN                 16
+#define CFSTORE_INDEX_SORTED_SIZE_MIN               8
+
+/* @brief   FNV-1a hash of a key name */
+static uint32_t cfstore_index_hash(const uint8_t* key, uint8_t len)
+{
+    uint32_t hash = 2166136261u;
+
+    while(len--){
+        hash ^= *key++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* @brief   helper function to get the hkvt of an index entry (offset plus one) */
+static cfstore_area_hkvt_t cfstore_index_get_hkvt(uint32_t entry)
+{
+    return cfstore_get_hkvt_from_head_ptr(cfstore_ctx_get()->area_0_head + entry - 1);
+}
+
+/* @brief   compare key names in the same way as strcmp() */
+static int cfstore_index_key_cmp(const uint8_t* key1, uint8_t len1, const uint8_t* key2, uint8_t len2)
+{
+    int cmp = memcmp(key1, key2, len1 < len2 ? len1 : len2);
+    if(cmp != 0){
+        return cmp;
+    }
+    return (int) len1 - (int) len2;
+}
+
+/* @brief   find the first sorted index position whose key name is not less than
+ *          (or if upper is set, greater than) the given key name. */
+static uint32_t cfstore_index_bound(const uint8_t* key, uint8_t len, bool upper)
+{
+    cfstore_index_t* index = &cfstore_ctx_get()->index;
+    cfstore_area_hkvt_t hkvt;
+    uint32_t low = 0;
+    uint32_t high = index->count;
+    uint32_t mid;
+    int cmp;
+
+    while(low < high){
+        mid = low + (high - low) / 2;
+        hkvt = cfstore_index_get_hkvt(index->sorted[mid]);
+        cmp = cfstore_index_key_cmp(hkvt.key, cfstore_hkvt_get_key_len(&hkvt), key, len);
+        if(cmp < 0 || (upper && cmp == 0)){
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/* @brief   insert an entry into the hash table, which must have a free slot */
+static void cfstore_index_hash_insert(uint32_t entry)
+{
+    cfstore_index_t* index = &cfstore_ctx_get()->index;
+    cfstore_area_hkvt_t hkvt = cfstore_index_get_hkvt(entry);
+    uint32_t mask = index->hash_size - 1;
+    uint32_t slot = cfstore_index_hash(hkvt.key, cfstore_hkvt_get_key_len(&hkvt)) & mask;
+
+    while(index->hash[slot] != 0){
+        slot = (slot + 1) & mask;
+    }
+    index->hash[slot] = entry;
+}
+
+/* @brief   free the index memory and mark it invalid so lookups walk the area */
+static void cfstore_index_free(void)
+{
+    cfstore_index_t* index = &cfstore_ctx_get()->index;
+
+    free(index->hash);
+    free(index->sorted);
+    memset(index, 0, sizeof(cfstore_index_t));
+}
+
+/* @brief   grow the index arrays so one more KV can be added.
+ *
+ * The hash table is rebuilt from the sorted array when it grows. */
+static int32_t cfstore_index_grow(void)
+{
+    cfstore_index_t* index = &cfstore_ctx_get()->index;
+    uint32_t size;
+    uint32_t i;
+    uint32_t *ptr;
+
+    if(index->count + 1 > index->sorted_size){
+        size = index->sorted_size ? 2 * index->sorted_size : CFSTORE_INDEX_SORTED_SIZE_MIN;
+        ptr = (uint32_t*) realloc(index->sorted, size * sizeof(uint32_t));
+        if(ptr == NULL){
+            return ARM_CFSTORE_DRIVER_ERROR_OUT_OF_MEMORY;
+        }
+        index->sorted = ptr;
+        index->sorted_size = size;
+    }
+    if(2 * (index->count + 1) > index->hash_size){
+        size = index->hash_size ? 2 * index->hash_size : CFSTORE_INDEX_HASH_SIZE_MIN;
+        ptr = (uint32_t*) calloc(size, sizeof(uint32_t));
+        if(ptr == NULL){
+            return ARM_CFSTORE_DRIVER_ERROR_OUT_OF_MEMORY;
+        }
+        free(index->hash);
+        index->hash = ptr;
+        index->hash_size = size;
+        for(i = 0; i < index->count; i++){
+            cfstore_index_hash_insert(index->sorted[i]);
+        }
+    }
+    return ARM_DRIVER_OK;
+}
+
+/* @brief   add the KV at head to the index.
+ *
+ * If memory runs out the index is dropped, and lookups fall back to walking
+ * the area. */
+static void cfstore_index_add(uint8_t* head)
+{
+    cfstore_ctx_t* ctx = cfstore_ctx_get();
+    cfstore_index_t* index = &ctx->index;
+    cfstore_area_hkvt_t hkvt = cfstore_get_hkvt_from_head_ptr(head);
+    uint32_t entry = (uint32_t) (head - ctx->area_0_head) + 1;
+    uint32_t pos;
+
+    if(!index->valid){
+        return;
+    }
+    if(cfstore_index_grow() < ARM_DRIVER_OK){
+        CFSTORE_ERRLOG("%s:Error: unable to grow the key index, dropping it\n", __func__);
+        cfstore_index_free();
+        return;
+    }
+    pos = cfstore_index_bound(hkvt.key, cfstore_hkvt_get_key_len(&hkvt), true);
+    memmove(&index->sorted[pos + 1], &index->sorted[pos], (index->count - pos) * sizeof(uint32_t));
+    index->sorted[pos] = entry;
+    index->count++;
+    cfstore_index_hash_insert(entry);
+}
+
+/* @brief   remove the KV at head from the index. Must be called before the KV is
+ *          removed from the area as the key name is needed to find the entries. */
+static void cfstore_index_remove(uint8_t* head)
+{
+    cfstore_ctx_t* ctx = cfstore_ctx_get();
+    cfstore_index_t* index = &ctx->index;
+    cfstore_area_hkvt_t hkvt = cfstore_get_hkvt_from_head_ptr(head);
+    uint8_t len = cfstore_hkvt_get_key_len(&hkvt);
+    uint32_t entry = (uint32_t) (head - ctx->area_0_head) + 1;
+    uint32_t mask = index->hash_size - 1;
+    uint32_t pos;
+    uint32_t slot;
+    uint32_t next;
+    uint32_t home;
+
+    if(!index->valid || index->count == 0){
+        return;
+    }
+    /* several KVs may have the same name while one is deleting */
+    for(pos = cfstore_index_bound(hkvt.key, len, false); pos < index->count; pos++){
+        if(index->sorted[pos] == entry){
+            memmove(&index->sorted[pos], &index->sorted[pos + 1], (index->count - pos - 1) * sizeof(uint32_t));
+            index->count--;
+            break;
+        }
+    }
+
+    slot = cfstore_index_hash(hkvt.key, len) & mask;
+    while(index->hash[slot] != entry){
+        CFSTORE_ASSERT(index->hash[slot] != 0);
+        slot = (slot + 1) & mask;
+    }
+    /* backward shift deletion: move up the following entries of the probe
+     * sequence which would no longer be found across the emptied slot */
+    next = slot;
+    for(;;){
+        next = (next + 1) & mask;
+        if(index->hash[next] == 0){
+            break;
+        }
+        hkvt = cfstore_index_get_hkvt(index->hash[next]);
+        home = cfstore_index_hash(hkvt.key, cfstore_hkvt_get_key_len(&hkvt)) & mask;
+        if(((next - home) & mask) >= ((next - slot) & mask)){
+            index->hash[slot] = index->hash[next];
+            slot = next;
+        }
+    }
+    index->hash[slot] = 0;
+}
+
+/* @brief   After a cfstore KV area memmove() operation, update the index offsets
+ *          of the KVs following head. See cfstore_file_update(). */
+static void cfstore_index_update(uint8_t* head, int32_t size_diff)
+{
+    cfstore_ctx_t* ctx = cfstore_ctx_get();
+    cfstore_index_t* index = &ctx->index;
+    uint32_t entry = (uint32_t) (head - ctx->area_0_head) + 1;
+    uint32_t i;
+
+    if(!index->valid){
+        return;
+    }
+    for(i = 0; i < index->count; i++){
+        if(index->sorted[i] > entry){
+            index->sorted[i] += size_diff;
+        }
+    }
+    for(i = 0; i < index->hash_size; i++){
+        if(index->hash[i] > entry){
+            index->hash[i] += size_diff;
+        }
+    }
+}
+
+/* @brief   (re)build the index from the KVs in the area */
+static void cfstore_index_rebuild(void)
+{
+    cfstore_ctx_t* ctx = cfstore_ctx_get();
+    cfstore_area_hkvt_t hkvt;
+    int32_t ret;
+
+    CFSTORE_FENTRYLOG("%s:entered\n", __func__);
+    cfstore_index_free();
+    ctx->index.valid = true;
+    ret = cfstore_get_head_hkvt(&hkvt);
+    while(ret >= ARM_DRIVER_OK && ctx->index.valid && cfstore_hkvt_is_valid(&hkvt, ctx->area_0_tail)){
+        cfstore_index_add(hkvt.head);
+        ret = cfstore_get_next_hkvt(&hkvt, &hkvt);
+    }
+}
+
+/* @brief   check if the KV is a Find() candidate i.e. it is not deleting and readable by the client */
+static bool cfstore_index_is_findable(cfstore_area_hkvt_t* hkvt)
+{
+    return !cfstore_hkvt_get_flags_delete(hkvt) && cfstore_is_kv_client_readable(hkvt);
+}
+
+/* @brief   cfstore_find_ex() using the index.
+ *
+ * KVs are returned in key name order: after prev, the next KV returned is the
+ * first matching one with a greater key name. This does not depend on prev
+ * still being in the area, so the Find() idiom can delete the KVs it finds.
+ */
+static int32_t cfstore_index_find(const char* key_name_query, cfstore_area_hkvt_t *prev, cfstore_area_hkvt_t *next)
+{
+    cfstore_index_t* index = &cfstore_ctx_get()->index;
+    size_t query_len = strlen(key_name_query);
+    size_t prefix_len = strcspn(key_name_query, "*");
+    uint8_t len;
+    uint32_t mask = index->hash_size - 1;
+    uint32_t slot;
+    uint32_t pos;
+    uint32_t prev_pos;
+    char key_name[CFSTORE_KEY_NAME_MAX_LENGTH+1];
+    int32_t ret;
+
+    if(index->count == 0){
+        memset(next, 0, sizeof(cfstore_area_hkvt_t));
+        return ARM_CFSTORE_DRIVER_ERROR_KEY_NOT_FOUND;
+    }
+    if(prefix_len == query_len){
+        /* no wildcard: exact match through the hash table */
+        slot = cfstore_index_hash((const uint8_t*) key_name_query, (uint8_t) query_len) & mask;
+        while(index->hash[slot] != 0){
+            *next = cfstore_index_get_hkvt(index->hash[slot]);
+            len = cfstore_hkvt_get_key_len(next);
+            if(len == query_len && memcmp(next->key, key_name_query, len) == 0 && cfstore_index_is_findable(next)){
+                if(prev == NULL || cfstore_index_key_cmp(next->key, len, prev->key, cfstore_hkvt_get_key_len(prev)) > 0){
+                    return ARM_DRIVER_OK;
+                }
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
+        memset(next, 0, sizeof(cfstore_area_hkvt_t));
+        return ARM_CFSTORE_DRIVER_ERROR_KEY_NOT_FOUND;
+    }
+
+    /* wildcard: only the KVs starting with the literal prefix can match */
+    pos = cfstore_index_bound((const uint8_t*) key_name_query, (uint8_t) prefix_len, false);
+    if(prev != NULL){
+        prev_pos = cfstore_index_bound(prev->key, cfstore_hkvt_get_key_len(prev), true);
+        pos = prev_pos > pos ? prev_pos : pos;
+    }
+    for(; pos < index->count; pos++){
+        *next = cfstore_index_get_hkvt(index->sorted[pos]);
+        len = cfstore_hkvt_get_key_len(next);
+        if(len < prefix_len || memcmp(next->key, key_name_query, prefix_len) != 0){
+            break;
+        }
+        if(!cfstore_index_is_findable(next)){
+            continue;
+        }
+        len++;
+        cfstore_get_key_name_ex(next, key_name, &len);
+        ret = cfstore_fnmatch(key_name_query, key_name, 0);
+        if(ret == 0){
+            CFSTORE_TP(CFSTORE_TP_FIND, "%s:Found matching key (key_name_query = \"%s\", next->key = \"%s\")\n", __func__, key_name_query, key_name);
+            return ARM_DRIVER_OK;
+        } else if(ret != CFSTORE_FNM_NOMATCH){
+            CFSTORE_ERRLOG("%s:Error: cfstore_fnmatch() error (ret=%d).\n", __func__, (int) ret);
+            return ARM_DRIVER_ERROR;
+        }
+    }
+    memset(next, 0, sizeof(cfstore_area_hkvt_t));
+    return ARM_CFSTORE_DRIVER_ERROR_KEY_NOT_FOUND;
+}
+
+#else
+
+static CFSTORE_INLINE void cfstore_index_add(uint8_t* head) { (void) head; }
+static CFSTORE_INLINE void cfstore_index_remove(uint8_t* head) { (void) head; }
+static CFSTORE_INLINE void cfstore_index_update(uint8_t* head, int32_t size_diff) { (void) head; (void) size_diff; }
+
+#endif /* CFSTORE_CONFIG_KEY_INDEX_ENABLED */
+
+
+/*
+ * Delta flush support functions
+ */
+
+#ifdef CFSTORE_CONFIG_DELTA_FLUSH_ENABLED
+
+/* @brief   set the changed range of the area to empty, e.g. when the area
+ *          is the same as the blob in flash. */
+static CFSTORE_INLINE void cfstore_delta_reset(cfstore_ctx_t* ctx)
+{
+    ctx->dirty_start = UINT32_MAX;
+    ctx->dirty_end = 0;
+}
+
+/* @brief   add [from, to) to the changed range of the area.
+ *
+ * @param   to
+ *          end of the changed memory, or NULL if everything from 'from'
+ *          to the end of the area has changed (e.g. KVs have moved).
+ *
+ * @note    offsets from area_0_head are recorded, so the range remains
+ *          valid when cfstore_realloc_ex() moves the area. */
+static void cfstore_delta_mark_dirty(cfstore_ctx_t* ctx, uint8_t* from, uint8_t* to)
+{
+    uint32_t start = (uint32_t) (from - ctx->area_0_head);
+    uint32_t end = to == NULL ? UINT32_MAX : (uint32_t) (to - ctx->area_0_head);
+
+    if(start < ctx->dirty_start){
+        ctx->dirty_start = start;
+    }
+    if(end > ctx->dirty_end){
+        ctx->dirty_end = end;
+    }
+}
+
+#else
+
+static CFSTORE_INLINE void cfstore_delta_mark_dirty(cfstore_ctx_t* ctx, uint8_t* from, uint8_t* to) { (void) ctx; (void) from; (void) to; }
+
+#endif /* CFSTORE_CONFIG_DELTA_FLUSH_ENABLED */
+
+
 /*
  * Flash support functions
  */
@@ -1576,6 +1995,7 @@ static void cfstore_flash_journal_callback(int32_t status, FlashJournal_OpCode_t
         ctx->fsm.event = cfstore_fsm_event_read_done;
         break;
     case FLASH_JOURNAL_OPCODE_LOG_BLOB:
+    case FLASH_JOURNAL_OPCODE_LOG_DELTA:
         ctx->fsm.event = cfstore_fsm_event_log_done;
         break;
     case FLASH_JOURNAL_OPCODE_COMMIT:
@@ -1606,7 +2026,7 @@ static int32_t cfstore_fsm_stop_on_entry(void* context)
     CFSTORE_ASSERT(ctx->fsm.state == cfstore_fsm_state_stopped);
 
     ctx->fsm.event = cfstore_fsm_event_max;
-    ctx->cmd_code = (FlashJournal_OpCode_t)((int) FLASH_JOURNAL_OPCODE_RESET+1);
+    ctx->cmd_code = (FlashJournal_OpCode_t)((int) FLASH_JOURNAL_OPCODE_LOG_DELTA+1);
     return ARM_DRIVER_OK;
 }
 
@@ -1785,6 +2205,10 @@ static int32_t cfstore_fsm_reading(void* context)
                     memset(&ctx->info, 0, sizeof(ctx->info));
                     goto out;
                 }
+#ifdef CFSTORE_CONFIG_KEY_INDEX_ENABLED
+                /* index the KVs read from flash */
+                cfstore_index_rebuild();
+#endif /* CFSTORE_CONFIG_KEY_INDEX_ENABLED */
                 ret = cfstore_fsm_state_set(&ctx->fsm, cfstore_fsm_state_ready, ctx);
                 if(ret < ARM_DRIVER_OK){
                     CFSTORE_ERRLOG("%s:Error: cfstore_fsm_state_set() failed (ret=%d)\n", __func__, (int) ret);
@@ -1839,6 +2263,56 @@ static int32_t cfstore_fsm_read_on_exit(void* context)
 
 /* int32_t cfstore_fsm_log_on_entry(void* context){ (void) context;} */
 
+#ifdef CFSTORE_CONFIG_DELTA_FLUSH_ENABLED
+/* @brief   log the changed range of the area as a flash journal delta record.
+ *
+ * @return  JOURNAL_STATUS_BOUNDED_CAPACITY if the changed range cannot be logged
+ *          as a delta, in which case the whole area should be logged instead:
+ *          the area size differs from the blob in flash, the delta would be as
+ *          large as the area, or the journal slot has no room for more deltas.
+ *          Otherwise the return code for cfstore_fsm_log_on_entry().
+ */
+static int32_t cfstore_delta_log(cfstore_ctx_t* ctx, FlashJournal_Info_t* info)
+{
+    int32_t ret = JOURNAL_STATUS_BOUNDED_CAPACITY;
+    uint64_t start = ctx->dirty_start;
+    uint64_t end = ctx->dirty_end;
+
+    CFSTORE_FENTRYLOG("%s:entered: dirty_start=%lu, dirty_end=%lu\n", __func__, (unsigned long) start, (unsigned long) end);
+    if(ctx->expected_blob_size == 0 || ctx->expected_blob_size != info->sizeofJournaledBlob || start >= end){
+        return JOURNAL_STATUS_BOUNDED_CAPACITY;
+    }
+    /* align the range with program_unit, within the area */
+    start -= start % info->program_unit;
+    if(end % info->program_unit > 0){
+        end += info->program_unit - (end % info->program_unit);
+    }
+    if(end > ctx->expected_blob_size){
+        end = ctx->expected_blob_size;
+    }
+    if(start >= end || end - start >= ctx->expected_blob_size){
+        return JOURNAL_STATUS_BOUNDED_CAPACITY;
+    }
+
+    CFSTORE_TP(CFSTORE_TP_FLUSH, "%s:logging delta: offset=%d, size=%d\n", __func__, (int) start, (int) (end - start));
+    ret = FlashJournal_logDelta(&ctx->jrnl, (size_t) start, (const void*) (ctx->area_0_head + start), (size_t) (end - start));
+    if(ret == JOURNAL_STATUS_BOUNDED_CAPACITY || ret == JOURNAL_STATUS_UNSUPPORTED){
+        return JOURNAL_STATUS_BOUNDED_CAPACITY;
+    } else if(ret < JOURNAL_STATUS_OK){
+        CFSTORE_ERRLOG("%s:Error: FlashJournal_logDelta() failed (ret=%d)\n", __func__, (int) ret);
+        /* move to ready state. cfstore client is expected to Uninitialize() before further calls */
+        cfstore_fsm_state_set(&ctx->fsm, cfstore_fsm_state_ready, ctx);
+        return cfstore_flash_map_error(ret);
+    } else if(ret > 0){
+        /* logDelta has completed synchronously */
+        cfstore_flash_journal_callback(ret, FLASH_JOURNAL_OPCODE_LOG_DELTA);
+        ret = ctx->status;
+    }
+    /* wait for async completion handler */
+    return ret;
+}
+#endif /* CFSTORE_CONFIG_DELTA_FLUSH_ENABLED */
+
 /* @brief   on entry to writing state, update value */
 int32_t cfstore_fsm_log_on_entry(void* context)
 {
@@ -1865,6 +2339,13 @@ int32_t cfstore_fsm_log_on_entry(void* context)
     /* log the changes to flash even when the area has shrunk to 0, as its necessary to erase the flash */
     if(ctx->area_dirty_flag == true)
     {
+#ifdef CFSTORE_CONFIG_DELTA_FLUSH_ENABLED
+        ret = cfstore_delta_log(ctx, &info);
+        if(ret != JOURNAL_STATUS_BOUNDED_CAPACITY){
+            goto out0;
+        }
+        /* the changed range cannot be logged as a delta, so log the whole area */
+#endif /* CFSTORE_CONFIG_DELTA_FLUSH_ENABLED */
         if(ctx->expected_blob_size > 0){
             CFSTORE_TP(CFSTORE_TP_FLUSH, "%s:logging: ctx->area_0_head=%p, ctx->expected_blob_size-%d\n", __func__, ctx->area_0_head, (int) ctx->expected_blob_size);
             ret = FlashJournal_log(&ctx->jrnl, (const void*) ctx->area_0_head, ctx->expected_blob_size);
@@ -1916,7 +2397,7 @@ static int32_t cfstore_fsm_logging(void* context)
     }
     else
     {   /* ctx->status >= 0 (status == 0 when everything is deleted) */
-        if(ctx->status == (int32_t)ctx->expected_blob_size){
+        if(ctx->status == (int32_t)ctx->expected_blob_size || (ctx->cmd_code == FLASH_JOURNAL_OPCODE_LOG_DELTA && ctx->status > 0)){
             /* move to the committing state to commit to flash*/
             ctx->status = cfstore_fsm_state_set(&ctx->fsm, cfstore_fsm_state_committing, ctx);
         } else {
@@ -1948,7 +2429,7 @@ static int32_t cfstore_fsm_commit_on_entry(void* context)
     cfstore_ctx_t* ctx = (cfstore_ctx_t*) context;
 
     CFSTORE_FENTRYLOG("%s:entered:\n", __func__);
-    if(ctx->area_dirty_flag == true)
+    if(ctx->area_dirty_flag == true && ctx->cmd_code != FLASH_JOURNAL_OPCODE_LOG_DELTA)
     {
 		ret = FlashJournal_commit(&ctx->jrnl);
 		CFSTORE_TP(CFSTORE_TP_FSM, "%s:debug: FlashJournal_commit() (ret=%d)\n", __func__, (int) ret);
@@ -1967,7 +2448,8 @@ static int32_t cfstore_fsm_commit_on_entry(void* context)
 		/* a commit should not be made because there have been no flashJournal_log() calls since the last commit.
 		 * If a _commit() call was made without any _log() calls then it would result in the flash being erased
 		 * because flash journal essentially contains a mirror image of the configuration store sram area, which
-		 * has to be *** FULLY*** repopulated before each _commit(). */
+		 * has to be *** FULLY*** repopulated before each _commit().
+		 * A delta record is persisted as soon as it has been logged, so does not need a commit either. */
 		cfstore_flash_journal_callback(ARM_DRIVER_OK_DONE, FLASH_JOURNAL_OPCODE_COMMIT);
 		ret = ctx->status;
     }
@@ -2015,6 +2497,9 @@ static int32_t cfstore_fsm_commit_on_exit(void* context)
 
     CFSTORE_FENTRYLOG("%s:entered:\n", __func__);
     ctx->area_dirty_flag = false;
+#ifdef CFSTORE_CONFIG_DELTA_FLUSH_ENABLED
+    cfstore_delta_reset(ctx);
+#endif /* CFSTORE_CONFIG_DELTA_FLUSH_ENABLED */
     /* notify client of commit status */
     cfstore_client_notify_data_init(&ctx->client_notify_data, CFSTORE_OPCODE_FLUSH, ctx->status, NULL);
     ctx->client_callback_notify_flag = true;
@@ -2147,7 +2632,7 @@ static int32_t cfstore_fsm_state_handle_event(cfstore_fsm_t* fsm, cfstore_fsm_ev
     /* do not clear context data set by caller as it may be used later
      *  fsm->event = cfstore_fsm_event_max;
      *  ctx->status = 0;
-     *  ctx->cmd_code =  (FlashJournal_OpCode_t)((int) FLASH_JOURNAL_OPCODE_RESET+1);
+     *  ctx->cmd_code =  (FlashJournal_OpCode_t)((int) FLASH_JOURNAL_OPCODE_LOG_DELTA+1);
      */
     return ret;
 }
@@ -2233,8 +2718,11 @@ static int32_t cfstore_flash_init(void)
     cfstore_ctx_t* ctx = cfstore_ctx_get();
 
     CFSTORE_FENTRYLOG("%s:entered: \n", __func__);
-    ctx->cmd_code = (FlashJournal_OpCode_t)((int) FLASH_JOURNAL_OPCODE_RESET+1);
+    ctx->cmd_code = (FlashJournal_OpCode_t)((int) FLASH_JOURNAL_OPCODE_LOG_DELTA+1);
     ctx->expected_blob_size = 0;
+#ifdef CFSTORE_CONFIG_DELTA_FLUSH_ENABLED
+    cfstore_delta_reset(ctx);
+#endif /* CFSTORE_CONFIG_DELTA_FLUSH_ENABLED */
     ctx->fsm.event = cfstore_fsm_event_max;
     ctx->fsm.state = cfstore_fsm_state_stopped;
     memset(&ctx->info, 0, sizeof(ctx->info));
@@ -2284,7 +2772,7 @@ static int32_t cfstore_flash_flush(cfstore_ctx_t* ctx)
     CFSTORE_FENTRYLOG("%s:entered\n", __func__);
     /* put the async completion code state variables into a known state */
     ctx->status = ARM_DRIVER_OK;
-    ctx->cmd_code = (FlashJournal_OpCode_t)((int) FLASH_JOURNAL_OPCODE_RESET+1);
+    ctx->cmd_code = (FlashJournal_OpCode_t)((int) FLASH_JOURNAL_OPCODE_LOG_DELTA+1);
 
     /* cfstore_fsm_state_handle_event() is called at intr context via
      * cfstore_flash_journal_callback(), and hence calls from app context are
@@ -2387,9 +2875,12 @@ static int32_t cfstore_delete_ex(cfstore_area_hkvt_t* hkvt)
      *     need to be updated. cfstore_realloc() can only do this starting from a set of correct
      *     cfstore_file_t::head pointers i.e. after 1. has been completed.
      */
+    cfstore_index_remove(hkvt->head);
+    cfstore_delta_mark_dirty(ctx, hkvt->head, NULL);
     memmove(hkvt->head, hkvt->tail, ctx->area_0_tail - hkvt->tail);
     /* zero the deleted KV memory */
     memset(ctx->area_0_tail-kv_size, 0, kv_size);
+    cfstore_index_update(hkvt->head, -1 *(int32_t)kv_size);
 
     /* The KV area has shrunk so a negative size_diff should be indicated to cfstore_file_update(). */
     ret = cfstore_file_update(hkvt->head, -1 *(int32_t)kv_size);
@@ -3113,6 +3604,7 @@ static int32_t cfstore_delete(ARM_CFSTORE_HANDLE hkey)
 
     /* set the dirty flag so the changes are persisted to backing store when flushed */
     ctx->area_dirty_flag = true;
+    cfstore_delta_mark_dirty(ctx, hkvt.head, hkvt.head + sizeof(cfstore_area_header_t));
 
 out0:
     /* Delete() always completes synchronously irrespective of flash mode, so indicate to caller */
@@ -3144,6 +3636,11 @@ static int32_t cfstore_find_ex(const char* key_name_query, cfstore_area_hkvt_t *
     cfstore_ctx_t* ctx = cfstore_ctx_get();
 
     CFSTORE_TP((CFSTORE_TP_FIND|CFSTORE_TP_FENTRY), "%s:entered: key_name_query=\"%s\", prev=%p, next=%p\n", __func__, key_name_query, prev, next);
+#ifdef CFSTORE_CONFIG_KEY_INDEX_ENABLED
+    if(ctx->index.valid){
+        return cfstore_index_find(key_name_query, prev, next);
+    }
+#endif /* CFSTORE_CONFIG_KEY_INDEX_ENABLED */
     if(prev == NULL){
         ret = cfstore_get_head_hkvt(next);
         /* CFSTORE_TP(CFSTORE_TP_FIND, "%s:next->head=%p, next->key=%p, next->value=%p, next->tail=%p, \n", __func__, next->head, next->key, next->value, next->tail); */
@@ -3374,6 +3871,7 @@ static int32_t cfstore_recreate(const char* key_name, ARM_CFSTORE_SIZE value_len
     if (kv_size_diff < 0){
         /* value blob size shrinking => do memmove() before realloc() which will free memory */
         memmove(hkvt->tail + kv_size_diff, hkvt->tail, memmove_len);
+        cfstore_index_update(hkvt->head, kv_size_diff);
         ret = cfstore_file_update(hkvt->head, kv_size_diff);
         if(ret < ARM_DRIVER_OK){
             CFSTORE_ERRLOG("%s:Error:file update failed\n", __func__);
@@ -3397,6 +3895,7 @@ static int32_t cfstore_recreate(const char* key_name, ARM_CFSTORE_SIZE value_len
     if(kv_size_diff > 0) {
         /* value blob size growing requires memmove() after realloc() */
         memmove(hkvt->tail+kv_size_diff, hkvt->tail, memmove_len);
+        cfstore_index_update(hkvt->head, kv_size_diff);
         ret = cfstore_file_update(hkvt->head, kv_size_diff);
         if(ret < ARM_DRIVER_OK){
             CFSTORE_ERRLOG("%s:Error:file update failed\n", __func__);
@@ -3410,6 +3909,8 @@ static int32_t cfstore_recreate(const char* key_name, ARM_CFSTORE_SIZE value_len
     cfstore_hkvt_set_value_len(hkvt, value_len);
     cfstore_file_create(hkvt, flags, hkey, &ctx->file_list);
     ctx->area_dirty_flag = true;
+    /* the KVs following this one may have moved, so everything from here to the end of the area has changed */
+    cfstore_delta_mark_dirty(ctx, hkvt->head, NULL);
 
 #ifdef CFSTORE_DEBUG
     cfstore_hkvt_dump(hkvt, __func__);
@@ -3541,6 +4042,7 @@ static int32_t cfstore_create(const char* key_name, ARM_CFSTORE_SIZE value_len,
     hdr->perm_other_write = kdesc->acl.perm_other_write;
     hdr->perm_other_execute = kdesc->acl.perm_other_execute;
     strncpy((char*)hdr + sizeof(cfstore_area_header_t), key_name, strlen(key_name));
+    cfstore_index_add((uint8_t*) hdr);
     hkvt = cfstore_get_hkvt_from_head_ptr((uint8_t*) hdr);
     if(cfstore_flags_is_default(kdesc->flags)){
         /* set as read-only by default default */
@@ -3552,6 +4054,7 @@ static int32_t cfstore_create(const char* key_name, ARM_CFSTORE_SIZE value_len,
     }
     cfstore_file_create(&hkvt, flags, hkey, &ctx->file_list);
     ctx->area_dirty_flag = true;
+    cfstore_delta_mark_dirty(ctx, hkvt.head, NULL);
     ret = ARM_DRIVER_OK;
 out1:
     cfstore_hkvt_dump(&hkvt,  __func__);
@@ -3838,6 +4341,7 @@ static int32_t cfstore_write(ARM_CFSTORE_HANDLE hkey, const char* data, ARM_CFST
     value_len = (ARM_CFSTORE_SIZE) cfstore_hkvt_get_value_len(&hkvt);
     *len = *len < value_len ? *len: value_len;
     memcpy(hkvt.value + file->wlocation, data, *len);
+    cfstore_delta_mark_dirty(ctx, hkvt.value + file->wlocation, hkvt.value + file->wlocation + *len);
     file->wlocation += *len;
     cfstore_hkvt_dump(&hkvt, __func__);
     ctx->area_dirty_flag = true;
@@ -3962,6 +4466,9 @@ static int32_t cfstore_initialise(ARM_CFSTORE_CALLBACK callback, void* client_co
         /* ctx->rw_area0_lock initialisation is not required here as the lock is statically initialised to 0 */
         ctx->area_0_head = NULL;
         ctx->area_0_tail = NULL;
+#ifdef CFSTORE_CONFIG_KEY_INDEX_ENABLED
+        cfstore_index_rebuild();
+#endif /* CFSTORE_CONFIG_KEY_INDEX_ENABLED */
 
         CFSTORE_ASSERT(sizeof(cfstore_file_t) == CFSTORE_HANDLE_BUFSIZE);
         if(sizeof(cfstore_file_t) != CFSTORE_HANDLE_BUFSIZE){
@@ -4061,6 +4568,9 @@ static int32_t cfstore_uninitialise(void)
             ctx->area_0_tail = NULL;
             ctx->area_0_len = 0;
         }
+#ifdef CFSTORE_CONFIG_KEY_INDEX_ENABLED
+        cfstore_index_free();
+#endif /* CFSTORE_CONFIG_KEY_INDEX_ENABLED */
     }
 out:
     /* notify client */
@@ -38,6 +38,7 @@ static const uint32_t SEQUENTIAL_FLASH_JOURNAL_MAGIC                       = 0xC
 static const uint32_t SEQUENTIAL_FLASH_JOURNAL_VERSION                     = 1;
 static const uint32_t SEQUENTIAL_FLASH_JOURNAL_HEADER_MAGIC                = 0xCEA00AEEUL;
 static const uint32_t SEQUENTIAL_FLASH_JOURNAL_HEADER_VERSION              = 1;
+static const uint32_t SEQUENTIAL_FLASH_JOURNAL_DELTA_MAGIC                 = 0xCE0DE17AUL;
 
 
 typedef enum {
@@ -50,6 +51,8 @@ typedef enum {
     SEQUENTIAL_JOURNAL_STATE_LOGGING_BODY,
     SEQUENTIAL_JOURNAL_STATE_LOGGING_TAIL,
     SEQUENTIAL_JOURNAL_STATE_READING,
+    SEQUENTIAL_JOURNAL_STATE_LOGGING_DELTA_HEAD,
+    SEQUENTIAL_JOURNAL_STATE_LOGGING_DELTA_BODY,
 } SequentialFlashJournalState_t;
 
 /**
@@ -97,6 +100,23 @@ typedef struct _SequentialFlashJournalLogTail {
 
 #define SEQUENTIAL_JOURNAL_VALID_TAIL(TAIL_PTR) ((TAIL_PTR)->magic == SEQUENTIAL_FLASH_JOURNAL_MAGIC)
 
+/**
+ * Meta-data placed at the head of every delta record. Delta records are
+ * appended to the erased space between the body and the tail of the slot
+ * holding the most recently committed blob; each one overwrites a range of
+ * that blob. The data for the delta follows immediately after this head.
+ */
+typedef struct _SequentialFlashJournalDeltaHead {
+    uint32_t magic;
+    uint32_t offset;     /**< the offset within the blob at which the delta applies. */
+    uint32_t size;       /**< the size of the delta data; a multiple of the program_unit. */
+    uint32_t crc32;      /**< This field contains the CRC of the head and the delta data.
+                          *   The 'CRC32' field is assumed to hold 0x0 for the purpose of
+                          *   computing the CRC */
+} SequentialFlashJournalDeltaHead_t;
+
+#define SEQUENTIAL_JOURNAL_VALID_DELTA_HEAD(PTR) ((PTR)->magic == SEQUENTIAL_FLASH_JOURNAL_DELTA_MAGIC)
+
 typedef struct _SequentialFlashJournal_t {
     FlashJournal_Ops_t             ops;                /**< the mandatory OPS table defining the strategy. */
     FlashJournal_Callback_t        callback;           /**< command completion callback. */
@@ -111,6 +131,8 @@ typedef struct _SequentialFlashJournal_t {
     uint32_t                       currentBlobIndex;   /**< index of the most recently written blob. */
     SequentialFlashJournalState_t  state;              /**< state of the journal. SEQUENTIAL_JOURNAL_STATE_INITIALIZED being the default. */
     FlashJournal_OpCode_t          prevCommand;        /**< the last command issued to the journal. */
+    uint32_t                       sizeofDeltas;       /**< space taken by the valid delta records following the current blob. */
+    uint32_t                       deltasSealed;       /**< set if a delta record failed to log; no more deltas until the next commit. */
 
     /**
      * The following is a union of sub-structures meant to keep state relevant
@@ -140,8 +162,9 @@ typedef struct _SequentialFlashJournal_t {
                     const uint8_t *dataBeingLogged; /**< temporary pointer aimed at the next data to be logged. */
                     size_t         amountLeftToLog;
                     union {
-                        SequentialFlashJournalLogHead_t head;
-                        SequentialFlashJournalLogTail_t tail;
+                        SequentialFlashJournalLogHead_t   head;
+                        SequentialFlashJournalLogTail_t   tail;
+                        SequentialFlashJournalDeltaHead_t delta;
                     };
                 };
             };
@@ -168,6 +191,10 @@ typedef char AssertSequentialJournalSizeLessThanOrEqualToGenericJournal[sizeof(S
 
 #define SLOT_ADDRESS(JOURNAL, INDEX) ((JOURNAL)->mtdStartOffset + (JOURNAL)->firstSlotOffset + ((INDEX) * (JOURNAL)->sizeofSlot))
 
+/* Delta records are appended after the body of the current blob, and must end before its tail. */
+#define DELTAS_ADDRESS(JOURNAL) (SLOT_ADDRESS((JOURNAL), (JOURNAL)->currentBlobIndex) + sizeof(SequentialFlashJournalLogHead_t) + (JOURNAL)->info.sizeofJournaledBlob)
+#define DELTAS_LIMIT(JOURNAL)   (SLOT_ADDRESS((JOURNAL), (JOURNAL)->currentBlobIndex + 1) - sizeof(SequentialFlashJournalLogTail_t))
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus
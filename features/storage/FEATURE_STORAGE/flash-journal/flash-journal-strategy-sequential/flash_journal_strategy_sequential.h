@@ -139,6 +139,7 @@ int32_t               flashJournalStrategySequential_readFrom(FlashJournal_t *jo
 int32_t               flashJournalStrategySequential_log(FlashJournal_t *journal, const void *blob, size_t n);
 int32_t               flashJournalStrategySequential_commit(FlashJournal_t *journal);
 int32_t               flashJournalStrategySequential_reset(FlashJournal_t *journal);
+int32_t               flashJournalStrategySequential_logDelta(FlashJournal_t *journal, size_t offset, const void *data, size_t size);
 
 static const FlashJournal_Ops_t FLASH_JOURNAL_STRATEGY_SEQUENTIAL = {
     flashJournalStrategySequential_initialize,
@@ -147,7 +148,8 @@ static const FlashJournal_Ops_t FLASH_JOURNAL_STRATEGY_SEQUENTIAL = {
     flashJournalStrategySequential_readFrom,
     flashJournalStrategySequential_log,
     flashJournalStrategySequential_commit,
-    flashJournalStrategySequential_reset
+    flashJournalStrategySequential_reset,
+    flashJournalStrategySequential_logDelta
 };
 
 #ifdef __cplusplus
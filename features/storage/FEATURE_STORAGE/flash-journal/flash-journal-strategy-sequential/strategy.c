@@ -32,6 +32,7 @@ static inline int32_t flashJournalStrategySequential_format_sanityChecks(ARM_DRI
 static inline int32_t flashJournalStrategySequential_read_sanityChecks(SequentialFlashJournal_t *journal, const void *blob, size_t sizeofBlob);
 static inline int32_t flashJournalStrategySequential_log_sanityChecks(SequentialFlashJournal_t *journal, const void *blob, size_t sizeofBlob);
 static inline int32_t flashJournalStrategySequential_commit_sanityChecks(SequentialFlashJournal_t *journal);
+static inline int32_t flashJournalStrategySequential_logDelta_sanityChecks(SequentialFlashJournal_t *journal, size_t offset, const void *data, size_t size);
 
 
 int32_t flashJournalStrategySequential_format(ARM_DRIVER_STORAGE      *mtd,
@@ -355,6 +356,38 @@ int32_t flashJournalStrategySequential_reset(FlashJournal_t *_journal)
     return flashJournalStrategySequential_reset_progress();
 }
 
+int32_t flashJournalStrategySequential_logDelta(FlashJournal_t *_journal, size_t offset, const void *data, size_t size)
+{
+    SequentialFlashJournal_t *journal;
+    activeJournal = journal = (SequentialFlashJournal_t *)_journal;
+
+    int32_t rc;
+    if ((rc = flashJournalStrategySequential_logDelta_sanityChecks(journal, offset, data, size)) != JOURNAL_STATUS_OK) {
+        return rc;
+    }
+
+    journal->log.blob         = data;
+    journal->log.sizeofBlob   = size;
+
+    /* setup the head of the delta record; its CRC32 covers the head and the delta data. */
+    journal->log.delta.magic  = SEQUENTIAL_FLASH_JOURNAL_DELTA_MAGIC;
+    journal->log.delta.offset = offset;
+    journal->log.delta.size   = size;
+    journal->log.delta.crc32  = 0;
+    flashJournalCrcReset();
+    flashJournalCrcCummulative((const unsigned char *)&journal->log.delta, sizeof(SequentialFlashJournalDeltaHead_t));
+    journal->log.delta.crc32  = flashJournalCrcCummulative((const unsigned char *)data, size);
+    flashJournalCrcReset();
+
+    journal->log.mtdOffset       = DELTAS_ADDRESS(journal) + journal->sizeofDeltas;
+    journal->log.dataBeingLogged = (const uint8_t *)&journal->log.delta;
+    journal->log.amountLeftToLog = sizeof(SequentialFlashJournalDeltaHead_t);
+    journal->state               = SEQUENTIAL_JOURNAL_STATE_LOGGING_DELTA_HEAD;
+    journal->prevCommand         = FLASH_JOURNAL_OPCODE_LOG_DELTA;
+
+    return flashJournalStrategySequential_logDelta_progress();
+}
+
 int32_t mtdGetTotalCapacity(ARM_DRIVER_STORAGE *mtd, uint64_t *capacityP)
 {
     /* fetch MTD's INFO */
@@ -475,3 +508,34 @@ int32_t flashJournalStrategySequential_commit_sanityChecks(SequentialFlashJourna
 
     return JOURNAL_STATUS_OK;
 }
+
+int32_t flashJournalStrategySequential_logDelta_sanityChecks(SequentialFlashJournal_t *journal, size_t offset, const void *data, size_t size)
+{
+    if ((journal == NULL) || (data == NULL) || (size == 0)) {
+        return JOURNAL_STATUS_PARAMETER;
+    }
+    if ((journal->state == SEQUENTIAL_JOURNAL_STATE_NOT_INITIALIZED) || (journal->state == SEQUENTIAL_JOURNAL_STATE_INIT_SCANNING_LOG_HEADERS)) {
+        return JOURNAL_STATUS_NOT_INITIALIZED;
+    }
+    if ((journal->state != SEQUENTIAL_JOURNAL_STATE_INITIALIZED) || (journal->prevCommand == FLASH_JOURNAL_OPCODE_LOG_BLOB)) {
+        return JOURNAL_STATUS_ERROR; /* journal is in an un-expected state, or in the middle of a sequence of log()s. */
+    }
+    if (journal->info.sizeofJournaledBlob == 0) {
+        return JOURNAL_STATUS_EMPTY; /* there is no committed blob to apply the delta to. */
+    }
+    if ((offset > journal->info.sizeofJournaledBlob) || (size > journal->info.sizeofJournaledBlob - offset)) {
+        return JOURNAL_STATUS_PARAMETER;
+    }
+    if (size % journal->info.program_unit) {
+        return JOURNAL_STATUS_PARAMETER; /* the delta data needs to align with program_unit. */
+    }
+    if (sizeof(SequentialFlashJournalDeltaHead_t) % journal->info.program_unit) {
+        return JOURNAL_STATUS_UNSUPPORTED; /* the head of a delta record can't be programmed on its own. */
+    }
+    if (journal->deltasSealed ||
+        (DELTAS_ADDRESS(journal) + journal->sizeofDeltas + sizeof(SequentialFlashJournalDeltaHead_t) + size > DELTAS_LIMIT(journal))) {
+        return JOURNAL_STATUS_BOUNDED_CAPACITY; /* the blob needs to be logged afresh to make room for more deltas. */
+    }
+
+    return JOURNAL_STATUS_OK;
+}
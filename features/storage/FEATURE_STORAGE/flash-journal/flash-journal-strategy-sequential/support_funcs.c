@@ -186,6 +186,8 @@ int32_t discoverLatestLoggedBlob(SequentialFlashJournal_t *journal)
     journal->nextSequenceNumber       = SEQUENTIAL_FLASH_JOURNAL_INVALD_NEXT_SEQUENCE_NUMBER; /* we are currently unaware of previously written blobs */
     journal->currentBlobIndex         = journal->numSlots;
     journal->info.sizeofJournaledBlob = 0;
+    journal->sizeofDeltas             = 0;
+    journal->deltasSealed             = 0;
 
     /* begin header-scan from the first block of the MTD */
     journal->initScan.currentOffset   = SLOT_ADDRESS(journal, 0);
@@ -233,12 +235,132 @@ int32_t discoverLatestLoggedBlob(SequentialFlashJournal_t *journal)
         // printf("discoverLatestLoggedBlob: initializing to defaults\n");
         journal->currentBlobIndex   = (uint32_t)-1; /* to be incremented to 0 during the first attempt to log(). */
         journal->nextSequenceNumber = 0;
+    } else if (journal->info.sizeofJournaledBlob) {
+        int32_t rc;
+        if ((rc = discoverLoggedDeltas(journal)) != JOURNAL_STATUS_OK) {
+            return rc;
+        }
     }
 
     journal->state = SEQUENTIAL_JOURNAL_STATE_INITIALIZED;
     return JOURNAL_STATUS_OK;
 }
 
+/**
+ * Scan the delta records following the most recently committed blob. The scan
+ * stops at the first record which is missing or fails its CRC32 check; only
+ * the records before it are applied to reads of the blob. If the space
+ * following the last valid record isn't erased (e.g. if power was lost while
+ * logging a delta), no further deltas are accepted until the next commit().
+ */
+int32_t discoverLoggedDeltas(SequentialFlashJournal_t *journal)
+{
+    int32_t rc;
+    ARM_DRIVER_STORAGE *mtd = journal->mtd;
+
+    ARM_STORAGE_INFO mtdInfo;
+    if (mtd->GetInfo(&mtdInfo) != ARM_DRIVER_OK) {
+        return JOURNAL_STATUS_STORAGE_API_ERROR;
+    }
+    const uint8_t erasedValue = mtdInfo.erased_value ? 0xFF : 0x00;
+
+    uint64_t deltaOffset = DELTAS_ADDRESS(journal);
+    while (deltaOffset + sizeof(SequentialFlashJournalDeltaHead_t) <= DELTAS_LIMIT(journal)) {
+        SequentialFlashJournalDeltaHead_t head;
+        /* TODO: add support for asynchronous read */
+        if ((rc = mtd->ReadData(deltaOffset, &head, sizeof(SequentialFlashJournalDeltaHead_t))) != sizeof(SequentialFlashJournalDeltaHead_t)) {
+            return JOURNAL_STATUS_STORAGE_IO_ERROR;
+        }
+
+        if (!SEQUENTIAL_JOURNAL_VALID_DELTA_HEAD(&head)) {
+            const uint8_t *headBytes = (const uint8_t *)&head;
+            for (unsigned i = 0; i < sizeof(SequentialFlashJournalDeltaHead_t); i++) {
+                if (headBytes[i] != erasedValue) {
+                    journal->deltasSealed = 1; /* a partially programmed head */
+                    break;
+                }
+            }
+            break;
+        }
+
+        if ((head.size == 0)                                                                          ||
+            (head.offset > journal->info.sizeofJournaledBlob)                                         ||
+            (head.size > journal->info.sizeofJournaledBlob - head.offset)                            ||
+            (deltaOffset + sizeof(SequentialFlashJournalDeltaHead_t) + head.size > DELTAS_LIMIT(journal))) {
+            journal->deltasSealed = 1;
+            break;
+        }
+
+        /* compute CRC32 over the head and the delta data */
+        uint32_t expectedCRC32 = head.crc32;
+        head.crc32 = 0;
+        flashJournalCrcReset();
+        uint32_t crc32 = flashJournalCrcCummulative((const unsigned char *)&head, sizeof(SequentialFlashJournalDeltaHead_t));
+
+        uint8_t crcBuffer[CRC_CHUNK_SIZE];
+        uint64_t dataOffset = deltaOffset + sizeof(SequentialFlashJournalDeltaHead_t);
+        for (uint32_t dataIndex = 0; dataIndex < head.size; ) {
+            size_t sizeofReadOperation = ((head.size - dataIndex) > CRC_CHUNK_SIZE) ? CRC_CHUNK_SIZE : (head.size - dataIndex);
+
+            /* TODO: add support for asynchronous read */
+            rc = mtd->ReadData(dataOffset + dataIndex, crcBuffer, sizeofReadOperation);
+            if (rc != (int32_t)sizeofReadOperation) {
+                flashJournalCrcReset();
+                return JOURNAL_STATUS_STORAGE_IO_ERROR;
+            }
+
+            dataIndex += sizeofReadOperation;
+            crc32 = flashJournalCrcCummulative(crcBuffer, sizeofReadOperation);
+        }
+        flashJournalCrcReset();
+
+        if (crc32 != expectedCRC32) {
+            journal->deltasSealed = 1;
+            break;
+        }
+
+        deltaOffset               += sizeof(SequentialFlashJournalDeltaHead_t) + head.size;
+        journal->sizeofDeltas      = deltaOffset - DELTAS_ADDRESS(journal);
+    }
+
+    return JOURNAL_STATUS_OK;
+}
+
+/**
+ * Apply the delta records following the most recently committed blob to data
+ * just read from the blob.
+ *
+ * @param logicalOffset
+ *            the offset within the blob of the data in 'buffer'.
+ */
+int32_t applyLoggedDeltas(SequentialFlashJournal_t *journal, size_t logicalOffset, uint8_t *buffer, size_t size)
+{
+    int32_t rc;
+    uint64_t deltaOffset = DELTAS_ADDRESS(journal);
+    uint64_t deltasEnd   = deltaOffset + journal->sizeofDeltas;
+
+    while (deltaOffset < deltasEnd) {
+        SequentialFlashJournalDeltaHead_t head;
+        /* TODO: add support for asynchronous read */
+        if ((rc = journal->mtd->ReadData(deltaOffset, &head, sizeof(SequentialFlashJournalDeltaHead_t))) != sizeof(SequentialFlashJournalDeltaHead_t)) {
+            return JOURNAL_STATUS_STORAGE_IO_ERROR;
+        }
+        deltaOffset += sizeof(SequentialFlashJournalDeltaHead_t);
+
+        /* read the part of the delta overlapping [logicalOffset, logicalOffset + size) straight into the buffer */
+        size_t start = (head.offset > logicalOffset) ? head.offset : logicalOffset;
+        size_t end   = ((head.offset + head.size) < (logicalOffset + size)) ? (head.offset + head.size) : (logicalOffset + size);
+        if (start < end) {
+            if ((rc = journal->mtd->ReadData(deltaOffset + (start - head.offset), buffer + (start - logicalOffset), end - start)) != (int32_t)(end - start)) {
+                return JOURNAL_STATUS_STORAGE_IO_ERROR;
+            }
+        }
+        deltaOffset += head.size;
+    }
+
+    return JOURNAL_STATUS_OK;
+}
+
 /**
  * Progress the state machine for the 'format' operation. This method can also be called from an interrupt handler.
  * @return  < JOURNAL_STATUS_OK for error
@@ -330,6 +452,8 @@ int32_t flashJournalStrategySequential_reset_progress(void)
     journal->nextSequenceNumber       = 0;
     journal->currentBlobIndex         = (uint32_t)-1;
     journal->info.sizeofJournaledBlob = 0;
+    journal->sizeofDeltas             = 0;
+    journal->deltasSealed             = 0;
     journal->state                    = SEQUENTIAL_JOURNAL_STATE_INITIALIZED;
     return 1;
 }
@@ -386,8 +510,16 @@ int32_t flashJournalStrategySequential_read_progress(void)
         }
     }
 
+    /* apply the deltas logged since the blob was committed */
+    size_t amountRead = journal->read.dataBeingRead - journal->read.blob;
+    if (journal->sizeofDeltas &&
+        ((rc = applyLoggedDeltas(journal, journal->read.logicalOffset - amountRead, (uint8_t *)journal->read.blob, amountRead)) != JOURNAL_STATUS_OK)) {
+        journal->state = SEQUENTIAL_JOURNAL_STATE_INITIALIZED; /* reset state */
+        return rc;
+    }
+
     journal->state = SEQUENTIAL_JOURNAL_STATE_INITIALIZED;
-    return (journal->read.dataBeingRead - journal->read.blob);
+    return amountRead;
 }
 
 /**
@@ -550,6 +682,8 @@ int32_t flashJournalStrategySequential_log_progress(void)
                 // printf("crc32 of slot: 0x%x\n", journal->log.tail.crc32);
 
                 journal->info.sizeofJournaledBlob = journal->log.tail.sizeofBlob;
+                journal->sizeofDeltas             = 0; /* the new slot starts without deltas */
+                journal->deltasSealed             = 0;
                 journal->state                    = SEQUENTIAL_JOURNAL_STATE_INITIALIZED; /* reset state to allow further operations */
 
                 ++journal->currentBlobIndex;
@@ -574,6 +708,62 @@ int32_t flashJournalStrategySequential_log_progress(void)
     }
 }
 
+int32_t flashJournalStrategySequential_logDelta_progress(void)
+{
+    SequentialFlashJournal_t *journal = activeJournal;
+
+    if ((journal->state != SEQUENTIAL_JOURNAL_STATE_LOGGING_DELTA_HEAD) &&
+        (journal->state != SEQUENTIAL_JOURNAL_STATE_LOGGING_DELTA_BODY)) {
+        return JOURNAL_STATUS_ERROR; /* journal is in an un-expected state. */
+    }
+
+    while (true) {
+        int32_t rc;
+
+        while (journal->log.amountLeftToLog) {
+            /* perform the IO */
+            rc = journal->mtd->ProgramData(journal->log.mtdOffset, journal->log.dataBeingLogged, journal->log.amountLeftToLog);
+            if (rc < ARM_DRIVER_OK) {
+                /* The record may have been partially programmed; it can't be followed by further deltas. */
+                journal->deltasSealed = 1;
+                journal->state        = SEQUENTIAL_JOURNAL_STATE_INITIALIZED; /* reset state */
+                if (rc == ARM_STORAGE_ERROR_RUNTIME_OR_INTEGRITY_FAILURE) {
+                    return JOURNAL_STATUS_STORAGE_RUNTIME_OR_INTEGRITY_FAILURE;
+                } else {
+                    return JOURNAL_STATUS_STORAGE_IO_ERROR;
+                }
+            }
+            if ((journal->mtdCapabilities.asynchronous_ops) && (rc == ARM_DRIVER_OK)) {
+                return JOURNAL_STATUS_OK; /* we've got pending asynchronous activity. */
+            } else {
+                /* synchronous completion. 'rc' contains the actual number of bytes transferred. */
+                journal->log.mtdOffset       += rc;
+                journal->log.amountLeftToLog -= rc;
+                journal->log.dataBeingLogged += rc;
+            }
+        }
+
+        /* state transition */
+        switch (journal->state) {
+            case SEQUENTIAL_JOURNAL_STATE_LOGGING_DELTA_HEAD:
+                journal->state               = SEQUENTIAL_JOURNAL_STATE_LOGGING_DELTA_BODY;
+                journal->log.dataBeingLogged = journal->log.blob;
+                journal->log.amountLeftToLog = journal->log.sizeofBlob;
+                break;
+
+            case SEQUENTIAL_JOURNAL_STATE_LOGGING_DELTA_BODY:
+                /* the record is complete; make it visible to reads. */
+                journal->sizeofDeltas += sizeof(SequentialFlashJournalDeltaHead_t) + journal->log.sizeofBlob;
+                journal->state         = SEQUENTIAL_JOURNAL_STATE_INITIALIZED;
+                return journal->log.sizeofBlob;
+
+            default:
+                journal->state = SEQUENTIAL_JOURNAL_STATE_INITIALIZED;
+                return JOURNAL_STATUS_ERROR;
+        }
+    }
+}
+
 void formatHandler(int32_t status, ARM_STORAGE_OPERATION operation)
 {
     if (status < ARM_DRIVER_OK) {
@@ -639,6 +829,17 @@ void mtdHandler(int32_t status, ARM_STORAGE_OPERATION operation)
                     activeJournal->callback(status, FLASH_JOURNAL_OPCODE_READ_BLOB);
                 }
                 break;
+
+            case SEQUENTIAL_JOURNAL_STATE_LOGGING_DELTA_HEAD:
+            case SEQUENTIAL_JOURNAL_STATE_LOGGING_DELTA_BODY:
+                /* reset journal state to allow further operation; the record may have been partially programmed. */
+                activeJournal->state        = SEQUENTIAL_JOURNAL_STATE_INITIALIZED;
+                activeJournal->deltasSealed = 1;
+
+                if (activeJournal->callback) {
+                    activeJournal->callback(status, FLASH_JOURNAL_OPCODE_LOG_DELTA);
+                }
+                break;
         }
 
         return;
@@ -656,6 +857,8 @@ void mtdHandler(int32_t status, ARM_STORAGE_OPERATION operation)
                 activeJournal->nextSequenceNumber       = 0;
                 activeJournal->currentBlobIndex         = (uint32_t)-1;
                 activeJournal->info.sizeofJournaledBlob = 0;
+                activeJournal->sizeofDeltas             = 0;
+                activeJournal->deltasSealed             = 0;
                 activeJournal->state                    = SEQUENTIAL_JOURNAL_STATE_INITIALIZED;
                 if (activeJournal->callback) {
                     activeJournal->callback(JOURNAL_STATUS_OK, FLASH_JOURNAL_OPCODE_RESET);
@@ -685,6 +888,8 @@ void mtdHandler(int32_t status, ARM_STORAGE_OPERATION operation)
                 activeJournal->nextSequenceNumber       = 0;
                 activeJournal->currentBlobIndex         = (uint32_t)-1;
                 activeJournal->info.sizeofJournaledBlob = 0;
+                activeJournal->sizeofDeltas             = 0;
+                activeJournal->deltasSealed             = 0;
                 activeJournal->state                    = SEQUENTIAL_JOURNAL_STATE_INITIALIZED;
                 if (activeJournal->callback) {
                     activeJournal->callback(JOURNAL_STATUS_OK, FLASH_JOURNAL_OPCODE_RESET);
@@ -694,6 +899,21 @@ void mtdHandler(int32_t status, ARM_STORAGE_OPERATION operation)
 
         case ARM_STORAGE_OPERATION_PROGRAM_DATA:
             // printf("journal mtdHandler: PROGRAM_DATA: received status of %ld\n", status);
+            if ((activeJournal->state == SEQUENTIAL_JOURNAL_STATE_LOGGING_DELTA_HEAD) ||
+                (activeJournal->state == SEQUENTIAL_JOURNAL_STATE_LOGGING_DELTA_BODY)) {
+                activeJournal->log.mtdOffset       += status;
+                activeJournal->log.amountLeftToLog -= status;
+                activeJournal->log.dataBeingLogged += status;
+
+                if ((rc = flashJournalStrategySequential_logDelta_progress()) == JOURNAL_STATUS_OK) {
+                    return; /* we've got pending asynchronous activity */
+                }
+                if (activeJournal->callback) {
+                    activeJournal->callback(rc, FLASH_JOURNAL_OPCODE_LOG_DELTA);
+                }
+                break;
+            }
+
             rc = status;
             activeJournal->log.mtdOffset       += rc;
             activeJournal->log.amountLeftToLog -= rc;
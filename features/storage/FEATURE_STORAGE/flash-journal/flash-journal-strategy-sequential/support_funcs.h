@@ -52,6 +52,8 @@ int32_t slotIsSane(SequentialFlashJournal_t        *journal,
 int32_t mtdGetStartAddr(ARM_DRIVER_STORAGE *mtd, uint64_t *startAddrP);
 int32_t setupSequentialJournalHeader(SequentialFlashJournalHeader_t *headerP, ARM_DRIVER_STORAGE *mtd, uint64_t totalSize, uint32_t numSlots);
 int32_t discoverLatestLoggedBlob(SequentialFlashJournal_t *journal);
+int32_t discoverLoggedDeltas(SequentialFlashJournal_t *journal);
+int32_t applyLoggedDeltas(SequentialFlashJournal_t *journal, size_t logicalOffset, uint8_t *buffer, size_t size);
 
 /**
  * Progress the state machine for the 'format' operation. This method can also be called from an interrupt handler.
@@ -69,6 +71,14 @@ int32_t flashJournalStrategySequential_format_progress(int32_t status, ARM_STORA
  */
 int32_t flashJournalStrategySequential_log_progress(void);
 
+/**
+ * Progress the state machine for the 'logDelta' operation. This method can also be called from an interrupt handler.
+ * @return  < JOURNAL_STATUS_OK for error
+ *          = JOURNAL_STATUS_OK to signal pending asynchronous activity
+ *          > JOURNAL_STATUS_OK for completion
+ */
+int32_t flashJournalStrategySequential_logDelta_progress(void);
+
 int32_t flashJournalStrategySequential_reset_progress(void);
 int32_t flashJournalStrategySequential_read_progress(void);
 
@@ -61,6 +61,7 @@ typedef enum _FlashJournal_OpCode {
     FLASH_JOURNAL_OPCODE_LOG_BLOB,
     FLASH_JOURNAL_OPCODE_COMMIT,
     FLASH_JOURNAL_OPCODE_RESET,
+    FLASH_JOURNAL_OPCODE_LOG_DELTA,
 } FlashJournal_OpCode_t;
 
 /**
@@ -184,6 +185,12 @@ typedef struct FlashJournal_Ops_t {
      *     Refer to @ref FlashJournal_reset.
      */
     int32_t               (*reset)     (struct FlashJournal_t *journal);
+
+    /**
+     * @brief Log (and commit) an update to a range of the most recently
+     *     committed blob. Refer to @ref FlashJournal_logDelta.
+     */
+    int32_t               (*logDelta)  (struct FlashJournal_t *journal, size_t offset, const void *data, size_t size);
 } FlashJournal_Ops_t;
 
 /**
@@ -687,6 +694,59 @@ static inline int32_t FlashJournal_commit(FlashJournal_t *journal)
     return journal->ops.commit(journal);
 }
 
+/**
+ * @brief Log an update to a range of the most recently committed blob. A
+ *     front-end for @ref FlashJournal_Ops_t::logDelta().
+ *
+ * @details Rather than logging a whole new version of the blob through a
+ *     sequence of log()s and a commit(), only the changed range is appended
+ *     to the journal as a delta record, protected by its own CRC32. A delta
+ *     is committed as soon as it has been logged; there is no separate
+ *     commit(). Subsequent reads of the blob (including after a restart)
+ *     return the committed blob with all logged deltas applied in order.
+ *
+ * @param  [in] journal
+ *                A previously initialized journal.
+ *
+ * @param  [in] offset
+ *                Offset within the blob of the range being updated.
+ *
+ * @param  [in] data
+ *                The new contents of the range.
+ *
+ * @param  [in] size
+ *                The size of the range. This should be a non-zero multiple
+ *                of FlashJournal_Info_t::program_unit, and offset + size
+ *                should not exceed the size of the committed blob.
+ *
+ * @return
+ *   The function executes in the following ways:
+ *   - When the operation is asynchronous, control returns to the caller with
+ *     JOURNAL_STATUS_OK before the actual completion of the operation (or
+ *     with an appropriate error code in case of failure). When the operation
+ *     completes, the command callback is invoked with
+ *     FLASH_JOURNAL_OPCODE_LOG_DELTA and 'size' passed in as the 'status'
+ *     parameter to indicate success.
+ *   - When the operation is executed synchronously, the function returns
+ *     'size' to indicate success, or an appropriate error code.
+ *
+ * @note There is room for deltas only in the space left over in the journal
+ *     after the committed blob. Once this space is used up, logDelta() fails
+ *     with JOURNAL_STATUS_BOUNDED_CAPACITY (without side effects), and the
+ *     caller should log and commit the whole blob instead. This folds the
+ *     deltas into a new version of the blob and makes room for new deltas.
+ *
+ * @note If there is no committed blob, logDelta() fails with
+ *     JOURNAL_STATUS_EMPTY. logDelta() may not be called during a sequence of
+ *     log()s.
+ */
+MBED_DEPRECATED_SINCE("mbed-os-5.5", "FlashJournal is deprecated. "
+                      "Use a BlockDevice or filesystem instead")
+static inline int32_t FlashJournal_logDelta(FlashJournal_t *journal, size_t offset, const void *data, size_t size)
+{
+    return journal->ops.logDelta(journal, offset, data, size);
+}
+
 /**
  * @brief Reset the journal. This has the effect of erasing all valid blobs. A
  *     front-end for @ref FlashJournal_Ops_t::reset().
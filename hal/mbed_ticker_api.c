@@ -15,12 +15,212 @@
  */
 #include <stdio.h>
 #include <stddef.h>
+#include <string.h>
 #include "hal/ticker_api.h"
 #include "platform/mbed_critical.h"
 
 static void schedule_interrupt(const ticker_data_t *const ticker);
 static void update_present_time(const ticker_data_t *const ticker);
 
+/*
+ * Enter a critical section protecting the queue of a ticker.
+ *
+ * When ticker statistics are enabled, returns the counter value at the
+ * start of the critical section.
+ */
+static uint32_t queue_critical_section_enter(const ticker_data_t *const ticker)
+{
+    core_util_critical_section_enter();
+#ifdef MBED_TICKER_STATS_ENABLED
+    return ticker->interface->read();
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Exit a critical section protecting the queue of a ticker and account the
+ * time spent in it.
+ */
+static void queue_critical_section_exit(const ticker_data_t *const ticker, uint32_t start)
+{
+#ifdef MBED_TICKER_STATS_ENABLED
+    ticker_stats_t *stats = &ticker->queue->stats;
+    uint32_t elapsed = ticker->interface->read() - start;
+
+    stats->critical_cnt++;
+    stats->critical_total_time += elapsed;
+    if (elapsed > stats->critical_max_time) {
+        stats->critical_max_time = elapsed;
+    }
+#endif
+    core_util_critical_section_exit();
+}
+
+#if MBED_TICKER_HEAP_QUEUE
+/*
+ * Link two heap roots, the root with the latest timestamp becomes the first
+ * child of the other one.
+ */
+static ticker_event_t *heap_link(ticker_event_t *a, ticker_event_t *b)
+{
+    if (b->timestamp < a->timestamp) {
+        ticker_event_t *tmp = a;
+        a = b;
+        b = tmp;
+    }
+
+    b->next = a->child;
+    if (b->next) {
+        b->next->ref = &b->next;
+    }
+
+    a->child = b;
+    b->ref = &a->child;
+    return a;
+}
+
+/*
+ * Combine a list of siblings into a single heap using the two pass pairing
+ * strategy.
+ */
+static ticker_event_t *heap_pair(ticker_event_t *list)
+{
+    // link pairs from left to right, stacking the results
+    ticker_event_t *pairs = NULL;
+    while (list) {
+        ticker_event_t *a = list;
+        ticker_event_t *b = a->next;
+        if (b) {
+            list = b->next;
+            a = heap_link(a, b);
+        } else {
+            list = NULL;
+        }
+
+        a->next = pairs;
+        pairs = a;
+    }
+
+    // then link the stacked pairs from right to left
+    ticker_event_t *root = pairs;
+    if (root) {
+        pairs = root->next;
+        while (pairs) {
+            ticker_event_t *a = pairs;
+            pairs = a->next;
+            root = heap_link(root, a);
+        }
+    }
+
+    return root;
+}
+
+/*
+ * Merge a heap into the heap of the queue.
+ */
+static void heap_meld(ticker_event_queue_t *queue, ticker_event_t *obj)
+{
+    if (queue->head) {
+        obj = heap_link(queue->head, obj);
+    }
+
+    obj->next = NULL;
+    obj->ref = &queue->head;
+    queue->head = obj;
+}
+#endif
+
+/*
+ * Insert an event in the queue of a ticker.
+ */
+static void queue_insert(ticker_event_queue_t *queue, ticker_event_t *obj)
+{
+#if MBED_TICKER_HEAP_QUEUE
+    obj->child = NULL;
+    heap_meld(queue, obj);
+#else
+    /* Go through the list until we either reach the end, or find
+       an element this should come before (which is possibly the
+       head). */
+    ticker_event_t *prev = NULL, *p = queue->head;
+    while (p != NULL) {
+        /* check if we come before p */
+        if (obj->timestamp < p->timestamp) {
+            break;
+        }
+        /* go to the next element */
+        prev = p;
+        p = p->next;
+    }
+
+    /* if we're at the end p will be NULL, which is correct */
+    obj->next = p;
+
+    /* if prev is NULL we're at the head */
+    if (prev == NULL) {
+        queue->head = obj;
+    } else {
+        prev->next = obj;
+    }
+#endif
+
+#ifdef MBED_TICKER_STATS_ENABLED
+    queue->stats.current_events++;
+    if (queue->stats.current_events > queue->stats.max_events) {
+        queue->stats.max_events = queue->stats.current_events;
+    }
+#endif
+}
+
+/*
+ * Remove an event from the queue of a ticker.
+ *
+ * Return true if the event was in the queue.
+ */
+static bool queue_remove(ticker_event_queue_t *queue, ticker_event_t *obj)
+{
+#if MBED_TICKER_HEAP_QUEUE
+    if (obj->ref == NULL) {
+        return false;
+    }
+
+    // detach the event from its parent then merge its children back
+    *obj->ref = obj->next;
+    if (obj->next) {
+        obj->next->ref = obj->ref;
+    }
+    obj->ref = NULL;
+
+    ticker_event_t *children = heap_pair(obj->child);
+    obj->child = NULL;
+    if (children) {
+        heap_meld(queue, children);
+    }
+#else
+    if (queue->head == obj) {
+        // first in the list, so just drop me
+        queue->head = obj->next;
+    } else {
+        // find the object before me, then drop me
+        ticker_event_t* p = queue->head;
+        while (p != NULL && p->next != obj) {
+            p = p->next;
+        }
+
+        if (p == NULL) {
+            return false;
+        }
+        p->next = obj->next;
+    }
+#endif
+
+#ifdef MBED_TICKER_STATS_ENABLED
+    queue->stats.current_events--;
+#endif
+    return true;
+}
+
 /*
  * Initialize a ticker instance.  
  */
@@ -37,6 +237,9 @@ static void initialize(const ticker_data_t *ticker)
     ticker->queue->event_handler = NULL;
     ticker->queue->head = NULL;
     ticker->queue->present_time = 0;
+#ifdef MBED_TICKER_STATS_ENABLED
+    memset(&ticker->queue->stats, 0, sizeof(ticker_stats_t));
+#endif
     ticker->queue->initialized = true;
     
     update_present_time(ticker);
@@ -159,7 +362,7 @@ void ticker_irq_handler(const ticker_data_t *const ticker)
             // This event was in the past:
             //      point to the following one and execute its handler
             ticker_event_t *p = ticker->queue->head;
-            ticker->queue->head = ticker->queue->head->next;
+            queue_remove(ticker->queue, p);
             if (ticker->queue->event_handler != NULL) {
                 (*ticker->queue->event_handler)(p->id); // NOTE: the handler can set new events
             }
@@ -194,7 +397,7 @@ void ticker_insert_event(const ticker_data_t *const ticker, ticker_event_t *obj,
 
 void ticker_insert_event_us(const ticker_data_t *const ticker, ticker_event_t *obj, us_timestamp_t timestamp, uint32_t id)
 {
-    core_util_critical_section_enter();
+    uint32_t start = queue_critical_section_enter(ticker);
 
     // update the current timestamp
     update_present_time(ticker);
@@ -203,57 +406,25 @@ void ticker_insert_event_us(const ticker_data_t *const ticker, ticker_event_t *o
     obj->timestamp = timestamp;
     obj->id = id;
 
-    /* Go through the list until we either reach the end, or find
-       an element this should come before (which is possibly the
-       head). */
-    ticker_event_t *prev = NULL, *p = ticker->queue->head;
-    while (p != NULL) {
-        /* check if we come before p */
-        if (timestamp < p->timestamp) {
-            break;
-        }
-        /* go to the next element */
-        prev = p;
-        p = p->next;
-    }
-    
-    /* if we're at the end p will be NULL, which is correct */
-    obj->next = p;
-
-    /* if prev is NULL we're at the head */
-    if (prev == NULL) {
-        ticker->queue->head = obj;
-    } else {
-        prev->next = obj;
-    }
+    queue_insert(ticker->queue, obj);
 
     schedule_interrupt(ticker);
 
-    core_util_critical_section_exit();
+    queue_critical_section_exit(ticker, start);
 }
 
 void ticker_remove_event(const ticker_data_t *const ticker, ticker_event_t *obj)
 {
-    core_util_critical_section_enter();
+    uint32_t start = queue_critical_section_enter(ticker);
 
-    // remove this object from the list
-    if (ticker->queue->head == obj) {
-        // first in the list, so just drop me
-        ticker->queue->head = obj->next;
+    // remove this object from the queue, the interrupt has to be
+    // rescheduled only if the object was the next event to execute
+    bool head = ticker->queue->head == obj;
+    if (queue_remove(ticker->queue, obj) && head) {
         schedule_interrupt(ticker);
-    } else {
-        // find the object before me, then drop me
-        ticker_event_t* p = ticker->queue->head;
-        while (p != NULL) {
-            if (p->next == obj) {
-                p->next = obj->next;
-                break;
-            }
-            p = p->next;
-        }
     }
 
-    core_util_critical_section_exit();
+    queue_critical_section_exit(ticker, start);
 }
 
 timestamp_t ticker_read(const ticker_data_t *const ticker)
@@ -281,3 +452,13 @@ int ticker_get_next_timestamp(const ticker_data_t *const data, timestamp_t *time
 
     return ret;
 }
+
+void ticker_get_stats(const ticker_data_t *const ticker, ticker_stats_t *stats)
+{
+    memset(stats, 0, sizeof(ticker_stats_t));
+#ifdef MBED_TICKER_STATS_ENABLED
+    core_util_critical_section_enter();
+    memcpy(stats, &ticker->queue->stats, sizeof(ticker_stats_t));
+    core_util_critical_section_exit();
+#endif
+}
@@ -292,6 +292,21 @@ void serial_tx_abort_asynch(serial_t *obj);
  */
 void serial_rx_abort_asynch(serial_t *obj);
 
+/** Get the number of bytes received by the ongoing RX transaction
+ *
+ *  This lets a driver hand over the data of a transfer which is not complete
+ *  yet, for example when the line goes idle. Targets which cannot tell keep
+ *  the default implementation, which returns -1.
+ *
+ *  Once the transaction completes or is aborted, the count is final and stays
+ *  available until the next transaction starts.
+ *
+ * @param obj The serial object
+ * @return The number of bytes written to the receive buffer by the ongoing or last
+ *         transaction, 0 if there was none, -1 if not supported
+ */
+int serial_rx_asynch_count(serial_t *obj);
+
 /**@}*/
 
 #endif
@@ -42,12 +42,35 @@ typedef uint32_t timestamp_t;
  */
 typedef uint64_t us_timestamp_t;
 
+/**
+ * Select the structure used to store pending events.
+ *
+ * By default events are stored in a sorted linked list, insertion and removal
+ * are O(n) and performed with interrupts disabled. When the
+ * platform.ticker-heap-queue configuration option is enabled, events are
+ * stored in a pairing heap instead: insertion is O(1) and removal is
+ * O(log n) amortized, which bounds the time spent in critical sections when
+ * many timers are armed.
+ *
+ * @note In heap mode events sharing the same timestamp are not guaranteed to
+ * be dispatched in insertion order.
+ */
+#if defined(MBED_CONF_PLATFORM_TICKER_HEAP_QUEUE) && MBED_CONF_PLATFORM_TICKER_HEAP_QUEUE
+#define MBED_TICKER_HEAP_QUEUE 1
+#else
+#define MBED_TICKER_HEAP_QUEUE 0
+#endif
+
 /** Ticker's event structure
  */
 typedef struct ticker_event_s {
     us_timestamp_t         timestamp; /**< Event's timestamp */
     uint32_t               id;        /**< TimerEvent object */
     struct ticker_event_s *next;      /**< Next event in the queue */
+#if MBED_TICKER_HEAP_QUEUE
+    struct ticker_event_s *child;     /**< First child in the heap */
+    struct ticker_event_s **ref;      /**< Link pointing to this event, NULL if not queued */
+#endif
 } ticker_event_t;
 
 typedef void (*ticker_event_handler)(uint32_t id);
@@ -63,6 +86,19 @@ typedef struct {
     void (*fire_interrupt)(void);                 /**< Fire interrupt right-away */
 } ticker_interface_t;
 
+/** Ticker's statistics structure
+ *
+ * Statistics are only gathered when the MBED_TICKER_STATS_ENABLED macro is
+ * defined. Times are expressed in ticker counts.
+ */
+typedef struct {
+    uint32_t critical_cnt;              /**< Number of critical sections entered by the queue */
+    uint32_t critical_max_time;         /**< Longest time spent in a critical section */
+    uint64_t critical_total_time;       /**< Cumulative time spent in critical sections */
+    uint32_t current_events;            /**< Number of events currently in the queue */
+    uint32_t max_events;                /**< Max number of events in the queue at a given time */
+} ticker_stats_t;
+
 /** Ticker's event queue structure
  */
 typedef struct {
@@ -70,6 +106,9 @@ typedef struct {
     ticker_event_t *head;               /**< A pointer to head */
     us_timestamp_t present_time;        /**< Store the timestamp used for present time */
     bool initialized;                   /**< Indicate if the instance is initialized */
+#ifdef MBED_TICKER_STATS_ENABLED
+    ticker_stats_t stats;               /**< Queue statistics */
+#endif
 } ticker_event_queue_t;
 
 /** Ticker's data structure
@@ -102,6 +141,9 @@ void ticker_set_handler(const ticker_data_t *const ticker, ticker_event_handler
 void ticker_irq_handler(const ticker_data_t *const ticker);
 
 /** Remove an event from the queue
+ *
+ * @note In heap mode, an event which has never been inserted must be zero
+ * initialized before being removed.
  *
  * @param ticker The ticker object.
  * @param obj  The event object to be removed from the queue
@@ -170,6 +212,15 @@ us_timestamp_t ticker_read_us(const ticker_data_t *const ticker);
  */
 int ticker_get_next_timestamp(const ticker_data_t *const ticker, timestamp_t *timestamp);
 
+/** Read the statistics of a ticker's event queue
+ *
+ * The structure is zeroed if MBED_TICKER_STATS_ENABLED is not defined.
+ *
+ * @param ticker        The ticker object.
+ * @param stats         A pointer to the ticker_stats_t structure to fill.
+ */
+void ticker_get_stats(const ticker_data_t *const ticker, ticker_stats_t *stats);
+
 /**@}*/
 
 #ifdef __cplusplus
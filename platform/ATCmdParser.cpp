@@ -18,7 +18,9 @@
  *
  */
 
+#include <errno.h>
 #include "ATCmdParser.h"
+#include "events/EventQueue.h"
 #include "mbed_poll.h"
 #include "mbed_debug.h"
 
@@ -39,38 +41,58 @@
 // getc/putc handling with timeouts
 int ATCmdParser::putc(char c)
 {
-    pollfh fhs;
-    fhs.fh = _fh;
-    fhs.events = POLLOUT;
+    return write(&c, 1) == 1 ? 0 : -1;
+}
 
-    int count = poll(&fhs, 1, _timeout);
-    if (count > 0 && (fhs.revents & POLLOUT)) {
-        return _fh->write(&c, 1) == 1 ? 0 : -1;
-    } else {
-        return -1;
+// Read ahead into the receive buffer, waiting up to timeout for data
+int ATCmdParser::fill(int timeout)
+{
+    // Blocking mode reads a character at a time, so that nothing past the
+    // response is taken from the file handle, which may be handed over once
+    // a command completes, e.g. to PPP after CONNECT
+    int size = _queue ? MBED_CONF_PLATFORM_AT_CMD_PARSER_READ_SIZE : 1;
+    while (true) {
+        ssize_t count = _fh->read(_rx_buffer, size);
+        if (count > 0) {
+            _rx_start = 0;
+            _rx_end = count;
+            return count;
+        } else if (count != -EAGAIN) {
+            return -1;
+        }
+
+        pollfh fhs;
+        fhs.fh = _fh;
+        fhs.events = POLLIN;
+        if (timeout == 0 || poll(&fhs, 1, timeout) <= 0 || !(fhs.revents & POLLIN)) {
+            return -1;
+        }
     }
 }
 
 int ATCmdParser::getc()
 {
-    pollfh fhs;
-    fhs.fh = _fh;
-    fhs.events = POLLIN;
-
-    int count = poll(&fhs, 1, _timeout);
-    if (count > 0 && (fhs.revents & POLLIN)) {
-        unsigned char ch;
-        return _fh->read(&ch, 1) == 1 ? ch : -1;
-    } else {
-        return -1;
+    if (_rx_start == _rx_end) {
+        pollfh fhs;
+        fhs.fh = _fh;
+        fhs.events = POLLIN;
+
+        int count = poll(&fhs, 1, _timeout);
+        if (count <= 0 || !(fhs.revents & POLLIN) || fill(_timeout) <= 0) {
+            return -1;
+        }
     }
+
+    return (unsigned char)_rx_buffer[_rx_start++];
 }
 
 void ATCmdParser::flush()
 {
+    _rx_start = _rx_end = 0;
     while (_fh->readable()) {
-        unsigned char ch;
-        _fh->read(&ch, 1);
+        if (_fh->read(_rx_buffer, MBED_CONF_PLATFORM_AT_CMD_PARSER_READ_SIZE) <= 0) {
+            break;
+        }
     }
 }
 
@@ -79,10 +101,23 @@ void ATCmdParser::flush()
 int ATCmdParser::write(const char *data, int size)
 {
     int i = 0;
-    for ( ; i < size; i++) {
-        if (putc(data[i]) < 0) {
+    while (i < size) {
+        pollfh fhs;
+        fhs.fh = _fh;
+        fhs.events = POLLOUT;
+
+        int count = poll(&fhs, 1, _timeout);
+        if (count <= 0 || !(fhs.revents & POLLOUT)) {
+            return -1;
+        }
+
+        ssize_t written = _fh->write(data + i, size - i);
+        if (written == -EAGAIN) {
+            continue;
+        } else if (written <= 0) {
             return -1;
         }
+        i += written;
     }
     return i;
 }
@@ -90,12 +125,35 @@ int ATCmdParser::write(const char *data, int size)
 int ATCmdParser::read(char *data, int size)
 {
     int i = 0;
-    for ( ; i < size; i++) {
-        int c = getc();
-        if (c < 0) {
+    while (i < size) {
+        // Data read ahead comes first
+        if (_rx_start < _rx_end) {
+            int count = _rx_end - _rx_start;
+            if (count > size - i) {
+                count = size - i;
+            }
+            memcpy(data + i, _rx_buffer + _rx_start, count);
+            _rx_start += count;
+            i += count;
+            continue;
+        }
+
+        pollfh fhs;
+        fhs.fh = _fh;
+        fhs.events = POLLIN;
+
+        int count = poll(&fhs, 1, _timeout);
+        if (count <= 0 || !(fhs.revents & POLLIN)) {
             return -1;
         }
-        data[i] = c;
+
+        ssize_t received = _fh->read(data + i, size - i);
+        if (received == -EAGAIN) {
+            continue;
+        } else if (received <= 0) {
+            return -1;
+        }
+        i += received;
     }
     return i;
 }
@@ -105,17 +163,12 @@ int ATCmdParser::read(char *data, int size)
 int ATCmdParser::vprintf(const char *format, va_list args)
 {
 
-    if (vsprintf(_buffer, format, args) < 0) {
+    int size = vsprintf(_buffer, format, args);
+    if (size < 0) {
         return false;
     }
 
-    int i = 0;
-    for ( ; _buffer[i]; i++) {
-        if (putc(_buffer[i]) < 0) {
-            return -1;
-        }
-    }
-    return i;
+    return write(_buffer, size);
 }
 
 int ATCmdParser::vscanf(const char *format, va_list args)
@@ -184,21 +237,18 @@ int ATCmdParser::vscanf(const char *format, va_list args)
 bool ATCmdParser::vsend(const char *command, va_list args)
 {
     // Create and send command
-    if (vsprintf(_buffer, command, args) < 0) {
+    int size = vsprintf(_buffer, command, args);
+    if (size < 0) {
         return false;
     }
 
-    for (int i = 0; _buffer[i]; i++) {
-        if (putc(_buffer[i]) < 0) {
-            return false;
-        }
+    if (write(_buffer, size) < 0) {
+        return false;
     }
 
     // Finish with newline
-    for (size_t i = 0; _output_delimiter[i]; i++) {
-        if (putc(_output_delimiter[i]) < 0) {
-            return false;
-        }
+    if (write(_output_delimiter, _output_delim_size) < 0) {
+        return false;
     }
 
     debug_if(_dbg_on, "AT> %s\n", _buffer);
@@ -250,6 +300,7 @@ restart:
         // We keep trying the match until we succeed or some other error
         // derails us.
         int j = 0;
+        int node = 0;
 
         while (true) {
             // Receive next character
@@ -275,20 +326,18 @@ restart:
             _buffer[offset + j] = 0;
 
             // Check for oob data
-            for (struct oob *oob = _oobs; oob; oob = oob->next) {
-                if ((unsigned)j == oob->len && memcmp(
-                        oob->prefix, _buffer+offset, oob->len) == 0) {
-                    debug_if(_dbg_on, "AT! %s\n", oob->prefix);
-                    oob->cb();
-
-                    if (_aborted) {
-                        debug_if(_dbg_on, "AT(Aborted)\n");
-                        return false;
-                    }
-                    // oob may have corrupted non-reentrant buffer,
-                    // so we need to set it up again
-                    goto restart;
+            struct oob *oob = oob_match(&node, c);
+            if (oob) {
+                debug_if(_dbg_on, "AT! %s\n", oob->prefix);
+                oob->cb();
+
+                if (_aborted) {
+                    debug_if(_dbg_on, "AT(Aborted)\n");
+                    return false;
                 }
+                // oob may have corrupted non-reentrant buffer,
+                // so we need to set it up again
+                goto restart;
             }
 
             // Check for match
@@ -321,6 +370,7 @@ restart:
             if (c == '\n' || j+1 >= _buffer_size - offset) {
                 debug_if(_dbg_on, "AT< %s", _buffer+offset);
                 j = 0;
+                node = 0;
             }
         }
     }
@@ -374,9 +424,245 @@ void ATCmdParser::oob(const char *prefix, Callback<void()> cb)
     oob->cb = cb;
     oob->next = _oobs;
     _oobs = oob;
+
+    // Grow the trie by the worst case, a new branch for the whole prefix
+    oob_node *trie = new oob_node[_oob_trie_size + oob->len + 1];
+    if (_oob_trie) {
+        memcpy(trie, _oob_trie, _oob_trie_size * sizeof(oob_node));
+        delete[] _oob_trie;
+    } else {
+        trie[0].c = 0;
+        trie[0].child = -1;
+        trie[0].sibling = -1;
+        trie[0].handler = NULL;
+        _oob_trie_size = 1;
+    }
+    _oob_trie = trie;
+
+    int node = 0;
+    for (unsigned i = 0; i < oob->len; i++) {
+        int next = _oob_trie[node].child;
+        while (next >= 0 && _oob_trie[next].c != prefix[i]) {
+            next = _oob_trie[next].sibling;
+        }
+
+        if (next < 0) {
+            next = _oob_trie_size++;
+            _oob_trie[next].c = prefix[i];
+            _oob_trie[next].child = -1;
+            _oob_trie[next].sibling = _oob_trie[node].child;
+            _oob_trie[next].handler = NULL;
+            _oob_trie[node].child = next;
+        }
+        node = next;
+    }
+
+    // The latest oob registered for a prefix wins
+    _oob_trie[node].handler = oob;
+}
+
+// Steps through the trie with the next character of a line, returns the oob
+// whose prefix the line starts with once it is complete
+struct ATCmdParser::oob *ATCmdParser::oob_match(int *node, char c)
+{
+    if (*node < 0 || !_oob_trie) {
+        return NULL;
+    }
+
+    int next = _oob_trie[*node].child;
+    while (next >= 0 && _oob_trie[next].c != c) {
+        next = _oob_trie[next].sibling;
+    }
+
+    *node = next;
+    return next >= 0 ? _oob_trie[next].handler : NULL;
 }
 
 void ATCmdParser::abort()
 {
     _aborted = true;
 }
+
+
+// Asynchronous mode
+void ATCmdParser::set_event_queue(events::EventQueue *queue)
+{
+    if (_queue) {
+        _fh->sigio(Callback<void()>());
+        _fh->set_blocking(true);
+        if (_process_pending) {
+            _queue->cancel(_process_id);
+            _process_pending = false;
+        }
+        if (_async_done) {
+            _queue->cancel(_async_timeout_id);
+            _async_done = Callback<void(int, const char *)>();
+        }
+        delete[] _async_buffer;
+        _async_buffer = NULL;
+    }
+
+    _queue = queue;
+    if (_queue) {
+        _async_buffer = new char[_buffer_size];
+        _async_line = 0;
+        _async_len = 0;
+        _async_node = 0;
+        _async_skip = false;
+        _process_pending = false;
+        _fh->set_blocking(false);
+        _fh->sigio(callback(this, &ATCmdParser::sigio));
+
+        // Data may have arrived before
+        sigio();
+    }
+}
+
+// Called on data, possibly in interrupt context
+void ATCmdParser::sigio()
+{
+    if (!_process_pending) {
+        _process_pending = true;
+        _process_id = _queue->call(this, &ATCmdParser::process);
+        if (!_process_id) {
+            _process_pending = false;
+        }
+    }
+}
+
+void ATCmdParser::process()
+{
+    // Data arriving from now on needs another pass
+    _process_pending = false;
+
+    while (_queue && (_rx_start < _rx_end || fill(0) > 0)) {
+        // Callbacks may consume data or leave asynchronous mode
+        while (_queue && _rx_start < _rx_end) {
+            process_char(_rx_buffer[_rx_start++]);
+        }
+    }
+}
+
+void ATCmdParser::process_char(char c)
+{
+    // Simplify newlines (borrowed from retarget.cpp)
+    if ((c == CR && _in_prev != LF) ||
+        (c == LF && _in_prev != CR)) {
+        _in_prev = c;
+        c = '\n';
+    } else if ((c == CR && _in_prev == LF) ||
+               (c == LF && _in_prev == CR)) {
+        _in_prev = c;
+        return;
+    } else {
+        _in_prev = c;
+    }
+
+    // Lines follow each other in the buffer while a response is collected,
+    // characters which do not fit are dropped
+    if (c != '\n') {
+        if (_async_skip) {
+            return;
+        }
+        if (_async_len + 2 < _buffer_size) {
+            _async_buffer[_async_len++] = c;
+        }
+
+        struct oob *oob = oob_match(&_async_node, c);
+        if (oob) {
+            debug_if(_dbg_on, "AT! %s\n", oob->prefix);
+            _async_len = _async_line;
+            _async_node = 0;
+            oob->cb();
+
+            // Drop the rest of the line, unless the callback read it
+            _async_skip = (_in_prev != CR && _in_prev != LF);
+        }
+        return;
+    }
+
+    if (_async_skip) {
+        _async_skip = false;
+        _async_len = _async_line;
+        _async_node = 0;
+        return;
+    }
+
+    _async_buffer[_async_len] = 0;
+    const char *line = _async_buffer + _async_line;
+    _async_node = 0;
+    if (!line[0]) {
+        return;
+    }
+
+    if (!_async_done) {
+        debug_if(_dbg_on, "AT< %s\n", line);
+        _async_len = _async_line;
+    } else if (strcmp(line, _ok_line) == 0) {
+        debug_if(_dbg_on, "AT= %s\n", line);
+        _async_len = _async_line;
+        async_complete(AT_OK);
+    } else if (strstr(line, _error_line)) {
+        debug_if(_dbg_on, "AT= %s\n", line);
+        async_complete(AT_ERROR);
+    } else {
+        _async_buffer[_async_len++] = '\n';
+        _async_line = _async_len;
+    }
+}
+
+void ATCmdParser::async_complete(int result)
+{
+    _queue->cancel(_async_timeout_id);
+
+    // Strip the last newline
+    if (_async_len > 0 && _async_buffer[_async_len - 1] == '\n') {
+        _async_len--;
+    }
+    _async_buffer[_async_len] = 0;
+
+    // Ready for the next command before the callback, which may send it.
+    // The lines stay in the buffer until more data is processed
+    Callback<void(int, const char *)> done = _async_done;
+    _async_done = Callback<void(int, const char *)>();
+    _async_line = 0;
+    _async_len = 0;
+    done(result, _async_buffer);
+}
+
+void ATCmdParser::async_timeout()
+{
+    if (_async_done) {
+        debug_if(_dbg_on, "AT(Timeout)\n");
+        _async_len = _async_line;
+        async_complete(AT_TIMEOUT);
+    }
+}
+
+bool ATCmdParser::vsend_async(Callback<void(int, const char *)> done,
+                              const char *command, va_list args)
+{
+    if (!_queue || _async_done) {
+        return false;
+    }
+
+    // Responses are collected from the start of the next line
+    _async_done = done;
+    if (!vsend(command, args)) {
+        _async_done = Callback<void(int, const char *)>();
+        return false;
+    }
+
+    _async_timeout_id = _queue->call_in(_timeout, this, &ATCmdParser::async_timeout);
+    return true;
+}
+
+bool ATCmdParser::send_async(Callback<void(int, const char *)> done,
+                             const char *command, ...)
+{
+    va_list args;
+    va_start(args, command);
+    bool res = vsend_async(done, command, args);
+    va_end(args);
+    return res;
+}
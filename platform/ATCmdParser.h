@@ -24,6 +24,14 @@
 #include <cstdarg>
 #include "Callback.h"
 
+namespace events {
+class EventQueue;
+}
+
+#ifndef MBED_CONF_PLATFORM_AT_CMD_PARSER_READ_SIZE
+#define MBED_CONF_PLATFORM_AT_CMD_PARSER_READ_SIZE 64
+#endif
+
 /**
  * Parser class for parsing AT commands
  *
@@ -41,6 +49,33 @@
  * at.read(buffer, value);
  * at.recv("OK");
  * @endcode
+ *
+ * With an event queue, commands are sent without blocking and received data
+ * is parsed as it arrives:
+ * @code
+ * EventQueue queue;
+ * ATCmdParser at = ATCmdParser(&serial, "\r\n");
+ *
+ * void on_ring() {
+ *     printf("ringing\n");
+ * }
+ *
+ * void on_csq(int result, const char *response) {
+ *     int rssi, ber;
+ *     if (result == ATCmdParser::AT_OK && sscanf(response, "+CSQ: %d,%d", &rssi, &ber) == 2) {
+ *         printf("rssi %d\n", rssi);
+ *     }
+ * }
+ *
+ * void query() {
+ *     at.send_async(on_csq, "AT+CSQ");
+ * }
+ *
+ * at.oob("RING", on_ring);
+ * at.set_event_queue(&queue);
+ * queue.call(query);
+ * queue.dispatch_forever();
+ * @endcode
  */
 
 namespace mbed {
@@ -71,7 +106,53 @@ private:
     };
     oob *_oobs;
 
+    // Trie of the oob prefixes, matched a character at a time
+    struct oob_node {
+        char c;
+        int16_t child;          // First node following this one, -1 if none
+        int16_t sibling;        // Next node with the same parent, -1 if none
+        struct oob *handler;    // oob whose prefix ends here, NULL if none
+    };
+    oob_node *_oob_trie;
+    int _oob_trie_size;
+
+    // Data read ahead from the file handle, a character at a time in
+    // blocking mode
+    char *_rx_buffer;
+    int _rx_start;
+    int _rx_end;
+
+    // Asynchronous mode
+    events::EventQueue *_queue;
+    volatile bool _process_pending;
+    int _process_id;
+    char *_async_buffer;
+    int _async_line;            // Start of the line being received
+    int _async_len;
+    int _async_node;
+    bool _async_skip;           // Rest of the line follows an oob prefix
+    int _async_timeout_id;
+    mbed::Callback<void(int, const char *)> _async_done;
+    const char *_ok_line;
+    const char *_error_line;
+
+    int fill(int timeout);
+    struct oob *oob_match(int *node, char c);
+    void sigio();
+    void process();
+    void process_char(char c);
+    void async_complete(int result);
+    void async_timeout();
+
 public:
+    /**
+     * Results of asynchronous commands
+     */
+    enum at_result {
+        AT_OK = 0,              /*!< response ended with the ok line */
+        AT_ERROR = -1,          /*!< response ended with an error line */
+        AT_TIMEOUT = -2,        /*!< no result line before the timeout */
+    };
 
     /**
      * Constructor
@@ -84,9 +165,13 @@ public:
      */
     ATCmdParser(FileHandle *fh, const char *output_delimiter = "\r",
              int buffer_size = 256, int timeout = 8000, bool debug = false)
-            : _fh(fh), _buffer_size(buffer_size), _in_prev(0), _oobs(NULL)
+            : _fh(fh), _buffer_size(buffer_size), _in_prev(0), _oobs(NULL),
+              _oob_trie(NULL), _oob_trie_size(0), _rx_start(0), _rx_end(0),
+              _queue(NULL), _process_pending(false), _async_buffer(NULL),
+              _ok_line("OK"), _error_line("ERROR")
     {
         _buffer = new char[buffer_size];
+        _rx_buffer = new char[MBED_CONF_PLATFORM_AT_CMD_PARSER_READ_SIZE];
         set_timeout(timeout);
         set_delimiter(output_delimiter);
         debug_on(debug);
@@ -97,11 +182,14 @@ public:
      */
     ~ATCmdParser()
     {
+        set_event_queue(NULL);
         while (_oobs) {
             struct oob *oob = _oobs;
             _oobs = oob->next;
             delete oob;
         }
+        delete[] _oob_trie;
+        delete[] _rx_buffer;
         delete[] _buffer;
     }
 
@@ -210,6 +298,58 @@ public:
 
     bool vrecv(const char *response, va_list args);
 
+    /**
+     * Process received data on an event queue instead of in recv()
+     *
+     * The file handle is set to non-blocking, and data is read in chunks as
+     * its sigio() callback signals it. Lines are matched against the oob
+     * prefixes and the response of the command sent by send_async(), and the
+     * callbacks are called on the event queue. recv(), read() and scanf()
+     * can still be called from these callbacks, e.g. to parse the data
+     * following an oob prefix.
+     *
+     * @param queue event queue to process data on, NULL to return to
+     *              blocking mode
+     */
+    void set_event_queue(events::EventQueue *queue);
+
+    /**
+     * Sends an AT command without waiting for its response
+     *
+     * The lines received after the command are collected until the ok line,
+     * or a line containing the error string, see set_result_lines(). The
+     * callback is then called on the event queue with the result and the
+     * lines, separated by newlines and including an error line. The lines
+     * are valid until the callback returns.
+     *
+     * Must be called in the context of the event queue, e.g. from a callback
+     * or an event. One command is in progress at a time.
+     *
+     * @param done called with the at_result and the lines received
+     * @param command printf-like format string of command to send which
+     *                is appended with a newline
+     * @param ... all printf-like arguments to insert into command
+     * @return true only if command is successfully sent, false if no event
+     *         queue is set or another command is in progress
+     */
+    bool send_async(mbed::Callback<void(int, const char *)> done,
+                    const char *command, ...) MBED_PRINTF_METHOD(2,3);
+
+    bool vsend_async(mbed::Callback<void(int, const char *)> done,
+                     const char *command, va_list args);
+
+    /**
+     * Sets the lines ending the response of an asynchronous command
+     * @param ok line ending a successful response, "OK" by default
+     * @param error string found in lines ending a failed response, "ERROR"
+     *              by default, which also matches "+CME ERROR: <err>"
+     */
+    void set_result_lines(const char *ok, const char *error)
+    {
+        _ok_line = ok;
+        _error_line = error;
+    }
+
     /**
      * Write a single byte to the underlying stream
      *
@@ -272,7 +412,8 @@ public:
      *
      * @param prefix string on when to initiate callback
      * @param func callback to call when string is read
-     * @note out-of-band data is only processed during a scanf call
+     * @note out-of-band data is only processed during a recv call, or as it
+     *       arrives when an event queue is set
      */
     void oob(const char *prefix, mbed::Callback<void()> func);
 
@@ -27,6 +27,8 @@ typedef int FILEHANDLE;
 namespace mbed {
 /** \addtogroup platform */
 
+struct poll_waiter;
+
 
 /** Class FileHandle
  *
@@ -40,6 +42,8 @@ namespace mbed {
  */
 class FileHandle : private NonCopyable<FileHandle> {
 public:
+    FileHandle() : _poll_waiters(NULL) {}
+
     virtual ~FileHandle() {}
 
     /** Read the contents of a file into a buffer
@@ -185,7 +189,8 @@ public:
      * The input parameter can be used or ignored - the could always return all events,
      * or could check just the events listed in events.
      * Call is non-blocking - returns instantaneous state of events.
-     * Whenever an event occurs, the derived class should call the sigio() callback).
+     * Whenever an event occurs, the derived class should call the sigio() callback
+     * and wake_pollers(), and return true from wakes_pollers().
      *
      * @param events        bitmask of poll events we're interested in - POLLIN/POLLOUT etc.
      *
@@ -240,6 +245,34 @@ public:
     {
         //Default for real files. Do nothing for real files.
     }
+
+    /** Check whether this file calls wake_pollers() on every state change
+     *
+     *  Files which don't are rescanned by mbed::poll() at the
+     *  platform.poll-rescan-interval while it waits.
+     *
+     *  @returns            true if wake_pollers() is called on state changes
+     */
+    virtual bool wakes_pollers() const
+    {
+        return false;
+    }
+
+protected:
+    /** Wake up the threads blocked in mbed::poll() on this file
+     *
+     *  Derived classes implementing poll() call this on state changes, at
+     *  the same points as they call the sigio() callback. Threads waiting in
+     *  mbed::poll() only recheck the files that woke them up.
+     *
+     *  Can be called from interrupt context.
+     */
+    void wake_pollers();
+
+private:
+    friend int poll(pollfh fhs[], unsigned nfhs, int timeout);
+
+    poll_waiter *_poll_waiters;
 };
 
 /** Not a member function
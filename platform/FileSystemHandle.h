@@ -47,7 +47,7 @@ public:
      *  @param file     Destination for the handle to a newly created file
      *  @param filename The name of the file to open
      *  @param flags    The flags to open the file in, one of O_RDONLY, O_WRONLY, O_RDWR,
-     *                  bitwise or'd with one of O_CREAT, O_TRUNC, O_APPEND
+     *                  bitwise or'd with one of O_CREAT, O_TRUNC, O_APPEND, O_DIRECT
      *  @return         0 on success, negative error code on failure
      */
     virtual int open(FileHandle **file, const char *filename, int flags) = 0;
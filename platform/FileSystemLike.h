@@ -50,7 +50,7 @@ public:
      *
      *  @param path     The name of the file to open
      *  @param flags    The flags to open the file in, one of O_RDONLY, O_WRONLY, O_RDWR,
-     *                  bitwise or'd with one of O_CREAT, O_TRUNC, O_APPEND
+     *                  bitwise or'd with one of O_CREAT, O_TRUNC, O_APPEND, O_DIRECT
      *  @return         A file handle on success, NULL on failure
      *  @deprecated Replaced by `int open(FileHandle **, ...)` for propagating error codes
      */
@@ -0,0 +1,487 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MBED_LOCKFREERINGBUFFER_H
+#define MBED_LOCKFREERINGBUFFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "platform/mbed_critical.h"
+#include "platform/mbed_assert.h"
+#include "platform/NonCopyable.h"
+
+namespace mbed {
+/** \addtogroup platform */
+
+/** Contiguous range of elements of a ring buffer
+ *
+ *  Spans are returned by the zero-copy operations of SPSCRingBuffer and
+ *  MPSCRingBuffer. They give direct access to the storage of the buffer.
+ *
+ *  @ingroup platform
+ */
+template<typename T>
+struct RingBufferSpan {
+    T *data;            /**< First element of the span, NULL if the span is empty */
+    uint32_t size;      /**< Number of elements in the span */
+};
+
+/** Lock-free single producer, single consumer ring buffer
+ *
+ *  Unlike CircularBuffer, this class never disables interrupts: the producer
+ *  only writes the head index and the consumer only writes the tail index,
+ *  both are published with the atomic operations of mbed_critical.h.
+ *  A typical use is an interrupt handler feeding a thread, or the reverse.
+ *
+ *  When the buffer is full, push operations fail instead of overwriting the
+ *  oldest element.
+ *
+ *  @note Synchronization level: Interrupt safe for one producer and one
+ *  consumer. Producer operations (push, reserve, commit) must not be called
+ *  concurrently from several contexts, and neither must consumer operations
+ *  (pop, peek, consume).
+ *  @ingroup platform
+ */
+template<typename T, uint32_t BufferSize>
+class SPSCRingBuffer : private NonCopyable<SPSCRingBuffer<T, BufferSize> > {
+    MBED_STATIC_ASSERT(BufferSize > 0 && BufferSize < 0x80000000,
+        "SPSCRingBuffer size must be in the range [1, 2^31)");
+
+public:
+    SPSCRingBuffer() : _head(0), _tail(0) {
+    }
+
+    /** Push an element into the buffer
+     *
+     *  @param data Element to be pushed to the buffer
+     *  @return True if the element was pushed, false if the buffer is full
+     */
+    bool push(const T &data) {
+        return push(&data, 1) == 1;
+    }
+
+    /** Push several elements into the buffer
+     *
+     *  @param data Elements to be pushed to the buffer
+     *  @param size Number of elements to push
+     *  @return Number of elements pushed, less than size if the buffer is full
+     */
+    uint32_t push(const T *data, uint32_t size) {
+        uint32_t pushed = 0;
+        while (pushed < size) {
+            RingBufferSpan<T> span = reserve(size - pushed);
+            if (!span.size) {
+                break;
+            }
+
+            for (uint32_t i = 0; i < span.size; i++) {
+                span.data[i] = data[pushed + i];
+            }
+
+            commit(span);
+            pushed += span.size;
+        }
+
+        return pushed;
+    }
+
+    /** Pop an element from the buffer
+     *
+     *  @param data Element popped from the buffer
+     *  @return True if the buffer is not empty and data contains an element,
+     *          false otherwise
+     */
+    bool pop(T &data) {
+        return pop(&data, 1) == 1;
+    }
+
+    /** Pop several elements from the buffer
+     *
+     *  @param data Buffer receiving the elements
+     *  @param size Maximum number of elements to pop
+     *  @return Number of elements popped
+     */
+    uint32_t pop(T *data, uint32_t size) {
+        uint32_t popped = 0;
+        while (popped < size) {
+            RingBufferSpan<T> span = peek(size - popped);
+            if (!span.size) {
+                break;
+            }
+
+            for (uint32_t i = 0; i < span.size; i++) {
+                data[popped + i] = span.data[i];
+            }
+
+            consume(span.size);
+            popped += span.size;
+        }
+
+        return popped;
+    }
+
+    /** Reserve contiguous free space at the head of the buffer
+     *
+     *  The elements of the span can be written in place and are made visible
+     *  to the consumer by commit(). The span may be shorter than requested if
+     *  the buffer is nearly full or the free space wraps around.
+     *
+     *  @param size Maximum number of elements to reserve
+     *  @return Span of reserved elements, empty if the buffer is full
+     */
+    RingBufferSpan<T> reserve(uint32_t size) {
+        uint32_t head = _head;
+        uint32_t used = distance(core_util_atomic_load_u32(&_tail), head);
+        uint32_t index = slot(head);
+
+        RingBufferSpan<T> span = { NULL, 0 };
+        span.size = min(size, min(BufferSize - used, BufferSize - index));
+        if (span.size) {
+            span.data = &_pool[index];
+        }
+        return span;
+    }
+
+    /** Publish elements previously reserved
+     *
+     *  The size of the span may be reduced before committing it, elements
+     *  beyond it are left free.
+     *
+     *  @param span Span returned by reserve()
+     */
+    void commit(const RingBufferSpan<T> &span) {
+        core_util_atomic_store_u32(&_head, advance(_head, span.size));
+    }
+
+    /** Access contiguous elements at the tail of the buffer without copying
+     *
+     *  The span may be shorter than the number of elements in the buffer if
+     *  they wrap around. Elements are released with consume().
+     *
+     *  @param size Maximum number of elements to access
+     *  @return Span of readable elements, empty if the buffer is empty
+     */
+    RingBufferSpan<T> peek(uint32_t size = BufferSize) {
+        uint32_t tail = _tail;
+        uint32_t used = distance(tail, core_util_atomic_load_u32(&_head));
+        uint32_t index = slot(tail);
+
+        RingBufferSpan<T> span = { NULL, 0 };
+        span.size = min(size, min(used, BufferSize - index));
+        if (span.size) {
+            span.data = &_pool[index];
+        }
+        return span;
+    }
+
+    /** Release elements at the tail of the buffer
+     *
+     *  @param size Number of elements to release, must not exceed the size of
+     *              the span returned by peek()
+     */
+    void consume(uint32_t size) {
+        core_util_atomic_store_u32(&_tail, advance(_tail, size));
+    }
+
+    /** Check if the buffer is empty
+     *
+     *  @return True if the buffer is empty, false if not
+     */
+    bool empty() const {
+        return size() == 0;
+    }
+
+    /** Check if the buffer is full
+     *
+     *  @return True if the buffer is full, false if not
+     */
+    bool full() const {
+        return size() == BufferSize;
+    }
+
+    /** Get the number of elements in the buffer
+     *
+     *  @return Number of elements in the buffer
+     */
+    uint32_t size() const {
+        uint32_t tail = core_util_atomic_load_u32(&_tail);
+        return distance(tail, core_util_atomic_load_u32(&_head));
+    }
+
+    /** Reset the buffer
+     *
+     *  @note Neither the producer nor the consumer may use the buffer
+     *  concurrently.
+     */
+    void reset() {
+        core_util_atomic_store_u32(&_head, 0);
+        core_util_atomic_store_u32(&_tail, 0);
+    }
+
+private:
+    // Indexes run over twice the buffer size to tell a full buffer from an
+    // empty one without requiring a power of two size.
+    static uint32_t min(uint32_t a, uint32_t b) {
+        return a < b ? a : b;
+    }
+
+    static uint32_t slot(uint32_t index) {
+        return index >= BufferSize ? index - BufferSize : index;
+    }
+
+    static uint32_t advance(uint32_t index, uint32_t count) {
+        index += count;
+        return index >= 2 * BufferSize ? index - 2 * BufferSize : index;
+    }
+
+    static uint32_t distance(uint32_t tail, uint32_t head) {
+        return head >= tail ? head - tail : head + 2 * BufferSize - tail;
+    }
+
+    T _pool[BufferSize];
+    volatile uint32_t _head;
+    volatile uint32_t _tail;
+};
+
+/** Lock-free multiple producer, single consumer ring buffer
+ *
+ *  Producers claim space by atomically advancing a reservation index with
+ *  core_util_atomic_cas_u32(), fill it, then mark each element ready. The
+ *  consumer only reads elements which are ready, in order, so a producer
+ *  interrupted between reservation and commit delays the consumer but never
+ *  blocks the other producers. This makes the buffer suitable for many
+ *  threads and interrupt handlers feeding a single thread, such as a logger.
+ *
+ *  Each element carries a one byte ready flag.
+ *
+ *  @note Synchronization level: Interrupt safe for any number of producers
+ *  and one consumer. Consumer operations (pop, peek, consume) must not be
+ *  called concurrently from several contexts.
+ *  @ingroup platform
+ */
+template<typename T, uint32_t BufferSize>
+class MPSCRingBuffer : private NonCopyable<MPSCRingBuffer<T, BufferSize> > {
+    MBED_STATIC_ASSERT(BufferSize > 0 && (BufferSize & (BufferSize - 1)) == 0,
+        "MPSCRingBuffer size must be a power of two");
+
+public:
+    MPSCRingBuffer() : _head(0), _tail(0) {
+        for (uint32_t i = 0; i < BufferSize; i++) {
+            _ready[i] = 0;
+        }
+    }
+
+    /** Push an element into the buffer
+     *
+     *  @param data Element to be pushed to the buffer
+     *  @return True if the element was pushed, false if the buffer is full
+     */
+    bool push(const T &data) {
+        return push(&data, 1) == 1;
+    }
+
+    /** Push several elements into the buffer
+     *
+     *  Elements pushed by a single call are contiguous in the buffer, unless
+     *  they wrap around its end.
+     *
+     *  @param data Elements to be pushed to the buffer
+     *  @param size Number of elements to push
+     *  @return Number of elements pushed, less than size if the buffer is full
+     */
+    uint32_t push(const T *data, uint32_t size) {
+        uint32_t pushed = 0;
+        while (pushed < size) {
+            RingBufferSpan<T> span = reserve(size - pushed);
+            if (!span.size) {
+                break;
+            }
+
+            for (uint32_t i = 0; i < span.size; i++) {
+                span.data[i] = data[pushed + i];
+            }
+
+            commit(span);
+            pushed += span.size;
+        }
+
+        return pushed;
+    }
+
+    /** Pop an element from the buffer
+     *
+     *  @param data Element popped from the buffer
+     *  @return True if an element was ready and data contains it, false
+     *          otherwise
+     */
+    bool pop(T &data) {
+        return pop(&data, 1) == 1;
+    }
+
+    /** Pop several elements from the buffer
+     *
+     *  @param data Buffer receiving the elements
+     *  @param size Maximum number of elements to pop
+     *  @return Number of elements popped
+     */
+    uint32_t pop(T *data, uint32_t size) {
+        uint32_t popped = 0;
+        while (popped < size) {
+            RingBufferSpan<T> span = peek(size - popped);
+            if (!span.size) {
+                break;
+            }
+
+            for (uint32_t i = 0; i < span.size; i++) {
+                data[popped + i] = span.data[i];
+            }
+
+            consume(span.size);
+            popped += span.size;
+        }
+
+        return popped;
+    }
+
+    /** Reserve contiguous free space at the head of the buffer
+     *
+     *  The elements of the span can be written in place and are made visible
+     *  to the consumer by commit(). The span may be shorter than requested if
+     *  the buffer is nearly full or the free space wraps around.
+     *
+     *  @note The whole span must be committed, the consumer stops at the first
+     *  element which is not.
+     *
+     *  @param size Maximum number of elements to reserve
+     *  @return Span of reserved elements, empty if the buffer is full
+     */
+    RingBufferSpan<T> reserve(uint32_t size) {
+        RingBufferSpan<T> span = { NULL, 0 };
+        uint32_t head = core_util_atomic_load_u32(&_head);
+        uint32_t count;
+        do {
+            uint32_t used = head - core_util_atomic_load_u32(&_tail);
+            uint32_t index = head & (BufferSize - 1);
+            count = min(size, min(BufferSize - used, BufferSize - index));
+            if (!count) {
+                return span;
+            }
+        } while (!core_util_atomic_cas_u32((uint32_t *)&_head, &head, head + count));
+
+        span.data = &_pool[head & (BufferSize - 1)];
+        span.size = count;
+        return span;
+    }
+
+    /** Publish elements previously reserved
+     *
+     *  @param span Span returned by reserve()
+     */
+    void commit(const RingBufferSpan<T> &span) {
+        uint32_t index = span.data - _pool;
+        for (uint32_t i = 0; i < span.size; i++) {
+            core_util_atomic_store_u8(&_ready[index + i], 1);
+        }
+    }
+
+    /** Access contiguous ready elements at the tail of the buffer without
+     *  copying
+     *
+     *  The span stops at the first element not yet committed by its producer
+     *  or at the end of the storage. Elements are released with consume().
+     *
+     *  @param size Maximum number of elements to access
+     *  @return Span of readable elements, empty if no element is ready
+     */
+    RingBufferSpan<T> peek(uint32_t size = BufferSize) {
+        uint32_t index = _tail & (BufferSize - 1);
+        uint32_t limit = min(size, BufferSize - index);
+
+        RingBufferSpan<T> span = { NULL, 0 };
+        while (span.size < limit && core_util_atomic_load_u8(&_ready[index + span.size])) {
+            span.size++;
+        }
+        if (span.size) {
+            span.data = &_pool[index];
+        }
+        return span;
+    }
+
+    /** Release elements at the tail of the buffer
+     *
+     *  @param size Number of elements to release, must not exceed the size of
+     *              the span returned by peek()
+     */
+    void consume(uint32_t size) {
+        uint32_t tail = _tail;
+        for (uint32_t i = 0; i < size; i++) {
+            _ready[(tail + i) & (BufferSize - 1)] = 0;
+        }
+        core_util_atomic_store_u32(&_tail, tail + size);
+    }
+
+    /** Check if the buffer has no element ready to be popped
+     *
+     *  @return True if no element is ready, false if not
+     */
+    bool empty() const {
+        return !core_util_atomic_load_u8(&_ready[_tail & (BufferSize - 1)]);
+    }
+
+    /** Check if the buffer is full
+     *
+     *  @return True if no space can be reserved, false if not
+     */
+    bool full() const {
+        return size() == BufferSize;
+    }
+
+    /** Get the number of elements in the buffer
+     *
+     *  @return Number of elements reserved and not yet consumed, including
+     *          the ones not committed yet
+     */
+    uint32_t size() const {
+        uint32_t tail = core_util_atomic_load_u32(&_tail);
+        return core_util_atomic_load_u32(&_head) - tail;
+    }
+
+    /** Reset the buffer
+     *
+     *  @note Neither the producers nor the consumer may use the buffer
+     *  concurrently.
+     */
+    void reset() {
+        for (uint32_t i = 0; i < BufferSize; i++) {
+            _ready[i] = 0;
+        }
+        core_util_atomic_store_u32(&_head, 0);
+        core_util_atomic_store_u32(&_tail, 0);
+    }
+
+private:
+    static uint32_t min(uint32_t a, uint32_t b) {
+        return a < b ? a : b;
+    }
+
+    T _pool[BufferSize];
+    volatile uint8_t _ready[BufferSize];
+    volatile uint32_t _head;
+    volatile uint32_t _tail;
+};
+
+}
+
+#endif
@@ -0,0 +1,372 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MBED_STATICCALLCHAIN_H
+#define MBED_STATICCALLCHAIN_H
+
+#include <stdint.h>
+#include "platform/Callback.h"
+#include "platform/CallChain.h"
+#include "platform/mbed_critical.h"
+#include "platform/mbed_assert.h"
+#include "platform/mbed_toolchain.h"
+#include "platform/NonCopyable.h"
+
+namespace mbed {
+/** \addtogroup platform */
+
+/** Fixed capacity CallChain
+ *
+ *  Same interface as CallChain, but the functions are stored in an array
+ *  inside the object rather than in a heap allocated list: adding a function
+ *  never allocates, and fails instead when the chain is full. Functions are
+ *  kept in order by index links next to the array, so the handle returned by
+ *  add() and add_front() is removed in constant time.
+ *
+ *  call() may run in an interrupt handler while functions are added or
+ *  removed from a thread or another interrupt handler:
+ *  - add(), add_front(), remove() and clear() mask interrupts for a constant
+ *    time (clear() for a time linear in the capacity). call() only masks
+ *    interrupts to free the slots of functions removed while it ran.
+ *  - A function removed while call() runs, including by itself, is not
+ *    called afterwards. Its slot is only reused once no call() is running,
+ *    so a running call() never follows a link into a reused slot.
+ *  - A function added while call() runs may or may not be called by it.
+ *
+ *  @note Synchronization level: Interrupt safe
+ *
+ *  Example:
+ *  @code
+ *  #include "mbed.h"
+ *
+ *  StaticCallChain<4> chain;
+ *
+ *  void first(void) {
+ *      printf("'first' function.\n");
+ *  }
+ *
+ *  void second(void) {
+ *      printf("'second' function.\n");
+ *  }
+ *
+ *  int main() {
+ *      pFunctionPointer_t handle = chain.add(second);
+ *      chain.add_front(first);
+ *      chain.call();
+ *      chain.remove(handle);
+ *  }
+ *  @endcode
+ *  @ingroup platform
+ */
+template<uint32_t Capacity>
+class StaticCallChain : private NonCopyable<StaticCallChain<Capacity> > {
+    MBED_STATIC_ASSERT(Capacity > 0 && Capacity < 255,
+        "StaticCallChain capacity must be in the range [1, 254]");
+
+public:
+    /** Create an empty chain
+     */
+    StaticCallChain() : _head(NONE), _tail(NONE), _free(0), _calling(0), _pending(false) {
+        for (uint32_t i = 0; i < Capacity; i++) {
+            _next[i] = (i + 1 < Capacity) ? i + 1 : NONE;
+            _state[i] = FREE;
+        }
+    }
+
+    /** Add a function at the end of the chain
+     *
+     *  @param func A pointer to a void function
+     *
+     *  @returns
+     *  The function object created for 'func', NULL if the chain is full
+     */
+    pFunctionPointer_t add(Callback<void()> func) {
+        return insert(func, false);
+    }
+
+    /** Add a function at the end of the chain
+     *
+     *  @param obj pointer to the object to call the member function on
+     *  @param method pointer to the member function to be called
+     *
+     *  @returns
+     *  The function object created for 'obj' and 'method', NULL if the
+     *  chain is full
+     *
+     *  @deprecated
+     *  The add function does not support cv-qualifiers. Replaced by
+     *  add(callback(obj, method)).
+     */
+    template<typename T, typename M>
+    MBED_DEPRECATED_SINCE("mbed-os-5.1",
+        "The add function does not support cv-qualifiers. Replaced by "
+        "add(callback(obj, method)).")
+    pFunctionPointer_t add(T *obj, M method) {
+        return add(callback(obj, method));
+    }
+
+    /** Add a function at the beginning of the chain
+     *
+     *  @param func A pointer to a void function
+     *
+     *  @returns
+     *  The function object created for 'func', NULL if the chain is full
+     */
+    pFunctionPointer_t add_front(Callback<void()> func) {
+        return insert(func, true);
+    }
+
+    /** Add a function at the beginning of the chain
+     *
+     *  @param obj pointer to the object to call the member function on
+     *  @param method pointer to the member function to be called
+     *
+     *  @returns
+     *  The function object created for 'obj' and 'method', NULL if the
+     *  chain is full
+     *
+     *  @deprecated
+     *  The add_front function does not support cv-qualifiers. Replaced by
+     *  add_front(callback(obj, method)).
+     */
+    template<typename T, typename M>
+    MBED_DEPRECATED_SINCE("mbed-os-5.1",
+        "The add_front function does not support cv-qualifiers. Replaced by "
+        "add_front(callback(obj, method)).")
+    pFunctionPointer_t add_front(T *obj, M method) {
+        return add_front(callback(obj, method));
+    }
+
+    /** Get the number of functions in the chain
+     */
+    int size() const {
+        int elements = 0;
+        for (uint8_t i = _head; i != NONE; i = _next[i]) {
+            if (_state[i] == LINKED) {
+                elements++;
+            }
+        }
+        return elements;
+    }
+
+    /** Get the maximum number of functions in the chain
+     */
+    static int capacity() {
+        return Capacity;
+    }
+
+    /** Get a function object from the chain
+     *
+     *  @param idx function object index
+     *
+     *  @returns
+     *  The function object at position 'idx' in the chain, NULL if the
+     *  chain is shorter
+     */
+    pFunctionPointer_t get(int idx) const {
+        for (uint8_t i = _head; i != NONE; i = _next[i]) {
+            if (_state[i] == LINKED && idx-- == 0) {
+                return const_cast<pFunctionPointer_t>(&_callbacks[i]);
+            }
+        }
+        return NULL;
+    }
+
+    /** Look for a function object in the call chain
+     *
+     *  @param f the function object to search
+     *
+     *  @returns
+     *  The index of the function object if found, -1 otherwise.
+     */
+    int find(pFunctionPointer_t f) const {
+        int idx = 0;
+        for (uint8_t i = _head; i != NONE; i = _next[i]) {
+            if (_state[i] == LINKED) {
+                if (f == &_callbacks[i]) {
+                    return idx;
+                }
+                idx++;
+            }
+        }
+        return -1;
+    }
+
+    /** Clear the call chain (remove all functions in the chain).
+     */
+    void clear() {
+        core_util_critical_section_enter();
+        for (uint8_t i = _head; i != NONE; i = _next[i]) {
+            if (_state[i] == LINKED) {
+                _state[i] = REMOVED;
+                _pending = true;
+            }
+        }
+        if (!_calling) {
+            sweep();
+        }
+        core_util_critical_section_exit();
+    }
+
+    /** Remove a function object from the chain
+     *
+     *  @param f the function object to remove
+     *
+     *  @returns
+     *  true if the function object was found and removed, false otherwise.
+     */
+    bool remove(pFunctionPointer_t f) {
+        // The handle points into the array, which gives its slot
+        if (f < &_callbacks[0] || f >= &_callbacks[Capacity]) {
+            return false;
+        }
+        uint8_t i = f - &_callbacks[0];
+
+        core_util_critical_section_enter();
+        if (_state[i] != LINKED) {
+            core_util_critical_section_exit();
+            return false;
+        }
+
+        if (_calling) {
+            _state[i] = REMOVED;
+            _pending = true;
+        } else {
+            unlink(i);
+        }
+        core_util_critical_section_exit();
+        return true;
+    }
+
+    /** Call all the functions in the chain in sequence
+     */
+    void call() {
+        // Links are only changed with interrupts masked, and slots of
+        // removed functions stay linked until no call is running
+        core_util_atomic_incr_u8(&_calling, 1);
+        uint8_t i = _head;
+        while (i != NONE) {
+            if (_state[i] == LINKED) {
+                _callbacks[i].call();
+            }
+            i = _next[i];
+        }
+
+        if (core_util_atomic_decr_u8(&_calling, 1) == 0 && _pending) {
+            core_util_critical_section_enter();
+            if (!_calling && _pending) {
+                sweep();
+            }
+            core_util_critical_section_exit();
+        }
+    }
+
+    void operator ()(void) {
+        call();
+    }
+
+    pFunctionPointer_t operator [](int i) const {
+        return get(i);
+    }
+
+private:
+    static const uint8_t NONE = 0xff;
+
+    enum {
+        FREE,
+        LINKED,
+        REMOVED,        // Still linked, unlinked once no call is running
+    };
+
+    pFunctionPointer_t insert(Callback<void()> &func, bool front) {
+        core_util_critical_section_enter();
+        uint8_t i = _free;
+        if (i == NONE) {
+            core_util_critical_section_exit();
+            return NULL;
+        }
+        _free = _next[i];
+
+        _callbacks[i] = func;
+        _state[i] = LINKED;
+        if (front) {
+            _prev[i] = NONE;
+            _next[i] = _head;
+            if (_head != NONE) {
+                _prev[_head] = i;
+            } else {
+                _tail = i;
+            }
+            _head = i;
+        } else {
+            _prev[i] = _tail;
+            _next[i] = NONE;
+            if (_tail != NONE) {
+                _next[_tail] = i;
+            } else {
+                _head = i;
+            }
+            _tail = i;
+        }
+        core_util_critical_section_exit();
+        return &_callbacks[i];
+    }
+
+    // Called with interrupts masked
+    void unlink(uint8_t i) {
+        if (_prev[i] != NONE) {
+            _next[_prev[i]] = _next[i];
+        } else {
+            _head = _next[i];
+        }
+        if (_next[i] != NONE) {
+            _prev[_next[i]] = _prev[i];
+        } else {
+            _tail = _prev[i];
+        }
+
+        _callbacks[i] = Callback<void()>();
+        _state[i] = FREE;
+        _next[i] = _free;
+        _free = i;
+    }
+
+    // Called with interrupts masked and no call running
+    void sweep() {
+        uint8_t i = _head;
+        while (i != NONE) {
+            uint8_t next = _next[i];
+            if (_state[i] == REMOVED) {
+                unlink(i);
+            }
+            i = next;
+        }
+        _pending = false;
+    }
+
+    Callback<void()> _callbacks[Capacity];
+    volatile uint8_t _next[Capacity];
+    uint8_t _prev[Capacity];
+    volatile uint8_t _state[Capacity];
+    volatile uint8_t _head;
+    uint8_t _tail;
+    uint8_t _free;
+    uint8_t _calling;
+    volatile bool _pending;
+};
+
+} // namespace mbed
+
+#endif
@@ -19,6 +19,8 @@
 #include "platform/mbed_toolchain.h"
 #include "platform/SingletonPtr.h"
 #include "platform/PlatformMutex.h"
+#include "platform/mbed_critical.h"
+#include "platform/mbed_assert.h"
 #include <stddef.h>
 #include <stdio.h>
 #include <string.h>
@@ -30,7 +32,8 @@
   activated by defining the MBED_HEAP_STATS_ENABLED macro.
 - the second can be used to trace each memory call by automatically invoking
   a callback on each memory operation (see hal/api/mbed_mem_trace.h). It is
-  activated by defining the MBED_MEM_TRACING_ENABLED macro.
+  activated by defining the MBED_MEM_TRACING_ENABLED macro. The callback in
+  platform/mbed_mem_profile.h aggregates the operations by caller.
 
 Both tracers can be activated and deactivated in any combination. If both tracers
 are active, the second one (MBED_MEM_TRACING_ENABLED) will trace the first one's
@@ -43,7 +46,7 @@ are active, the second one (MBED_MEM_TRACING_ENABLED) will trace the first one's
 /* Size must be a multiple of 8 to keep alignment */
 typedef struct {
     uint32_t size;
-    uint32_t pad;
+    uint32_t owner;             // Thread slot accounted, with ARENA_BLOCK if from its arena
 } alloc_info_t;
 
 #ifdef MBED_MEM_TRACING_ENABLED
@@ -54,20 +57,249 @@ static SingletonPtr<PlatformMutex> malloc_stats_mutex;
 static mbed_stats_heap_t heap_stats = {0, 0, 0, 0, 0};
 #endif
 
+#ifndef MBED_CONF_PLATFORM_HEAP_STATS_THREADS
+#define MBED_CONF_PLATFORM_HEAP_STATS_THREADS       0
+#endif
+#ifndef MBED_CONF_PLATFORM_HEAP_ARENA_SIZE
+#define MBED_CONF_PLATFORM_HEAP_ARENA_SIZE          0
+#endif
+#ifndef MBED_CONF_PLATFORM_HEAP_ARENA_BLOCK_SIZE
+#define MBED_CONF_PLATFORM_HEAP_ARENA_BLOCK_SIZE    32
+#endif
+
+/* Allocations are accounted to the thread making them, and the small ones
+ * served from an arena of that thread without taking the heap lock */
+#if defined(MBED_HEAP_STATS_ENABLED) && MBED_CONF_RTOS_PRESENT && MBED_CONF_PLATFORM_HEAP_STATS_THREADS > 0
+#define HEAP_THREADS    MBED_CONF_PLATFORM_HEAP_STATS_THREADS
+#if MBED_CONF_PLATFORM_HEAP_ARENA_SIZE > 0
+#define HEAP_ARENAS
+#endif
+#endif
+
+#ifdef MBED_HEAP_STATS_ENABLED
+#ifdef HEAP_THREADS
+#include "cmsis_os2.h"
+
+/* Slot of the interrupts and of the threads that do not fit */
+#define OTHER_THREADS   HEAP_THREADS
+
+#define ARENA_BLOCK     0x80000000
+#define ARENA_STRIDE    (sizeof(alloc_info_t) + ((MBED_CONF_PLATFORM_HEAP_ARENA_BLOCK_SIZE + 7) & ~7))
+
+MBED_STATIC_ASSERT(MBED_CONF_PLATFORM_HEAP_ARENA_BLOCK_SIZE >= sizeof(void *),
+    "heap-arena-block-size must fit a pointer");
+
+typedef struct {
+    osThreadId_t id;
+    mbed_stats_heap_t stats;
+#ifdef HEAP_ARENAS
+    alloc_info_t *arena_free;   // Blocks freed, linked through their data
+    uint32_t arena_top;         // Offset of the blocks never allocated
+#endif
+} heap_thread_t;
+
+static heap_thread_t heap_threads[HEAP_THREADS + 1];
+#ifdef HEAP_ARENAS
+static uint64_t heap_arenas[HEAP_THREADS][MBED_CONF_PLATFORM_HEAP_ARENA_SIZE / sizeof(uint64_t)];
+#endif
+
+static bool heap_thread_terminated(osThreadId_t id)
+{
+    osThreadState_t state = osThreadGetState(id);
+    return state == osThreadTerminated || state == osThreadInactive || state == osThreadError;
+}
+
+static uint32_t heap_thread_owner()
+{
+    osThreadId_t id = osThreadGetId();
+    if (id == NULL) {
+        return OTHER_THREADS;
+    }
+
+    for (uint32_t i = 0; i < HEAP_THREADS; i++) {
+        if (heap_threads[i].id == id) {
+            return i;
+        }
+    }
+
+    // First allocation of this thread, slots are only taken with the heap
+    // lock. Terminated threads which leaked memory keep their slot
+    uint32_t owner = OTHER_THREADS;
+    malloc_stats_mutex->lock();
+    for (uint32_t i = 0; i < HEAP_THREADS && owner == OTHER_THREADS; i++) {
+        if (heap_threads[i].id == id) {
+            owner = i;
+        } else if (heap_threads[i].id == NULL || heap_thread_terminated(heap_threads[i].id)) {
+            core_util_critical_section_enter();
+            if (heap_threads[i].stats.alloc_cnt == 0) {
+                memset(&heap_threads[i], 0, sizeof(heap_thread_t));
+                heap_threads[i].id = id;
+#ifdef HEAP_ARENAS
+                heap_threads[i].stats.reserved_size = MBED_CONF_PLATFORM_HEAP_ARENA_SIZE;
+#endif
+                owner = i;
+            }
+            core_util_critical_section_exit();
+        }
+    }
+    malloc_stats_mutex->unlock();
+    return owner;
+}
+#else
+static uint32_t heap_thread_owner()
+{
+    return 0;
+}
+#endif
+
+/* Statistics are updated with interrupts disabled, as allocations from the
+ * arenas do not take the heap lock */
+static void heap_stats_alloc(alloc_info_t *alloc_info, uint32_t size, uint32_t owner)
+{
+    core_util_critical_section_enter();
+    if (alloc_info != NULL) {
+        alloc_info->size = size;
+        alloc_info->owner = owner;
+    }
+
+    mbed_stats_heap_t *stats[] = {
+        &heap_stats,
+#ifdef HEAP_THREADS
+        &heap_threads[owner & ~ARENA_BLOCK].stats,
+#endif
+    };
+    for (uint32_t i = 0; i < sizeof(stats) / sizeof(stats[0]); i++) {
+        if (alloc_info != NULL) {
+            stats[i]->current_size += size;
+            stats[i]->total_size += size;
+            stats[i]->alloc_cnt += 1;
+            if (stats[i]->current_size > stats[i]->max_size) {
+                stats[i]->max_size = stats[i]->current_size;
+            }
+        } else {
+            stats[i]->alloc_fail_cnt += 1;
+        }
+    }
+    core_util_critical_section_exit();
+}
+
+static void heap_stats_free(alloc_info_t *alloc_info)
+{
+    core_util_critical_section_enter();
+    mbed_stats_heap_t *stats[] = {
+        &heap_stats,
+#ifdef HEAP_THREADS
+        &heap_threads[alloc_info->owner & ~ARENA_BLOCK].stats,
+#endif
+    };
+    for (uint32_t i = 0; i < sizeof(stats) / sizeof(stats[0]); i++) {
+        stats[i]->current_size -= alloc_info->size;
+        stats[i]->alloc_cnt -= 1;
+    }
+    core_util_critical_section_exit();
+}
+
+#ifdef HEAP_ARENAS
+static alloc_info_t *heap_arena_alloc(size_t size, uint32_t owner)
+{
+    if (size > MBED_CONF_PLATFORM_HEAP_ARENA_BLOCK_SIZE || owner == OTHER_THREADS) {
+        return NULL;
+    }
+
+    // Only the owner takes blocks, but any thread may free them
+    heap_thread_t *thread = &heap_threads[owner];
+    core_util_critical_section_enter();
+    alloc_info_t *alloc_info = thread->arena_free;
+    if (alloc_info != NULL) {
+        thread->arena_free = *(alloc_info_t **)(alloc_info + 1);
+    } else if (thread->arena_top + ARENA_STRIDE <= MBED_CONF_PLATFORM_HEAP_ARENA_SIZE) {
+        alloc_info = (alloc_info_t *)((char *)heap_arenas[owner] + thread->arena_top);
+        thread->arena_top += ARENA_STRIDE;
+    }
+    core_util_critical_section_exit();
+
+    if (alloc_info != NULL) {
+        heap_stats_alloc(alloc_info, size, owner | ARENA_BLOCK);
+    }
+    return alloc_info;
+}
+
+static bool heap_arena_free(alloc_info_t *alloc_info)
+{
+    if (!(alloc_info->owner & ARENA_BLOCK)) {
+        return false;
+    }
+
+    heap_thread_t *thread = &heap_threads[alloc_info->owner & ~ARENA_BLOCK];
+    heap_stats_free(alloc_info);
+    core_util_critical_section_enter();
+    *(alloc_info_t **)(alloc_info + 1) = thread->arena_free;
+    thread->arena_free = alloc_info;
+    core_util_critical_section_exit();
+    return true;
+}
+#else
+static alloc_info_t *heap_arena_alloc(size_t size, uint32_t owner)
+{
+    return NULL;
+}
+
+static bool heap_arena_free(alloc_info_t *alloc_info)
+{
+    return false;
+}
+#endif
+#endif // #ifdef MBED_HEAP_STATS_ENABLED
+
 void mbed_stats_heap_get(mbed_stats_heap_t *stats)
 {
 #ifdef MBED_HEAP_STATS_ENABLED
     extern uint32_t mbed_heap_size;
     heap_stats.reserved_size = mbed_heap_size;
 
-    malloc_stats_mutex->lock();
+    core_util_critical_section_enter();
     memcpy(stats, &heap_stats, sizeof(mbed_stats_heap_t));
-    malloc_stats_mutex->unlock();
+    core_util_critical_section_exit();
 #else
     memset(stats, 0, sizeof(mbed_stats_heap_t));
 #endif
 }
 
+int mbed_stats_heap_get_thread(uint32_t thread_id, mbed_stats_heap_t *stats)
+{
+#ifdef HEAP_THREADS
+    // Id 0 is the slot shared by interrupts and the threads which didn't get
+    // their own, unused slots before it have a NULL id as well
+    for (uint32_t i = thread_id ? 0 : OTHER_THREADS; i <= HEAP_THREADS; i++) {
+        if ((uint32_t)(uintptr_t)heap_threads[i].id == thread_id) {
+            core_util_critical_section_enter();
+            memcpy(stats, &heap_threads[i].stats, sizeof(mbed_stats_heap_t));
+            core_util_critical_section_exit();
+            return 0;
+        }
+    }
+#endif
+    memset(stats, 0, sizeof(mbed_stats_heap_t));
+    return -1;
+}
+
+size_t mbed_stats_heap_get_each(mbed_stats_heap_thread_t *stats, size_t count)
+{
+    size_t filled = 0;
+#ifdef HEAP_THREADS
+    for (uint32_t i = 0; i <= HEAP_THREADS && filled < count; i++) {
+        core_util_critical_section_enter();
+        if (heap_threads[i].stats.total_size || heap_threads[i].stats.alloc_fail_cnt) {
+            stats[filled].thread_id = (uint32_t)(uintptr_t)heap_threads[i].id;
+            memcpy(&stats[filled].heap, &heap_threads[i].stats, sizeof(mbed_stats_heap_t));
+            filled++;
+        }
+        core_util_critical_section_exit();
+    }
+#endif
+    return filled;
+}
+
 /******************************************************************************/
 /* GCC memory allocation wrappers                                             */
 /******************************************************************************/
@@ -92,21 +324,17 @@ extern "C" {
 extern "C" void * __wrap__malloc_r(struct _reent * r, size_t size) {
     void *ptr = NULL;
 #ifdef MBED_HEAP_STATS_ENABLED
-    malloc_stats_mutex->lock();
-    alloc_info_t *alloc_info = (alloc_info_t*)__real__malloc_r(r, size + sizeof(alloc_info_t));
+    uint32_t owner = heap_thread_owner();
+    alloc_info_t *alloc_info = heap_arena_alloc(size, owner);
+    if (alloc_info == NULL) {
+        malloc_stats_mutex->lock();
+        alloc_info = (alloc_info_t*)__real__malloc_r(r, size + sizeof(alloc_info_t));
+        heap_stats_alloc(alloc_info, size, owner);
+        malloc_stats_mutex->unlock();
+    }
     if (alloc_info != NULL) {
-        alloc_info->size = size;
         ptr = (void*)(alloc_info + 1);
-        heap_stats.current_size += size;
-        heap_stats.total_size += size;
-        heap_stats.alloc_cnt += 1;
-        if (heap_stats.current_size > heap_stats.max_size) {
-            heap_stats.max_size = heap_stats.current_size;
-        }
-    } else {
-        heap_stats.alloc_fail_cnt += 1;
     }
-    malloc_stats_mutex->unlock();
 #else // #ifdef MBED_HEAP_STATS_ENABLED
     ptr = __real__malloc_r(r, size);
 #endif // #ifdef MBED_HEAP_STATS_ENABLED
@@ -160,15 +388,18 @@ extern "C" void * __wrap__realloc_r(struct _reent * r, void * ptr, size_t size)
 
 extern "C" void __wrap__free_r(struct _reent * r, void * ptr) {
 #ifdef MBED_HEAP_STATS_ENABLED
-    malloc_stats_mutex->lock();
     alloc_info_t *alloc_info = NULL;
     if (ptr != NULL) {
         alloc_info = ((alloc_info_t*)ptr) - 1;
-        heap_stats.current_size -= alloc_info->size;
-        heap_stats.alloc_cnt -= 1;
     }
-    __real__free_r(r, (void*)alloc_info);
-    malloc_stats_mutex->unlock();
+    if (alloc_info == NULL || !heap_arena_free(alloc_info)) {
+        malloc_stats_mutex->lock();
+        if (alloc_info != NULL) {
+            heap_stats_free(alloc_info);
+        }
+        __real__free_r(r, (void*)alloc_info);
+        malloc_stats_mutex->unlock();
+    }
 #else // #ifdef MBED_HEAP_STATS_ENABLED
     __real__free_r(r, ptr);
 #endif // #ifdef MBED_HEAP_STATS_ENABLED
@@ -245,21 +476,17 @@ extern "C" {
 extern "C" void* SUB_MALLOC(size_t size) {
     void *ptr = NULL;
 #ifdef MBED_HEAP_STATS_ENABLED
-    malloc_stats_mutex->lock();
-    alloc_info_t *alloc_info = (alloc_info_t*)SUPER_MALLOC(size + sizeof(alloc_info_t));
+    uint32_t owner = heap_thread_owner();
+    alloc_info_t *alloc_info = heap_arena_alloc(size, owner);
+    if (alloc_info == NULL) {
+        malloc_stats_mutex->lock();
+        alloc_info = (alloc_info_t*)SUPER_MALLOC(size + sizeof(alloc_info_t));
+        heap_stats_alloc(alloc_info, size, owner);
+        malloc_stats_mutex->unlock();
+    }
     if (alloc_info != NULL) {
-        alloc_info->size = size;
         ptr = (void*)(alloc_info + 1);
-        heap_stats.current_size += size;
-        heap_stats.total_size += size;
-        heap_stats.alloc_cnt += 1;
-        if (heap_stats.current_size > heap_stats.max_size) {
-            heap_stats.max_size = heap_stats.current_size;
-        }
-    } else {
-        heap_stats.alloc_fail_cnt += 1;
     }
-    malloc_stats_mutex->unlock();
 #else // #ifdef MBED_HEAP_STATS_ENABLED
     ptr = SUPER_MALLOC(size);
 #endif // #ifdef MBED_HEAP_STATS_ENABLED
@@ -327,15 +554,18 @@ extern "C" void *SUB_CALLOC(size_t nmemb, size_t size) {
 
 extern "C" void SUB_FREE(void *ptr) {
 #ifdef MBED_HEAP_STATS_ENABLED
-    malloc_stats_mutex->lock();
     alloc_info_t *alloc_info = NULL;
     if (ptr != NULL) {
         alloc_info = ((alloc_info_t*)ptr) - 1;
-        heap_stats.current_size -= alloc_info->size;
-        heap_stats.alloc_cnt -= 1;
     }
-    SUPER_FREE((void*)alloc_info);
-    malloc_stats_mutex->unlock();
+    if (alloc_info == NULL || !heap_arena_free(alloc_info)) {
+        malloc_stats_mutex->lock();
+        if (alloc_info != NULL) {
+            heap_stats_free(alloc_info);
+        }
+        SUPER_FREE((void*)alloc_info);
+        malloc_stats_mutex->unlock();
+    }
 #else // #ifdef MBED_HEAP_STATS_ENABLED
     SUPER_FREE(ptr);
 #endif // #ifdef MBED_HEAP_STATS_ENABLED
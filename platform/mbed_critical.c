@@ -334,3 +334,32 @@ void *core_util_atomic_decr_ptr(void **valuePtr, ptrdiff_t delta) {
     return (void *)core_util_atomic_decr_u32((uint32_t *)valuePtr, (uint32_t)delta);
 }
 
+/* Loads and stores of naturally aligned bytes and words are single-copy atomic,
+ * the barriers provide the ordering with the surrounding memory accesses.
+ * These functions are kept out of line so that they also act as compiler
+ * barriers. */
+uint8_t core_util_atomic_load_u8(const volatile uint8_t *valuePtr)
+{
+    uint8_t value = *valuePtr;
+    __DMB();
+    return value;
+}
+
+uint32_t core_util_atomic_load_u32(const volatile uint32_t *valuePtr)
+{
+    uint32_t value = *valuePtr;
+    __DMB();
+    return value;
+}
+
+void core_util_atomic_store_u8(volatile uint8_t *valuePtr, uint8_t desiredValue)
+{
+    __DMB();
+    *valuePtr = desiredValue;
+}
+
+void core_util_atomic_store_u32(volatile uint32_t *valuePtr, uint32_t desiredValue)
+{
+    __DMB();
+    *valuePtr = desiredValue;
+}
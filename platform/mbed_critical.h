@@ -360,6 +360,50 @@ uint32_t core_util_atomic_decr_u32(uint32_t *valuePtr, uint32_t delta);
  */
 void *core_util_atomic_decr_ptr(void **valuePtr, ptrdiff_t delta);
 
+/**
+ * Atomic load with acquire semantics.
+ *
+ * Memory accesses following the load in program order cannot be performed
+ * before it, which makes it suitable to read an index or a flag published by
+ * another context with core_util_atomic_store_u8().
+ *
+ * @param  valuePtr Target memory location being read.
+ * @return          The loaded value.
+ */
+uint8_t core_util_atomic_load_u8(const volatile uint8_t *valuePtr);
+
+/**
+ * Atomic load with acquire semantics.
+ *
+ * @see core_util_atomic_load_u8
+ *
+ * @param  valuePtr Target memory location being read.
+ * @return          The loaded value.
+ */
+uint32_t core_util_atomic_load_u32(const volatile uint32_t *valuePtr);
+
+/**
+ * Atomic store with release semantics.
+ *
+ * Memory accesses preceding the store in program order are completed before
+ * it is performed, which makes it suitable to publish data to another
+ * context reading it with core_util_atomic_load_u8().
+ *
+ * @param  valuePtr     Target memory location being written.
+ * @param  desiredValue The value to store.
+ */
+void core_util_atomic_store_u8(volatile uint8_t *valuePtr, uint8_t desiredValue);
+
+/**
+ * Atomic store with release semantics.
+ *
+ * @see core_util_atomic_store_u8
+ *
+ * @param  valuePtr     Target memory location being written.
+ * @param  desiredValue The value to store.
+ */
+void core_util_atomic_store_u32(volatile uint32_t *valuePtr, uint32_t desiredValue);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
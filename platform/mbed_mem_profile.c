@@ -0,0 +1,327 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include "platform/mbed_mem_profile.h"
+#include "platform/mbed_mem_trace.h"
+#include "platform/mbed_critical.h"
+
+#ifndef MBED_CONF_PLATFORM_MEM_PROFILE_SITES
+#define MBED_CONF_PLATFORM_MEM_PROFILE_SITES        32
+#endif
+
+#ifndef MBED_CONF_PLATFORM_MEM_PROFILE_ALLOCATIONS
+#define MBED_CONF_PLATFORM_MEM_PROFILE_ALLOCATIONS  256
+#endif
+
+#define SITES           MBED_CONF_PLATFORM_MEM_PROFILE_SITES
+#define ALLOCATIONS     MBED_CONF_PLATFORM_MEM_PROFILE_ALLOCATIONS
+
+/* Entry of the callers which do not fit in the table */
+#define OTHER_SITE      SITES
+
+/* The allocation table is kept at most 3/4 full to bound the probes */
+#define MAX_LIVE        (ALLOCATIONS - ALLOCATIONS / 4)
+
+/******************************************************************************
+ * Internal variables, functions and helpers
+ *****************************************************************************/
+
+typedef struct {
+    void *ptr;
+    uint32_t size;
+    uint16_t site;
+} live_alloc_t;
+
+static mbed_mem_profile_site_t sites[SITES + 1];
+static live_alloc_t allocs[ALLOCATIONS];
+static uint32_t live_cnt;
+static mbed_mem_profile_stats_t profile_stats;
+
+static uint32_t hash(const void *p, uint32_t size) {
+    uint32_t x = (uint32_t)(uintptr_t)p;
+    x ^= x >> 16;
+    x *= 0x45d9f3b;
+    x ^= x >> 16;
+    return x % size;
+}
+
+static uint8_t size_class(uint32_t size) {
+    uint8_t bucket = 0;
+    for (uint32_t limit = 8; size > limit && bucket < MBED_MEM_PROFILE_BUCKETS - 1; limit <<= 1) {
+        bucket++;
+    }
+    return bucket;
+}
+
+/* Callers are never removed, so a probe stops at the caller or a free entry */
+static uint16_t find_site(void *caller) {
+    if (caller == NULL) {
+        return OTHER_SITE;
+    }
+
+    uint32_t i = hash(caller, SITES);
+    for (uint32_t n = 0; n < SITES; n++) {
+        if (sites[i].caller == caller) {
+            return i;
+        }
+        if (sites[i].caller == NULL) {
+            sites[i].caller = caller;
+            profile_stats.site_cnt++;
+            return i;
+        }
+        i = (i + 1) % SITES;
+    }
+    return OTHER_SITE;
+}
+
+static live_alloc_t *find_alloc(void *ptr) {
+    uint32_t i = hash(ptr, ALLOCATIONS);
+    while (allocs[i].ptr != NULL) {
+        if (allocs[i].ptr == ptr) {
+            return &allocs[i];
+        }
+        i = (i + 1) % ALLOCATIONS;
+    }
+    return NULL;
+}
+
+/* Fill the hole left by a removed allocation with the following entries that
+ * were displaced past it, so that probes never need tombstones */
+static void remove_alloc(live_alloc_t *alloc) {
+    uint32_t hole = alloc - allocs;
+    uint32_t i = hole;
+    while (true) {
+        i = (i + 1) % ALLOCATIONS;
+        if (allocs[i].ptr == NULL) {
+            break;
+        }
+
+        uint32_t home = hash(allocs[i].ptr, ALLOCATIONS);
+        if ((i > hole && (home <= hole || home > i)) ||
+            (i < hole && (home <= hole && home > i))) {
+            allocs[hole] = allocs[i];
+            hole = i;
+        }
+    }
+    allocs[hole].ptr = NULL;
+    live_cnt--;
+}
+
+static void account(uint16_t site, uint32_t size) {
+    mbed_mem_profile_site_t *s = &sites[site];
+    s->live_size += size;
+    s->live_cnt++;
+    s->alloc_cnt++;
+    s->size_hist[size_class(size)]++;
+    if (s->live_size > s->max_size) {
+        s->max_size = s->live_size;
+    }
+}
+
+static void profile_alloc(void *res, size_t size, void *caller) {
+    if (res == NULL) {
+        return;
+    }
+
+    uint16_t site = find_site(caller);
+    live_alloc_t *alloc = find_alloc(res);
+    if (alloc) {
+        // Already accounted, e.g. by the malloc() a realloc() is built on
+        sites[alloc->site].live_size -= alloc->size;
+        sites[alloc->site].live_cnt--;
+    } else if (live_cnt < MAX_LIVE) {
+        uint32_t i = hash(res, ALLOCATIONS);
+        while (allocs[i].ptr != NULL) {
+            i = (i + 1) % ALLOCATIONS;
+        }
+        alloc = &allocs[i];
+        alloc->ptr = res;
+        live_cnt++;
+    } else {
+        profile_stats.untracked_cnt++;
+        return;
+    }
+
+    alloc->size = size;
+    alloc->site = site;
+    account(site, size);
+}
+
+static void profile_free(void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+
+    live_alloc_t *alloc = find_alloc(ptr);
+    if (alloc == NULL) {
+        profile_stats.unknown_free_cnt++;
+        return;
+    }
+
+    sites[alloc->site].live_size -= alloc->size;
+    sites[alloc->site].live_cnt--;
+    remove_alloc(alloc);
+}
+
+static size_t put_uint(uint8_t *buffer, size_t size, size_t len, uintptr_t value) {
+    do {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        if (value) {
+            byte |= 0x80;
+        }
+        if (len < size) {
+            buffer[len] = byte;
+        }
+        len++;
+    } while (value);
+    return len;
+}
+
+/******************************************************************************
+ * Public interface
+ *****************************************************************************/
+
+void mbed_mem_profile_callback(uint8_t op, void *res, void *caller, ...) {
+    va_list va;
+    void *ptr;
+    size_t size;
+
+    va_start(va, caller);
+    core_util_critical_section_enter();
+    switch (op) {
+        case MBED_MEM_TRACE_MALLOC:
+            size = va_arg(va, size_t);
+            profile_alloc(res, size, caller);
+            break;
+
+        case MBED_MEM_TRACE_REALLOC:
+            ptr = va_arg(va, void*);
+            size = va_arg(va, size_t);
+            // A failed realloc() leaves the memory allocated, and the free()
+            // and malloc() it may be built on are already accounted
+            if (ptr != res && (res != NULL || size == 0) && find_alloc(ptr)) {
+                profile_free(ptr);
+            }
+            profile_alloc(res, size, caller);
+            break;
+
+        case MBED_MEM_TRACE_CALLOC:
+            size = va_arg(va, size_t);
+            size *= va_arg(va, size_t);
+            profile_alloc(res, size, caller);
+            break;
+
+        case MBED_MEM_TRACE_FREE:
+            ptr = va_arg(va, void*);
+            profile_free(ptr);
+            break;
+
+        default:
+            break;
+    }
+    core_util_critical_section_exit();
+    va_end(va);
+}
+
+void mbed_mem_profile_reset(void) {
+    core_util_critical_section_enter();
+    memset(sites, 0, sizeof(sites));
+    memset(allocs, 0, sizeof(allocs));
+    memset(&profile_stats, 0, sizeof(profile_stats));
+    live_cnt = 0;
+    core_util_critical_section_exit();
+}
+
+void mbed_mem_profile_get_stats(mbed_mem_profile_stats_t *stats) {
+    core_util_critical_section_enter();
+    memcpy(stats, &profile_stats, sizeof(mbed_mem_profile_stats_t));
+    core_util_critical_section_exit();
+}
+
+size_t mbed_mem_profile_get(mbed_mem_profile_site_t *out, size_t count) {
+    size_t filled = 0;
+
+    for (uint32_t i = 0; i <= SITES && count; i++) {
+        // Copy one entry at a time to keep interrupts enabled while sorting
+        mbed_mem_profile_site_t site;
+        core_util_critical_section_enter();
+        memcpy(&site, &sites[i], sizeof(site));
+        core_util_critical_section_exit();
+        if (site.alloc_cnt == 0) {
+            continue;
+        }
+
+        size_t j = filled < count ? filled++ : count;
+        while (j > 0 && out[j - 1].live_size < site.live_size) {
+            if (j < count) {
+                out[j] = out[j - 1];
+            }
+            j--;
+        }
+        if (j < count) {
+            out[j] = site;
+        }
+    }
+    return filled;
+}
+
+size_t mbed_mem_profile_dump(uint8_t *buffer, size_t size) {
+    mbed_mem_profile_stats_t stats;
+    mbed_mem_profile_get_stats(&stats);
+
+    // The entries are counted again as they are copied, callers may be added
+    // in between
+    uint32_t entries = 0;
+    for (uint32_t i = 0; i <= SITES; i++) {
+        if (sites[i].alloc_cnt) {
+            entries++;
+        }
+    }
+
+    size_t len = 0;
+    const uint8_t header[] = {'M', 'P', MBED_MEM_PROFILE_DUMP_VERSION, MBED_MEM_PROFILE_BUCKETS};
+    for (uint32_t i = 0; i < sizeof(header); i++) {
+        len = put_uint(buffer, size, len, header[i]);
+    }
+    len = put_uint(buffer, size, len, entries);
+    len = put_uint(buffer, size, len, stats.untracked_cnt);
+    len = put_uint(buffer, size, len, stats.unknown_free_cnt);
+
+    for (uint32_t i = 0; i <= SITES && entries; i++) {
+        mbed_mem_profile_site_t site;
+        core_util_critical_section_enter();
+        memcpy(&site, &sites[i], sizeof(site));
+        core_util_critical_section_exit();
+        if (site.alloc_cnt == 0) {
+            continue;
+        }
+        entries--;
+
+        len = put_uint(buffer, size, len, (uintptr_t)site.caller);
+        len = put_uint(buffer, size, len, site.live_size);
+        len = put_uint(buffer, size, len, site.max_size);
+        len = put_uint(buffer, size, len, site.live_cnt);
+        len = put_uint(buffer, size, len, site.alloc_cnt);
+        for (uint32_t j = 0; j < MBED_MEM_PROFILE_BUCKETS; j++) {
+            len = put_uint(buffer, size, len, site.size_hist[j]);
+        }
+    }
+    return len;
+}
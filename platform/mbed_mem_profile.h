@@ -0,0 +1,119 @@
+/** \addtogroup platform */
+/** @{*/
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MBED_MEM_PROFILE_H__
+#define __MBED_MEM_PROFILE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Number of size classes in the histogram of each caller: up to 8 bytes,
+ * up to 16 bytes, and so on up to 512 bytes, then larger allocations */
+#define MBED_MEM_PROFILE_BUCKETS        8
+
+/* Version of the format written by mbed_mem_profile_dump() */
+#define MBED_MEM_PROFILE_DUMP_VERSION   1
+
+typedef struct {
+    void *caller;               /**< Caller of the allocations, NULL for the callers that did not fit in the table. */
+    uint32_t live_size;         /**< Bytes allocated currently. */
+    uint32_t max_size;          /**< Max bytes allocated at a given time. */
+    uint32_t live_cnt;          /**< Current number of allocations. */
+    uint32_t alloc_cnt;         /**< Cumulative number of allocations. */
+    uint32_t size_hist[MBED_MEM_PROFILE_BUCKETS]; /**< Cumulative number of allocations in each size class. */
+} mbed_mem_profile_site_t;
+
+typedef struct {
+    uint32_t site_cnt;          /**< Number of callers in the table. */
+    uint32_t untracked_cnt;     /**< Allocations not accounted for as too many allocations were live. */
+    uint32_t unknown_free_cnt;  /**< Frees of memory not allocated while profiling. */
+} mbed_mem_profile_stats_t;
+
+/**
+ * Memory trace callback aggregating the allocations by caller. Install it with
+ * 'mbed_mem_trace_set_callback(mbed_mem_profile_callback)', or call it from
+ * another callback.
+ *
+ * Callers are kept in a table of MBED_CONF_PLATFORM_MEM_PROFILE_SITES entries,
+ * and live allocations in a table of MBED_CONF_PLATFORM_MEM_PROFILE_ALLOCATIONS
+ * entries so that they are accounted to their caller when freed. Both tables
+ * are statically allocated and hashed, so each memory operation costs a bounded
+ * time with interrupts disabled. Callers which do not fit share an entry whose
+ * caller is NULL, and allocations which do not fit are only counted.
+ *
+ * See 'mbed_mem_trace_cb_t' for the parameters.
+ */
+void mbed_mem_profile_callback(uint8_t op, void *res, void *caller, ...);
+
+/**
+ * Clear the profile, e.g. before installing the callback.
+ */
+void mbed_mem_profile_reset(void);
+
+/**
+ * Fill the passed in structure with the state of the profile tables.
+ *
+ * @param stats     A pointer to the mbed_mem_profile_stats_t structure to fill
+ */
+void mbed_mem_profile_get_stats(mbed_mem_profile_stats_t *stats);
+
+/**
+ * Fill the passed array with the callers using the most memory currently,
+ * sorted by decreasing live_size.
+ *
+ * @param sites     A pointer to an array of mbed_mem_profile_site_t structures to fill
+ * @param count     The number of mbed_mem_profile_site_t structures in the provided array
+ * @return          The number of mbed_mem_profile_site_t structures that have been filled
+ */
+size_t mbed_mem_profile_get(mbed_mem_profile_site_t *sites, size_t count);
+
+/**
+ * Write the profile in a compact binary form, e.g. to send it to a host.
+ *
+ * The dump starts with the bytes 'M', 'P', MBED_MEM_PROFILE_DUMP_VERSION and
+ * MBED_MEM_PROFILE_BUCKETS. The numbers that follow are unsigned LEB128
+ * (7 bits per byte, least significant first, top bit set on all but the last
+ * byte):
+ *
+ * - the number of callers that follow, then untracked_cnt and
+ *   unknown_free_cnt of mbed_mem_profile_stats_t
+ * - for each caller: the caller address, live_size, max_size, live_cnt,
+ *   alloc_cnt and the MBED_MEM_PROFILE_BUCKETS entries of size_hist
+ *
+ * The entry of the callers which did not fit in the table comes last, with a
+ * caller address of 0, if any allocation was accounted to it.
+ *
+ * @param buffer    Buffer to write the dump to, may be NULL if size is 0
+ * @param size      Size of the buffer in bytes
+ * @return          The size of the complete dump, which was only written in
+ *                  full if it is not larger than 'size'
+ */
+size_t mbed_mem_profile_dump(uint8_t *buffer, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif// #ifndef __MBED_MEM_PROFILE_H__
+
+
+/** @}*/
@@ -13,62 +13,211 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <errno.h>
+#include <new>
 #include "mbed_poll.h"
 #include "FileHandle.h"
 #include "Timer.h"
+#include "platform/mbed_critical.h"
 #ifdef MBED_CONF_RTOS_PRESENT
-#include "rtos/Thread.h"
+#include "rtos/Semaphore.h"
 #endif
 
+#ifndef MBED_CONF_PLATFORM_POLL_RESCAN_INTERVAL
+#define MBED_CONF_PLATFORM_POLL_RESCAN_INTERVAL 10
+#endif
+
+// Number of file handles poll() can wait on without allocating
+#define POLL_WAITERS_STACK  4
+
 namespace mbed {
 
+struct poll_wait;
+
+/* One per file handle and poll() call, linked on the file handle so that
+ * wake_pollers() only touches the callers waiting on it */
+struct poll_waiter {
+    poll_waiter *next;          // Next waiter on the same file handle
+    poll_waiter *next_ready;    // Next signalled waiter of the same poll() call
+    poll_wait *wait;
+    unsigned index;
+    bool ready;
+};
+
+struct poll_wait {
+#ifdef MBED_CONF_RTOS_PRESENT
+    rtos::Semaphore sem;
+#endif
+    poll_waiter *ready;         // Waiters signalled since the last scan
+    volatile bool signalled;
+
+    poll_wait() :
+#ifdef MBED_CONF_RTOS_PRESENT
+        sem(0, 1),
+#endif
+        ready(NULL), signalled(false) {}
+};
+
+void FileHandle::wake_pollers()
+{
+    core_util_critical_section_enter();
+    for (poll_waiter *w = _poll_waiters; w; w = w->next) {
+        if (w->ready) {
+            continue;
+        }
+        w->ready = true;
+        w->next_ready = w->wait->ready;
+        w->wait->ready = w;
+        if (!w->wait->signalled) {
+            w->wait->signalled = true;
+#ifdef MBED_CONF_RTOS_PRESENT
+            w->wait->sem.release();
+#endif
+        }
+    }
+    core_util_critical_section_exit();
+}
+
+static int poll_scan(pollfh *fh)
+{
+    short mask = fh->events | POLLERR | POLLHUP | POLLNVAL;
+    if (fh->fh) {
+        fh->revents = fh->fh->poll(mask) & mask;
+    } else {
+        fh->revents = POLLNVAL;
+    }
+    return fh->revents ? 1 : 0;
+}
+
+// File handles which don't call wake_pollers() are rescanned periodically
+static bool poll_periodic(pollfh *fh)
+{
+    return fh->fh && !fh->fh->wakes_pollers();
+}
+
 // timeout -1 forever, or milliseconds
 int poll(pollfh fhs[], unsigned nfhs, int timeout)
 {
-    /**
-     * TODO Proper wake-up mechanism.
-     * In order to correctly detect availability of read/write a FileHandle, we needed
-     * a select or poll mechanisms. We opted for poll as POSIX defines in
-     * http://pubs.opengroup.org/onlinepubs/009695399/functions/poll.html Currently,
-     * mbed::poll() just spins and scans filehandles looking for any events we are
-     * interested in. In future, his spinning behaviour will be replaced with
-     * condition variables.
-     */
+    /* Every file handle gets a waiter registered before the first scan, so
+     * that no event between the scan and the wait gets lost. Once woken, only
+     * the file handles that signalled are scanned again. File handles which
+     * don't declare that they call wake_pollers() are rescanned at the
+     * platform.poll-rescan-interval instead. */
+    int count = 0;
+    if (timeout == 0) {
+        for (unsigned n = 0; n < nfhs; n++) {
+            count += poll_scan(&fhs[n]);
+        }
+        return count;
+    }
+
+    poll_waiter stack_waiters[POLL_WAITERS_STACK];
+    poll_waiter *waiters = stack_waiters;
+    if (nfhs > POLL_WAITERS_STACK) {
+        waiters = new (std::nothrow) poll_waiter[nfhs];
+        if (!waiters) {
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+
+    poll_wait wait;
+    bool periodic = false;
+    for (unsigned n = 0; n < nfhs; n++) {
+        periodic = periodic || poll_periodic(&fhs[n]);
+
+        poll_waiter *w = &waiters[n];
+        w->wait = &wait;
+        w->index = n;
+        w->ready = false;
+        w->next_ready = NULL;
+        w->next = NULL;
+        if (fhs[n].fh) {
+            core_util_critical_section_enter();
+            w->next = fhs[n].fh->_poll_waiters;
+            fhs[n].fh->_poll_waiters = w;
+            core_util_critical_section_exit();
+        }
+    }
+
     Timer timer;
     if (timeout > 0) {
         timer.start();
     }
 
-    int count = 0;
-    for (;;) {
-        /* Scan the file handles */
-        for (unsigned n = 0; n < nfhs; n++) {
-            FileHandle *fh = fhs[n].fh;
-            short mask = fhs[n].events | POLLERR | POLLHUP | POLLNVAL;
-            if (fh) {
-                fhs[n].revents = fh->poll(mask) & mask;
-            } else {
-                fhs[n].revents = POLLNVAL;
-            }
-            if (fhs[n].revents) {
-                count++;
+    for (unsigned n = 0; n < nfhs; n++) {
+        count += poll_scan(&fhs[n]);
+    }
+
+    while (!count) {
+        int wait_ms = timeout;
+        if (timeout > 0) {
+            wait_ms = timeout - timer.read_ms();
+            if (wait_ms <= 0) {
+                break;
             }
         }
 
-        if (count) {
-            break;
+        bool rescan = false;
+        if (periodic && MBED_CONF_PLATFORM_POLL_RESCAN_INTERVAL >= 0 &&
+                (wait_ms < 0 || wait_ms > MBED_CONF_PLATFORM_POLL_RESCAN_INTERVAL)) {
+            wait_ms = MBED_CONF_PLATFORM_POLL_RESCAN_INTERVAL;
+            rescan = true;
         }
 
-        /* Nothing selected - this is where timeout handling would be needed */
-        if (timeout == 0 || (timeout > 0 && timer.read_ms() > timeout)) {
-            break;
-        }
 #ifdef MBED_CONF_RTOS_PRESENT
-        // TODO - proper blocking
-        // wait for condition variable, wait queue whatever here
-        rtos::Thread::yield();
+        if (wait.sem.wait(wait_ms < 0 ? osWaitForever : wait_ms) > 0) {
+            rescan = false;
+        }
+#else
+        /* Without an RTOS there is nothing to block on, keep scanning */
+        rescan = true;
 #endif
+
+        core_util_critical_section_enter();
+        poll_waiter *ready = wait.ready;
+        wait.ready = NULL;
+        wait.signalled = false;
+        core_util_critical_section_exit();
+
+        /* A waiter is requeued if its file handle signals again once its
+         * ready flag is cleared, so clear it before scanning */
+        while (ready) {
+            poll_waiter *w = ready;
+            ready = w->next_ready;
+            core_util_critical_section_enter();
+            w->ready = false;
+            core_util_critical_section_exit();
+            if (!rescan || !poll_periodic(&fhs[w->index])) {
+                count += poll_scan(&fhs[w->index]);
+            }
+        }
+
+        if (rescan) {
+            for (unsigned n = 0; n < nfhs; n++) {
+                if (poll_periodic(&fhs[n])) {
+                    count += poll_scan(&fhs[n]);
+                }
+            }
+        }
     }
+
+    for (unsigned n = 0; n < nfhs; n++) {
+        if (fhs[n].fh) {
+            core_util_critical_section_enter();
+            poll_waiter **p = &fhs[n].fh->_poll_waiters;
+            while (*p != &waiters[n]) {
+                p = &(*p)->next;
+            }
+            *p = waiters[n].next;
+            core_util_critical_section_exit();
+        }
+    }
+
+    if (waiters != stack_waiters) {
+        delete[] waiters;
+    }
+
     return count;
 }
 
@@ -39,6 +39,7 @@ typedef int mode_t;     ///< Mode for opening files
 #define O_CREAT  0x0200
 #define O_TRUNC  0x0400
 #define O_APPEND 0x0008
+#define O_DIRECT 0x80000
 
 #define NAME_MAX 255    ///< Maximum size of a name in a file path
 
@@ -46,6 +47,10 @@ typedef int mode_t;     ///< Mode for opening files
 #include <sys/fcntl.h>
 #include <sys/types.h>
 #include <sys/syslimits.h>
+
+#ifndef O_DIRECT
+#define O_DIRECT 0x80000  ///< Transfer aligned data directly to the device
+#endif
 #endif
 
 
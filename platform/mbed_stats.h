@@ -41,6 +41,33 @@ typedef struct {
  */
 void mbed_stats_heap_get(mbed_stats_heap_t *stats);
 
+typedef struct {
+    uint32_t thread_id;         /**< Identifier for thread the allocations are accounted to, 0 for interrupts and threads that did not fit. */
+    mbed_stats_heap_t heap;     /**< Heap stats of the allocations made by the thread, reserved_size is the size of its arena. */
+} mbed_stats_heap_thread_t;
+
+/**
+ *  Fill the passed in heap stat structure with the heap stats of the allocations made by a thread,
+ *  wherever they are freed. Threads are tracked when the platform.heap-stats-threads configuration
+ *  is set, the first ones to allocate memory get a slot while the others share thread_id 0. A
+ *  terminated thread keeps its slot until all its allocations are freed.
+ *
+ *  @param thread_id    Identifier of the thread, as returned by rtos::Thread::gettid() in the thread
+ *  @param stats        A pointer to the mbed_stats_heap_t structure to fill
+ *  @return             0 on success, -1 if the thread is not tracked
+ */
+int mbed_stats_heap_get_thread(uint32_t thread_id, mbed_stats_heap_t *stats);
+
+/**
+ *  Fill the passed array of stat structures with the heap stats of each tracked thread which
+ *  allocated memory.
+ *
+ *  @param stats    A pointer to an array of mbed_stats_heap_thread_t structures to fill
+ *  @param count    The number of mbed_stats_heap_thread_t structures in the provided array
+ *  @return         The number of mbed_stats_heap_thread_t structures that have been filled
+ */
+size_t mbed_stats_heap_get_each(mbed_stats_heap_thread_t *stats, size_t count);
+
 typedef struct {
     uint32_t thread_id;         /**< Identifier for thread that owns the stack or 0 if multiple threads. */
     uint32_t max_size;          /**< Maximum number of bytes used on the stack. */
@@ -20,6 +20,7 @@
 // math.h required for floating point operations for baud rate calculation
 #include <math.h>
 #include "mbed_assert.h"
+#include "mbed_critical.h"
 
 #include <string.h>
 
@@ -83,6 +84,7 @@ void serial_init(serial_t *obj, PinName tx, PinName rx)
     obj->serial.uartDmaRx.dmaUsageState = DMA_USAGE_OPPORTUNISTIC;;
     obj->serial.txstate = kUART_TxIdle;
     obj->serial.rxstate = kUART_RxIdle;
+    obj->rx_buff.pos = 0;
 
     /* Zero the handle. */
     memset(&(obj->serial.uart_transfer_handle), 0, sizeof(obj->serial.uart_transfer_handle));
@@ -608,6 +610,30 @@ uint8_t serial_rx_active(serial_t *obj)
     return 1;
 }
 
+int serial_rx_asynch_count(serial_t *obj)
+{
+    uint32_t count;
+    status_t status;
+
+    /* Once complete or aborted, pos holds the number of bytes received */
+    if (obj->serial.rxstate == kUART_RxIdle) {
+        return obj->rx_buff.pos;
+    }
+
+    if (obj->serial.uartDmaRx.dmaUsageState == DMA_USAGE_ALLOCATED || obj->serial.uartDmaRx.dmaUsageState == DMA_USAGE_TEMPORARY_ALLOCATED) {
+        status = UART_TransferGetReceiveCountEDMA(uart_addrs[obj->serial.index], &obj->serial.uart_dma_handle, &count);
+    } else {
+        status = UART_TransferGetReceiveCount(uart_addrs[obj->serial.index], &obj->serial.uart_transfer_handle, &count);
+    }
+
+    /* The driver is idle before the completion interrupt is handled */
+    if (status != kStatus_Success) {
+        return obj->rx_buff.length;
+    }
+
+    return count;
+}
+
 int serial_irq_handler_asynch(serial_t *obj)
 {
     int status = 0;
@@ -624,6 +650,7 @@ int serial_irq_handler_asynch(serial_t *obj)
 
         if ((obj->serial.rxstate != kUART_RxIdle) && (obj->serial.uart_dma_handle.rxState == kUART_RxIdle)) {
             obj->serial.rxstate = kUART_RxIdle;
+            obj->rx_buff.pos = obj->rx_buff.length;
             status |= SERIAL_EVENT_RX_COMPLETE;
         }
 
@@ -645,6 +672,7 @@ int serial_irq_handler_asynch(serial_t *obj)
 
         if ((obj->serial.rxstate != kUART_RxIdle) && (obj->serial.uart_transfer_handle.rxState == kUART_RxIdle)) {
             obj->serial.rxstate = kUART_RxIdle;
+            obj->rx_buff.pos = obj->rx_buff.length;
             status |= SERIAL_EVENT_RX_COMPLETE;
         }
     }
@@ -696,6 +724,11 @@ void serial_tx_abort_asynch(serial_t *obj)
 void serial_rx_abort_asynch(serial_t *obj)
 {
     if (obj->serial.uartDmaRx.dmaUsageState == DMA_USAGE_ALLOCATED || obj->serial.uartDmaRx.dmaUsageState == DMA_USAGE_TEMPORARY_ALLOCATED) {
+        /* Stop the requests first, so that the count cannot change anymore */
+        UART_EnableRxDMA(uart_addrs[obj->serial.index], false);
+        if (obj->serial.rxstate != kUART_RxIdle) {
+            obj->rx_buff.pos = serial_rx_asynch_count(obj);
+        }
         UART_TransferAbortReceiveEDMA(uart_addrs[obj->serial.index], &obj->serial.uart_dma_handle);
         /* Release the dma channels if they were opportunistically allocated */
         if (obj->serial.uartDmaRx.dmaUsageState == DMA_USAGE_TEMPORARY_ALLOCATED) {
@@ -707,8 +740,15 @@ void serial_rx_abort_asynch(serial_t *obj)
             }
         }
     } else {
+        core_util_critical_section_enter();
+        if (obj->serial.rxstate != kUART_RxIdle) {
+            obj->rx_buff.pos = serial_rx_asynch_count(obj);
+        }
         UART_TransferAbortReceive(uart_addrs[obj->serial.index], &obj->serial.uart_transfer_handle);
+        core_util_critical_section_exit();
     }
+
+    obj->serial.rxstate = kUART_RxIdle;
 }
 
 #endif